@@ -1,9 +1,6 @@
 #version 410
 
-struct ViewProjTransforms {
-	mat4 view_projection;
-	mat4 view_projection_inverse;
-};
+#include "common/view_proj_transforms.glsl"
 
 layout(std140) uniform CameraViewProjTransforms {
 	ViewProjTransforms camera;
@@ -17,12 +14,48 @@ uniform int light_index;
 
 uniform sampler2D depth_texture;
 uniform sampler2D normal_texture;
+uniform sampler2D diffuse_texture;
 uniform sampler2D shadow_texture;
+uniform sampler2DShadow shadow_compare_texture;
+uniform sampler2D shadow_moments_texture;
+
+// Must match the values of `ShadowFiltering` in src/EDAN35/assignment2.cpp.
+const int shadow_filtering_reference_5x5   = 0;
+const int shadow_filtering_hardware_poisson = 1;
+const int shadow_filtering_vsm             = 2;
+const int shadow_filtering_evsm            = 3;
+
+uniform int shadow_filtering;
+uniform int poisson_taps_nb;
+uniform float poisson_radius;
+uniform float shadow_bias;
+uniform float light_bleeding_reduction;
+uniform vec2 evsm_exponents;
+uniform vec2 light_near_far;
+
+uniform bool use_compact_gbuffer;
 
 uniform vec2 inverse_screen_resolution;
 
+// Size of the viewport divided by the size of the G-buffer targets, as the
+// G-buffer might only be partially filled when using dynamic resolution.
+uniform vec2 render_scale;
+
 uniform vec3 camera_position;
 
+// When lights are accumulated over several frames, each pixel only
+// evaluates this light every `lights_interleave` frames, following an
+// ordered dithering pattern, and weights it accordingly.
+uniform int lights_interleave;
+uniform int frame_index;
+
+const int bayer_4x4[16] = int[](
+	 0,  8,  2, 10,
+	12,  4, 14,  6,
+	 3, 11,  1,  9,
+	15,  7, 13,  5
+);
+
 uniform vec3 light_color;
 uniform vec3 light_position;
 uniform vec3 light_direction;
@@ -32,14 +65,123 @@ uniform float light_angle_falloff;
 layout(location = 0) out vec4 light_diffuse_contribution;
 layout(location = 1) out vec4 light_specular_contribution;
 
-void main() {
+const vec2 poisson_disk[16] = vec2[](
+	vec2(-0.94201624, -0.39906216), vec2( 0.94558609, -0.76890725),
+	vec2(-0.09418410, -0.92938870), vec2( 0.34495938,  0.29387760),
+	vec2(-0.91588581,  0.45771432), vec2(-0.81544232, -0.87912464),
+	vec2(-0.38277543,  0.27676845), vec2( 0.97484398,  0.75648379),
+	vec2( 0.44323325, -0.97511554), vec2( 0.53742981, -0.47373420),
+	vec2(-0.26496911, -0.41893023), vec2( 0.79197514,  0.19090188),
+	vec2(-0.24188840,  0.99706507), vec2(-0.81409955,  0.91437590),
+	vec2( 0.19984126,  0.78641367), vec2( 0.14383161, -0.14100290)
+);
+
+#include "octahedral.glsl"
+
+// Maps a depth value read from the shadow map to a linear depth in [0, 1]
+// between the near and far planes of the light; this has to match what
+// shadow_moments.frag stores.
+float linearise_light_depth(float window_depth)
+{
+	float n = light_near_far.x;
+	float f = light_near_far.y;
+	float view_depth = 2.0 * n * f / (f + n - (window_depth * 2.0 - 1.0) * (f - n));
+	return (view_depth - n) / (f - n);
+}
+
+float chebyshev_upper_bound(vec2 moments, float depth, float min_variance)
+{
+	if (depth <= moments.x)
+		return 1.0;
+
+	float variance = max(moments.y - moments.x * moments.x, min_variance);
+	float d = depth - moments.x;
+	float p_max = variance / (variance + d * d);
+
+	// Cut off the tail of the distribution to hide light bleeding.
+	return clamp((p_max - light_bleeding_reduction) / (1.0 - light_bleeding_reduction), 0.0, 1.0);
+}
+
+// The derivatives of `shadowmap_coord` are given explicitly, as they are
+// computed before pixels start taking different paths.
+float compute_visibility(vec3 shadowmap_coord, vec2 shadowmap_coord_dx, vec2 shadowmap_coord_dy)
+{
+	if (shadow_filtering == shadow_filtering_hardware_poisson) {
+		vec2 shadowmap_texel_size = 1.0 / textureSize(shadow_compare_texture, 0);
+
+		// Rotate the kernel per pixel to trade banding for noise.
+		float angle = 6.28318530718 * fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+		mat2 rotation = mat2(cos(angle), sin(angle), -sin(angle), cos(angle));
+
+		// Each tap is a 2x2 bilinear-weighted comparison done by the sampler.
+		float visibility = 0.0;
+		for (int i = 0; i < poisson_taps_nb; ++i) {
+			vec2 offset = rotation * poisson_disk[i] * poisson_radius * shadowmap_texel_size;
+			visibility += texture(shadow_compare_texture, vec3(shadowmap_coord.xy + offset, shadowmap_coord.z - shadow_bias));
+		}
+		return visibility / float(poisson_taps_nb);
+	}
+
+	if (shadow_filtering == shadow_filtering_vsm) {
+		vec2 moments = textureGrad(shadow_moments_texture, shadowmap_coord.xy, shadowmap_coord_dx, shadowmap_coord_dy).xy;
+		return chebyshev_upper_bound(moments, linearise_light_depth(shadowmap_coord.z), 0.00002);
+	}
+
+	if (shadow_filtering == shadow_filtering_evsm) {
+		vec4 moments = textureGrad(shadow_moments_texture, shadowmap_coord.xy, shadowmap_coord_dx, shadowmap_coord_dy);
+		float depth = linearise_light_depth(shadowmap_coord.z) * 2.0 - 1.0;
+		vec2 warped_depth = vec2(exp(evsm_exponents.x * depth), -exp(-evsm_exponents.y * depth));
+		vec2 depth_scale = 0.0001 * evsm_exponents * warped_depth;
+		vec2 min_variance = depth_scale * depth_scale;
+		float positive = chebyshev_upper_bound(moments.xy, warped_depth.x, min_variance.x);
+		float negative = chebyshev_upper_bound(moments.zw, warped_depth.y, min_variance.y);
+		return min(positive, negative);
+	}
+
+	// Reference: 25 unfiltered depth comparisons per pixel.
 	vec2 shadowmap_texel_size = 1.0 / textureSize(shadow_texture, 0);
-	vec2 texcoord = gl_FragCoord.xy * inverse_screen_resolution;
-	vec3 normal = texture(normal_texture, texcoord).xyz * 2.0 - 1.0;
-	vec4 position = vec4((2 * texcoord - 1), texture(depth_texture, texcoord).x * 2 - 1, 1);
+	float visibility = 0.0;
+	for (int x = -2; x <= 2; x++) {
+		for (int y = -2; y <= 2; y++) {
+			vec2 offset = vec2(x, y) * shadowmap_texel_size;
+			float shadow_depth = texture(shadow_texture, shadowmap_coord.xy + offset).x;
+			if (shadow_depth >= shadowmap_coord.z - shadow_bias) {
+				visibility += 1.0;
+			}
+		}
+	}
+	return visibility / 25.0;
+}
+
+void main() {
+	vec2 screen_texcoord = gl_FragCoord.xy * inverse_screen_resolution;
+	vec2 texcoord = screen_texcoord * render_scale;
+	vec3 normal = use_compact_gbuffer ? decode_octahedral(texture(normal_texture, texcoord).xy)
+	                                  : texture(normal_texture, texcoord).xyz * 2.0 - 1.0;
+	vec4 position = vec4((2 * screen_texcoord - 1), texture(depth_texture, texcoord).x * 2 - 1, 1);
 	vec4 world_position = camera.view_projection_inverse * position;
 	world_position /= world_position.w;
 
+	vec4 shadowmap_position = lights[light_index].view_projection * world_position;
+	shadowmap_position.xyz /= shadowmap_position.w;
+	shadowmap_position.xyz = shadowmap_position.xyz * 0.5 + 0.5;
+	vec2 shadowmap_position_dx = dFdx(shadowmap_position.xy);
+	vec2 shadowmap_position_dy = dFdy(shadowmap_position.xy);
+
+	float interleave_weight = 1.0;
+	if (lights_interleave > 1) {
+		ivec2 pattern_coord = ivec2(gl_FragCoord.xy) & 3;
+		int rank = bayer_4x4[pattern_coord.y * 4 + pattern_coord.x];
+		if ((rank + light_index + frame_index) % lights_interleave != 0) {
+			// Add nothing rather than discarding, as the stencil still
+			// needs to be reset.
+			light_diffuse_contribution = vec4(0.0, 0.0, 0.0, 1.0);
+			light_specular_contribution = vec4(0.0, 0.0, 0.0, 1.0);
+			return;
+		}
+		interleave_weight = float(lights_interleave);
+	}
+
 	vec3 light_dir = normalize(light_position - world_position.xyz);
 	float light_distance = length(light_position - world_position.xyz);
 	float light_attenuation = 1.0 / (1 + (light_distance * light_distance * 0.000003));
@@ -52,23 +194,21 @@ void main() {
 	vec3 view_dir = normalize(camera_position - world_position.xyz);
 	vec3 reflect_dir = reflect(-light_dir, normal);
 
-	vec4 shadowmap_position = lights[light_index].view_projection * world_position;
-	shadowmap_position.xyz /= shadowmap_position.w;
-	shadowmap_position.xy = shadowmap_position.xy * 0.5 + 0.5;
-	float shadow = 1.0;
-	for (int x = -2; x <= 2; x++) {
-		for (int y = -2; y <= 2; y++) {
-			vec2 offset = vec2(x, y) * shadowmap_texel_size;
-			float shadow_depth = texture(shadow_texture, shadowmap_position.xy + offset).x;
-			float depth = shadowmap_position.z;
-			if (shadow_depth < depth) {
-				shadow -= 1.0 / 30.0;
-			}
-		}
-	}
+	float shadow = compute_visibility(shadowmap_position.xyz, shadowmap_position_dx, shadowmap_position_dy);
+
+	vec3 light = light_color * light_attenuation * angle_falloff * shadow * light_intensity / 400000.0 * interleave_weight;
 
-	vec3 light = light_color * light_attenuation * angle_falloff * shadow * light_intensity / 400000.0;
+	vec3 diffuse = light * max(ndotl, 0.0);
+	vec3 specular = light * max(dot(view_dir, reflect_dir), 0.0);
 
-	light_diffuse_contribution = vec4(light * max(ndotl, 0.0), 1.0);
-	light_specular_contribution = vec4(light * max(dot(view_dir, reflect_dir), 0.0), 1.0);
+	if (use_compact_gbuffer) {
+		// Apply the material here so that a single target is accumulated
+		// into; `light_specular_contribution` has no attachment.
+		vec4 material = texture(diffuse_texture, texcoord);
+		light_diffuse_contribution = vec4(diffuse * material.rgb + specular * material.a, 1.0);
+		light_specular_contribution = vec4(0.0);
+	} else {
+		light_diffuse_contribution = vec4(diffuse, 1.0);
+		light_specular_contribution = vec4(specular, 1.0);
+	}
 }
@@ -1,10 +1,6 @@
 #version 410
 
-struct ViewProjTransforms
-{
-	mat4 view_projection;
-	mat4 view_projection_inverse;
-};
+#include "common/view_proj_transforms.glsl"
 
 layout (std140) uniform CameraViewProjTransforms
 {
@@ -0,0 +1,28 @@
+#version 410
+
+#include "common/view_proj_transforms.glsl"
+
+layout (std140) uniform CameraViewProjTransforms
+{
+	ViewProjTransforms camera;
+};
+
+uniform mat4 vertex_model_to_world;
+
+layout (location = 0) in vec3 vertex;
+layout (location = 2) in vec3 texcoord;
+
+out VS_OUT {
+	vec2 texcoord;
+} vs_out;
+
+// The G-buffer is filled with an equal depth test against the output of
+// this pass, so both have to compute the exact same depths.
+invariant gl_Position;
+
+void main()
+{
+	vs_out.texcoord = texcoord.xy;
+
+	gl_Position = camera.view_projection * vertex_model_to_world * vec4(vertex, 1.0);
+}
@@ -0,0 +1,45 @@
+#version 410
+
+// One level of the pyramid the lights get accumulated at, when they are
+// evaluated at a lower resolution than the G-buffer: each texel covers 2x2
+// texels of the level above.
+
+uniform sampler2D depth_texture;         // Representative depth of the source level
+uniform sampler2D min_max_depth_texture; // Depth range of the source level, unless it is the G-buffer
+uniform sampler2D normal_texture;
+
+uniform bool is_first_level;
+uniform ivec2 source_size; // Area of the source level that was rendered to, in texels
+
+layout (location = 0) out vec4 normal;
+layout (location = 1) out vec2 min_max_depth;
+
+void main()
+{
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+	ivec2 source_base = texel * 2;
+
+	// Alternating between the closest and the farthest sample, in a
+	// checkerboard pattern, keeps both sides of depth discontinuities
+	// represented at the lower resolution.
+	bool keep_closest = ((texel.x + texel.y) & 1) == 0;
+
+	float representative_depth = keep_closest ? 1.0 : 0.0;
+	ivec2 representative_texel = source_base;
+	vec2 depth_range = vec2(1.0, 0.0);
+	for (int i = 0; i < 4; ++i) {
+		ivec2 source_texel = min(source_base + ivec2(i & 1, i >> 1), source_size - 1);
+		float depth = texelFetch(depth_texture, source_texel, 0).x;
+		vec2 range = is_first_level ? vec2(depth) : texelFetch(min_max_depth_texture, source_texel, 0).xy;
+		depth_range = vec2(min(depth_range.x, range.x), max(depth_range.y, range.y));
+
+		if (keep_closest ? depth <= representative_depth : depth >= representative_depth) {
+			representative_depth = depth;
+			representative_texel = source_texel;
+		}
+	}
+
+	normal = texelFetch(normal_texture, representative_texel, 0);
+	min_max_depth = depth_range;
+	gl_FragDepth = representative_depth;
+}
@@ -1,14 +1,22 @@
 #version 410
 
-uniform bool has_diffuse_texture;
-uniform bool has_specular_texture;
-uniform bool has_normals_texture;
-uniform bool has_opacity_texture;
+// Which textures the material has is selected through the
+// HAS_DIFFUSE_TEXTURE, HAS_SPECULAR_TEXTURE, HAS_NORMALS_TEXTURE and
+// HAS_OPACITY_TEXTURE defines, injected by the program manager.
+#ifdef HAS_DIFFUSE_TEXTURE
 uniform sampler2D diffuse_texture;
+#endif
+#ifdef HAS_SPECULAR_TEXTURE
 uniform sampler2D specular_texture;
+#endif
+#ifdef HAS_NORMALS_TEXTURE
 uniform sampler2D normals_texture;
+#endif
+#ifdef HAS_OPACITY_TEXTURE
 uniform sampler2D opacity_texture;
+#endif
 uniform mat4 normal_model_to_world;
+uniform bool use_compact_gbuffer;
 
 in VS_OUT {
 	vec3 normal;
@@ -21,29 +29,45 @@ layout (location = 0) out vec4 geometry_diffuse;
 layout (location = 1) out vec4 geometry_specular;
 layout (location = 2) out vec4 geometry_normal;
 
+#include "octahedral.glsl"
 
 void main()
 {
-	if (has_opacity_texture && texture(opacity_texture, fs_in.texcoord).r < 1.0)
+#ifdef HAS_OPACITY_TEXTURE
+	if (texture(opacity_texture, fs_in.texcoord).r < 1.0)
 		discard;
+#endif
 
 	// Diffuse color
+#ifdef HAS_DIFFUSE_TEXTURE
+	geometry_diffuse = texture(diffuse_texture, fs_in.texcoord);
+#else
 	geometry_diffuse = vec4(0.0f);
-	if (has_diffuse_texture)
-		geometry_diffuse = texture(diffuse_texture, fs_in.texcoord);
+#endif
 
 	// Specular color
+#ifdef HAS_SPECULAR_TEXTURE
+	geometry_specular = texture(specular_texture, fs_in.texcoord);
+#else
 	geometry_specular = vec4(0.0f);
-	if (has_specular_texture)
-		geometry_specular = texture(specular_texture, fs_in.texcoord);
+#endif
 
 	// Worldspace normal
-	geometry_normal = vec4(fs_in.normal, 0.0);
-	if (has_normals_texture) {
-		vec3 normal = texture(normals_texture, fs_in.texcoord).xyz;
-		normal = normalize(normal * 2.0 - 1.0);
-		mat3 tbn = mat3(fs_in.tangent, fs_in.binormal, fs_in.normal);
-		normal = tbn * normal;
-		geometry_normal = (normal_model_to_world * vec4(normal, 0.0) + 1.0) / 2.0;
+	vec3 normal = fs_in.normal;
+#ifdef HAS_NORMALS_TEXTURE
+	normal = texture(normals_texture, fs_in.texcoord).xyz;
+	normal = normalize(normal * 2.0 - 1.0);
+	mat3 tbn = mat3(fs_in.tangent, fs_in.binormal, fs_in.normal);
+	normal = tbn * normal;
+#endif
+	normal = normalize((normal_model_to_world * vec4(normal, 0.0)).xyz);
+
+	if (use_compact_gbuffer) {
+		// Only the specular intensity is kept, in the alpha channel of the
+		// diffuse target; the specular target is not even bound.
+		geometry_diffuse.a = dot(geometry_specular.rgb, vec3(0.2126, 0.7152, 0.0722));
+		geometry_normal = vec4(encode_octahedral(normal), 0.0, 0.0);
+	} else {
+		geometry_normal = vec4(normal * 0.5 + 0.5, 0.0);
 	}
 }
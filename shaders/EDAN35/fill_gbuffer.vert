@@ -1,10 +1,6 @@
 #version 410
 
-struct ViewProjTransforms
-{
-	mat4 view_projection;
-	mat4 view_projection_inverse;
-};
+#include "common/view_proj_transforms.glsl"
 
 layout (std140) uniform CameraViewProjTransforms
 {
@@ -26,6 +22,9 @@ out VS_OUT {
 	vec3 binormal;
 } vs_out;
 
+// Must match the depth pre-pass exactly, as it is used with an equal depth
+// test afterwards.
+invariant gl_Position;
 
 void main() {
 	vs_out.normal   = normalize(normal);
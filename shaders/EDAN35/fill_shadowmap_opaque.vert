@@ -0,0 +1,20 @@
+#version 410
+
+#include "common/view_proj_transforms.glsl"
+
+layout (std140) uniform LightViewProjTransforms
+{
+	ViewProjTransforms lights[4];
+};
+
+uniform int light_index;
+uniform mat4 vertex_model_to_world;
+
+layout (location = 0) in vec3 vertex;
+
+// Used without a fragment shader, for meshes without an opacity texture:
+// only the depth gets written.
+void main()
+{
+	gl_Position = lights[light_index].view_projection * vertex_model_to_world * vec4(vertex, 1.0);
+}
@@ -0,0 +1,21 @@
+#version 410
+
+uniform bool has_opacity_texture;
+uniform sampler2D opacity_texture;
+uniform uint first_triangle;
+
+in VS_OUT {
+	vec2 texcoord;
+} fs_in;
+
+layout (location = 0) out uint triangle_id;
+
+void main()
+{
+	if (has_opacity_texture && texture(opacity_texture, fs_in.texcoord).r < 1.0)
+		discard;
+
+	// Index of the triangle among all meshes, offset by one as 0 is used
+	// for the background.
+	triangle_id = first_triangle + uint(gl_PrimitiveID) + 1u;
+}
@@ -4,21 +4,161 @@ uniform sampler2D diffuse_texture;
 uniform sampler2D specular_texture;
 uniform sampler2D light_d_texture;
 uniform sampler2D light_s_texture;
+uniform sampler2D depth_texture;
+uniform sampler2D normal_texture;
+
+// When lights are accumulated at a lower resolution than the G-buffer, the
+// representative depth, normal and depth range of each of their texels,
+// from the pyramid the lights were accumulated with.
+uniform sampler2D lighting_depth_texture;
+uniform sampler2D lighting_normal_texture;
+uniform sampler2D lighting_min_max_depth_texture;
+
+uniform bool use_compact_gbuffer;
+
+// Size of the light targets divided by the size of the G-buffer, and area
+// of the light targets that was rendered to, in texels.
+uniform float lighting_scale;
+uniform ivec2 lighting_size;
+uniform float depth_sigma;  // Relative difference in view depth
+uniform float normal_power;
+
+// Size of the area of the G-buffer that was rendered to, divided by the size
+// of the output; when it differs from 1, the image is upscaled.
+uniform vec2 render_scale;
+uniform vec2 camera_near_far;
 
 layout (pixel_center_integer) in vec4 gl_FragCoord;
 
 out vec4 frag_color;
 
+const vec3 ambient = vec3(0.15);
+
+float linearise_depth(float window_depth)
+{
+	float n = camera_near_far.x;
+	float f = camera_near_far.y;
+	return 2.0 * n * f / (f + n - (window_depth * 2.0 - 1.0) * (f - n));
+}
+
+float view_depth(ivec2 texel)
+{
+	return linearise_depth(texelFetch(depth_texture, texel, 0).x);
+}
+
+// Joint-bilateral upsampling of the light contributions: the bilinear
+// footprint in the light targets is weighted by how closely the depth and
+// normal of each texel match the ones of the G-buffer texel.
+void upsample_lights(ivec2 texel, out vec3 light_d, out vec3 light_s)
+{
+	vec2 source_coord = (vec2(texel) + 0.5) * lighting_scale - 0.5;
+	ivec2 base = ivec2(floor(source_coord));
+	vec2 f = source_coord - vec2(base);
+
+	float depth = view_depth(texel);
+	vec3 normal = normalize(texelFetch(normal_texture, texel, 0).xyz * 2.0 - 1.0);
+
+	// Footprints without any discontinuity get plain bilinear filtering.
+	bool is_flat = true;
+	for (int i = 0; i < 4; ++i) {
+		ivec2 source_texel = clamp(base + ivec2(i & 1, i >> 1), ivec2(0), lighting_size - 1);
+		vec2 range = texelFetch(lighting_min_max_depth_texture, source_texel, 0).xy;
+		is_flat = is_flat && linearise_depth(range.y) - linearise_depth(range.x) <= depth_sigma * depth;
+	}
+
+	light_d = vec3(0.0);
+	light_s = vec3(0.0);
+	float weights_sum = 0.0;
+	float closest_difference = 1.0e20;
+	ivec2 closest_texel = base;
+	for (int i = 0; i < 4; ++i) {
+		ivec2 offset = ivec2(i & 1, i >> 1);
+		ivec2 source_texel = clamp(base + offset, ivec2(0), lighting_size - 1);
+		vec2 bilinear = mix(1.0 - f, f, vec2(offset));
+		float weight = bilinear.x * bilinear.y;
+
+		float depth_difference = abs(linearise_depth(texelFetch(lighting_depth_texture, source_texel, 0).x) - depth) / depth;
+		if (depth_difference < closest_difference) {
+			closest_difference = depth_difference;
+			closest_texel = source_texel;
+		}
+		if (!is_flat) {
+			vec3 source_normal = normalize(texelFetch(lighting_normal_texture, source_texel, 0).xyz * 2.0 - 1.0);
+			weight *= exp(-(depth_difference * depth_difference) / (depth_sigma * depth_sigma))
+			        * pow(max(dot(normal, source_normal), 0.0), normal_power);
+		}
+
+		light_d += texelFetch(light_d_texture, source_texel, 0).rgb * weight;
+		light_s += texelFetch(light_s_texture, source_texel, 0).rgb * weight;
+		weights_sum += weight;
+	}
+
+	// None of the texels lies on the same surface: fall back to the one
+	// whose depth is the closest.
+	if (weights_sum < 1.0e-4) {
+		light_d = texelFetch(light_d_texture, closest_texel, 0).rgb;
+		light_s = texelFetch(light_s_texture, closest_texel, 0).rgb;
+		return;
+	}
+	light_d /= weights_sum;
+	light_s /= weights_sum;
+}
+
+vec3 shade(ivec2 texel)
+{
+	// The compact layout accumulates lights with the material already
+	// applied, in `light_d_texture`.
+	if (use_compact_gbuffer) {
+		vec3 diffuse = texelFetch(diffuse_texture, texel, 0).rgb;
+		vec3 light   = texelFetch(light_d_texture, texel, 0).rgb;
+		return ambient * diffuse + light;
+	}
+
+	vec3 diffuse  = texelFetch(diffuse_texture,  texel, 0).rgb;
+	vec3 specular = texelFetch(specular_texture, texel, 0).rgb;
+
+	vec3 light_d;
+	vec3 light_s;
+	if (lighting_scale == 1.0) {
+		light_d = texelFetch(light_d_texture, texel, 0).rgb;
+		light_s = texelFetch(light_s_texture, texel, 0).rgb;
+	} else {
+		upsample_lights(texel, light_d, light_s);
+	}
+
+	return (ambient + light_d) * diffuse + light_s * specular;
+}
+
 void main()
 {
 	ivec2 pixel_coord = ivec2(gl_FragCoord.xy);
 
-	vec3 diffuse  = texelFetch(diffuse_texture,  pixel_coord, 0).rgb;
-	vec3 specular = texelFetch(specular_texture, pixel_coord, 0).rgb;
+	if (render_scale == vec2(1.0)) {
+		frag_color = vec4(shade(pixel_coord), 1.0);
+		return;
+	}
+
+	// Edge-aware upscaling: the bilinear footprint is shaded, and texels
+	// whose depth differs from the one closest to the output pixel are
+	// down-weighted, so that edges do not get blurred across.
+	ivec2 rendered_size = ivec2(vec2(textureSize(diffuse_texture, 0)) * render_scale + 0.5);
+	vec2 source_coord = (gl_FragCoord.xy + 0.5) * render_scale - 0.5;
+	ivec2 base = ivec2(floor(source_coord));
+	vec2 f = source_coord - vec2(base);
+
+	float reference_depth = view_depth(clamp(ivec2(source_coord + 0.5), ivec2(0), rendered_size - 1));
 
-	vec3 light_d  = texelFetch(light_d_texture,  pixel_coord, 0).rgb;
-	vec3 light_s  = texelFetch(light_s_texture,  pixel_coord, 0).rgb;
-	const vec3 ambient = vec3(0.15);
+	vec3 colour = vec3(0.0);
+	float weights_sum = 0.0;
+	for (int i = 0; i < 4; ++i) {
+		ivec2 offset = ivec2(i & 1, i >> 1);
+		ivec2 texel = clamp(base + offset, ivec2(0), rendered_size - 1);
+		vec2 bilinear = mix(1.0 - f, f, vec2(offset));
+		float depth_difference = abs(view_depth(texel) - reference_depth) / reference_depth;
+		float weight = bilinear.x * bilinear.y / (0.001 + depth_difference * depth_difference * 1000.0);
+		colour += shade(texel) * weight;
+		weights_sum += weight;
+	}
 
-	frag_color =  vec4((ambient + light_d) * diffuse + light_s * specular, 1.0);
+	frag_color = vec4(colour / weights_sum, 1.0);
 }
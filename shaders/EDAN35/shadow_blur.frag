@@ -0,0 +1,23 @@
+#version 410
+
+uniform sampler2D source_texture;
+
+// Size of a texel along the blurring axis, in texture coordinates.
+uniform vec2 direction;
+
+out vec4 blurred;
+
+// 9-tap Gaussian folded into 5 fetches by relying on bilinear filtering.
+const float offsets[3] = float[](0.0, 1.3846153846, 3.2307692308);
+const float weights[3] = float[](0.2270270270, 0.3162162162, 0.0702702703);
+
+void main()
+{
+	vec2 texcoord = gl_FragCoord.xy / vec2(textureSize(source_texture, 0));
+
+	blurred = textureLod(source_texture, texcoord, 0.0) * weights[0];
+	for (int i = 1; i < 3; ++i) {
+		blurred += textureLod(source_texture, texcoord + direction * offsets[i], 0.0) * weights[i];
+		blurred += textureLod(source_texture, texcoord - direction * offsets[i], 0.0) * weights[i];
+	}
+}
@@ -0,0 +1,35 @@
+#version 410
+
+uniform sampler2D shadow_texture;
+
+// Must match the values of `ShadowFiltering` in src/EDAN35/assignment2.cpp.
+const int shadow_filtering_evsm = 3;
+
+uniform int shadow_filtering;
+uniform vec2 evsm_exponents;
+uniform vec2 light_near_far;
+
+layout (pixel_center_integer) in vec4 gl_FragCoord;
+
+out vec4 moments;
+
+void main()
+{
+	float window_depth = texelFetch(shadow_texture, ivec2(gl_FragCoord.xy), 0).x;
+
+	// Store linear depth, as the hyperbolic distribution of the depth buffer
+	// would collapse most of the variance near 1.
+	float n = light_near_far.x;
+	float f = light_near_far.y;
+	float view_depth = 2.0 * n * f / (f + n - (window_depth * 2.0 - 1.0) * (f - n));
+	float depth = (view_depth - n) / (f - n);
+
+	if (shadow_filtering == shadow_filtering_evsm) {
+		depth = depth * 2.0 - 1.0;
+		float positive = exp(evsm_exponents.x * depth);
+		float negative = -exp(-evsm_exponents.y * depth);
+		moments = vec4(positive, positive * positive, negative, negative * negative);
+	} else {
+		moments = vec4(depth, depth * depth, 0.0, 0.0);
+	}
+}
@@ -0,0 +1,103 @@
+#version 410
+
+#include "common/view_proj_transforms.glsl"
+
+layout (std140) uniform CameraViewProjTransforms
+{
+	ViewProjTransforms camera;
+};
+
+uniform sampler2D light_d_texture;
+uniform sampler2D light_s_texture;
+uniform sampler2D depth_texture;
+uniform sampler2D normal_texture;
+uniform sampler2D history_light_d_texture;
+uniform sampler2D history_light_s_texture;
+uniform sampler2D history_geometry_texture;
+
+uniform bool use_compact_gbuffer;
+uniform bool is_history_valid;
+uniform mat4 previous_view_projection;
+uniform vec2 inverse_screen_resolution;
+uniform vec2 camera_near_far;
+
+// Size of the viewport divided by the size of the targets, for this frame
+// and for the one the history comes from.
+uniform vec2 render_scale;
+uniform vec2 previous_render_scale;
+
+uniform float history_weight;
+uniform float depth_tolerance;  // Relative difference in view depth
+uniform float normal_tolerance; // Minimum cosine between normals
+
+layout (location = 0) out vec4 accumulated_light_d;
+layout (location = 1) out vec4 accumulated_light_s;
+layout (location = 2) out vec4 geometry; // World-space normal and window depth, for validating the next frame
+layout (location = 3) out vec4 error;    // Red where the history got rejected, green for how much it differs
+
+#include "octahedral.glsl"
+
+float view_depth(float window_depth)
+{
+	float n = camera_near_far.x;
+	float f = camera_near_far.y;
+	return 2.0 * n * f / (f + n - (window_depth * 2.0 - 1.0) * (f - n));
+}
+
+float luminance(vec3 colour)
+{
+	return dot(colour, vec3(0.2126, 0.7152, 0.0722));
+}
+
+void main()
+{
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+	vec2 screen_texcoord = gl_FragCoord.xy * inverse_screen_resolution;
+
+	vec3 light_d = texelFetch(light_d_texture, texel, 0).rgb;
+	vec3 light_s = use_compact_gbuffer ? vec3(0.0) : texelFetch(light_s_texture, texel, 0).rgb;
+	float depth = texelFetch(depth_texture, texel, 0).x;
+	vec3 normal = use_compact_gbuffer ? decode_octahedral(texelFetch(normal_texture, texel, 0).xy)
+	                                  : normalize(texelFetch(normal_texture, texel, 0).xyz * 2.0 - 1.0);
+
+	accumulated_light_d = vec4(light_d, 1.0);
+	accumulated_light_s = vec4(light_s, 1.0);
+	geometry = vec4(normal, depth);
+	error = vec4(0.0, 0.0, 0.0, 1.0);
+	if (depth == 1.0)
+		return;
+
+	// Where the surface seen through this pixel was the frame before.
+	vec4 world_position = camera.view_projection_inverse * vec4(screen_texcoord * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+	vec4 previous_position = previous_view_projection * (world_position / world_position.w);
+	vec3 previous_ndc = previous_position.xyz / previous_position.w;
+	vec2 previous_screen_texcoord = previous_ndc.xy * 0.5 + 0.5;
+	vec2 previous_texcoord = previous_screen_texcoord * previous_render_scale;
+
+	// Reject the history if that point was off-screen, or if something
+	// else was seen there: disocclusions show up as a different depth or
+	// a different orientation.
+	bool is_accepted = is_history_valid && previous_position.w > 0.0
+	                && all(greaterThanEqual(previous_screen_texcoord, vec2(0.0)))
+	                && all(lessThanEqual(previous_screen_texcoord, vec2(1.0)));
+	if (is_accepted) {
+		vec4 previous_geometry = texture(history_geometry_texture, previous_texcoord);
+		float expected_depth = view_depth(previous_ndc.z * 0.5 + 0.5);
+		float previous_depth = view_depth(previous_geometry.w);
+		is_accepted = abs(expected_depth - previous_depth) <= depth_tolerance * expected_depth
+		           && dot(normal, previous_geometry.xyz) >= normal_tolerance;
+	}
+	if (!is_accepted) {
+		error = vec4(1.0, 0.0, 0.0, 1.0);
+		return;
+	}
+
+	vec3 history_light_d = texture(history_light_d_texture, previous_texcoord).rgb;
+	vec3 history_light_s = use_compact_gbuffer ? vec3(0.0) : texture(history_light_s_texture, previous_texcoord).rgb;
+	accumulated_light_d = vec4(mix(light_d, history_light_d, history_weight), 1.0);
+	accumulated_light_s = vec4(mix(light_s, history_light_s, history_weight), 1.0);
+
+	float history_luminance = luminance(history_light_d + history_light_s);
+	float difference = abs(luminance(light_d + light_s) - history_luminance) / max(history_luminance, 0.001);
+	error = vec4(0.0, clamp(difference, 0.0, 1.0), 0.0, 1.0);
+}
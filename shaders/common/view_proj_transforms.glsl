@@ -0,0 +1,7 @@
+// Must match `ViewProjTransforms` on the CPU side; each shader declares the
+// uniform blocks it needs.
+struct ViewProjTransforms
+{
+	mat4 view_projection;
+	mat4 view_projection_inverse;
+};
@@ -2,6 +2,7 @@
 #include "config.hpp"
 #include "core/Bonobo.h"
 #include "core/FPSCamera.h"
+#include "core/GLStateCache.hpp"
 #include "core/ShaderProgramManager.hpp"
 #include "core/helpers.hpp"
 #include "core/node.hpp"
@@ -228,6 +229,8 @@ int main() {
     float time_scale = 1.0f;
 
     while (!glfwWindowShouldClose(window)) {
+        GLStateCache::Get().BeginFrame();
+
         //
         // Compute timings information
         //
@@ -312,7 +315,7 @@ int main() {
         //
         // Queue the computed frame for display on screen
         //
-        glfwSwapBuffers(window);
+        window_manager.SwapBuffers(window);
     }
 
     glDeleteTextures(1, &neptune_texture);
@@ -5,6 +5,7 @@
 #include "config.hpp"
 #include "core/Bonobo.h"
 #include "core/FPSCamera.h"
+#include "core/GLStateCache.hpp"
 #include "core/ShaderProgramManager.hpp"
 #include "core/node.hpp"
 #include <imgui.h>
@@ -194,6 +195,8 @@ void edaf80::Assignment2::run() {
     changeCullMode(cull_mode);
 
     while (!glfwWindowShouldClose(window)) {
+        GLStateCache::Get().BeginFrame();
+
         auto const nowTime = std::chrono::high_resolution_clock::now();
         auto const deltaTimeUs = std::chrono::duration_cast<std::chrono::microseconds>(nowTime - lastTime);
         lastTime = nowTime;
@@ -301,14 +304,14 @@ void edaf80::Assignment2::run() {
         }
         ImGui::End();
 
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        bonobo::changePolygonMode(bonobo::polygon_mode_t::fill);
         if (show_basis)
             bonobo::renderBasis(basis_thickness_scale, basis_length_scale, mCamera.GetWorldToClipMatrix());
         if (show_logs)
             Log::View::Render();
         mWindowManager.RenderImGuiFrame(show_gui);
 
-        glfwSwapBuffers(window);
+        mWindowManager.SwapBuffers(window);
     }
 }
 
@@ -4,6 +4,7 @@
 #include "config.hpp"
 #include "core/Bonobo.h"
 #include "core/FPSCamera.h"
+#include "core/GLStateCache.hpp"
 #include "core/ShaderProgramManager.hpp"
 #include "core/helpers.hpp"
 #include "core/node.hpp"
@@ -84,6 +85,8 @@ void edaf80::Assignment4::run() {
     changeCullMode(cull_mode);
 
     while (!glfwWindowShouldClose(window)) {
+        GLStateCache::Get().BeginFrame();
+
         auto const nowTime = std::chrono::high_resolution_clock::now();
         auto const deltaTimeUs = std::chrono::duration_cast<std::chrono::microseconds>(nowTime - lastTime);
         lastTime = nowTime;
@@ -102,13 +105,15 @@ void edaf80::Assignment4::run() {
         }
         camera_position = mCamera.mWorld.GetTranslation();
 
+        if (program_manager.Update())
+            shader_reload_failed = !program_manager.AreAllProgramsValid();
         if (inputHandler.GetKeycodeState(GLFW_KEY_R) & JUST_PRESSED) {
-            shader_reload_failed = !program_manager.ReloadAllPrograms();
-            if (shader_reload_failed)
+            if (!program_manager.ReloadModifiedPrograms())
                 tinyfd_notifyPopup("Shader Program Reload Error",
                                    "An error occurred while reloading shader programs; see the logs for details.\n"
-                                   "Rendering is suspended until the issue is solved. Once fixed, just reload the shaders again.",
+                                   "Failing programs keep their previous version until the issue is solved; they get rebuilt as soon as their sources are saved.",
                                    "error");
+            shader_reload_failed = !program_manager.AreAllProgramsValid();
         }
         if (inputHandler.GetKeycodeState(GLFW_KEY_F3) & JUST_RELEASED)
             show_logs = !show_logs;
@@ -143,7 +148,7 @@ void edaf80::Assignment4::run() {
             //
         }
 
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        bonobo::changePolygonMode(bonobo::polygon_mode_t::fill);
 
         //
         // Todo: If you want a custom ImGUI window, you can set it up
@@ -173,7 +178,7 @@ void edaf80::Assignment4::run() {
             Log::View::Render();
         mWindowManager.RenderImGuiFrame(show_gui);
 
-        glfwSwapBuffers(window);
+        mWindowManager.SwapBuffers(window);
     }
 }
 
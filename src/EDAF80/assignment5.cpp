@@ -6,6 +6,7 @@
 #include "config.hpp"
 #include "core/Bonobo.h"
 #include "core/FPSCamera.h"
+#include "core/GLStateCache.hpp"
 #include "core/ShaderProgramManager.hpp"
 #include "core/node.hpp"
 
@@ -154,22 +155,28 @@ void edaf80::Assignment5::run() {
         glUniform1f(glGetUniformLocation(program, "shininess"), player_material.shininess);
     };
 
-    auto skybox_shape = parametric_shapes::createSphere(100.0f, 100u, 100u);
-    if (skybox_shape.vao == 0u) {
+    if (std::getenv("LUGGCGL_SHAPES_BENCHMARK") != nullptr)
+        parametric_shapes::runBenchmark();
+
+    // All spheres are looked up from the registry: they get the same unit
+    // sphere, scaled to their radius through their transform.
+    auto const skybox_shape = parametric_shapes::getSphere(100u, 100u);
+    if (skybox_shape == nullptr) {
         LogError("Failed to retrieve the mesh for the skybox");
         return;
     }
 
     Node skybox;
-    skybox.set_geometry(skybox_shape);
+    skybox.set_geometry(*skybox_shape);
+    skybox.get_transform().SetScale(100.0f);
     skybox.set_program(&skybox_shader, set_uniforms);
     skybox.add_texture("skybox", skybox_texture, GL_TEXTURE_CUBE_MAP);
 
-    auto sand_shapes = new std::vector<bonobo::mesh_data>();
+    auto sand_shapes = new std::vector<parametric_shapes::shared_mesh>();
 
     for (auto i = 0; i < num_sand_spheres; i++) {
-        auto sand_shape = parametric_shapes::createSphere(sand_radius, 100u, 100u);
-        if (sand_shape.vao == 0u) {
+        auto sand_shape = parametric_shapes::getSphere(100u, 100u);
+        if (sand_shape == nullptr) {
             LogError("Failed to retrieve the mesh for the sand sphere");
             return;
         }
@@ -182,7 +189,8 @@ void edaf80::Assignment5::run() {
 
     for (auto i = 0; i < num_sand_spheres; i++) {
         Node sand_sphere;
-        sand_sphere.set_geometry(sand_shapes->at(i));
+        sand_sphere.set_geometry(*sand_shapes->at(i));
+        sand_sphere.get_transform().SetScale(sand_radius);
         sand_sphere.set_material_constants(gold_material);
         sand_sphere.set_program(&phong_shader, sand_phong_set_uniforms);
         sand_sphere.add_texture("diffuseMap", sand_sphere_diffuse_texture, GL_TEXTURE_2D);
@@ -209,11 +217,11 @@ void edaf80::Assignment5::run() {
         sand_nodes->push_back(sand_sphere);
     }
 
-    auto gold_shapes = new std::vector<bonobo::mesh_data>();
+    auto gold_shapes = new std::vector<parametric_shapes::shared_mesh>();
 
     for (auto i = 0; i < num_gold_spheres; i++) {
-        auto gold_shape = parametric_shapes::createSphere(gold_radius, 100u, 100u);
-        if (gold_shape.vao == 0u) {
+        auto gold_shape = parametric_shapes::getSphere(100u, 100u);
+        if (gold_shape == nullptr) {
             LogError("Failed to retrieve the mesh for the gold sphere");
             return;
         }
@@ -226,7 +234,8 @@ void edaf80::Assignment5::run() {
 
     for (auto i = 0; i < num_gold_spheres; i++) {
         Node gold_sphere;
-        gold_sphere.set_geometry(gold_shapes->at(i));
+        gold_sphere.set_geometry(*gold_shapes->at(i));
+        gold_sphere.get_transform().SetScale(gold_radius);
         gold_sphere.set_material_constants(gold_material);
         gold_sphere.set_program(&phong_shader, gold_phong_set_uniforms);
         gold_sphere.add_texture("diffuseMap", gold_sphere_diffuse_texture, GL_TEXTURE_2D);
@@ -267,6 +276,8 @@ void edaf80::Assignment5::run() {
     player.add_texture("specularMap", player_specular_texture, GL_TEXTURE_2D);
     player.add_texture("normalMap", player_normal_texture, GL_TEXTURE_2D);
 
+    parametric_shapes::logRegistryStatistics();
+
     glClearDepthf(1.0f);
     glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
     glEnable(GL_DEPTH_TEST);
@@ -276,6 +287,8 @@ void edaf80::Assignment5::run() {
     bool shader_reload_failed = false;
 
     while (!glfwWindowShouldClose(window)) {
+        GLStateCache::Get().BeginFrame();
+
         auto const nowTime = std::chrono::high_resolution_clock::now();
         auto const deltaTimeUs = std::chrono::duration_cast<std::chrono::microseconds>(nowTime - lastTime);
         lastTime = nowTime;
@@ -289,13 +302,15 @@ void edaf80::Assignment5::run() {
 
         camera_position = mCamera.mWorld.GetTranslation();
 
+        if (program_manager.Update())
+            shader_reload_failed = !program_manager.AreAllProgramsValid();
         if (inputHandler.GetKeycodeState(GLFW_KEY_R) & JUST_PRESSED) {
-            shader_reload_failed = !program_manager.ReloadAllPrograms();
-            if (shader_reload_failed)
+            if (!program_manager.ReloadModifiedPrograms())
                 tinyfd_notifyPopup("Shader Program Reload Error",
                                    "An error occurred while reloading shader programs; see the logs for details.\n"
-                                   "Rendering is suspended until the issue is solved. Once fixed, just reload the shaders again.",
+                                   "Failing programs keep their previous version until the issue is solved; they get rebuilt as soon as their sources are saved.",
                                    "error");
+            shader_reload_failed = !program_manager.AreAllProgramsValid();
         }
         if (inputHandler.GetKeycodeState(GLFW_KEY_F11) & JUST_RELEASED)
             mWindowManager.ToggleFullscreenStatusForWindow(window);
@@ -305,16 +320,18 @@ void edaf80::Assignment5::run() {
         glViewport(0, 0, framebuffer_width, framebuffer_height);
 
         glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        skybox.render(mCamera.GetWorldToClipMatrix());
+        bonobo::changePolygonMode(bonobo::polygon_mode_t::fill);
         skybox.get_transform().SetTranslate(mCamera.mWorld.GetTranslation());
-        for (auto &gold_node : *gold_nodes) {
-            gold_node.render(mCamera.GetWorldToClipMatrix());
-        }
-        for (auto &sand_node : *sand_nodes) {
-            sand_node.render(mCamera.GetWorldToClipMatrix());
+        if (!shader_reload_failed) {
+            skybox.render(mCamera.GetWorldToClipMatrix());
+            for (auto &gold_node : *gold_nodes) {
+                gold_node.render(mCamera.GetWorldToClipMatrix());
+            }
+            for (auto &sand_node : *sand_nodes) {
+                sand_node.render(mCamera.GetWorldToClipMatrix());
+            }
+            player.render(mCamera.GetWorldToClipMatrix());
         }
-        player.render(mCamera.GetWorldToClipMatrix());
 
         // if the player is colliding with a gold node we need to change the position of the gold node and add speed to the player
         for (auto i = 0; i < num_gold_spheres; i++) {
@@ -367,8 +384,33 @@ void edaf80::Assignment5::run() {
             }
         }
 
-        glfwSwapBuffers(window);
+        mWindowManager.SwapBuffers(window);
     }
+
+    delete gold_nodes_positions;
+    delete gold_nodes;
+    delete sand_nodes_positions;
+    delete sand_nodes;
+
+    // The shared sphere is deleted along with its last reference, when
+    // leaving run().
+    delete gold_shapes;
+    delete sand_shapes;
+
+    glDeleteBuffers(1, &player_shape.ibo);
+    glDeleteBuffers(1, &player_shape.bo);
+    glDeleteVertexArrays(1, &player_shape.vao);
+
+    glDeleteTextures(1, &sand_sphere_normal_texture);
+    glDeleteTextures(1, &sand_sphere_specular_texture);
+    glDeleteTextures(1, &sand_sphere_diffuse_texture);
+    glDeleteTextures(1, &player_normal_texture);
+    glDeleteTextures(1, &player_specular_texture);
+    glDeleteTextures(1, &player_diffuse_texture);
+    glDeleteTextures(1, &gold_sphere_normal_texture);
+    glDeleteTextures(1, &gold_sphere_specular_texture);
+    glDeleteTextures(1, &gold_sphere_diffuse_texture);
+    glDeleteTextures(1, &skybox_texture);
 }
 
 int main() {
@@ -1,18 +1,28 @@
 #include "parametric_shapes.hpp"
+#include "core/GLStateCache.hpp"
+#include "core/GPUMemoryRegistry.hpp"
 #include "core/Log.h"
 
 #include <glm/glm.hpp>
 
 #include <array>
 #include <cassert>
+#include <chrono>
 #include <cmath>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <thread>
+#include <tuple>
 #include <vector>
 
 bonobo::mesh_data
 parametric_shapes::createQuad(float const width, float const height,
                               unsigned int const horizontal_split_count,
                               unsigned int const vertical_split_count) {
+    GPUMemoryRegistry::Scope const memory_scope("parametric_shapes::createQuad");
+
     auto const vertices = std::array<glm::vec3, 4>{
         glm::vec3(0.0f, 0.0f, 0.0f),
         glm::vec3(width, 0.0f, 0.0f),
@@ -118,429 +128,247 @@ parametric_shapes::createQuad(float const width, float const height,
     glBindBuffer(GL_ARRAY_BUFFER, 0u);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0u);
 
+    // The bindings above did not go through the state cache, which has to
+    // forget what it knew.
+    GLStateCache::Get().Invalidate();
+
     return data;
 }
 
-bonobo::mesh_data
-parametric_shapes::createSphere(float const radius, unsigned int const horizontal_split_count, unsigned int const vertical_split_count) {
-    bonobo::mesh_data data;
+namespace {
+    void deleteSurface(parametric_shapes::detail::mapped_surface &surface) {
+        glDeleteBuffers(1, &surface.data.ibo);
+        glDeleteBuffers(1, &surface.data.bo);
+        glDeleteVertexArrays(1, &surface.data.vao);
+        surface = parametric_shapes::detail::mapped_surface();
+    }
+}
 
-    // Number of vertices
-    // we calculate one more vertex than the number of splits to account for the edges
-    const unsigned int vertex_count = (horizontal_split_count + 1) * (vertical_split_count + 1);
-
-    // Arrays to store vertex attributes
-    std::vector<glm::vec3> vertices(vertex_count);
-    std::vector<glm::vec3> normals(vertex_count);
-    std::vector<glm::vec3> tangents(vertex_count);
-    std::vector<glm::vec3> binormals(vertex_count);
-    std::vector<glm::vec2> texcoords(vertex_count); // Texture coordinates
-
-    // Step sizes for theta and phi
-    // We divide the sphere into a grid, and d_theta and d_phi represent how much
-    // we move with each step along the horizontal and vertical directions
-    float const d_theta = 2.0f *
-                          glm::pi<float>() / static_cast<float>(horizontal_split_count);
-    float const d_phi = glm::pi<float>() / static_cast<float>(vertical_split_count);
-
-    // Generate vertices
-    unsigned int index = 0;
-    for (unsigned int i = 0; i <= horizontal_split_count; ++i) {
-        float theta = i * d_theta;
-        float cos_theta = cos(theta);
-        float sin_theta = sin(theta);
-
-        for (unsigned int j = 0; j <= vertical_split_count; ++j) {
-            float phi = j * d_phi;
-            float cos_phi = cos(phi);
-            float sin_phi = sin(phi);
-
-            // Compute vertex position (parametric sphere equation)
-            glm::vec3 position = glm::vec3(radius * sin_phi * sin_theta, -radius * cos_phi, radius * sin_phi * cos_theta);
-            vertices[index] = position;
-
-            // Normal is just the normalized position for a sphere
-            glm::vec3 normal = glm::normalize(position);
-            normals[index] = normal;
-            glm::vec3 tangent;
-
-            // Regular tangent calculation
-            tangent = glm::vec3(
-                cos_theta, // x-component
-                0.0f,                                            // y-component
-                -sin_theta // z-component
-            );
-
-            tangents[index] = glm::normalize(tangent);
-
-            glm::vec3 binormal = glm::cross(tangent, normal);
-            binormals[index] = glm::normalize(binormal);
-
-            // Texture coordinates
-            texcoords[index] = glm::vec2(static_cast<float>(i) / horizontal_split_count, static_cast<float>(j) / vertical_split_count);
-
-            ++index;
-        }
+parametric_shapes::parameter_sample
+parametric_shapes::detail::sampleParameter(glm::vec2 const &range, unsigned int const edges_count,
+                                           unsigned int const index) {
+    // Computed from the index rather than accumulated, so that the last
+    // sample lands exactly on the end of the range.
+    parameter_sample sample;
+    sample.value = glm::mix(range.x, range.y, static_cast<float>(index) / static_cast<float>(edges_count));
+    sample.cos = std::cos(sample.value);
+    sample.sin = std::sin(sample.value);
+    return sample;
+}
+
+unsigned int
+parametric_shapes::detail::getWorkersCount(std::size_t const vertices_nb, unsigned int const rows_nb,
+                                           unsigned int const requested_workers_nb) {
+    auto workers_nb = requested_workers_nb;
+    if (workers_nb == 0u) {
+        auto const hardware_threads_nb = std::max(std::thread::hardware_concurrency(), 1u);
+        workers_nb = static_cast<unsigned int>(std::min<std::size_t>(hardware_threads_nb, vertices_nb / vertices_per_worker));
     }
+    return std::max(std::min(workers_nb, rows_nb), 1u);
+}
 
-    // Generate indices
-    std::vector<glm::uvec3> indices(horizontal_split_count * vertical_split_count * 2); // Two triangles per quad
-    index = 0;
-    for (unsigned int i = 0; i < horizontal_split_count; ++i) {
-        for (unsigned int j = 0; j < vertical_split_count; ++j) {
-            unsigned int first = i * (vertical_split_count + 1) + j;
-            unsigned int second = first + vertical_split_count + 1;
-
-            // First triangle
-            indices[index] = glm::uvec3(first, second, first + 1);
-            ++index;
-
-            // Second triangle
-            indices[index] = glm::uvec3(second, second + 1, first + 1);
-            ++index;
-        }
+bool parametric_shapes::detail::mapSurface(mapped_surface &surface, unsigned int const u_edges_count,
+                                           unsigned int const v_edges_count, std::string const &name) {
+    if (u_edges_count == 0u || v_edges_count == 0u) {
+        LogError("Failed to create \"%s\": parametric surfaces need at least one edge in each direction.", name.c_str());
+        return false;
+    }
+
+    auto const vertices_nb = static_cast<std::size_t>(u_edges_count + 1u) * (v_edges_count + 1u);
+    auto const triangles_nb = 2u * static_cast<std::size_t>(u_edges_count) * v_edges_count;
+    if (vertices_nb > std::numeric_limits<GLuint>::max() || 3u * triangles_nb > static_cast<std::size_t>(std::numeric_limits<GLsizei>::max())) {
+        LogError("Failed to create \"%s\": too many vertices for 32-bit indices.", name.c_str());
+        return false;
     }
 
-    // Create and bind the VAO
+    auto &data = surface.data;
+    data.name = name;
+    data.vertices_nb = static_cast<GLsizei>(vertices_nb);
+    data.indices_nb = static_cast<GLsizei>(3u * triangles_nb);
+
+    // One block per attribute, as the shapes were laid out before.
+    auto const vertices_offset = std::size_t(0u);
+    auto const normals_offset = vertices_offset + vertices_nb * sizeof(glm::vec3);
+    auto const texcoords_offset = normals_offset + vertices_nb * sizeof(glm::vec3);
+    auto const tangents_offset = texcoords_offset + vertices_nb * sizeof(glm::vec2);
+    auto const binormals_offset = tangents_offset + vertices_nb * sizeof(glm::vec3);
+    auto const bo_size = binormals_offset + vertices_nb * sizeof(glm::vec3);
+    auto const ibo_size = triangles_nb * sizeof(glm::uvec3);
+
     glGenVertexArrays(1, &data.vao);
     assert(data.vao != 0u);
     glBindVertexArray(data.vao);
 
-    // Vertex buffer size
-    const auto vertices_size = static_cast<GLsizeiptr>(vertices.size() * sizeof(glm::vec3));
-    const auto normals_size = static_cast<GLsizeiptr>(normals.size() * sizeof(glm::vec3));
-    const auto tangents_size = static_cast<GLsizeiptr>(tangents.size() * sizeof(glm::vec3));
-    const auto binormals_size = static_cast<GLsizeiptr>(binormals.size() * sizeof(glm::vec3));
-    const auto texcoords_size = static_cast<GLsizeiptr>(texcoords.size() * sizeof(glm::vec2));
-    const auto buffer_size = vertices_size + normals_size + tangents_size + binormals_size + texcoords_size;
-
-    // Generate and bind the buffer object for vertices
     glGenBuffers(1, &data.bo);
     assert(data.bo != 0u);
     glBindBuffer(GL_ARRAY_BUFFER, data.bo);
-    glBufferData(GL_ARRAY_BUFFER, buffer_size, nullptr, GL_STATIC_DRAW);
-
-    // Upload vertex data
-    glBufferSubData(GL_ARRAY_BUFFER, 0, vertices_size, vertices.data());
-    glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::vertices));
-    glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::vertices), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const *>(0x0));
-
-    // Upload normal data
-    glBufferSubData(GL_ARRAY_BUFFER, vertices_size, normals_size, normals.data());
-    // copies the vertex positions into GPU memory
-    glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::normals));
-    // enables the vertex attribute for positions
-    glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::normals), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const *>(vertices_size));
-    // tells OpenGL that the vertex data consists of 3D floating-point values
-
-    // Upload tangent data
-    glBufferSubData(GL_ARRAY_BUFFER, vertices_size + normals_size, tangents_size, tangents.data());
-    glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::tangents));
-    glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::tangents), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const *>(vertices_size + normals_size));
-
-    // Upload binormal data
-    glBufferSubData(GL_ARRAY_BUFFER, vertices_size + normals_size + tangents_size, binormals_size, binormals.data());
-    glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::binormals));
-    glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::binormals), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const *>(vertices_size + normals_size + tangents_size));
-
-    // Upload texture coordinates
-    glBufferSubData(GL_ARRAY_BUFFER, vertices_size + normals_size + tangents_size + binormals_size, texcoords_size, texcoords.data());
-    glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::texcoords));
-    glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::texcoords), 2, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const *>(vertices_size + normals_size + tangents_size + binormals_size));
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(bo_size), nullptr, GL_STATIC_DRAW);
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0u);
+    auto const set_attribute = [](bonobo::shader_bindings const binding, GLint const components_nb, std::size_t const offset) {
+        glEnableVertexAttribArray(static_cast<unsigned int>(binding));
+        glVertexAttribPointer(static_cast<unsigned int>(binding), components_nb, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const *>(offset));
+    };
+    set_attribute(bonobo::shader_bindings::vertices, 3, vertices_offset);
+    set_attribute(bonobo::shader_bindings::normals, 3, normals_offset);
+    set_attribute(bonobo::shader_bindings::texcoords, 2, texcoords_offset);
+    set_attribute(bonobo::shader_bindings::tangents, 3, tangents_offset);
+    set_attribute(bonobo::shader_bindings::binormals, 3, binormals_offset);
 
-    // Generate and bind the element buffer for indices
     glGenBuffers(1, &data.ibo);
     assert(data.ibo != 0u);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, data.ibo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(glm::uvec3), indices.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(ibo_size), nullptr, GL_STATIC_DRAW);
+
+    // Nothing was written to the buffers yet, so the previous content does
+    // not need to be preserved, nor read back.
+    auto const access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT;
+    auto const vertex_data = static_cast<char *>(glMapBufferRange(GL_ARRAY_BUFFER, 0, static_cast<GLsizeiptr>(bo_size), access));
+    auto const index_data = glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, 0, static_cast<GLsizeiptr>(ibo_size), access);
+
+    if (vertex_data == nullptr || index_data == nullptr) {
+        LogError("Failed to map the buffers of \"%s\".", name.c_str());
+        if (vertex_data != nullptr)
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+        if (index_data != nullptr)
+            glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
+        glBindVertexArray(0u);
+        glBindBuffer(GL_ARRAY_BUFFER, 0u);
+        GLStateCache::Get().Invalidate();
+        deleteSurface(surface);
+        return false;
+    }
 
-    data.indices_nb = static_cast<GLsizei>(indices.size() * 3u);
+    glBindVertexArray(0u);
+    glBindBuffer(GL_ARRAY_BUFFER, 0u);
+    GLStateCache::Get().Invalidate();
+
+    surface.positions = reinterpret_cast<glm::vec3 *>(vertex_data + vertices_offset);
+    surface.normals = reinterpret_cast<glm::vec3 *>(vertex_data + normals_offset);
+    surface.texcoords = reinterpret_cast<glm::vec2 *>(vertex_data + texcoords_offset);
+    surface.tangents = reinterpret_cast<glm::vec3 *>(vertex_data + tangents_offset);
+    surface.binormals = reinterpret_cast<glm::vec3 *>(vertex_data + binormals_offset);
+    surface.triangles = static_cast<glm::uvec3 *>(index_data);
+    return true;
+}
 
+bonobo::mesh_data
+parametric_shapes::detail::unmapSurface(mapped_surface &surface,
+                                        glm::vec3 const &bounds_min, glm::vec3 const &bounds_max) {
+    // The element array buffer binding is part of the VAO state.
+    glBindVertexArray(surface.data.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, surface.data.bo);
+    auto const is_vertex_data_valid = glUnmapBuffer(GL_ARRAY_BUFFER) == GL_TRUE;
+    auto const is_index_data_valid = glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER) == GL_TRUE;
     glBindVertexArray(0u);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0u);
+    glBindBuffer(GL_ARRAY_BUFFER, 0u);
+    GLStateCache::Get().Invalidate();
+
+    // Unmapping fails if the content got corrupted in the meantime, for
+    // example by a change of screen mode.
+    if (!is_vertex_data_valid || !is_index_data_valid) {
+        LogError("The content of \"%s\" got lost while being written.", surface.data.name.c_str());
+        deleteSurface(surface);
+        return bonobo::mesh_data();
+    }
 
+    auto data = surface.data;
+    data.bounds_min = bounds_min;
+    data.bounds_max = bounds_max;
+    surface = mapped_surface();
     return data;
 }
 
-bonobo::mesh_data
-parametric_shapes::createTorus(float const major_radius,
-                               float const minor_radius,
-                               unsigned int const major_split_count,
-                               unsigned int const minor_split_count) {
-    bonobo::mesh_data data;
-
-    // Number of vertices based on the splits
-    const unsigned int vertex_count = (major_split_count + 1) * (minor_split_count + 1);
-
-    // Create vectors for vertices, normals, tangents, binormals, and texture coordinates
-    std::vector<glm::vec3> vertices(vertex_count);
-    std::vector<glm::vec3> normals(vertex_count);
-    std::vector<glm::vec3> tangents(vertex_count);
-    std::vector<glm::vec3> binormals(vertex_count);
-    std::vector<glm::vec2> texcoords(vertex_count);
-
-    // Compute the step sizes for theta and phi
-    float const d_theta = 2.0f * glm::pi<float>() / static_cast<float>(major_split_count);
-    float const d_phi = 2.0f * glm::pi<float>() / static_cast<float>(minor_split_count);
-
-    unsigned int index = 0;
-    for (unsigned int i = 0; i <= major_split_count; ++i) {
-        float theta = i * d_theta;
-        float cos_theta = cos(theta);
-        float sin_theta = sin(theta);
-
-        for (unsigned int j = 0; j <= minor_split_count; ++j) {
-            float phi = j * d_phi;
-            float cos_phi = cos(phi);
-            float sin_phi = sin(phi);
-
-            // Compute position using equation (2a)
-            glm::vec3 position = glm::vec3(
-                (major_radius + minor_radius * cos_theta) * cos_phi,
-                -minor_radius * sin_theta,
-                (major_radius + minor_radius * cos_theta) * sin_phi);
-            vertices[index] = position;
-
-            // Compute the tangent using equation (2b)
-            glm::vec3 tangent = glm::vec3(
-                -minor_radius * sin_theta * cos_phi,
-                -minor_radius * cos_theta,
-                -minor_radius * sin_theta * sin_phi);
-            tangents[index] = glm::normalize(tangent);
-
-            // Compute the binormal using equation (2c)
-            glm::vec3 binormal = glm::vec3(
-                -(major_radius + minor_radius * cos_theta) * sin_phi,
-                0.0f,
-                (major_radius + minor_radius * cos_theta) * cos_phi);
-            binormals[index] = glm::normalize(binormal);
-
-            // Compute the normal as the cross product of tangent and binormal
-            glm::vec3 normal = glm::normalize(glm::cross(tangent, binormal));
-            normals[index] = normal;
-
-            // Texture coordinates
-            texcoords[index] = glm::vec2(
-                static_cast<float>(i) / static_cast<float>(major_split_count),
-                static_cast<float>(j) / static_cast<float>(minor_split_count));
-
-            ++index;
+namespace {
+    // u goes around the y axis, v from the bottom pole to the top one.
+    struct sphere_surface {
+        float radius;
+
+        parametric_shapes::surface_point operator()(parametric_shapes::parameter_sample const &theta,
+                                                    parametric_shapes::parameter_sample const &phi) const {
+            parametric_shapes::surface_point point;
+            point.position = radius * glm::vec3(phi.sin * theta.sin, -phi.cos, phi.sin * theta.cos);
+            // Divided by `radius * phi.sin`, which vanishes at the poles.
+            point.du = glm::vec3(theta.cos, 0.0f, -theta.sin);
+            // Divided by `radius`.
+            point.dv = glm::vec3(phi.cos * theta.sin, phi.sin, phi.cos * theta.cos);
+            return point;
         }
-    }
+    };
 
-    // Create index buffer (two triangles per quad)
-    std::vector<glm::uvec3> indices(major_split_count * minor_split_count * 2);
-    index = 0;
-    for (unsigned int i = 0; i < major_split_count; ++i) {
-        for (unsigned int j = 0; j < minor_split_count; ++j) {
-            unsigned int first = i * (minor_split_count + 1) + j;
-            unsigned int second = first + minor_split_count + 1;
-
-            // First triangle
-            indices[index] = glm::uvec3(first, second, first + 1);
-            ++index;
-
-            // Second triangle
-            indices[index] = glm::uvec3(second, second + 1, first + 1);
-            ++index;
-        }
-    }
+    // u goes around the cross-section, v around the major ring.
+    struct torus_surface {
+        float major_radius;
+        float minor_radius;
 
-    // Upload the geometry to the GPU
-    glGenVertexArrays(1, &data.vao);
-    assert(data.vao != 0u);
-    glBindVertexArray(data.vao);
+        parametric_shapes::surface_point operator()(parametric_shapes::parameter_sample const &theta,
+                                                    parametric_shapes::parameter_sample const &phi) const {
+            auto const distance_to_centre = major_radius + minor_radius * theta.cos;
 
-    const auto vertices_size = static_cast<GLsizeiptr>(vertices.size() * sizeof(glm::vec3));
-    const auto normals_size = static_cast<GLsizeiptr>(normals.size() * sizeof(glm::vec3));
-    const auto tangents_size = static_cast<GLsizeiptr>(tangents.size() * sizeof(glm::vec3));
-    const auto binormals_size = static_cast<GLsizeiptr>(binormals.size() * sizeof(glm::vec3));
-    const auto texcoords_size = static_cast<GLsizeiptr>(texcoords.size() * sizeof(glm::vec2));
-    const auto buffer_size = vertices_size + normals_size + tangents_size + binormals_size + texcoords_size;
+            parametric_shapes::surface_point point;
+            point.position = glm::vec3(distance_to_centre * phi.cos, minor_radius * theta.sin, distance_to_centre * phi.sin);
+            point.du = minor_radius * glm::vec3(-theta.sin * phi.cos, theta.cos, -theta.sin * phi.sin);
+            point.dv = distance_to_centre * glm::vec3(-phi.sin, 0.0f, phi.cos);
+            return point;
+        }
+    };
 
-    // Upload vertex data
-    glGenBuffers(1, &data.bo);
-    glBindBuffer(GL_ARRAY_BUFFER, data.bo);
-    glBufferData(GL_ARRAY_BUFFER, buffer_size, nullptr, GL_STATIC_DRAW);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, vertices_size, vertices.data());
-    glBufferSubData(GL_ARRAY_BUFFER, vertices_size, normals_size, normals.data());
-    glBufferSubData(GL_ARRAY_BUFFER, vertices_size + normals_size, tangents_size, tangents.data());
-    glBufferSubData(GL_ARRAY_BUFFER, vertices_size + normals_size + tangents_size, binormals_size, binormals.data());
-    glBufferSubData(GL_ARRAY_BUFFER, vertices_size + normals_size + tangents_size + binormals_size, texcoords_size, texcoords.data());
-
-    // Enable vertex attributes
-    glEnableVertexAttribArray(0); // Position
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const *>(0x0));
-    glEnableVertexAttribArray(1); // Normal
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const *>(vertices_size));
-    glEnableVertexAttribArray(2); // Tangent
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const *>(vertices_size + normals_size));
-    glEnableVertexAttribArray(3); // Binormal
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const *>(vertices_size + normals_size + tangents_size));
-    glEnableVertexAttribArray(4); // Texcoords
-    glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const *>(vertices_size + normals_size + tangents_size + binormals_size));
-
-    // Index buffer
-    glGenBuffers(1, &data.ibo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, data.ibo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(glm::uvec3), indices.data(), GL_STATIC_DRAW);
+    // u goes out from the centre, v around it; the ring lies in the xy-plane.
+    struct circle_ring_surface {
+        parametric_shapes::surface_point operator()(parametric_shapes::parameter_sample const &distance_to_centre,
+                                                    parametric_shapes::parameter_sample const &theta) const {
+            parametric_shapes::surface_point point;
+            point.position = distance_to_centre.value * glm::vec3(theta.cos, theta.sin, 0.0f);
+            point.du = glm::vec3(theta.cos, theta.sin, 0.0f);
+            // Divided by `distance_to_centre`, which vanishes at the centre.
+            point.dv = glm::vec3(-theta.sin, theta.cos, 0.0f);
+            return point;
+        }
+    };
+}
 
-    data.indices_nb = static_cast<GLsizei>(indices.size() * 3u);
+bonobo::mesh_data
+parametric_shapes::createSphere(float const radius,
+                                unsigned int const longitude_split_count,
+                                unsigned int const latitude_split_count) {
+    GPUMemoryRegistry::Scope const memory_scope("parametric_shapes::createSphere");
+
+    return createParametricSurface(sphere_surface{radius},
+                                   glm::vec2(0.0f, glm::two_pi<float>()), glm::vec2(0.0f, glm::pi<float>()),
+                                   longitude_split_count + 1u, latitude_split_count + 1u,
+                                   "Sphere");
+}
 
-    glBindVertexArray(0u);
+bonobo::mesh_data
+parametric_shapes::createTorus(float const major_radius,
+                               float const minor_radius,
+                               unsigned int const major_split_count,
+                               unsigned int const minor_split_count) {
+    GPUMemoryRegistry::Scope const memory_scope("parametric_shapes::createTorus");
 
-    return data;
+    return createParametricSurface(torus_surface{major_radius, minor_radius},
+                                   glm::vec2(0.0f, glm::two_pi<float>()), glm::vec2(0.0f, glm::two_pi<float>()),
+                                   major_split_count + 1u, minor_split_count + 1u,
+                                   "Torus");
 }
 
-// bonobo::mesh_data
-// parametric_shapes::createTorus(float const major_radius,
-//                                float const minor_radius,
-//                                unsigned int const major_split_count,
-//                                unsigned int const minor_split_count)
-//{
-//	//! \todo (Optional) Implement this function
-//	return bonobo::mesh_data();
-// }
-
 bonobo::mesh_data
 parametric_shapes::createCircleRing(float const radius,
                                     float const spread_length,
                                     unsigned int const circle_split_count,
                                     unsigned int const spread_split_count) {
-    auto const circle_slice_edges_count = circle_split_count + 1u;
-    auto const spread_slice_edges_count = spread_split_count + 1u;
-    auto const circle_slice_vertices_count = circle_slice_edges_count + 1u;
-    auto const spread_slice_vertices_count = spread_slice_edges_count + 1u;
-    auto const vertices_nb = circle_slice_vertices_count * spread_slice_vertices_count;
-
-    auto vertices = std::vector<glm::vec3>(vertices_nb);
-    auto normals = std::vector<glm::vec3>(vertices_nb);
-    auto texcoords = std::vector<glm::vec3>(vertices_nb);
-    auto tangents = std::vector<glm::vec3>(vertices_nb);
-    auto binormals = std::vector<glm::vec3>(vertices_nb);
-
-    float const spread_start = radius - 0.5f * spread_length;
-    float const d_theta = glm::two_pi<float>() / (static_cast<float>(circle_slice_edges_count));
-    float const d_spread = spread_length / (static_cast<float>(spread_slice_edges_count));
-
-    // generate vertices iteratively
-    size_t index = 0u;
-    float theta = 0.0f;
-    for (unsigned int i = 0u; i < circle_slice_vertices_count; ++i) {
-        float const cos_theta = std::cos(theta);
-        float const sin_theta = std::sin(theta);
-
-        float distance_to_centre = spread_start;
-        for (unsigned int j = 0u; j < spread_slice_vertices_count; ++j) {
-            // vertex
-            vertices[index] = glm::vec3(distance_to_centre * cos_theta,
-                                        distance_to_centre * sin_theta,
-                                        0.0f);
-
-            // texture coordinates
-            texcoords[index] = glm::vec3(static_cast<float>(j) / (static_cast<float>(spread_slice_vertices_count)),
-                                         static_cast<float>(i) / (static_cast<float>(circle_slice_vertices_count)),
-                                         0.0f);
-
-            // tangent
-            auto const t = glm::vec3(cos_theta, sin_theta, 0.0f);
-            tangents[index] = t;
-
-            // binormal
-            auto const b = glm::vec3(-sin_theta, cos_theta, 0.0f);
-            binormals[index] = b;
-
-            // normal
-            auto const n = glm::cross(t, b);
-            normals[index] = n;
-
-            distance_to_centre += d_spread;
-            ++index;
-        }
-
-        theta += d_theta;
-    }
-
-    // create index array
-    auto index_sets = std::vector<glm::uvec3>(2u * circle_slice_edges_count * spread_slice_edges_count);
-
-    // generate indices iteratively
-    index = 0u;
-    for (unsigned int i = 0u; i < circle_slice_edges_count; ++i) {
-        for (unsigned int j = 0u; j < spread_slice_edges_count; ++j) {
-            index_sets[index] = glm::uvec3(spread_slice_vertices_count * (i + 0u) + (j + 0u),
-                                           spread_slice_vertices_count * (i + 0u) + (j + 1u),
-                                           spread_slice_vertices_count * (i + 1u) + (j + 1u));
-            ++index;
-
-            index_sets[index] = glm::uvec3(spread_slice_vertices_count * (i + 0u) + (j + 0u),
-                                           spread_slice_vertices_count * (i + 1u) + (j + 1u),
-                                           spread_slice_vertices_count * (i + 1u) + (j + 0u));
-            ++index;
-        }
-    }
-
-    bonobo::mesh_data data;
-    glGenVertexArrays(1, &data.vao);
-    assert(data.vao != 0u);
-    glBindVertexArray(data.vao);
-
-    auto const vertices_offset = 0u;
-    auto const vertices_size = static_cast<GLsizeiptr>(vertices.size() * sizeof(glm::vec3));
-    auto const normals_offset = vertices_size;
-    auto const normals_size = static_cast<GLsizeiptr>(normals.size() * sizeof(glm::vec3));
-    auto const texcoords_offset = normals_offset + normals_size;
-    auto const texcoords_size = static_cast<GLsizeiptr>(texcoords.size() * sizeof(glm::vec3));
-    auto const tangents_offset = texcoords_offset + texcoords_size;
-    auto const tangents_size = static_cast<GLsizeiptr>(tangents.size() * sizeof(glm::vec3));
-    auto const binormals_offset = tangents_offset + tangents_size;
-    auto const binormals_size = static_cast<GLsizeiptr>(binormals.size() * sizeof(glm::vec3));
-    auto const bo_size = static_cast<GLsizeiptr>(vertices_size + normals_size + texcoords_size + tangents_size + binormals_size);
-    glGenBuffers(1, &data.bo);
-    assert(data.bo != 0u);
-    glBindBuffer(GL_ARRAY_BUFFER, data.bo);
-    glBufferData(GL_ARRAY_BUFFER, bo_size, nullptr, GL_STATIC_DRAW);
-
-    glBufferSubData(GL_ARRAY_BUFFER, vertices_offset, vertices_size, static_cast<GLvoid const *>(vertices.data()));
-    glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::vertices));
-    glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::vertices), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const *>(0x0));
-
-    glBufferSubData(GL_ARRAY_BUFFER, normals_offset, normals_size, static_cast<GLvoid const *>(normals.data()));
-    glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::normals));
-    glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::normals), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const *>(normals_offset));
-
-    glBufferSubData(GL_ARRAY_BUFFER, texcoords_offset, texcoords_size, static_cast<GLvoid const *>(texcoords.data()));
-    glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::texcoords));
-    glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::texcoords), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const *>(texcoords_offset));
-
-    glBufferSubData(GL_ARRAY_BUFFER, tangents_offset, tangents_size, static_cast<GLvoid const *>(tangents.data()));
-    glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::tangents));
-    glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::tangents), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const *>(tangents_offset));
-
-    glBufferSubData(GL_ARRAY_BUFFER, binormals_offset, binormals_size, static_cast<GLvoid const *>(binormals.data()));
-    glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::binormals));
-    glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::binormals), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const *>(binormals_offset));
-
-    glBindBuffer(GL_ARRAY_BUFFER, 0u);
-
-    data.indices_nb = static_cast<GLsizei>(index_sets.size() * 3u);
-    glGenBuffers(1, &data.ibo);
-    assert(data.ibo != 0u);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, data.ibo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(index_sets.size() * sizeof(glm::uvec3)), reinterpret_cast<GLvoid const *>(index_sets.data()), GL_STATIC_DRAW);
-
-    glBindVertexArray(0u);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0u);
-
-    return data;
-
+    GPUMemoryRegistry::Scope const memory_scope("parametric_shapes::createCircleRing");
 
+    return createParametricSurface(circle_ring_surface{},
+                                   glm::vec2(radius - 0.5f * spread_length, radius + 0.5f * spread_length),
+                                   glm::vec2(0.0f, glm::two_pi<float>()),
+                                   spread_split_count + 1u, circle_split_count + 1u,
+                                   "Circle ring");
 }
 
 bonobo::mesh_data
 parametric_shapes::createSpaceShip() {
+    GPUMemoryRegistry::Scope const memory_scope("parametric_shapes::createSpaceShip");
+
     bonobo::mesh_data data;
 
     // Define vertices for a simple 3D spaceship without wings
@@ -704,6 +532,178 @@ parametric_shapes::createSpaceShip() {
     // Unbind the VAO and EBO
     glBindVertexArray(0u);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0u);
+    GLStateCache::Get().Invalidate();
 
     return data;
 }
+
+namespace {
+    enum class shape_type : unsigned int {
+        sphere,
+        torus,
+        circle_ring
+    };
+
+    struct shape_key {
+        shape_type type;
+        float parameter; // Ratio which cannot be applied through a transform, if any
+        unsigned int first_split_count;
+        unsigned int second_split_count;
+
+        bool operator<(shape_key const &other) const {
+            return std::tie(type, parameter, first_split_count, second_split_count)
+                 < std::tie(other.type, other.parameter, other.first_split_count, other.second_split_count);
+        }
+    };
+
+    struct registry_entry {
+        std::weak_ptr<bonobo::mesh_data const> mesh;
+        std::size_t size{0u};        // In bytes, of the vertex and index buffers
+        float generation_time{0.0f}; // In milliseconds, upload included
+    };
+
+    std::map<shape_key, registry_entry> registry;
+    parametric_shapes::registry_statistics statistics;
+
+    std::size_t getBufferSize(GLenum const target, GLuint const buffer) {
+        if (buffer == 0u)
+            return 0u;
+
+        GLint size = 0;
+        glBindBuffer(target, buffer);
+        glGetBufferParameteriv(target, GL_BUFFER_SIZE, &size);
+        glBindBuffer(target, 0u);
+        return static_cast<std::size_t>(size);
+    }
+
+    parametric_shapes::shared_mesh
+    getShape(shape_key const &key, std::function<bonobo::mesh_data()> const &generate) {
+        auto &entry = registry[key];
+        if (auto mesh = entry.mesh.lock()) {
+            ++statistics.meshes_reused_nb;
+            statistics.bytes_saved += entry.size;
+            statistics.generation_time_saved += entry.generation_time;
+            return mesh;
+        }
+
+        auto const start_time = std::chrono::high_resolution_clock::now();
+        auto const data = generate();
+        if (data.vao == 0u)
+            return nullptr;
+
+        // Both buffers are unbound by now, so the generic array buffer
+        // binding point can be used to query their size.
+        entry.size = getBufferSize(GL_ARRAY_BUFFER, data.bo) + getBufferSize(GL_ARRAY_BUFFER, data.ibo);
+        entry.generation_time = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count();
+        ++statistics.meshes_generated_nb;
+
+        auto const mesh = parametric_shapes::shared_mesh(new bonobo::mesh_data(data),
+                                                          [](bonobo::mesh_data const *data) {
+                                                              glDeleteBuffers(1, &data->ibo);
+                                                              glDeleteBuffers(1, &data->bo);
+                                                              glDeleteVertexArrays(1, &data->vao);
+                                                              delete data;
+                                                          });
+        entry.mesh = mesh;
+        return mesh;
+    }
+}
+
+parametric_shapes::shared_mesh
+parametric_shapes::getSphere(unsigned int const longitude_split_count,
+                             unsigned int const latitude_split_count) {
+    return getShape({shape_type::sphere, 0.0f, longitude_split_count, latitude_split_count},
+                    [=]() {
+                        return createSphere(1.0f, longitude_split_count, latitude_split_count);
+                    });
+}
+
+parametric_shapes::shared_mesh
+parametric_shapes::getTorus(float const minor_radius_ratio,
+                            unsigned int const major_split_count,
+                            unsigned int const minor_split_count) {
+    return getShape({shape_type::torus, minor_radius_ratio, major_split_count, minor_split_count},
+                    [=]() {
+                        return createTorus(1.0f, minor_radius_ratio, major_split_count, minor_split_count);
+                    });
+}
+
+parametric_shapes::shared_mesh
+parametric_shapes::getCircleRing(float const spread_length_ratio,
+                                 unsigned int const circle_split_count,
+                                 unsigned int const spread_split_count) {
+    return getShape({shape_type::circle_ring, spread_length_ratio, circle_split_count, spread_split_count},
+                    [=]() {
+                        return createCircleRing(1.0f, spread_length_ratio, circle_split_count, spread_split_count);
+                    });
+}
+
+parametric_shapes::registry_statistics
+parametric_shapes::getRegistryStatistics() {
+    return statistics;
+}
+
+void parametric_shapes::logRegistryStatistics() {
+    LogInfo("Parametric shapes: %zu meshes generated, %zu requests served with an existing mesh, saving %.2f MiB and %.2f ms.",
+            statistics.meshes_generated_nb, statistics.meshes_reused_nb,
+            static_cast<float>(statistics.bytes_saved) / (1024.0f * 1024.0f),
+            statistics.generation_time_saved);
+}
+
+void parametric_shapes::runBenchmark() {
+    // 1024 edges in each direction give a bit over a million vertices.
+    auto constexpr split_count = 1023u;
+    auto constexpr runs_nb = 10u;
+
+    struct benchmark_case {
+        char const *shape;
+        unsigned int workers_nb;
+        std::function<bonobo::mesh_data(unsigned int)> create;
+    };
+    auto const create_sphere = [](unsigned int const workers_nb) {
+        return createParametricSurface(sphere_surface{1.0f},
+                                       glm::vec2(0.0f, glm::two_pi<float>()), glm::vec2(0.0f, glm::pi<float>()),
+                                       split_count + 1u, split_count + 1u, "Benchmark sphere", workers_nb);
+    };
+    auto const create_torus = [](unsigned int const workers_nb) {
+        return createParametricSurface(torus_surface{1.0f, 0.25f},
+                                       glm::vec2(0.0f, glm::two_pi<float>()), glm::vec2(0.0f, glm::two_pi<float>()),
+                                       split_count + 1u, split_count + 1u, "Benchmark torus", workers_nb);
+    };
+    auto const cases = std::array<benchmark_case, 4>{{{"sphere", 1u, create_sphere},
+                                                      {"sphere", 0u, create_sphere},
+                                                      {"torus", 1u, create_torus},
+                                                      {"torus", 0u, create_torus}}};
+
+    auto const vertices_nb = static_cast<std::size_t>(split_count + 2u) * (split_count + 2u);
+    LogInfo("┭ Benchmarking parametric surfaces of %zu vertices, over %u runs…", vertices_nb, runs_nb);
+    for (auto const &benchmark : cases) {
+        auto const threads_nb = detail::getWorkersCount(vertices_nb, split_count + 2u, benchmark.workers_nb);
+        float min_duration = std::numeric_limits<float>::max();
+        float total_duration = 0.0f;
+        for (unsigned int i = 0u; i < runs_nb; ++i) {
+            // Waiting for the driver to be done includes the upload, without
+            // the work left over from the previous run.
+            glFinish();
+            auto const start_time = std::chrono::high_resolution_clock::now();
+            auto const data = benchmark.create(benchmark.workers_nb);
+            glFinish();
+            auto const duration = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count();
+
+            if (data.vao == 0u) {
+                LogError("┕ Failed to generate the %s; aborting the benchmark.", benchmark.shape);
+                return;
+            }
+            glDeleteBuffers(1, &data.ibo);
+            glDeleteBuffers(1, &data.bo);
+            glDeleteVertexArrays(1, &data.vao);
+
+            min_duration = std::min(min_duration, duration);
+            total_duration += duration;
+        }
+        LogInfo("│ %s, %u thread(s): min %.2f ms, mean %.2f ms, %.1f million vertices per second",
+                benchmark.shape, threads_nb, min_duration, total_duration / static_cast<float>(runs_nb),
+                static_cast<float>(vertices_nb) / (min_duration * 1000.0f));
+    }
+    LogInfo("┕ Done benchmarking parametric surfaces.");
+}
@@ -2,7 +2,71 @@
 
 #include "core/helpers.hpp"
 
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
 namespace parametric_shapes {
+    //! \brief Value of a surface parameter along a grid line, with its
+    //!        cosine and sine; those are computed once per grid line rather
+    //!        than once per vertex.
+    struct parameter_sample {
+        float value{0.0f};
+        float cos{1.0f};
+        float sin{0.0f};
+    };
+
+    //! \brief Point of a parametric surface p(u, v), and the partial
+    //!        derivatives of p at that point.
+    //!
+    //! The derivatives only need to be correct up to a positive factor:
+    //! surfaces can drop the factors vanishing at singular points, such as
+    //! the poles of a sphere, to keep a valid tangent frame there.
+    struct surface_point {
+        glm::vec3 position{0.0f};
+        glm::vec3 du{1.0f, 0.0f, 0.0f}; //!< ∂p/∂u, giving the tangent
+        glm::vec3 dv{0.0f, 1.0f, 0.0f}; //!< ∂p/∂v, giving the binormal
+    };
+
+    //! \brief Tessellate a parametric surface into a grid and make it
+    //!        available to OpenGL.
+    //!
+    //! `surface` is called as `surface(u, v)` with two `parameter_sample`,
+    //! and returns a `surface_point`. The normal is the cross product of
+    //! the tangent and the binormal; triangles are counter-clockwise when
+    //! seen from the side it points to. Texture coordinates go from (0, 0)
+    //! to (1, 1) over the parameter ranges.
+    //!
+    //! Vertex attributes are written straight into the mapped vertex
+    //! buffer, one block per attribute, and indices into the mapped index
+    //! buffer; rows of the grid are split between several threads for
+    //! large surfaces, so `surface` has to be safe to call concurrently.
+    //!
+    //! @param u_range first and last values of u
+    //! @param v_range first and last values of v
+    //! @param u_edges_count number of edges along u, at least 1
+    //! @param v_edges_count number of edges along v, at least 1
+    //! @param name name given to the mesh
+    //! @param workers_nb number of threads generating the surface; 0 picks
+    //!                   one per `vertices_per_worker` vertices, up to the
+    //!                   number of hardware threads.
+    //! @return wrapper around OpenGL objects' name containing the geometry
+    //!         data
+    template<typename F>
+    bonobo::mesh_data createParametricSurface(F const &surface,
+                                              glm::vec2 const &u_range,
+                                              glm::vec2 const &v_range,
+                                              unsigned int const u_edges_count,
+                                              unsigned int const v_edges_count,
+                                              std::string const &name,
+                                              unsigned int const workers_nb = 0u);
+
+    //! \brief Below this amount of vertices, threads cost more than they
+    //!        save.
+    constexpr std::size_t vertices_per_worker = 32768u;
+
     //! \brief Create a quad a given tesselation level and make it
     //!        available to OpenGL.
     //!
@@ -100,4 +164,94 @@ namespace parametric_shapes {
                                        unsigned int const spread_split_count);
 
     bonobo::mesh_data createSpaceShip();
+
+    //! \brief Mesh shared between all the users requesting the same shape;
+    //!        its OpenGL objects are deleted along with the last reference.
+    using shared_mesh = std::shared_ptr<bonobo::mesh_data const>;
+
+    //! \brief Retrieve a sphere of radius 1 from the registry, generating it
+    //!        only if no one currently holds it.
+    //!
+    //! Meshes are unit-sized so that all spheres of a same tesselation level
+    //! can share one: apply the radius through the transform of the nodes
+    //! instead, using `TRSTransformf::SetScale()`.
+    //!
+    //! Nodes only copy the names of the OpenGL objects, so the returned
+    //! pointer has to be kept alive for as long as they are rendered.
+    //!
+    //! @param longitude_split_count see `createSphere()`
+    //! @param latitude_split_count see `createSphere()`
+    //! @return the shared mesh, or nullptr if it could not be generated
+    shared_mesh getSphere(unsigned int const longitude_split_count,
+                          unsigned int const latitude_split_count);
+
+    //! \brief Retrieve a torus of major radius 1 from the registry; see
+    //!        `getSphere()`.
+    //!
+    //! @param minor_radius_ratio minor radius divided by the major one, as
+    //!                           it cannot be applied through a transform
+    //! @param major_split_count see `createTorus()`
+    //! @param minor_split_count see `createTorus()`
+    shared_mesh getTorus(float const minor_radius_ratio,
+                         unsigned int const major_split_count,
+                         unsigned int const minor_split_count);
+
+    //! \brief Retrieve a circle ring of radius 1 from the registry; see
+    //!        `getSphere()`.
+    //!
+    //! @param spread_length_ratio spread length divided by the radius, as
+    //!                            it cannot be applied through a transform
+    //! @param circle_split_count see `createCircleRing()`
+    //! @param spread_split_count see `createCircleRing()`
+    shared_mesh getCircleRing(float const spread_length_ratio,
+                              unsigned int const circle_split_count,
+                              unsigned int const spread_split_count);
+
+    struct registry_statistics {
+        std::size_t meshes_generated_nb{0u}; //!< number of meshes generated by the registry
+        std::size_t meshes_reused_nb{0u};    //!< number of requests served with an existing mesh
+        std::size_t bytes_saved{0u};         //!< GPU memory that reusing meshes avoided allocating
+        float generation_time_saved{0.0f};   //!< time that reusing meshes avoided spending, in milliseconds
+    };
+
+    //! \brief How much the registry saved since the start of the program.
+    registry_statistics getRegistryStatistics();
+
+    //! \brief Log the statistics returned by `getRegistryStatistics()`.
+    void logRegistryStatistics();
+
+    //! \brief Log how long generating and uploading a sphere and a torus of
+    //!        over a million vertices takes, with a single thread and with
+    //!        the default amount of threads.
+    void runBenchmark();
+
+    namespace detail {
+        //! \brief Mesh whose buffers are allocated and mapped, for the
+        //!        attributes and indices to be written in.
+        struct mapped_surface {
+            bonobo::mesh_data data;
+            glm::vec3 *positions{nullptr};
+            glm::vec3 *normals{nullptr};
+            glm::vec2 *texcoords{nullptr};
+            glm::vec3 *tangents{nullptr};
+            glm::vec3 *binormals{nullptr};
+            glm::uvec3 *triangles{nullptr};
+        };
+
+        bool mapSurface(mapped_surface &surface, unsigned int const u_edges_count,
+                        unsigned int const v_edges_count, std::string const &name);
+
+        //! \return the mesh, or an empty one if its content got lost while
+        //!         mapped, in which case its OpenGL objects are deleted.
+        bonobo::mesh_data unmapSurface(mapped_surface &surface,
+                                       glm::vec3 const &bounds_min, glm::vec3 const &bounds_max);
+
+        parameter_sample sampleParameter(glm::vec2 const &range, unsigned int const edges_count,
+                                         unsigned int const index);
+
+        unsigned int getWorkersCount(std::size_t const vertices_nb, unsigned int const rows_nb,
+                                     unsigned int const requested_workers_nb);
+    }
 }
+
+#include "parametric_shapes.inl"
@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <thread>
+#include <vector>
+
+template<typename F>
+bonobo::mesh_data
+parametric_shapes::createParametricSurface(F const &surface,
+                                           glm::vec2 const &u_range,
+                                           glm::vec2 const &v_range,
+                                           unsigned int const u_edges_count,
+                                           unsigned int const v_edges_count,
+                                           std::string const &name,
+                                           unsigned int const workers_nb) {
+    detail::mapped_surface mapped;
+    if (!detail::mapSurface(mapped, u_edges_count, v_edges_count, name))
+        return bonobo::mesh_data();
+
+    auto const u_vertices_nb = u_edges_count + 1u;
+    auto const v_vertices_nb = v_edges_count + 1u;
+
+    // Samples along v are the same for every row.
+    auto v_samples = std::vector<parameter_sample>(v_vertices_nb);
+    for (unsigned int j = 0u; j < v_vertices_nb; ++j)
+        v_samples[j] = detail::sampleParameter(v_range, v_edges_count, j);
+
+    struct bounds {
+        glm::vec3 min{std::numeric_limits<float>::max()};
+        glm::vec3 max{std::numeric_limits<float>::lowest()};
+    };
+
+    auto const generate_rows = [&](unsigned int const first_row, unsigned int const last_row, bounds &rows_bounds) {
+        for (unsigned int i = first_row; i < last_row; ++i) {
+            auto const u = detail::sampleParameter(u_range, u_edges_count, i);
+            auto const texcoord_u = static_cast<float>(i) / static_cast<float>(u_edges_count);
+
+            auto index = i * v_vertices_nb;
+            for (unsigned int j = 0u; j < v_vertices_nb; ++j, ++index) {
+                auto const point = surface(u, v_samples[j]);
+                auto const tangent = glm::normalize(point.du);
+                auto const binormal = glm::normalize(point.dv);
+
+                mapped.positions[index] = point.position;
+                mapped.normals[index] = glm::normalize(glm::cross(tangent, binormal));
+                mapped.texcoords[index] = glm::vec2(texcoord_u, static_cast<float>(j) / static_cast<float>(v_edges_count));
+                mapped.tangents[index] = tangent;
+                mapped.binormals[index] = binormal;
+
+                rows_bounds.min = glm::min(rows_bounds.min, point.position);
+                rows_bounds.max = glm::max(rows_bounds.max, point.position);
+            }
+
+            if (i == u_edges_count)
+                continue;
+
+            auto triangle = 2u * i * v_edges_count;
+            for (unsigned int j = 0u; j < v_edges_count; ++j) {
+                auto const current = i * v_vertices_nb + j;
+                auto const next_row = current + v_vertices_nb;
+                mapped.triangles[triangle++] = glm::uvec3(current, next_row, current + 1u);
+                mapped.triangles[triangle++] = glm::uvec3(next_row, next_row + 1u, current + 1u);
+            }
+        }
+    };
+
+    // Workers write to disjoint ranges of rows, and no OpenGL calls are made
+    // until they are all done.
+    auto const threads_nb = detail::getWorkersCount(static_cast<std::size_t>(u_vertices_nb) * v_vertices_nb,
+                                                    u_vertices_nb, workers_nb);
+    auto workers_bounds = std::vector<bounds>(threads_nb);
+    std::vector<std::thread> workers;
+    for (unsigned int k = 1u; k < threads_nb; ++k)
+        workers.emplace_back(generate_rows,
+                             k * u_vertices_nb / threads_nb, (k + 1u) * u_vertices_nb / threads_nb,
+                             std::ref(workers_bounds[k]));
+    generate_rows(0u, u_vertices_nb / threads_nb, workers_bounds[0]);
+    for (auto &worker : workers)
+        worker.join();
+
+    auto surface_bounds = bounds();
+    for (auto const &worker_bounds : workers_bounds) {
+        surface_bounds.min = glm::min(surface_bounds.min, worker_bounds.min);
+        surface_bounds.max = glm::max(surface_bounds.max, worker_bounds.max);
+    }
+
+    return detail::unmapSurface(mapped, surface_bounds.min, surface_bounds.max);
+}
@@ -6,11 +6,19 @@
 
 #include "config.hpp"
 #include "core/Bonobo.h"
+#include "core/FlythroughBenchmark.hpp"
 #include "core/FPSCamera.h"
+#include "core/GLCallCounters.hpp"
+#include "core/GLStateCache.hpp"
+#include "core/GPUMemoryRegistry.hpp"
+#include "core/GPUTimerQueryPool.hpp"
 #include "core/helpers.hpp"
 #include "core/node.hpp"
 #include "core/opengl.hpp"
+#include "core/Profiler.h"
+#include "core/RenderGraph.hpp"
 #include "core/ShaderProgramManager.hpp"
+#include "core/ShaderReflection.hpp"
 
 #include <imgui.h>
 #include <glm/glm.hpp>
@@ -18,9 +26,17 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <tinyfiledialogs.h>
 
+#include <algorithm>
 #include <array>
 #include <clocale>
+#include <cmath>
 #include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <limits>
+#include <map>
+#include <numeric>
 #include <stdexcept>
 
 namespace constant
@@ -28,6 +44,10 @@ namespace constant
 	constexpr uint32_t shadowmap_res_x = 1024;
 	constexpr uint32_t shadowmap_res_y = 1024;
 
+	// Material textures are all resampled to that size for the visibility
+	// buffer, to fit in a single array texture.
+	constexpr GLsizei visibility_buffer_material_res = 512;
+
 	constexpr float  scale_lengths       = 100.0f; // The scene is expressed in centimetres rather than metres, hence the x100.
 
 	constexpr size_t lights_nb           = 4;
@@ -35,6 +55,59 @@ namespace constant
 	constexpr float  light_angle_falloff = glm::radians(37.0f);
 }
 
+// Uniforms set through the reflection of the programs using them.
+namespace uniform
+{
+	ShaderReflection::UniformId const vertex_model_to_world     = ShaderReflection::GetUniformId("vertex_model_to_world");
+	ShaderReflection::UniformId const normal_model_to_world     = ShaderReflection::GetUniformId("normal_model_to_world");
+	ShaderReflection::UniformId const light_index               = ShaderReflection::GetUniformId("light_index");
+	ShaderReflection::UniformId const opacity_texture           = ShaderReflection::GetUniformId("opacity_texture");
+	ShaderReflection::UniformId const has_opacity_texture       = ShaderReflection::GetUniformId("has_opacity_texture");
+	ShaderReflection::UniformId const use_compact_gbuffer       = ShaderReflection::GetUniformId("use_compact_gbuffer");
+	ShaderReflection::UniformId const diffuse_texture           = ShaderReflection::GetUniformId("diffuse_texture");
+	ShaderReflection::UniformId const specular_texture          = ShaderReflection::GetUniformId("specular_texture");
+	ShaderReflection::UniformId const normals_texture           = ShaderReflection::GetUniformId("normals_texture");
+	ShaderReflection::UniformId const first_triangle            = ShaderReflection::GetUniformId("first_triangle");
+	ShaderReflection::UniformId const visibility_buffer         = ShaderReflection::GetUniformId("visibility_buffer");
+	ShaderReflection::UniformId const material_textures         = ShaderReflection::GetUniformId("material_textures");
+	ShaderReflection::UniformId const vertices_nb               = ShaderReflection::GetUniformId("vertices_nb");
+	ShaderReflection::UniformId const render_size               = ShaderReflection::GetUniformId("render_size");
+	ShaderReflection::UniformId const depth_texture             = ShaderReflection::GetUniformId("depth_texture");
+	ShaderReflection::UniformId const normal_texture            = ShaderReflection::GetUniformId("normal_texture");
+	ShaderReflection::UniformId const shadow_texture            = ShaderReflection::GetUniformId("shadow_texture");
+	ShaderReflection::UniformId const shadow_compare_texture    = ShaderReflection::GetUniformId("shadow_compare_texture");
+	ShaderReflection::UniformId const shadow_moments_texture    = ShaderReflection::GetUniformId("shadow_moments_texture");
+	ShaderReflection::UniformId const camera_position           = ShaderReflection::GetUniformId("camera_position");
+	ShaderReflection::UniformId const inverse_screen_resolution = ShaderReflection::GetUniformId("inverse_screen_resolution");
+	ShaderReflection::UniformId const render_scale              = ShaderReflection::GetUniformId("render_scale");
+	ShaderReflection::UniformId const light_color               = ShaderReflection::GetUniformId("light_color");
+	ShaderReflection::UniformId const light_position            = ShaderReflection::GetUniformId("light_position");
+	ShaderReflection::UniformId const light_direction           = ShaderReflection::GetUniformId("light_direction");
+	ShaderReflection::UniformId const light_intensity           = ShaderReflection::GetUniformId("light_intensity");
+	ShaderReflection::UniformId const light_angle_falloff       = ShaderReflection::GetUniformId("light_angle_falloff");
+	ShaderReflection::UniformId const shadow_filtering          = ShaderReflection::GetUniformId("shadow_filtering");
+	ShaderReflection::UniformId const poisson_taps_nb           = ShaderReflection::GetUniformId("poisson_taps_nb");
+	ShaderReflection::UniformId const poisson_radius            = ShaderReflection::GetUniformId("poisson_radius");
+	ShaderReflection::UniformId const shadow_bias               = ShaderReflection::GetUniformId("shadow_bias");
+	ShaderReflection::UniformId const light_bleeding_reduction  = ShaderReflection::GetUniformId("light_bleeding_reduction");
+	ShaderReflection::UniformId const evsm_exponents            = ShaderReflection::GetUniformId("evsm_exponents");
+	ShaderReflection::UniformId const light_near_far            = ShaderReflection::GetUniformId("light_near_far");
+	ShaderReflection::UniformId const lights_interleave         = ShaderReflection::GetUniformId("lights_interleave");
+	ShaderReflection::UniformId const frame_index               = ShaderReflection::GetUniformId("frame_index");
+	ShaderReflection::UniformId const light_d_texture           = ShaderReflection::GetUniformId("light_d_texture");
+	ShaderReflection::UniformId const light_s_texture           = ShaderReflection::GetUniformId("light_s_texture");
+	ShaderReflection::UniformId const history_light_d_texture   = ShaderReflection::GetUniformId("history_light_d_texture");
+	ShaderReflection::UniformId const history_light_s_texture   = ShaderReflection::GetUniformId("history_light_s_texture");
+	ShaderReflection::UniformId const history_geometry_texture  = ShaderReflection::GetUniformId("history_geometry_texture");
+	ShaderReflection::UniformId const is_history_valid          = ShaderReflection::GetUniformId("is_history_valid");
+	ShaderReflection::UniformId const previous_view_projection  = ShaderReflection::GetUniformId("previous_view_projection");
+	ShaderReflection::UniformId const camera_near_far           = ShaderReflection::GetUniformId("camera_near_far");
+	ShaderReflection::UniformId const previous_render_scale     = ShaderReflection::GetUniformId("previous_render_scale");
+	ShaderReflection::UniformId const history_weight            = ShaderReflection::GetUniformId("history_weight");
+	ShaderReflection::UniformId const depth_tolerance           = ShaderReflection::GetUniformId("depth_tolerance");
+	ShaderReflection::UniformId const normal_tolerance          = ShaderReflection::GetUniformId("normal_tolerance");
+}
+
 namespace
 {
 	template <class E> constexpr auto toU(E const& e)
@@ -42,53 +115,40 @@ namespace
 		return static_cast<std::underlying_type_t<E>>(e);
 	}
 
-	enum class Texture : uint32_t {
-		DepthBuffer = 0u,
-		ShadowMap,
-		GBufferDiffuse,
-		GBufferSpecular,
-		GBufferWorldSpaceNormal,
-		LightDiffuseContribution,
-		LightSpecularContribution,
-		Result,
+	enum class GBufferLayout : int32_t {
+		Reference = 0, // One RGBA8 target per attribute and per light contribution
+		Compact,       // Octahedral RG16 normals, specular intensity in the diffuse alpha, single R11G11B10F light target
+		Visibility,    // Triangle IDs only, expanded into the reference targets by a compute pass; needs OpenGL 4.3
 		Count
 	};
-	using Textures = std::array<GLuint, toU(Texture::Count)>;
-	Textures createTextures(GLsizei framebuffer_width, GLsizei framebuffer_height);
+	char const* const gbuffer_layout_names[] = {
+		"Reference",
+		"Compact",
+		"Visibility buffer"
+	};
+
+	//! \brief Estimated memory and bandwidth cost of a G-buffer layout, in
+	//! bytes per pixel; blending is counted as a read and a write.
+	struct GBufferBudget
+	{
+		uint32_t storage{ 0u };        // All full-resolution targets, including depth and result
+		uint32_t fill{ 0u };           // Written by the G-buffer pass
+		uint32_t per_light{ 0u };      // Read and written by each light volume
+		uint32_t resolve{ 0u };        // Read and written by the resolve pass
+	};
+	GBufferBudget getGBufferBudget(GBufferLayout layout);
 
 	enum class Sampler : uint32_t {
 		Nearest = 0u,
 		Linear,
 		Mipmaps,
+		ShadowCompare,
+		ShadowMoments,
 		Count
 	};
 	using Samplers = std::array<GLuint, toU(Sampler::Count)>;
 	Samplers createSamplers();
 
-	enum class FBO : uint32_t {
-		GBuffer = 0u,
-		ShadowMap,
-		LightAccumulation,
-		Resolve,
-		FinalWithDepth,
-		Count
-	};
-	using FBOs = std::array<GLuint, toU(FBO::Count)>;
-	FBOs createFramebufferObjects(Textures const& textures);
-
-	enum class ElapsedTimeQuery : uint32_t {
-		GbufferGeneration = 0u,
-		ShadowMap0Generation,
-		Light0Accumulation = ShadowMap0Generation + static_cast<uint32_t>(constant::lights_nb),
-		Resolve = Light0Accumulation + static_cast<uint32_t>(constant::lights_nb),
-		ConeWireframe,
-		GUI,
-		CopyToFramebuffer,
-		Count
-	};
-	using ElapsedTimeQueries = std::array<GLuint, toU(ElapsedTimeQuery::Count)>;
-	ElapsedTimeQueries createElapsedTimeQueries();
-
 	enum class UBO : uint32_t {
 		CameraViewProjTransforms = 0u,
 		LightViewProjTransforms,
@@ -97,6 +157,215 @@ namespace
 	using UBOs = std::array<GLuint, toU(UBO::Count)>;
 	UBOs createUniformBufferObjects();
 
+	enum class ShadowFiltering : int32_t {
+		Reference5x5 = 0,   // 25 unfiltered depth comparisons per pixel
+		HardwarePoisson,    // Rotated Poisson disk over a comparison sampler
+		VSM,                // Variance shadow maps
+		EVSM,               // Exponential variance shadow maps
+		Count
+	};
+	char const* const shadow_filtering_names[] = {
+		"Reference 5x5",
+		"Hardware compare + Poisson",
+		"VSM",
+		"EVSM"
+	};
+
+	struct ShadowSettings
+	{
+		ShadowFiltering filtering{ ShadowFiltering::HardwarePoisson };
+		int   poisson_taps_nb{ 8 };
+		float poisson_radius{ 1.5f }; // In shadow map texels
+		float bias{ 0.00002f };
+		int   blur_passes_nb{ 1 };
+		float light_bleeding_reduction{ 0.2f };
+		glm::vec2 evsm_exponents{ 40.0f, 5.0f };
+	};
+
+	// Quality tiers, from cheapest to most expensive; the last one is the
+	// original brute-force filtering, kept for comparison.
+	std::array<ShadowSettings, 5> const shadow_quality_presets = {
+		ShadowSettings{ ShadowFiltering::HardwarePoisson,  4, 1.0f, 0.00002f, 0, 0.2f,  { 40.0f, 5.0f } },
+		ShadowSettings{ ShadowFiltering::HardwarePoisson,  8, 1.5f, 0.00002f, 0, 0.2f,  { 40.0f, 5.0f } },
+		ShadowSettings{ ShadowFiltering::VSM,              8, 1.5f, 0.00002f, 1, 0.3f,  { 40.0f, 5.0f } },
+		ShadowSettings{ ShadowFiltering::EVSM,             8, 1.5f, 0.00002f, 2, 0.05f, { 40.0f, 5.0f } },
+		ShadowSettings{ ShadowFiltering::Reference5x5,     8, 1.5f, 0.00002f, 0, 0.2f,  { 40.0f, 5.0f } }
+	};
+	char const* const shadow_quality_preset_names[] = {
+		"Low",
+		"Medium",
+		"High",
+		"Ultra",
+		"Reference"
+	};
+
+	//! \brief Resolution the lights get accumulated at, relative to the
+	//! G-buffer; each step halves it along both axes.
+	enum class LightingResolution : int32_t {
+		Full = 0,
+		Half,
+		Quarter,
+		Count
+	};
+	char const* const lighting_resolution_names[] = {
+		"Full",
+		"Half",
+		"Quarter"
+	};
+	float getLightingScale(LightingResolution resolution);
+
+	//! \brief Size of the area covering `scale` times `size` texels, rounded
+	//! the same way as the framebuffer-relative textures of the render graph.
+	int getScaledSize(int size, float scale);
+
+	//! \brief How the light contributions get upsampled back to the
+	//! resolution of the G-buffer, by the resolve pass.
+	struct LightUpsamplingSettings
+	{
+		LightingResolution resolution{ LightingResolution::Full };
+		float depth_sigma{ 0.02f };  // Relative difference in view depth
+		float normal_power{ 8.0f };
+	};
+
+	// From the sharpest to the cheapest.
+	std::array<LightUpsamplingSettings, 3> const light_upsampling_presets = {
+		LightUpsamplingSettings{ LightingResolution::Full,    0.02f, 8.0f },
+		LightUpsamplingSettings{ LightingResolution::Half,    0.02f, 8.0f },
+		LightUpsamplingSettings{ LightingResolution::Quarter, 0.05f, 4.0f }
+	};
+	char const* const light_upsampling_preset_names[] = {
+		"Quality",
+		"Balanced",
+		"Performance"
+	};
+
+	//! \brief Settings changing the passes or textures of the render graph,
+	//! which gets rebuilt whenever any of them changes.
+	struct RenderGraphConfiguration
+	{
+		GBufferLayout   gbuffer_layout{ GBufferLayout::Reference };
+		int             lights_nb{ 0 };
+		ShadowFiltering shadow_filtering{ ShadowFiltering::HardwarePoisson };
+		int             blur_passes_nb{ 0 };
+		bool            use_depth_prepass{ false };
+		LightingResolution lighting_resolution{ LightingResolution::Full };
+		bool            use_temporal_lighting{ false };
+		bool            show_textures{ false };
+		bool            show_debug_elements{ false };
+
+		bool operator==(RenderGraphConfiguration const& other) const
+		{
+			return gbuffer_layout == other.gbuffer_layout
+			    && lights_nb == other.lights_nb
+			    && shadow_filtering == other.shadow_filtering
+			    && blur_passes_nb == other.blur_passes_nb
+			    && use_depth_prepass == other.use_depth_prepass
+			    && lighting_resolution == other.lighting_resolution
+			    && use_temporal_lighting == other.use_temporal_lighting
+			    && show_textures == other.show_textures
+			    && show_debug_elements == other.show_debug_elements;
+		}
+	};
+
+	//! \brief Drives the fraction of the render targets used by the
+	//! G-buffer and light accumulation passes, from the measured GPU time.
+	struct DynamicResolution
+	{
+		bool  is_enabled{ false };
+		float target_frame_time_ms{ 16.0f };
+		float min_scale{ 0.5f };
+		float max_scale{ 1.0f };
+		float scale{ 1.0f };            // Applied to both axes
+		float smoothed_frame_time_ms{ 0.0f };
+		int   frames_since_last_change{ 0 };
+	};
+
+	//! \brief Update the resolution scale given the GPU time of the latest
+	//! frame whose timings are known.
+	//!
+	//! Timings are only known a few frames late, so the scale is changed at
+	//! most every `settle_frames_nb` frames, to let the effect of the
+	//! previous change reach the measurements.
+	void updateDynamicResolution(DynamicResolution& dynamic_resolution, float gpu_frame_time_ms, int settle_frames_nb);
+
+	//! \brief Amortise the lights over several frames: each pixel only
+	//! evaluates some of them every frame, and the missing ones are filled
+	//! in by the contributions accumulated over the previous frames.
+	struct TemporalLighting
+	{
+		bool  is_enabled{ false };
+		int   lights_per_pixel{ 1 };      // Evaluated per pixel and frame, on average
+		float history_weight{ 0.9f };
+		float depth_tolerance{ 0.02f };   // Relative difference in view depth
+		float normal_tolerance{ 0.9f };   // Minimum cosine between normals
+		bool  show_error{ false };
+	};
+
+	//! \brief Light contributions accumulated over the previous frames.
+	//!
+	//! They have to survive from one frame to the next, unlike the textures
+	//! of the render graph which get aliased; two sets are ping-ponged, one
+	//! being read while the other one gets written.
+	struct TemporalLightingHistory
+	{
+		std::array<GLuint, 2> light_diffuse{ { 0u, 0u } };
+		std::array<GLuint, 2> light_specular{ { 0u, 0u } };
+		std::array<GLuint, 2> geometry{ { 0u, 0u } };     // World-space normal and window depth
+		std::array<GLuint, 2> framebuffers{ { 0u, 0u } };
+		GLuint error{ 0u };                               // Shared by both sets, only for visualisation
+		GLsizei width{ 0 };
+		GLsizei height{ 0 };
+		size_t current{ 0u };                             // Set written this frame
+		bool is_valid{ false };                           // Whether the other set can be reprojected
+		glm::mat4 previous_view_projection{ 1.0f };
+		glm::vec2 previous_render_scale{ 1.0f };
+		int frame_index{ 0 };
+	};
+	TemporalLightingHistory createTemporalLightingHistory(GLsizei width, GLsizei height);
+	void deleteTemporalLightingHistory(TemporalLightingHistory& history);
+
+	enum class LightVolumeCulling : int32_t {
+		None = 0,          // Shade every pixel behind the back faces of the cone
+		Scissor,           // Same, within the screen-space bounds of the cone
+		StencilAndScissor, // Only shade pixels inside the cone, marked in the stencil buffer
+		Count
+	};
+	char const* const light_volume_culling_names[] = {
+		"None",
+		"Scissor",
+		"Stencil + scissor"
+	};
+
+	//! \brief Screen-space rectangle covering the projection of a light
+	//! cone, as (x, y, width, height) in pixels.
+	//!
+	//! Computed from the bounding box of the cone, and falling back to the
+	//! whole viewport when that box crosses the plane of the camera.
+	glm::ivec4 computeLightScissor(glm::mat4 const& cone_model_to_clip, int viewport_width, int viewport_height);
+
+	//! \brief GL_SAMPLES_PASSED queries counting the fragments shaded by
+	//! the G-buffer pass and by each light, read back a few frames late so
+	//! as not to stall.
+	//!
+	//! The latest count is kept for each G-buffer and light culling mode, so
+	//! that they can be compared after switching between them.
+	struct ShadedFragmentsCounters
+	{
+		static constexpr size_t latency_frames_nb = 4u;
+		std::array<std::array<GLuint, constant::lights_nb>, latency_frames_nb> queries;
+		std::array<std::array<LightVolumeCulling, constant::lights_nb>, latency_frames_nb> issued_with; // Count if not issued
+		std::array<std::array<GLuint64, constant::lights_nb>, static_cast<size_t>(LightVolumeCulling::Count)> last_counts;
+		std::array<GLuint, latency_frames_nb> gbuffer_queries;
+		std::array<int, latency_frames_nb> gbuffer_issued_with; // Whether the depth pre-pass was used, or -1 if not issued
+		std::array<GLuint64, 2> gbuffer_last_counts;            // Without and with the depth pre-pass
+		size_t current_frame{ 0u };
+	};
+	ShadedFragmentsCounters createShadedFragmentsCounters();
+
+	//! \brief Collect the counts that are available, and move on to the
+	//! next set of queries; call it once per frame.
+	void advanceShadedFragmentsCounters(ShadedFragmentsCounters& counters);
+
 	struct ViewProjTransforms
 	{
 		glm::mat4 view_projection = glm::mat4(1.0f);
@@ -111,52 +380,88 @@ namespace
 		GLuint opacity_texture_id{ 0u };
 	};
 
-	struct GBufferShaderLocations
+	// Textures a material has, selecting the variant of the G-buffer filling
+	// program to use.
+	enum MaterialFeature : std::uint32_t
 	{
-		GLuint ubo_CameraViewProjTransforms{ 0u };
-		GLuint vertex_model_to_world{ 0u };
-		GLuint normal_model_to_world{ 0u };
-		GLuint diffuse_texture{ 0u };
-		GLuint specular_texture{ 0u };
-		GLuint normals_texture{ 0u };
-		GLuint opacity_texture{ 0u };
-		GLuint has_diffuse_texture{ 0u };
-		GLuint has_specular_texture{ 0u };
-		GLuint has_normals_texture{ 0u };
-		GLuint has_opacity_texture{ 0u };
+		MaterialFeatureDiffuseTexture  = 1u << 0,
+		MaterialFeatureSpecularTexture = 1u << 1,
+		MaterialFeatureNormalsTexture  = 1u << 2,
+		MaterialFeatureOpacityTexture  = 1u << 3,
+		MaterialFeatureAll             = (1u << 4) - 1u
 	};
-	void fillGBufferShaderLocations(GLuint gbuffer_shader, GBufferShaderLocations& locations);
+	std::uint32_t getMaterialFeatures(GeometryTextureData const& texture_data);
 
-	struct FillShadowmapShaderLocations
+	//! \brief Per-mesh data read by the visibility buffer resolve pass;
+	//! must match `Mesh` in resolve_visibility_buffer.comp.
+	struct VisibilityBufferMesh
 	{
-		GLuint ubo_LightViewProjTransforms{ 0u };
-		GLuint light_index{ 0u };
-		GLuint vertex_model_to_world{ 0u };
-		GLuint opacity_texture{ 0u };
-		GLuint has_opacity_texture{ 0u };
+		uint32_t first_triangle{ 0u };
+		uint32_t first_index{ 0u };
+		uint32_t first_vertex{ 0u };
+		int32_t  diffuse_layer{ -1 };
+		int32_t  specular_layer{ -1 };
+		int32_t  normals_layer{ -1 };
+		uint32_t padding[2]{ 0u, 0u };
 	};
-	void fillShadowmapShaderLocations(GLuint shadowmap_shader, FillShadowmapShaderLocations& locations);
 
-	struct AccumulateLightsShaderLocations
+	//! \brief Scene geometry and materials packed for the visibility buffer
+	//! resolve pass, which can fetch the attributes of any triangle.
+	//!
+	//! Vertex attributes and indices of all meshes are copied on the GPU
+	//! into shader storage buffers, and the material textures are resampled
+	//! into the layers of a single array texture, as OpenGL 4.3 has no way
+	//! to pick arbitrary textures from a shader.
+	struct VisibilityBufferScene
 	{
-		GLuint ubo_CameraViewProjTransforms{ 0u };
-		GLuint ubo_LightViewProjTransforms{ 0u };
-		GLuint light_index{ 0u };
-		GLuint vertex_model_to_world{ 0u };
-		GLuint vertex_world_to_clip{ 0u };
-		GLuint vertex_clip_to_world{ 0u };
-		GLuint depth_texture{ 0u };
-		GLuint normal_texture{ 0u };
-		GLuint shadow_texture{ 0u };
-		GLuint camera_position{ 0u };
-		GLuint inverse_screen_resolution{ 0u };
-		GLuint light_color{ 0u };
-		GLuint light_position{ 0u };
-		GLuint light_direction{ 0u };
-		GLuint light_intensity{ 0u };
-		GLuint light_angle_falloff{ 0u };
+		GLuint meshes{ 0u };            // One VisibilityBufferMesh per packed mesh
+		GLuint indices{ 0u };
+		GLuint attributes{ 0u };        // Positions, normals, texture coordinates, tangents and binormals, one after the other
+		GLuint material_textures{ 0u };
+		GLuint vertices_nb{ 0u };
+		std::vector<GLuint> first_triangles; // Per mesh of the scene
+		std::vector<bool> is_packed;         // Per mesh of the scene; only indexed triangle lists are
 	};
-	void fillAccumulateLightsShaderLocations(GLuint accumulate_lights_shader, AccumulateLightsShaderLocations& locations);
+	VisibilityBufferScene createVisibilityBufferScene(std::vector<bonobo::mesh_data> const& geometry,
+	                                                  std::vector<GeometryTextureData> const& texture_data);
+	void deleteVisibilityBufferScene(VisibilityBufferScene& scene);
+
+	//! \brief Sweep over G-buffer layouts, resolution scales and light
+	//! counts, measuring the mean GPU frame time of each combination.
+	struct GBufferBenchmark
+	{
+		struct Case
+		{
+			GBufferLayout layout{ GBufferLayout::Reference };
+			float scale{ 1.0f };
+			int lights_nb{ 1 };
+			int render_width{ 0 };
+			int render_height{ 0 };
+			double mean_gpu_frame_time_ms{ 0.0 };
+		};
+
+		// Enough for the timings of the previous case to be out of the way.
+		static constexpr int warmup_frames_nb = 16;
+		static constexpr int measured_frames_nb = 64;
+
+		std::vector<Case> cases;
+		size_t current_case{ 0u };
+		int current_frame{ 0 };
+		double accumulated_gpu_frame_time_ms{ 0.0 };
+		bool is_running{ false };
+	};
+	GBufferBenchmark createGBufferBenchmark(bool include_visibility_buffer);
+
+	//! \brief Account for the GPU time of the latest frame whose timings
+	//! are known, and move on to the next case once enough frames were
+	//! measured; call it once per frame.
+	void advanceGBufferBenchmark(GBufferBenchmark& benchmark, double gpu_frame_time_ms, int render_width, int render_height);
+
+	bool exportGBufferBenchmark(GBufferBenchmark const& benchmark, std::string const& filename);
+
+	//! \brief Path down the nave of Sponza and back, used when no path was
+	//! recorded yet.
+	FlythroughBenchmark createDefaultFlythrough();
 
 	bonobo::mesh_data loadCone();
 } // namespace
@@ -165,8 +470,16 @@ edan35::Assignment2::Assignment2(WindowManager& windowManager) :
 	mCamera(0.5f * glm::half_pi<float>(),
 	        static_cast<float>(config::resolution_x) / static_cast<float>(config::resolution_y),
 	        0.01f * constant::scale_lengths, 40.0f * constant::scale_lengths),
-	inputHandler(), mWindowManager(windowManager), window(nullptr)
+	inputHandler(), mWindowManager(windowManager), window(nullptr),
+	startup_time(std::chrono::high_resolution_clock::now())
 {
+	// Sponza gets read and decoded on worker threads while the window gets
+	// created and the programs built.
+	sponza_import = std::async(std::launch::async, []() {
+		PROFILE_THREAD_NAME("Scene import");
+		return bonobo::importObjects(config::resources_path("sponza/sponza.obj"));
+	});
+
 	WindowManager::WindowDatum window_datum{ inputHandler, mCamera, config::resolution_x, config::resolution_y, 0, 0, 0, 0};
 
 	window = mWindowManager.CreateGLFWWindow("EDAN35: Assignment 2", window_datum, config::msaa_rate);
@@ -185,39 +498,20 @@ edan35::Assignment2::~Assignment2()
 void
 edan35::Assignment2::run()
 {
-	// Load the geometry of Sponza
-	auto const sponza_geometry = bonobo::loadObjects(config::resources_path("sponza/sponza.obj"));
-	if (sponza_geometry.empty()) {
-		LogError("Failed to load the Sponza model");
-		return;
-	}
-	std::vector<GeometryTextureData> sponza_geometry_texture_data;
-	sponza_geometry_texture_data.reserve(sponza_geometry.size());
-	for (auto const& geometry : sponza_geometry) {
-		auto const diffuse_texture = geometry.bindings.find("diffuse_texture");
-		auto const specular_texture = geometry.bindings.find("specular_texture");
-		auto const normals_texture = geometry.bindings.find("normals_texture");
-		auto const opacity_texture = geometry.bindings.find("opacity_texture");
-
-		GeometryTextureData data;
-		if (diffuse_texture != geometry.bindings.end())
-		{
-			data.diffuse_texture_id = diffuse_texture->second;
-		}
-		if (specular_texture != geometry.bindings.end())
-		{
-			data.specular_texture_id = specular_texture->second;
-		}
-		if (normals_texture != geometry.bindings.end())
-		{
-			data.normals_texture_id = normals_texture->second;
-		}
-		if (opacity_texture != geometry.bindings.end())
-		{
-			data.opacity_texture_id = opacity_texture->second;
-		}
-		sponza_geometry_texture_data.emplace_back(std::move(data));
-	}
+	// State changes made while rendering go through the cache, which drops
+	// the redundant ones; anything bypassing it has to invalidate it.
+	auto& state = GLStateCache::Get();
+
+	// Depth-only passes can source their vertices from the position-only
+	// VAO built by `loadObjects()`, which also holds texture coordinates
+	// for the alpha-tested meshes.
+	auto const draw_geometry = [&state](bonobo::mesh_data const& geometry, bool use_depth_vao){
+		state.BindVertexArray(use_depth_vao && geometry.depth_vao != 0u ? geometry.depth_vao : geometry.vao);
+		if (geometry.ibo != 0u)
+			glDrawElements(geometry.drawing_mode, geometry.indices_nb, GL_UNSIGNED_INT, reinterpret_cast<GLvoid const*>(0x0));
+		else
+			glDrawArrays(geometry.drawing_mode, 0, geometry.vertices_nb);
+	};
 
 	auto const cone_geometry = loadCone();
 	Node cone;
@@ -237,81 +531,273 @@ edan35::Assignment2::run()
 	// Setup OpenGL objects
 	// Look further down in this file to see the implementation of those functions.
 	//
-	Textures const textures = createTextures(framebuffer_width, framebuffer_height);
-	FBOs const fbos = createFramebufferObjects(textures);
 	Samplers const samplers = createSamplers();
-	ElapsedTimeQueries const elapsed_time_queries = createElapsedTimeQueries();
+	GPUTimerQueryPool gpu_timers;
 	UBOs const ubos = createUniformBufferObjects();
+	ShadedFragmentsCounters shaded_fragments_counters = createShadedFragmentsCounters();
+
+	// All render targets and framebuffers are owned by the render graph,
+	// whose passes are declared further down.
+	RenderGraph render_graph;
+	render_graph.SetTimerPool(&gpu_timers);
+	render_graph.SetFramebufferSize(framebuffer_width, framebuffer_height);
 
 	//
 	// Load all the shader programs used
 	//
 	ShaderProgramManager program_manager;
+	// Builds are only queued here, and carried out while the loading screen
+	// is displayed.
+	program_manager.SetBuildsDeferred(true);
 	GLuint fallback_shader = 0u;
 	program_manager.CreateAndRegisterProgram("Fallback",
 	                                         { { ShaderType::vertex, "common/fallback.vert" },
 	                                           { ShaderType::fragment, "common/fallback.frag" } },
 	                                         fallback_shader);
-	if (fallback_shader == 0u) {
-		LogError("Failed to load fallback shader");
-		return;
-	}
 
-	GLuint fill_gbuffer_shader = 0u;
-	program_manager.CreateAndRegisterProgram("Fill G-Buffer",
-	                                         { { ShaderType::vertex, "EDAN35/fill_gbuffer.vert" },
-	                                           { ShaderType::fragment, "EDAN35/fill_gbuffer.frag" } },
-	                                         fill_gbuffer_shader);
-	if (fill_gbuffer_shader == 0u) {
-		LogError("Failed to load G-buffer filling shader");
-		return;
-	}
-	GBufferShaderLocations fill_gbuffer_shader_locations;
-	fillGBufferShaderLocations(fill_gbuffer_shader, fill_gbuffer_shader_locations);
+	// Variants only sample the textures the material has, and are built
+	// when first drawn with; the one with all textures is built while
+	// loading to catch errors early.
+	auto const fill_gbuffer_variants = program_manager.CreateAndRegisterProgramVariants("Fill G-Buffer",
+	                                                                                 { { ShaderType::vertex, "EDAN35/fill_gbuffer.vert" },
+	                                                                                   { ShaderType::fragment, "EDAN35/fill_gbuffer.frag" } },
+	                                                                                 { "HAS_DIFFUSE_TEXTURE", "HAS_SPECULAR_TEXTURE", "HAS_NORMALS_TEXTURE", "HAS_OPACITY_TEXTURE" });
+	program_manager.GetProgramVariant(fill_gbuffer_variants, MaterialFeatureAll);
 
 	GLuint fill_shadowmap_shader = 0u;
 	program_manager.CreateAndRegisterProgram("Fill shadow map",
 	                                         { { ShaderType::vertex, "EDAN35/fill_shadowmap.vert" },
 	                                           { ShaderType::fragment, "EDAN35/fill_shadowmap.frag" } },
 	                                         fill_shadowmap_shader);
-	if (fill_shadowmap_shader == 0u) {
-		LogError("Failed to load shadowmap filling shader");
-		return;
+	auto const& fill_shadowmap_uniforms = program_manager.GetReflection(fill_shadowmap_shader);
+
+	GLuint fill_shadowmap_opaque_shader = 0u;
+	program_manager.CreateAndRegisterProgram("Fill shadow map (opaque)",
+	                                         { { ShaderType::vertex, "EDAN35/fill_shadowmap_opaque.vert" } },
+	                                         fill_shadowmap_opaque_shader);
+	auto const& fill_shadowmap_opaque_uniforms = program_manager.GetReflection(fill_shadowmap_opaque_shader);
+
+	GLuint depth_prepass_shader = 0u;
+	program_manager.CreateAndRegisterProgram("Depth pre-pass",
+	                                         { { ShaderType::vertex, "EDAN35/depth_prepass.vert" },
+	                                           { ShaderType::fragment, "EDAN35/fill_shadowmap.frag" } },
+	                                         depth_prepass_shader);
+	auto const& depth_prepass_uniforms = program_manager.GetReflection(depth_prepass_shader);
+
+	GLuint depth_prepass_opaque_shader = 0u;
+	program_manager.CreateAndRegisterProgram("Depth pre-pass (opaque)",
+	                                         { { ShaderType::vertex, "EDAN35/depth_prepass_opaque.vert" } },
+	                                         depth_prepass_opaque_shader);
+	auto const& depth_prepass_opaque_uniforms = program_manager.GetReflection(depth_prepass_opaque_shader);
+
+	// The visibility buffer needs compute shaders and shader storage
+	// buffers, i.e. OpenGL 4.3; the other G-buffer layouts keep working
+	// without it.
+	GLuint fill_visibility_buffer_shader = 0u;
+	GLuint resolve_visibility_buffer_shader = 0u;
+	if (GLAD_GL_VERSION_4_3) {
+		program_manager.CreateAndRegisterProgram("Fill visibility buffer",
+		                                         { { ShaderType::vertex, "EDAN35/depth_prepass.vert" },
+		                                           { ShaderType::fragment, "EDAN35/fill_visibility_buffer.frag" } },
+		                                         fill_visibility_buffer_shader);
+		program_manager.CreateAndRegisterProgram("Resolve visibility buffer",
+		                                         { { ShaderType::compute, "EDAN35/resolve_visibility_buffer.comp" } },
+		                                         resolve_visibility_buffer_shader);
 	}
-	FillShadowmapShaderLocations fill_shadowmap_shader_locations;
-	fillShadowmapShaderLocations(fill_shadowmap_shader, fill_shadowmap_shader_locations);
+	auto const& fill_visibility_buffer_uniforms = program_manager.GetReflection(fill_visibility_buffer_shader);
+	auto const& resolve_visibility_buffer_uniforms = program_manager.GetReflection(resolve_visibility_buffer_shader);
+	auto const meshes_binding = ShaderReflection::GetBlockBinding(GL_SHADER_STORAGE_BLOCK, "Meshes");
+	auto const indices_binding = ShaderReflection::GetBlockBinding(GL_SHADER_STORAGE_BLOCK, "Indices");
+	auto const attributes_binding = ShaderReflection::GetBlockBinding(GL_SHADER_STORAGE_BLOCK, "Attributes");
+
+	// Only packed the first time the visibility buffer gets used.
+	VisibilityBufferScene visibility_buffer_scene;
 
 	GLuint accumulate_lights_shader = 0u;
 	program_manager.CreateAndRegisterProgram("Accumulate light",
 	                                         { { ShaderType::vertex, "EDAN35/accumulate_lights.vert" },
 	                                           { ShaderType::fragment, "EDAN35/accumulate_lights.frag" } },
 	                                         accumulate_lights_shader);
-	if (accumulate_lights_shader == 0u) {
-		LogError("Failed to load lights accumulating shader");
-		return;
-	}
-	AccumulateLightsShaderLocations accumulate_light_shader_locations;
-	fillAccumulateLightsShaderLocations(accumulate_lights_shader, accumulate_light_shader_locations);
+	auto const& accumulate_lights_uniforms = program_manager.GetReflection(accumulate_lights_shader);
+
+	GLuint shadow_moments_shader = 0u;
+	program_manager.CreateAndRegisterProgram("Shadow moments",
+	                                         { { ShaderType::vertex, "EDAN35/resolve_deferred.vert" },
+	                                           { ShaderType::fragment, "EDAN35/shadow_moments.frag" } },
+	                                         shadow_moments_shader);
+
+	GLuint shadow_blur_shader = 0u;
+	program_manager.CreateAndRegisterProgram("Shadow moments blur",
+	                                         { { ShaderType::vertex, "EDAN35/resolve_deferred.vert" },
+	                                           { ShaderType::fragment, "EDAN35/shadow_blur.frag" } },
+	                                         shadow_blur_shader);
 
 	GLuint resolve_deferred_shader = 0u;
 	program_manager.CreateAndRegisterProgram("Resolve deferred",
 	                                         { { ShaderType::vertex, "EDAN35/resolve_deferred.vert" },
 	                                           { ShaderType::fragment, "EDAN35/resolve_deferred.frag" } },
 	                                         resolve_deferred_shader);
-	if (resolve_deferred_shader == 0u) {
-		LogError("Failed to load deferred resolution shader");
-		return;
-	}
+
+	GLuint downsample_gbuffer_shader = 0u;
+	program_manager.CreateAndRegisterProgram("Downsample G-buffer",
+	                                         { { ShaderType::vertex, "EDAN35/resolve_deferred.vert" },
+	                                           { ShaderType::fragment, "EDAN35/downsample_gbuffer.frag" } },
+	                                         downsample_gbuffer_shader);
+
+	GLuint temporal_lights_shader = 0u;
+	program_manager.CreateAndRegisterProgram("Temporal light accumulation",
+	                                         { { ShaderType::vertex, "EDAN35/resolve_deferred.vert" },
+	                                           { ShaderType::fragment, "EDAN35/temporal_lights.frag" } },
+	                                         temporal_lights_shader);
+	auto const& temporal_lights_uniforms = program_manager.GetReflection(temporal_lights_shader);
 
 	GLuint render_light_cones_shader = 0u;
 	program_manager.CreateAndRegisterProgram("Render light cones",
 	                                         { { ShaderType::vertex, "EDAN35/render_light_cones.vert" },
 	                                           { ShaderType::fragment, "EDAN35/render_light_cones.frag" } },
 	                                         render_light_cones_shader);
-	if (render_light_cones_shader == 0u) {
-		LogError("Failed to load light cones rendering shader");
+
+	//
+	// Display a loading screen until Sponza got read and uploaded, and all
+	// programs got built
+	//
+	auto const startup_steps_nb = program_manager.GetPendingBuildsCount() + 1u;
+	std::vector<bonobo::mesh_data> uploaded_sponza_geometry;
+	{
+		PROFILE_ZONE("Loading screen");
+		bool is_sponza_uploaded = false;
+		while (!is_sponza_uploaded || program_manager.GetPendingBuildsCount() != 0u) {
+			glfwPollEvents();
+			if (glfwWindowShouldClose(window))
+				return;
+
+			program_manager.Update();
+
+			// The upload happens as soon as the data is ready, while the
+			// programs might still be building.
+			if (!is_sponza_uploaded && sponza_import.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+				auto const sponza_scene = sponza_import.get();
+				if (sponza_scene != nullptr)
+					uploaded_sponza_geometry = bonobo::uploadObjects(*sponza_scene);
+				is_sponza_uploaded = true;
+			}
+
+			// Headless runs only get a fixed number of presented frames,
+			// which are meant for the scene rather than the loading screen.
+			if (mWindowManager.IsHeadless())
+				continue;
+
+			auto const remaining_steps_nb = program_manager.GetPendingBuildsCount() + (is_sponza_uploaded ? 0u : 1u);
+			auto const progress = static_cast<float>(startup_steps_nb - remaining_steps_nb) / static_cast<float>(startup_steps_nb);
+
+			glfwGetFramebufferSize(window, &framebuffer_width, &framebuffer_height);
+			glBindFramebuffer(GL_FRAMEBUFFER, 0u);
+			glViewport(0, 0, framebuffer_width, framebuffer_height);
+			glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT);
+
+			mWindowManager.NewImGuiFrame();
+			auto const& io = ImGui::GetIO();
+			ImGui::SetNextWindowPos(ImVec2(0.5f * io.DisplaySize.x, 0.5f * io.DisplaySize.y), ImGuiCond_Always, ImVec2(0.5f, 0.5f));
+			ImGui::Begin("Loading", nullptr, ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoSavedSettings);
+			ImGui::Text("%s", is_sponza_uploaded ? "Building shader programs..." : "Loading Sponza and building shader programs...");
+			ImGui::ProgressBar(progress, ImVec2(320.0f, 0.0f));
+			ImGui::End();
+			mWindowManager.RenderImGuiFrame(true);
+
+			mWindowManager.SwapBuffers(window);
+		}
+	}
+	program_manager.SetBuildsDeferred(false);
+	// The loading screen bypassed the state cache.
+	state.Invalidate();
+	LogInfo("Sponza and %zu programs loaded in %.3f s.", startup_steps_nb - 1u,
+	        std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - startup_time).count());
+
+	for (auto const& program : std::initializer_list<std::pair<GLuint const*, char const*>>{
+		{ &fallback_shader,              "fallback shader" },
+		{ &fill_shadowmap_shader,        "shadowmap filling shader" },
+		{ &fill_shadowmap_opaque_shader, "opaque shadowmap filling shader" },
+		{ &depth_prepass_shader,         "depth pre-pass shader" },
+		{ &depth_prepass_opaque_shader,  "opaque depth pre-pass shader" },
+		{ &accumulate_lights_shader,     "lights accumulating shader" },
+		{ &shadow_moments_shader,        "shadow moments shader" },
+		{ &shadow_blur_shader,           "shadow moments blurring shader" },
+		{ &resolve_deferred_shader,      "deferred resolution shader" },
+		{ &downsample_gbuffer_shader,    "G-buffer downsampling shader" },
+		{ &temporal_lights_shader,       "temporal light accumulation shader" },
+		{ &render_light_cones_shader,    "light cones rendering shader" },
+	}) {
+		if (*program.first == 0u) {
+			LogError("Failed to load %s", program.second);
+			return;
+		}
+	}
+	if (program_manager.GetProgramVariant(fill_gbuffer_variants, MaterialFeatureAll) == 0u) {
+		LogError("Failed to load G-buffer filling shader");
+		return;
+	}
+	auto const is_visibility_buffer_supported = fill_visibility_buffer_shader != 0u && resolve_visibility_buffer_shader != 0u;
+	if (GLAD_GL_VERSION_4_3 && !is_visibility_buffer_supported)
+		LogWarning("Failed to load the visibility buffer shaders: that G-buffer layout is disabled.");
+
+	auto const sponza_geometry = std::move(uploaded_sponza_geometry);
+	if (sponza_geometry.empty()) {
+		LogError("Failed to load the Sponza model");
 		return;
 	}
+	std::vector<GeometryTextureData> sponza_geometry_texture_data;
+	sponza_geometry_texture_data.reserve(sponza_geometry.size());
+	for (auto const& geometry : sponza_geometry) {
+		auto const diffuse_texture = geometry.bindings.find("diffuse_texture");
+		auto const specular_texture = geometry.bindings.find("specular_texture");
+		auto const normals_texture = geometry.bindings.find("normals_texture");
+		auto const opacity_texture = geometry.bindings.find("opacity_texture");
+
+		GeometryTextureData data;
+		if (diffuse_texture != geometry.bindings.end())
+		{
+			data.diffuse_texture_id = diffuse_texture->second;
+		}
+		if (specular_texture != geometry.bindings.end())
+		{
+			data.specular_texture_id = specular_texture->second;
+		}
+		if (normals_texture != geometry.bindings.end())
+		{
+			data.normals_texture_id = normals_texture->second;
+		}
+		if (opacity_texture != geometry.bindings.end())
+		{
+			data.opacity_texture_id = opacity_texture->second;
+		}
+		sponza_geometry_texture_data.emplace_back(std::move(data));
+	}
+
+	// Meshes with an opacity texture discard fragments, which disables early
+	// depth testing for their whole draw: the depth pre-pass draws them after
+	// all opaque meshes.
+	std::vector<std::size_t> opaque_geometry_indices;
+	std::vector<std::size_t> alpha_tested_geometry_indices;
+	for (std::size_t i = 0; i < sponza_geometry.size(); ++i) {
+		if (sponza_geometry_texture_data[i].opacity_texture_id != 0u)
+			alpha_tested_geometry_indices.push_back(i);
+		else
+			opaque_geometry_indices.push_back(i);
+	}
+
+	// The G-buffer is filled with meshes sorted by material features, to
+	// switch between program variants as little as possible.
+	std::vector<std::uint32_t> sponza_geometry_features;
+	sponza_geometry_features.reserve(sponza_geometry.size());
+	for (auto const& texture_data : sponza_geometry_texture_data)
+		sponza_geometry_features.push_back(getMaterialFeatures(texture_data));
+	std::vector<std::size_t> gbuffer_geometry_indices(sponza_geometry.size());
+	std::iota(gbuffer_geometry_indices.begin(), gbuffer_geometry_indices.end(), std::size_t(0));
+	std::stable_sort(gbuffer_geometry_indices.begin(), gbuffer_geometry_indices.end(),
+	                 [&sponza_geometry_features](std::size_t lhs, std::size_t rhs) {
+	                     return sponza_geometry_features[lhs] < sponza_geometry_features[rhs];
+	                 });
 
 	auto const set_uniforms = [](GLuint /*program*/){};
 
@@ -320,11 +806,10 @@ edan35::Assignment2::run()
 
 	const GLuint debug_texture_id = bonobo::getDebugTextureID();
 
-	auto const bind_texture_with_sampler = [](GLenum target, unsigned int slot, GLuint program, std::string const& name, GLuint texture, GLuint sampler){
-		glActiveTexture(GL_TEXTURE0 + slot);
-		glBindTexture(target, texture);
+	auto const bind_texture_with_sampler = [&state](GLenum target, unsigned int slot, GLuint program, std::string const& name, GLuint texture, GLuint sampler){
+		state.BindTexture(slot, target, texture);
 		glUniform1i(glGetUniformLocation(program, name.c_str()), static_cast<GLint>(slot));
-		glBindSampler(slot, sampler);
+		state.BindSampler(slot, sampler);
 	};
 
 
@@ -362,438 +847,1048 @@ edan35::Assignment2::run()
 	glEnable(GL_CULL_FACE);
 
 
-	glBindFramebuffer(GL_READ_FRAMEBUFFER, fbos[toU(FBO::Resolve)]);
-
-
 	auto seconds_nb = 0.0f;
-	std::array<GLuint64, toU(ElapsedTimeQuery::Count)> pass_elapsed_times;
 	auto lastTime = std::chrono::high_resolution_clock::now();
+	bool is_first_frame = true;
 	bool show_textures = true;
 	bool show_cone_wireframe = false;
 
 	bool show_logs = true;
 	bool show_gui = true;
 	bool shader_reload_failed = false;
-	bool copy_elapsed_times = true;
-	bool first_frame = true;
 	bool show_basis = false;
+	auto gbuffer_layout = GBufferLayout::Reference;
+	DynamicResolution dynamic_resolution;
+	auto light_volume_culling = LightVolumeCulling::StencilAndScissor;
+	bool use_depth_prepass = true;
+	bool use_depth_only_vertex_streams = true;
+	GBufferBenchmark gbuffer_benchmark;
+	// Restored once the benchmark is over.
+	auto layout_before_benchmark = gbuffer_layout;
+	auto lights_nb_before_benchmark = lights_nb;
+	auto dynamic_resolution_before_benchmark = dynamic_resolution;
+	std::string const flythrough_path_filename = "EDAN35_assignment2_flythrough.txt";
+	std::string const flythrough_report_filename = "EDAN35_assignment2_flythrough.json";
+	FlythroughBenchmark flythrough;
+	// A path given through LUGGCGL_FLYTHROUGH gets benchmarked right away,
+	// and the assignment exits once done; meant for batch runs.
+	char const* const automated_flythrough_path = std::getenv("LUGGCGL_FLYTHROUGH");
+	bool const is_flythrough_automated = automated_flythrough_path != nullptr && *automated_flythrough_path != '\0';
+	if (is_flythrough_automated) {
+		if (flythrough.LoadPath(automated_flythrough_path))
+			flythrough.Start(FlythroughBenchmark::Settings(), &gpu_timers, flythrough_report_filename);
+		if (!flythrough.IsRunning())
+			glfwSetWindowShouldClose(window, true);
+	} else if (std::ifstream(flythrough_path_filename)) {
+		flythrough.LoadPath(flythrough_path_filename);
+	} else {
+		flythrough = createDefaultFlythrough();
+	}
+	std::array<double, 2> shadow_maps_mean_gpu_time = { 0.0, 0.0 }; // In ms, with the full and the depth-only vertex streams
+	TemporalLighting temporal_lighting;
+	TemporalLightingHistory temporal_lighting_history; // Only allocated once temporal lighting gets enabled
+	int lights_interleave = 1; // Frames over which each pixel goes through all lights; updated every frame
+	int light_upsampling_preset = 0;
+	LightUpsamplingSettings light_upsampling = light_upsampling_presets[light_upsampling_preset];
+	std::array<double, toU(LightingResolution::Count)> lighting_mean_gpu_time = { 0.0, 0.0, 0.0 }; // In ms, per lighting resolution
+	int shadow_quality_preset = 1;
+	ShadowSettings shadow_settings = shadow_quality_presets[shadow_quality_preset];
 	float basis_thickness_scale = 40.0f;
 	float basis_length_scale = 400.0f;
 
-	while (!glfwWindowShouldClose(window)) {
-		auto const nowTime = std::chrono::high_resolution_clock::now();
-		auto const deltaTimeUs = std::chrono::duration_cast<std::chrono::microseconds>(nowTime - lastTime);
-		lastTime = nowTime;
-		if (!are_lights_paused)
-			seconds_nb += std::chrono::duration<decltype(seconds_nb)>(deltaTimeUs).count();
-
-		auto& io = ImGui::GetIO();
-		inputHandler.SetUICapture(io.WantCaptureMouse, io.WantCaptureKeyboard);
-
-		glfwPollEvents();
-		inputHandler.Advance();
-		mCamera.Update(deltaTimeUs, inputHandler);
+	// The render targets keep their full size, and the G-buffer and light
+	// accumulation passes only render to their lower-left part; updated
+	// every frame.
+	int render_width = framebuffer_width;
+	int render_height = framebuffer_height;
+	auto render_scale = glm::vec2(1.0f);
 
-		camera_view_proj_transforms.view_projection = mCamera.GetWorldToClipMatrix();
-		camera_view_proj_transforms.view_projection_inverse = mCamera.GetClipToWorldMatrix();
+	// Same for the light targets, which may be smaller than the G-buffer.
+	int lighting_width = framebuffer_width;
+	int lighting_height = framebuffer_height;
+	auto lighting_render_scale = glm::vec2(1.0f);
 
-		auto const view_projection = camera_view_proj_transforms.view_projection;
 
-		if (inputHandler.GetKeycodeState(GLFW_KEY_R) & JUST_PRESSED) {
-			shader_reload_failed = !program_manager.ReloadAllPrograms();
-			if (shader_reload_failed)
-			{
-				tinyfd_notifyPopup("Shader Program Reload Error",
-				                   "An error occurred while reloading shader programs; see the logs for details.\n"
-				                   "Rendering is suspended until the issue is solved. Once fixed, just reload the shaders again.",
-				                   "error");
+	//
+	// Declare the passes of the render graph, alongside the textures they
+	// read from and render to. Textures of identical format and size whose
+	// lifetimes do not overlap, like the shadow maps of the different lights,
+	// end up sharing the same OpenGL texture.
+	//
+	// The passes only capture handles by value, as they outlive this lambda.
+	//
+	auto const select_gbuffer_layout = [&](GBufferLayout layout){
+		if (layout == GBufferLayout::Visibility) {
+			if (!is_visibility_buffer_supported) {
+				LogWarning("The visibility buffer needs OpenGL 4.3.");
+				return;
 			}
-			else
-			{
-				fillGBufferShaderLocations(fill_gbuffer_shader, fill_gbuffer_shader_locations);
-				fillShadowmapShaderLocations(fill_shadowmap_shader, fill_shadowmap_shader_locations);
-				fillAccumulateLightsShaderLocations(accumulate_lights_shader, accumulate_light_shader_locations);
+			if (visibility_buffer_scene.meshes == 0u) {
+				visibility_buffer_scene = createVisibilityBufferScene(sponza_geometry, sponza_geometry_texture_data);
+				state.Invalidate();
 			}
+			if (visibility_buffer_scene.meshes == 0u)
+				return;
 		}
-		if (inputHandler.GetKeycodeState(GLFW_KEY_F3) & JUST_RELEASED)
-			show_logs = !show_logs;
-		if (inputHandler.GetKeycodeState(GLFW_KEY_F2) & JUST_RELEASED)
-			show_gui = !show_gui;
+		gbuffer_layout = layout;
+	};
 
-		mWindowManager.NewImGuiFrame();
+	RenderGraphConfiguration render_graph_configuration;
+	std::vector<RenderGraph::PassHandle> shadow_map_passes;
+	std::vector<RenderGraph::PassHandle> lighting_passes; // Whose cost depends on the lighting resolution
+	auto const build_render_graph = [&](RenderGraphConfiguration const& configuration){
+		using LoadOp = RenderGraph::LoadOp;
+
+		render_graph.Reset();
+		shadow_map_passes.clear();
+		lighting_passes.clear();
+		// The content of the light targets may change meaning.
+		temporal_lighting_history.is_valid = false;
+
+		auto const use_compact_gbuffer = configuration.gbuffer_layout == GBufferLayout::Compact;
+		auto const use_visibility_buffer = configuration.gbuffer_layout == GBufferLayout::Visibility;
+		auto const use_shadow_moments = configuration.shadow_filtering == ShadowFiltering::VSM
+		                             || configuration.shadow_filtering == ShadowFiltering::EVSM;
+
+		auto const screen_texture = [](GLint internal_format, GLenum format, GLenum type){
+			RenderGraph::TextureDescription description;
+			description.internal_format = internal_format;
+			description.format = format;
+			description.type = type;
+			return description;
+		};
+		auto const shadow_texture = [](GLint internal_format, GLenum format, GLenum type, bool has_mipmaps){
+			RenderGraph::TextureDescription description;
+			description.internal_format = internal_format;
+			description.format = format;
+			description.type = type;
+			description.is_framebuffer_relative = false;
+			description.width = constant::shadowmap_res_x;
+			description.height = constant::shadowmap_res_y;
+			description.has_mipmaps = has_mipmaps;
+			return description;
+		};
 
-		if (!first_frame && show_gui && copy_elapsed_times) {
-			// Copy all timings back from the GPU to the CPU.
-			for (GLuint i = 0; i < pass_elapsed_times.size(); ++i) {
-				glGetQueryObjectui64v(elapsed_time_queries[i], GL_QUERY_RESULT, pass_elapsed_times.data() + i);
-			}
+		// The stencil is used for masking the light volumes.
+		auto const depth_buffer = render_graph.CreateTexture("Depth buffer", screen_texture(GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8));
+		// Images written from compute shaders need a sized format.
+		auto const gbuffer_format = use_visibility_buffer ? GL_RGBA8 : GL_RGBA;
+		auto const gbuffer_diffuse = render_graph.CreateTexture("GBuffer diffuse", screen_texture(gbuffer_format, GL_RGBA, GL_UNSIGNED_BYTE));
+		auto gbuffer_specular = RenderGraph::invalid_handle;
+		auto gbuffer_normal = RenderGraph::invalid_handle;
+		auto light_diffuse = RenderGraph::invalid_handle;
+		auto light_specular = RenderGraph::invalid_handle;
+		if (use_compact_gbuffer) {
+			// The specular intensity lives in the alpha channel of the diffuse
+			// target, and lights are accumulated with the material already
+			// applied: there is neither a specular G-buffer target nor a
+			// specular light contribution.
+			gbuffer_normal = render_graph.CreateTexture("GBuffer octahedral normals", screen_texture(GL_RG16, GL_RG, GL_UNSIGNED_SHORT));
+			light_diffuse = render_graph.CreateTexture("Light contribution", screen_texture(GL_R11F_G11F_B10F, GL_RGB, GL_FLOAT));
+		} else {
+			gbuffer_specular = render_graph.CreateTexture("GBuffer specular", screen_texture(gbuffer_format, GL_RGBA, GL_UNSIGNED_BYTE));
+			gbuffer_normal = render_graph.CreateTexture("GBuffer normals", screen_texture(gbuffer_format, GL_RGBA, GL_UNSIGNED_BYTE));
+			// Interleaved lights get scaled up, which would saturate 8-bit
+			// targets.
+			auto const light_format = configuration.use_temporal_lighting ? GL_RGBA16F : GL_RGBA;
+			auto const light_type = configuration.use_temporal_lighting ? GL_FLOAT : GL_UNSIGNED_BYTE;
+			auto light_description = screen_texture(light_format, GL_RGBA, light_type);
+			light_description.scale = getLightingScale(configuration.lighting_resolution);
+			light_diffuse = render_graph.CreateTexture("Light diffuse contribution", light_description);
+			light_specular = render_graph.CreateTexture("Light specular contribution", light_description);
 		}
+		auto const result = render_graph.CreateTexture("Final result", screen_texture(GL_RGBA, GL_RGBA, GL_UNSIGNED_BYTE));
+		auto visibility_buffer = RenderGraph::invalid_handle;
+		if (use_visibility_buffer)
+			visibility_buffer = render_graph.CreateTexture("Visibility buffer", screen_texture(GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT));
 
 
-		for (size_t i = 0; i < static_cast<size_t>(lights_nb); ++i) {
-			auto& lightTransform = lightTransforms[i];
-			lightTransform.SetRotate(glm::two_pi<float>() * static_cast<float>(i) / static_cast<float>(constant::lights_nb) + 0.1f * seconds_nb, glm::vec3(0.0f, 1.0f, 0.0f));
+		//
+		// Pass 0: Optionally lay down the depth first, so that the g-buffer
+		// pass only shades visible fragments
+		//
+		if (configuration.use_depth_prepass) {
+			auto const depth_prepass = render_graph.AddPass("Depth pre-pass", [&](RenderGraph const& /*graph*/){
+				if (shader_reload_failed)
+					return;
+
+				glViewport(0, 0, render_width, render_height);
+
+				// Draw opaque meshes front to back, based on the distance
+				// to their bounding box, for early depth testing to reject
+				// as many fragments as possible.
+				auto const camera_position = mCamera.mWorld.GetTranslation();
+				auto const squared_distance_to = [&camera_position, &sponza_geometry](std::size_t geometry_index){
+					auto const& geometry = sponza_geometry[geometry_index];
+					auto const offset = glm::clamp(camera_position, geometry.bounds_min, geometry.bounds_max) - camera_position;
+					return glm::dot(offset, offset);
+				};
+				std::sort(opaque_geometry_indices.begin(), opaque_geometry_indices.end(),
+				          [&squared_distance_to](std::size_t lhs, std::size_t rhs){
+					return squared_distance_to(lhs) < squared_distance_to(rhs);
+				});
 
-			auto const light_view_matrix = lightOffsetTransform.GetMatrixInverse() * lightTransform.GetMatrixInverse();
-			auto const light_world_matrix = glm::inverse(light_view_matrix) * coneScaleTransform.GetMatrix();
-			auto const light_world_to_clip_matrix = lightProjection * light_view_matrix;
+				auto const vertex_model_to_world = glm::mat4(1.0f);
 
-			light_view_proj_transforms[i].view_projection = light_world_to_clip_matrix;
-			light_view_proj_transforms[i].view_projection_inverse = glm::inverse(light_world_to_clip_matrix);
+				// Opaque meshes need neither texture coordinates nor a
+				// fragment shader.
+				if (use_depth_only_vertex_streams) {
+					state.UseProgram(depth_prepass_opaque_shader);
+					depth_prepass_opaque_uniforms.Set(uniform::vertex_model_to_world, vertex_model_to_world);
+					for (auto const i : opaque_geometry_indices)
+						draw_geometry(sponza_geometry[i], true);
+				}
+
+				state.UseProgram(depth_prepass_shader);
+				depth_prepass_uniforms.Set(uniform::vertex_model_to_world, vertex_model_to_world);
+				for (auto const& geometry_indices : { std::cref(opaque_geometry_indices), std::cref(alpha_tested_geometry_indices) }) {
+					for (auto const i : geometry_indices.get()) {
+						auto const& geometry = sponza_geometry[i];
+						auto const& texture_data = sponza_geometry_texture_data[i];
+						if (use_depth_only_vertex_streams && texture_data.opacity_texture_id == 0u)
+							continue;
+
+						depth_prepass_uniforms.Set(uniform::has_opacity_texture, texture_data.opacity_texture_id != 0u);
+						depth_prepass_uniforms.BindTexture(uniform::opacity_texture, GL_TEXTURE_2D,
+						                                   texture_data.opacity_texture_id != 0u ? texture_data.opacity_texture_id : debug_texture_id,
+						                                   texture_data.opacity_texture_id != 0u ? samplers[toU(Sampler::Mipmaps)] : samplers[toU(Sampler::Nearest)]);
+
+						draw_geometry(geometry, use_depth_only_vertex_streams);
+					}
+				}
+				depth_prepass_uniforms.UnbindSamplers();
+			});
+			render_graph.SetDepthAttachment(depth_prepass, depth_buffer, true, LoadOp::Clear);
 		}
 
 
 		//
-		// Update per-frame changing UBOs.
+		// Pass 1: Render scene into the g-buffer, or into the visibility
+		// buffer which then gets expanded into the g-buffer
 		//
-		glBindBuffer(GL_UNIFORM_BUFFER, ubos[toU(UBO::CameraViewProjTransforms)]);
-		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(camera_view_proj_transforms), &camera_view_proj_transforms);
-		glBindBuffer(GL_UNIFORM_BUFFER, ubos[toU(UBO::LightViewProjTransforms)]);
-		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(light_view_proj_transforms), light_view_proj_transforms.data());
-		glBindBuffer(GL_UNIFORM_BUFFER, 0u);
-
-
-		if (!shader_reload_failed) {
-			//
-			// Pass 1: Render scene into the g-buffer
-			//
-			utils::opengl::debug::beginDebugGroup("Fill G-buffer");
-			glBeginQuery(GL_TIME_ELAPSED, elapsed_time_queries[toU(ElapsedTimeQuery::GbufferGeneration)]);
+		if (use_visibility_buffer) {
+			auto const fill_visibility_buffer_pass = render_graph.AddPass("Fill visibility buffer", [&, use_depth_prepass = configuration.use_depth_prepass](RenderGraph const& /*graph*/){
+				if (shader_reload_failed)
+					return;
 
-			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[toU(FBO::GBuffer)]);
-			glViewport(0, 0, framebuffer_width, framebuffer_height);
-			glClear(GL_DEPTH_BUFFER_BIT);
-			// XXX: Is any other clearing needed?
-
-			glUseProgram(fill_gbuffer_shader);
-			glUniform1i(fill_gbuffer_shader_locations.diffuse_texture, 0);
-			glUniform1i(fill_gbuffer_shader_locations.specular_texture, 1);
-			glUniform1i(fill_gbuffer_shader_locations.normals_texture, 2);
-			glUniform1i(fill_gbuffer_shader_locations.opacity_texture, 3);
-			for (std::size_t i = 0; i < sponza_geometry.size(); ++i)
-			{
-				auto const& geometry = sponza_geometry[i];
-				auto const& texture_data = sponza_geometry_texture_data[i];
+				glViewport(0, 0, render_width, render_height);
 
-				utils::opengl::debug::beginDebugGroup(geometry.name);
+				if (use_depth_prepass) {
+					state.DepthFunc(GL_EQUAL);
+					state.DepthMask(GL_FALSE);
+				}
 
+				// Only positions are needed, and texture coordinates for
+				// alpha testing.
+				state.UseProgram(fill_visibility_buffer_shader);
 				auto const vertex_model_to_world = glm::mat4(1.0f);
-				auto const normal_model_to_world = glm::mat4(1.0f);
+				fill_visibility_buffer_uniforms.Set(uniform::vertex_model_to_world, vertex_model_to_world);
+				for (std::size_t i = 0; i < sponza_geometry.size(); ++i) {
+					if (!visibility_buffer_scene.is_packed[i])
+						continue;
+					auto const& texture_data = sponza_geometry_texture_data[i];
 
-				glUniformMatrix4fv(fill_gbuffer_shader_locations.vertex_model_to_world, 1, GL_FALSE, glm::value_ptr(vertex_model_to_world));
-				glUniformMatrix4fv(fill_gbuffer_shader_locations.normal_model_to_world, 1, GL_FALSE, glm::value_ptr(normal_model_to_world));
+					fill_visibility_buffer_uniforms.Set(uniform::first_triangle, visibility_buffer_scene.first_triangles[i]);
+					fill_visibility_buffer_uniforms.Set(uniform::has_opacity_texture, texture_data.opacity_texture_id != 0u);
+					fill_visibility_buffer_uniforms.BindTexture(uniform::opacity_texture, GL_TEXTURE_2D,
+					                                            texture_data.opacity_texture_id != 0u ? texture_data.opacity_texture_id : debug_texture_id,
+					                                            texture_data.opacity_texture_id != 0u ? samplers[toU(Sampler::Mipmaps)] : samplers[toU(Sampler::Nearest)]);
+
+					draw_geometry(sponza_geometry[i], true);
+				}
+				fill_visibility_buffer_uniforms.UnbindSamplers();
+
+				state.DepthMask(GL_TRUE);
+				state.DepthFunc(GL_LESS);
+			});
+			render_graph.WriteColour(fill_visibility_buffer_pass, visibility_buffer, 0u, LoadOp::Clear);
+			if (configuration.use_depth_prepass)
+				render_graph.SetDepthAttachment(fill_visibility_buffer_pass, depth_buffer, false);
+			else
+				render_graph.SetDepthAttachment(fill_visibility_buffer_pass, depth_buffer, true, LoadOp::Clear);
+
+			auto const resolve_visibility_buffer_pass = render_graph.AddPass("Resolve visibility buffer",
+			                                                                 [&, visibility_buffer, gbuffer_diffuse, gbuffer_specular, gbuffer_normal](RenderGraph const& graph){
+				if (shader_reload_failed)
+					return;
+
+				state.UseProgram(resolve_visibility_buffer_shader);
+				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, meshes_binding, visibility_buffer_scene.meshes);
+				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, indices_binding, visibility_buffer_scene.indices);
+				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, attributes_binding, visibility_buffer_scene.attributes);
+				resolve_visibility_buffer_uniforms.Set(uniform::vertices_nb, visibility_buffer_scene.vertices_nb);
+				resolve_visibility_buffer_uniforms.Set(uniform::render_size, glm::ivec2(render_width, render_height));
+
+				resolve_visibility_buffer_uniforms.BindTexture(uniform::visibility_buffer, GL_TEXTURE_2D, graph.GetTexture(visibility_buffer), samplers[toU(Sampler::Nearest)]);
+				resolve_visibility_buffer_uniforms.BindTexture(uniform::material_textures, GL_TEXTURE_2D_ARRAY, visibility_buffer_scene.material_textures, samplers[toU(Sampler::Mipmaps)]);
+
+				glBindImageTexture(0u, graph.GetTexture(gbuffer_diffuse), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+				glBindImageTexture(1u, graph.GetTexture(gbuffer_specular), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+				glBindImageTexture(2u, graph.GetTexture(gbuffer_normal), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+
+				glDispatchCompute(static_cast<GLuint>(render_width + 7) / 8u, static_cast<GLuint>(render_height + 7) / 8u, 1u);
+
+				// The G-buffer is then sampled by the light and resolve
+				// passes.
+				glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+				for (GLuint unit = 0u; unit < 3u; ++unit)
+					glBindImageTexture(unit, 0u, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+				for (auto const binding : { meshes_binding, indices_binding, attributes_binding })
+					glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, 0u);
+				resolve_visibility_buffer_uniforms.UnbindSamplers();
+			});
+			render_graph.ReadTexture(resolve_visibility_buffer_pass, visibility_buffer);
+			render_graph.WriteImage(resolve_visibility_buffer_pass, gbuffer_diffuse);
+			render_graph.WriteImage(resolve_visibility_buffer_pass, gbuffer_specular);
+			render_graph.WriteImage(resolve_visibility_buffer_pass, gbuffer_normal);
+		} else {
+			auto const fill_gbuffer_pass = render_graph.AddPass("Fill G-buffer", [&, use_compact_gbuffer, use_depth_prepass = configuration.use_depth_prepass](RenderGraph const& /*graph*/){
+				if (shader_reload_failed)
+					return;
+
+				glViewport(0, 0, render_width, render_height);
+
+				if (use_depth_prepass) {
+					// Depth is already known: only visible fragments pass.
+					state.DepthFunc(GL_EQUAL);
+					state.DepthMask(GL_FALSE);
+				}
+				auto const counter_frame = shaded_fragments_counters.current_frame;
+				glBeginQuery(GL_SAMPLES_PASSED, shaded_fragments_counters.gbuffer_queries[counter_frame]);
 
-				auto const default_sampler = samplers[toU(Sampler::Nearest)];
 				auto const mipmap_sampler = samplers[toU(Sampler::Mipmaps)];
+				GLuint current_program = 0u;
+				for (auto const i : gbuffer_geometry_indices)
+				{
+					auto const& geometry = sponza_geometry[i];
+					auto const& texture_data = sponza_geometry_texture_data[i];
+					auto const features = sponza_geometry_features[i];
+
+					auto const program = program_manager.GetProgramVariant(fill_gbuffer_variants, features);
+					if (program == 0u)
+						continue;
+					auto const& uniforms = program_manager.GetProgramVariantReflection(fill_gbuffer_variants, features);
+					if (program != current_program) {
+						auto const vertex_model_to_world = glm::mat4(1.0f);
+						auto const normal_model_to_world = glm::mat4(1.0f);
+
+						state.UseProgram(program);
+						uniforms.Set(uniform::use_compact_gbuffer, use_compact_gbuffer);
+						uniforms.Set(uniform::vertex_model_to_world, vertex_model_to_world);
+						uniforms.Set(uniform::normal_model_to_world, normal_model_to_world);
+						current_program = program;
+					}
 
-				glUniform1i(fill_gbuffer_shader_locations.has_diffuse_texture, texture_data.diffuse_texture_id != 0u ? 1 : 0);
-				glBindSampler(0u, texture_data.diffuse_texture_id != 0u ? mipmap_sampler : default_sampler);
-				glActiveTexture(GL_TEXTURE0);
-				glBindTexture(GL_TEXTURE_2D, texture_data.diffuse_texture_id != 0u ? texture_data.diffuse_texture_id : debug_texture_id);
-
-				glUniform1i(fill_gbuffer_shader_locations.has_specular_texture, texture_data.specular_texture_id != 0u ? 1 : 0);
-				glBindSampler(1u, texture_data.specular_texture_id != 0u ? mipmap_sampler : default_sampler);
-				glActiveTexture(GL_TEXTURE1);
-				glBindTexture(GL_TEXTURE_2D, texture_data.specular_texture_id != 0u ? texture_data.specular_texture_id : debug_texture_id);
-
-				glUniform1i(fill_gbuffer_shader_locations.has_normals_texture, texture_data.normals_texture_id != 0u ? 1 : 0);
-				glBindSampler(2u, texture_data.normals_texture_id != 0u ? mipmap_sampler : default_sampler);
-				glActiveTexture(GL_TEXTURE2);
-				glBindTexture(GL_TEXTURE_2D, texture_data.normals_texture_id != 0u ? texture_data.normals_texture_id : debug_texture_id);
-
-				glUniform1i(fill_gbuffer_shader_locations.has_opacity_texture, texture_data.opacity_texture_id != 0u ? 1 : 0);
-				glBindSampler(3u, texture_data.opacity_texture_id != 0u ? mipmap_sampler : default_sampler);
-				glActiveTexture(GL_TEXTURE3);
-				glBindTexture(GL_TEXTURE_2D, texture_data.opacity_texture_id != 0u ? texture_data.opacity_texture_id : debug_texture_id);
-
-				glBindVertexArray(geometry.vao);
-				if (geometry.ibo != 0u)
-					glDrawElements(geometry.drawing_mode, geometry.indices_nb, GL_UNSIGNED_INT, reinterpret_cast<GLvoid const*>(0x0));
-				else
-					glDrawArrays(geometry.drawing_mode, 0, geometry.vertices_nb);
+					utils::opengl::debug::beginDebugGroup(geometry.name);
 
+					// Variants do not declare the samplers of the textures
+					// the material lacks, which are then not bound.
+					uniforms.BindTexture(uniform::diffuse_texture, GL_TEXTURE_2D, texture_data.diffuse_texture_id, mipmap_sampler);
+					uniforms.BindTexture(uniform::specular_texture, GL_TEXTURE_2D, texture_data.specular_texture_id, mipmap_sampler);
+					uniforms.BindTexture(uniform::normals_texture, GL_TEXTURE_2D, texture_data.normals_texture_id, mipmap_sampler);
+					uniforms.BindTexture(uniform::opacity_texture, GL_TEXTURE_2D, texture_data.opacity_texture_id, mipmap_sampler);
 
-				utils::opengl::debug::endDebugGroup();
-			}
-			glBindTexture(GL_TEXTURE_2D, 0);
-			glBindVertexArray(0u);
-			glUseProgram(0u);
+					state.BindVertexArray(geometry.vao);
+					if (geometry.ibo != 0u)
+						glDrawElements(geometry.drawing_mode, geometry.indices_nb, GL_UNSIGNED_INT, reinterpret_cast<GLvoid const*>(0x0));
+					else
+						glDrawArrays(geometry.drawing_mode, 0, geometry.vertices_nb);
 
-			glEndQuery(GL_TIME_ELAPSED);
-			utils::opengl::debug::endDebugGroup();
 
+					utils::opengl::debug::endDebugGroup();
+				}
 
+				glEndQuery(GL_SAMPLES_PASSED);
+				shaded_fragments_counters.gbuffer_issued_with[counter_frame] = use_depth_prepass ? 1 : 0;
+
+				state.DepthMask(GL_TRUE);
+				state.DepthFunc(GL_LESS);
+			});
+			render_graph.WriteColour(fill_gbuffer_pass, gbuffer_diffuse, 0u, LoadOp::Clear);
+			if (!use_compact_gbuffer)
+				render_graph.WriteColour(fill_gbuffer_pass, gbuffer_specular, 1u, LoadOp::Clear);
+			render_graph.WriteColour(fill_gbuffer_pass, gbuffer_normal, 2u, LoadOp::Clear);
+			if (configuration.use_depth_prepass)
+				render_graph.SetDepthAttachment(fill_gbuffer_pass, depth_buffer, false);
+			else
+				render_graph.SetDepthAttachment(fill_gbuffer_pass, depth_buffer, true, LoadOp::Clear);
+		}
+
+
+		//
+		// Pass 1.1: Optionally build a pyramid of depths and normals from the
+		// G-buffer, down to the resolution the lights get accumulated at
+		//
+		auto lighting_depth = depth_buffer;
+		auto lighting_normal = gbuffer_normal;
+		auto lighting_min_max_depth = RenderGraph::invalid_handle;
+		for (uint32_t level = 1u; level <= static_cast<uint32_t>(toU(configuration.lighting_resolution)); ++level) {
+			auto const level_scale = 1.0f / static_cast<float>(1u << level);
+			auto const level_suffix = "1/" + std::to_string(1u << level);
+			auto const level_texture = [level_scale, &screen_texture](GLint internal_format, GLenum format, GLenum type){
+				auto description = screen_texture(internal_format, format, type);
+				description.scale = level_scale;
+				return description;
+			};
+
+			// The stencil is used for masking the light volumes, as with the
+			// full-resolution depth buffer.
+			auto const level_depth = render_graph.CreateTexture("Lighting depth " + level_suffix, level_texture(GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8));
+			auto const level_normal = render_graph.CreateTexture("Lighting normals " + level_suffix, level_texture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE));
+			auto const level_min_max_depth = render_graph.CreateTexture("Lighting depth range " + level_suffix, level_texture(GL_RG32F, GL_RG, GL_FLOAT));
+
+			auto const downsample_pass = render_graph.AddPass("Downsample G-buffer " + level_suffix,
+			                                                  [&, level, level_scale, source_depth = lighting_depth, source_normal = lighting_normal, source_min_max_depth = lighting_min_max_depth](RenderGraph const& graph){
+				if (shader_reload_failed)
+					return;
+
+				glViewport(0, 0, getScaledSize(render_width, level_scale), getScaledSize(render_height, level_scale));
+				// The representative depth gets written for every texel.
+				state.DepthFunc(GL_ALWAYS);
+
+				state.UseProgram(downsample_gbuffer_shader);
+
+				bind_texture_with_sampler(GL_TEXTURE_2D, 0, downsample_gbuffer_shader, "depth_texture", graph.GetTexture(source_depth), samplers[toU(Sampler::Nearest)]);
+				bind_texture_with_sampler(GL_TEXTURE_2D, 1, downsample_gbuffer_shader, "normal_texture", graph.GetTexture(source_normal), samplers[toU(Sampler::Nearest)]);
+				bind_texture_with_sampler(GL_TEXTURE_2D, 2, downsample_gbuffer_shader, "min_max_depth_texture", graph.GetTexture(source_min_max_depth), samplers[toU(Sampler::Nearest)]);
+				glUniform1i(glGetUniformLocation(downsample_gbuffer_shader, "is_first_level"), level == 1u ? 1 : 0);
+				glUniform2i(glGetUniformLocation(downsample_gbuffer_shader, "source_size"),
+				            getScaledSize(render_width, 2.0f * level_scale), getScaledSize(render_height, 2.0f * level_scale));
+
+				bonobo::drawFullscreen();
+
+				state.BindSampler(2, 0u);
+				state.BindSampler(1, 0u);
+				state.BindSampler(0, 0u);
+				state.DepthFunc(GL_LESS);
+			});
+			render_graph.ReadTexture(downsample_pass, lighting_depth);
+			render_graph.ReadTexture(downsample_pass, lighting_normal);
+			if (lighting_min_max_depth != RenderGraph::invalid_handle)
+				render_graph.ReadTexture(downsample_pass, lighting_min_max_depth);
+			render_graph.WriteColour(downsample_pass, level_normal, 0u, LoadOp::DontCare);
+			render_graph.WriteColour(downsample_pass, level_min_max_depth, 1u, LoadOp::DontCare);
+			render_graph.SetDepthAttachment(downsample_pass, level_depth, true, LoadOp::Clear);
+			lighting_passes.push_back(downsample_pass);
+
+			lighting_depth = level_depth;
+			lighting_normal = level_normal;
+			lighting_min_max_depth = level_min_max_depth;
+		}
+
+
+		//
+		// Pass 2: Generate shadowmaps and accumulate lights' contribution
+		//
+		auto shadow_map = RenderGraph::invalid_handle;
+		auto shadow_moments = RenderGraph::invalid_handle;
+		for (int i = 0; i < configuration.lights_nb; ++i) {
+			auto const light_suffix = std::to_string(i);
 
 			//
-			// Pass 2: Generate shadowmaps and accumulate lights' contribution
+			// Pass 2.1: Generate shadow map for light i
 			//
-			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[toU(FBO::LightAccumulation)]);
-			glViewport(0, 0, framebuffer_width, framebuffer_height);
-			glClear(GL_COLOR_BUFFER_BIT);
-			// XXX: Is any clearing needed?
-			for (size_t i = 0; i < static_cast<size_t>(lights_nb); ++i) {
-				auto const& lightTransform = lightTransforms[i];
-				auto const light_view_matrix = lightOffsetTransform.GetMatrixInverse() * lightTransform.GetMatrixInverse();
-				auto const light_world_matrix = glm::inverse(light_view_matrix) * coneScaleTransform.GetMatrix();
-				auto const light_world_to_clip_matrix = lightProjection * light_view_matrix;
-
-				//
-				// Pass 2.1: Generate shadow map for light i
-				//
-				utils::opengl::debug::beginDebugGroup("Create shadow map " + std::to_string(i));
-				glBeginQuery(GL_TIME_ELAPSED, elapsed_time_queries[toU(ElapsedTimeQuery::ShadowMap0Generation) + i]);
-
-				glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[toU(FBO::ShadowMap)]);
-				glViewport(0, 0, constant::shadowmap_res_x, constant::shadowmap_res_y);
-				glClear(GL_DEPTH_BUFFER_BIT);
-				// XXX: Is any clearing needed?
-
-				glUseProgram(fill_shadowmap_shader);
-				glUniform1i(fill_shadowmap_shader_locations.light_index, static_cast<int>(i));
-				glUniform1i(fill_shadowmap_shader_locations.opacity_texture, 0);
+			shadow_map = render_graph.CreateTexture("Shadow map " + light_suffix, shadow_texture(GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT, GL_FLOAT, false));
+			auto const shadow_map_pass = render_graph.AddPass("Create shadow map " + light_suffix, [&, i](RenderGraph const& /*graph*/){
+				if (shader_reload_failed)
+					return;
+
+				auto const vertex_model_to_world = glm::mat4(1.0f);
+
+				// Opaque meshes need neither texture coordinates nor a
+				// fragment shader.
+				if (use_depth_only_vertex_streams) {
+					state.UseProgram(fill_shadowmap_opaque_shader);
+					fill_shadowmap_opaque_uniforms.Set(uniform::light_index, i);
+					fill_shadowmap_opaque_uniforms.Set(uniform::vertex_model_to_world, vertex_model_to_world);
+					for (auto const geometry_index : opaque_geometry_indices) {
+						auto const& geometry = sponza_geometry[geometry_index];
+
+						utils::opengl::debug::beginDebugGroup(geometry.name);
+						draw_geometry(geometry, true);
+						utils::opengl::debug::endDebugGroup();
+					}
+				}
+
+				state.UseProgram(fill_shadowmap_shader);
+				fill_shadowmap_uniforms.Set(uniform::light_index, i);
+				fill_shadowmap_uniforms.Set(uniform::vertex_model_to_world, vertex_model_to_world);
 				for (std::size_t i = 0; i < sponza_geometry.size(); ++i)
 				{
 					auto const& geometry = sponza_geometry[i];
 					auto const& texture_data = sponza_geometry_texture_data[i];
+					if (use_depth_only_vertex_streams && texture_data.opacity_texture_id == 0u)
+						continue;
 
 					utils::opengl::debug::beginDebugGroup(geometry.name);
 
-					auto const vertex_model_to_world = glm::mat4(1.0f);
-					glUniformMatrix4fv(fill_shadowmap_shader_locations.vertex_model_to_world, 1, GL_FALSE, glm::value_ptr(vertex_model_to_world));
-
-					glUniform1i(fill_shadowmap_shader_locations.has_opacity_texture, texture_data.opacity_texture_id != 0u ? 1 : 0);
-					glBindSampler(0u, texture_data.opacity_texture_id != 0u ? samplers[toU(Sampler::Mipmaps)] : samplers[toU(Sampler::Nearest)]);
-					glActiveTexture(GL_TEXTURE0);
-					glBindTexture(GL_TEXTURE_2D, texture_data.opacity_texture_id != 0u ? texture_data.opacity_texture_id : debug_texture_id);
-
-					glBindVertexArray(geometry.vao);
-					if (geometry.ibo != 0u)
-						glDrawElements(geometry.drawing_mode, geometry.indices_nb, GL_UNSIGNED_INT, reinterpret_cast<GLvoid const*>(0x0));
-					else
-						glDrawArrays(geometry.drawing_mode, 0, geometry.vertices_nb);
+					fill_shadowmap_uniforms.Set(uniform::has_opacity_texture, texture_data.opacity_texture_id != 0u);
+					fill_shadowmap_uniforms.BindTexture(uniform::opacity_texture, GL_TEXTURE_2D,
+					                                    texture_data.opacity_texture_id != 0u ? texture_data.opacity_texture_id : debug_texture_id,
+					                                    texture_data.opacity_texture_id != 0u ? samplers[toU(Sampler::Mipmaps)] : samplers[toU(Sampler::Nearest)]);
 
+					draw_geometry(geometry, use_depth_only_vertex_streams);
 
 					utils::opengl::debug::endDebugGroup();
 				}
-				glBindTexture(GL_TEXTURE_2D, 0);
-				glBindVertexArray(0u);
-				glUseProgram(0u);
-
-				glEndQuery(GL_TIME_ELAPSED);
-				utils::opengl::debug::endDebugGroup();
-
-
-				glCullFace(GL_FRONT);
-				glEnable(GL_BLEND);
-				glDepthFunc(GL_GREATER);
-				glDepthMask(GL_FALSE);
-				glBlendEquationSeparate(GL_FUNC_ADD, GL_MIN);
-				glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ONE, GL_ONE);
-				//
-				// Pass 2.2: Accumulate light i contribution
-				utils::opengl::debug::beginDebugGroup("Accumulate light " + std::to_string(i));
-				glBeginQuery(GL_TIME_ELAPSED, elapsed_time_queries[toU(ElapsedTimeQuery::Light0Accumulation) + i]);
-
-				glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[toU(FBO::LightAccumulation)]);
-				glUseProgram(accumulate_lights_shader);
-				glViewport(0, 0, framebuffer_width, framebuffer_height);
-				// XXX: Is any clearing needed?
-
-				glUniform1i(accumulate_light_shader_locations.light_index, static_cast<int>(i));
-				glUniformMatrix4fv(accumulate_light_shader_locations.vertex_model_to_world, 1, GL_FALSE, glm::value_ptr(light_world_matrix));
-				glUniform3fv(accumulate_light_shader_locations.camera_position, 1, glm::value_ptr(mCamera.mWorld.GetTranslation()));
-				glUniform2f(accumulate_light_shader_locations.inverse_screen_resolution,
-				            1.0f / static_cast<float>(framebuffer_width),
-				            1.0f / static_cast<float>(framebuffer_height));
-				glUniform3fv(accumulate_light_shader_locations.light_color, 1, glm::value_ptr(lightColors[i]));
-				glUniform3fv(accumulate_light_shader_locations.light_position, 1, glm::value_ptr(lightTransform.GetTranslation()));
-				glUniform3fv(accumulate_light_shader_locations.light_direction, 1, glm::value_ptr(lightTransform.GetFront()));
-				glUniform1f(accumulate_light_shader_locations.light_intensity, constant::light_intensity);
-				glUniform1f(accumulate_light_shader_locations.light_angle_falloff, constant::light_angle_falloff);
-
-				glActiveTexture(GL_TEXTURE0);
-				glBindTexture(GL_TEXTURE_2D, textures[toU(Texture::DepthBuffer)]);
-				glUniform1i(accumulate_light_shader_locations.depth_texture, 0);
-				glBindSampler(0, samplers[toU(Sampler::Linear)]);
-
-				glActiveTexture(GL_TEXTURE1);
-				glBindTexture(GL_TEXTURE_2D, textures[toU(Texture::GBufferWorldSpaceNormal)]);
-				glUniform1i(accumulate_light_shader_locations.normal_texture, 1);
-				glBindSampler(1, samplers[toU(Sampler::Linear)]);
-
-				glActiveTexture(GL_TEXTURE2);
-				glBindTexture(GL_TEXTURE_2D, textures[toU(Texture::ShadowMap)]);
-				glUniform1i(accumulate_light_shader_locations.shadow_texture, 2);
-				glBindSampler(2, samplers[toU(Sampler::Linear)]);
-
-				glBindVertexArray(cone_geometry.vao);
-				glDrawArrays(cone_geometry.drawing_mode, 0, cone_geometry.vertices_nb);
-
-				glBindVertexArray(0u);
-				glUseProgram(0u);
-				glBindSampler(2u, 0u);
-				glBindSampler(1u, 0u);
-				glBindSampler(0u, 0u);
+				fill_shadowmap_uniforms.UnbindSamplers();
+			});
+			render_graph.SetDepthAttachment(shadow_map_pass, shadow_map, true, LoadOp::Clear);
+			shadow_map_passes.push_back(shadow_map_pass);
 
-				glEndQuery(GL_TIME_ELAPSED);
-				utils::opengl::debug::endDebugGroup();
 
-				glDepthMask(GL_TRUE);
-				glDepthFunc(GL_LESS);
-				glDisable(GL_BLEND);
-				glCullFace(GL_BACK);
+			//
+			// Pass 2.2: Prefilter shadow map i into moments
+			//
+			// Those passes are declared regardless of the filtering used, and
+			// culled by the graph unless the light accumulation reads their
+			// output. EVSM needs 32-bit floats to hold its exponentially
+			// warped depths; VSM only uses the first two channels.
+			auto const moments_description = [&shadow_texture](bool has_mipmaps){
+				return shadow_texture(GL_RGBA32F, GL_RGBA, GL_FLOAT, has_mipmaps);
+			};
+			auto const generate_mipmaps = [&state](GLuint texture){
+				state.BindTexture(0u, GL_TEXTURE_2D, texture);
+				glGenerateMipmap(GL_TEXTURE_2D);
+			};
+
+			auto const has_blur = configuration.blur_passes_nb > 0;
+			shadow_moments = render_graph.CreateTexture("Shadow moments " + light_suffix, moments_description(!has_blur));
+			auto const shadow_moments_pass = render_graph.AddPass("Compute shadow moments " + light_suffix,
+			                                                      [&, shadow_map, shadow_moments, has_blur, generate_mipmaps](RenderGraph const& graph){
+				state.UseProgram(shadow_moments_shader);
+				glUniform1i(glGetUniformLocation(shadow_moments_shader, "shadow_filtering"), toU(shadow_settings.filtering));
+				glUniform2fv(glGetUniformLocation(shadow_moments_shader, "evsm_exponents"), 1, glm::value_ptr(shadow_settings.evsm_exponents));
+				glUniform2f(glGetUniformLocation(shadow_moments_shader, "light_near_far"), lightProjectionNearPlane, lightProjectionFarPlane);
+				bind_texture_with_sampler(GL_TEXTURE_2D, 0, shadow_moments_shader, "shadow_texture", graph.GetTexture(shadow_map), samplers[toU(Sampler::Nearest)]);
+				bonobo::drawFullscreen();
+
+				if (!has_blur)
+					generate_mipmaps(graph.GetTexture(shadow_moments));
+
+				state.BindSampler(0u, 0u);
+			});
+			render_graph.ReadTexture(shadow_moments_pass, shadow_map);
+			render_graph.WriteColour(shadow_moments_pass, shadow_moments, 0u, LoadOp::DontCare);
+
+			// Separable blur; the last vertical pass generates the mipmaps
+			// sampled by the light accumulation.
+			for (int blur_pass = 0; blur_pass < configuration.blur_passes_nb; ++blur_pass) {
+				for (int axis = 0; axis < 2; ++axis) {
+					auto const is_last = blur_pass + 1 == configuration.blur_passes_nb && axis == 1;
+					auto const direction = axis == 0 ? glm::vec2(1.0f / static_cast<float>(constant::shadowmap_res_x), 0.0f)
+					                                 : glm::vec2(0.0f, 1.0f / static_cast<float>(constant::shadowmap_res_y));
+					auto const pass_name = "Blur shadow moments " + light_suffix + (axis == 0 ? " horizontally #" : " vertically #") + std::to_string(blur_pass);
+
+					auto const source = shadow_moments;
+					shadow_moments = render_graph.CreateTexture(pass_name, moments_description(is_last));
+					auto const blur_pass_handle = render_graph.AddPass(pass_name,
+					                                                   [&, source, destination = shadow_moments, direction, is_last, generate_mipmaps](RenderGraph const& graph){
+						state.UseProgram(shadow_blur_shader);
+						glUniform2fv(glGetUniformLocation(shadow_blur_shader, "direction"), 1, glm::value_ptr(direction));
+						bind_texture_with_sampler(GL_TEXTURE_2D, 0, shadow_blur_shader, "source_texture", graph.GetTexture(source), samplers[toU(Sampler::ShadowMoments)]);
+						bonobo::drawFullscreen();
+
+						if (is_last)
+							generate_mipmaps(graph.GetTexture(destination));
+
+						state.BindSampler(0u, 0u);
+					});
+					render_graph.ReadTexture(blur_pass_handle, source);
+					render_graph.WriteColour(blur_pass_handle, shadow_moments, 0u, LoadOp::DontCare);
+				}
 			}
 
 
 			//
-			// Pass 3: Compute final image using both the g-buffer and  the light accumulation buffer
+			// Pass 2.3: Accumulate light i contribution
 			//
-			utils::opengl::debug::beginDebugGroup("Resolve");
-			glBeginQuery(GL_TIME_ELAPSED, elapsed_time_queries[toU(ElapsedTimeQuery::Resolve)]);
+			auto const light_pass = render_graph.AddPass("Accumulate light " + light_suffix,
+			                                             [&, i, use_compact_gbuffer, lighting_depth, lighting_normal, gbuffer_diffuse, shadow_map, shadow_moments](RenderGraph const& graph){
+				if (shader_reload_failed)
+					return;
 
-			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[toU(FBO::Resolve)]);
-			glUseProgram(resolve_deferred_shader);
-			glViewport(0, 0, framebuffer_width, framebuffer_height);
-			// XXX: Is any clearing needed?
+				auto const& lightTransform = lightTransforms[i];
+				auto const light_view_matrix = lightOffsetTransform.GetMatrixInverse() * lightTransform.GetMatrixInverse();
+				auto const light_world_matrix = glm::inverse(light_view_matrix) * coneScaleTransform.GetMatrix();
 
-			bind_texture_with_sampler(GL_TEXTURE_2D, 0, resolve_deferred_shader, "diffuse_texture", textures[toU(Texture::GBufferDiffuse)], samplers[toU(Sampler::Nearest)]);
-			bind_texture_with_sampler(GL_TEXTURE_2D, 1, resolve_deferred_shader, "specular_texture", textures[toU(Texture::GBufferSpecular)], samplers[toU(Sampler::Nearest)]);
-			bind_texture_with_sampler(GL_TEXTURE_2D, 2, resolve_deferred_shader, "light_d_texture", textures[toU(Texture::LightDiffuseContribution)], samplers[toU(Sampler::Nearest)]);
-			bind_texture_with_sampler(GL_TEXTURE_2D, 3, resolve_deferred_shader, "light_s_texture", textures[toU(Texture::LightSpecularContribution)], samplers[toU(Sampler::Nearest)]);
+				glViewport(0, 0, lighting_width, lighting_height);
+				state.DepthMask(GL_FALSE);
 
-			bonobo::drawFullscreen();
+				if (light_volume_culling != LightVolumeCulling::None) {
+					auto const scissor = computeLightScissor(mCamera.GetWorldToClipMatrix() * light_world_matrix, lighting_width, lighting_height);
+					state.Enable(GL_SCISSOR_TEST);
+					glScissor(scissor.x, scissor.y, scissor.z, scissor.w);
+				}
 
-			glBindSampler(3, 0u);
-			glBindSampler(2, 0u);
-			glBindSampler(1, 0u);
-			glBindSampler(0, 0u);
-			glUseProgram(0u);
+				if (light_volume_culling == LightVolumeCulling::StencilAndScissor) {
+					// Mark the pixels whose G-buffer sample lies within the
+					// cone: those have the back face of the cone behind them,
+					// but not the front one. The stencil buffer was cleared
+					// along with the depth, and gets reset by the shading
+					// below.
+					utils::opengl::debug::beginDebugGroup("Mark light volume");
+					state.UseProgram(render_light_cones_shader);
+					glUniformMatrix4fv(glGetUniformLocation(render_light_cones_shader, "vertex_model_to_world"), 1, GL_FALSE, glm::value_ptr(light_world_matrix));
+					glUniformMatrix4fv(glGetUniformLocation(render_light_cones_shader, "vertex_world_to_clip"), 1, GL_FALSE, glm::value_ptr(mCamera.GetWorldToClipMatrix()));
+					state.ColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+					state.Disable(GL_CULL_FACE);
+					state.DepthFunc(GL_LESS);
+					state.Enable(GL_STENCIL_TEST);
+					glStencilFunc(GL_ALWAYS, 0, 0xFF);
+					glStencilOpSeparate(GL_BACK, GL_KEEP, GL_INCR_WRAP, GL_KEEP);
+					glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_DECR_WRAP, GL_KEEP);
+
+					state.BindVertexArray(cone_geometry.vao);
+					glDrawArrays(cone_geometry.drawing_mode, 0, cone_geometry.vertices_nb);
+
+					state.ColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+					state.Enable(GL_CULL_FACE);
+					utils::opengl::debug::endDebugGroup();
 
-			glEndQuery(GL_TIME_ELAPSED);
-			utils::opengl::debug::endDebugGroup();
+					// Only shade the marked pixels, which are covered exactly
+					// once by the back faces of the cone.
+					glStencilFunc(GL_NOTEQUAL, 0, 0xFF);
+					glStencilOp(GL_KEEP, GL_KEEP, GL_ZERO);
+					state.DepthFunc(GL_ALWAYS);
+				} else {
+					state.DepthFunc(GL_GREATER);
+				}
+
+				state.CullFace(GL_FRONT);
+				state.Enable(GL_BLEND);
+				state.BlendEquationSeparate(GL_FUNC_ADD, GL_MIN);
+				state.BlendFuncSeparate(GL_ONE, GL_ONE, GL_ONE, GL_ONE);
+
+				state.UseProgram(accumulate_lights_shader);
+
+				accumulate_lights_uniforms.Set(uniform::light_index, i);
+				accumulate_lights_uniforms.Set(uniform::vertex_model_to_world, light_world_matrix);
+				accumulate_lights_uniforms.Set(uniform::camera_position, mCamera.mWorld.GetTranslation());
+				accumulate_lights_uniforms.Set(uniform::inverse_screen_resolution,
+				                               glm::vec2(1.0f / static_cast<float>(lighting_width),
+				                                         1.0f / static_cast<float>(lighting_height)));
+				accumulate_lights_uniforms.Set(uniform::render_scale, lighting_render_scale);
+				accumulate_lights_uniforms.Set(uniform::light_color, lightColors[i]);
+				accumulate_lights_uniforms.Set(uniform::light_position, lightTransform.GetTranslation());
+				accumulate_lights_uniforms.Set(uniform::light_direction, lightTransform.GetFront());
+				accumulate_lights_uniforms.Set(uniform::light_intensity, constant::light_intensity);
+				accumulate_lights_uniforms.Set(uniform::light_angle_falloff, constant::light_angle_falloff);
+				accumulate_lights_uniforms.Set(uniform::shadow_filtering, toU(shadow_settings.filtering));
+				accumulate_lights_uniforms.Set(uniform::poisson_taps_nb, shadow_settings.poisson_taps_nb);
+				accumulate_lights_uniforms.Set(uniform::poisson_radius, shadow_settings.poisson_radius);
+				accumulate_lights_uniforms.Set(uniform::shadow_bias, shadow_settings.bias);
+				accumulate_lights_uniforms.Set(uniform::light_bleeding_reduction, shadow_settings.light_bleeding_reduction);
+				accumulate_lights_uniforms.Set(uniform::evsm_exponents, shadow_settings.evsm_exponents);
+				accumulate_lights_uniforms.Set(uniform::light_near_far, glm::vec2(lightProjectionNearPlane, lightProjectionFarPlane));
+				accumulate_lights_uniforms.Set(uniform::use_compact_gbuffer, use_compact_gbuffer);
+				accumulate_lights_uniforms.Set(uniform::lights_interleave, lights_interleave);
+				accumulate_lights_uniforms.Set(uniform::frame_index, temporal_lighting_history.frame_index);
+
+				accumulate_lights_uniforms.BindTexture(uniform::depth_texture, GL_TEXTURE_2D, graph.GetTexture(lighting_depth), samplers[toU(Sampler::Linear)]);
+				accumulate_lights_uniforms.BindTexture(uniform::normal_texture, GL_TEXTURE_2D, graph.GetTexture(lighting_normal), samplers[toU(Sampler::Linear)]);
+				accumulate_lights_uniforms.BindTexture(uniform::shadow_texture, GL_TEXTURE_2D, graph.GetTexture(shadow_map), samplers[toU(Sampler::Linear)]);
+				// Each sampler gets a unit of its own, as a unit cannot be
+				// shared between a `sampler2D` and a `sampler2DShadow`.
+				accumulate_lights_uniforms.BindTexture(uniform::shadow_compare_texture, GL_TEXTURE_2D, graph.GetTexture(shadow_map), samplers[toU(Sampler::ShadowCompare)]);
+				accumulate_lights_uniforms.BindTexture(uniform::shadow_moments_texture, GL_TEXTURE_2D, graph.GetTexture(shadow_moments), samplers[toU(Sampler::ShadowMoments)]);
+				accumulate_lights_uniforms.BindTexture(uniform::diffuse_texture, GL_TEXTURE_2D, graph.GetTexture(gbuffer_diffuse), samplers[toU(Sampler::Nearest)]);
+
+				glBeginQuery(GL_SAMPLES_PASSED, shaded_fragments_counters.queries[shaded_fragments_counters.current_frame][i]);
+				state.BindVertexArray(cone_geometry.vao);
+				glDrawArrays(cone_geometry.drawing_mode, 0, cone_geometry.vertices_nb);
+				glEndQuery(GL_SAMPLES_PASSED);
+				shaded_fragments_counters.issued_with[shaded_fragments_counters.current_frame][i] = light_volume_culling;
+
+				accumulate_lights_uniforms.UnbindSamplers();
+
+				state.Disable(GL_STENCIL_TEST);
+				state.Disable(GL_SCISSOR_TEST);
+				state.DepthMask(GL_TRUE);
+				state.DepthFunc(GL_LESS);
+				state.Disable(GL_BLEND);
+				state.CullFace(GL_BACK);
+			});
+			// The first light clears the contributions of the previous frame.
+			auto const light_load_op = i == 0 ? LoadOp::Clear : LoadOp::Load;
+			render_graph.WriteColour(light_pass, light_diffuse, 0u, light_load_op);
+			if (!use_compact_gbuffer)
+				render_graph.WriteColour(light_pass, light_specular, 1u, light_load_op);
+			render_graph.SetDepthAttachment(light_pass, lighting_depth, false);
+			render_graph.ReadTexture(light_pass, lighting_depth);
+			render_graph.ReadTexture(light_pass, lighting_normal);
+			if (use_compact_gbuffer)
+				render_graph.ReadTexture(light_pass, gbuffer_diffuse);
+			render_graph.ReadTexture(light_pass, shadow_map);
+			if (use_shadow_moments)
+				render_graph.ReadTexture(light_pass, shadow_moments);
+			lighting_passes.push_back(light_pass);
 		}
 
 
-		auto const show_debug_elements = show_cone_wireframe || show_basis;
-		if (show_debug_elements) {
-			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[toU(FBO::FinalWithDepth)]);
+		//
+		// Pass 2.4: Blend the lights evaluated this frame with the ones
+		// accumulated over the previous frames, reprojected; the result goes
+		// to the history, outside of the graph, so that it can be read back
+		// next frame.
+		//
+		if (configuration.use_temporal_lighting) {
+			auto const temporal_pass = render_graph.AddPass("Temporal light accumulation",
+			                                                [&, use_compact_gbuffer, light_diffuse, light_specular, lighting_depth, lighting_normal](RenderGraph const& graph){
+				if (shader_reload_failed)
+					return;
+
+				auto const& history = temporal_lighting_history;
+				auto const previous = 1u - history.current;
+				state.BindFramebuffer(GL_FRAMEBUFFER, history.framebuffers[history.current]);
+				glViewport(0, 0, lighting_width, lighting_height);
+
+				state.UseProgram(temporal_lights_shader);
+
+				temporal_lights_uniforms.BindTexture(uniform::light_d_texture, GL_TEXTURE_2D, graph.GetTexture(light_diffuse), samplers[toU(Sampler::Nearest)]);
+				temporal_lights_uniforms.BindTexture(uniform::light_s_texture, GL_TEXTURE_2D, graph.GetTexture(light_specular), samplers[toU(Sampler::Nearest)]);
+				temporal_lights_uniforms.BindTexture(uniform::depth_texture, GL_TEXTURE_2D, graph.GetTexture(lighting_depth), samplers[toU(Sampler::Nearest)]);
+				temporal_lights_uniforms.BindTexture(uniform::normal_texture, GL_TEXTURE_2D, graph.GetTexture(lighting_normal), samplers[toU(Sampler::Nearest)]);
+				temporal_lights_uniforms.BindTexture(uniform::history_light_d_texture, GL_TEXTURE_2D, history.light_diffuse[previous], samplers[toU(Sampler::Linear)]);
+				temporal_lights_uniforms.BindTexture(uniform::history_light_s_texture, GL_TEXTURE_2D, history.light_specular[previous], samplers[toU(Sampler::Linear)]);
+				// Interpolating depths and normals across edges would let
+				// disocclusions through.
+				temporal_lights_uniforms.BindTexture(uniform::history_geometry_texture, GL_TEXTURE_2D, history.geometry[previous], samplers[toU(Sampler::Nearest)]);
+
+				temporal_lights_uniforms.Set(uniform::use_compact_gbuffer, use_compact_gbuffer);
+				temporal_lights_uniforms.Set(uniform::is_history_valid, history.is_valid);
+				temporal_lights_uniforms.Set(uniform::previous_view_projection, history.previous_view_projection);
+				temporal_lights_uniforms.Set(uniform::inverse_screen_resolution,
+				                             glm::vec2(1.0f / static_cast<float>(lighting_width),
+				                                       1.0f / static_cast<float>(lighting_height)));
+				temporal_lights_uniforms.Set(uniform::camera_near_far, glm::vec2(mCamera.mNear, mCamera.mFar));
+				temporal_lights_uniforms.Set(uniform::render_scale, lighting_render_scale);
+				temporal_lights_uniforms.Set(uniform::previous_render_scale, history.previous_render_scale);
+				temporal_lights_uniforms.Set(uniform::history_weight, temporal_lighting.history_weight);
+				temporal_lights_uniforms.Set(uniform::depth_tolerance, temporal_lighting.depth_tolerance);
+				temporal_lights_uniforms.Set(uniform::normal_tolerance, temporal_lighting.normal_tolerance);
+
+				bonobo::drawFullscreen();
+
+				temporal_lights_uniforms.UnbindSamplers();
+			});
+			render_graph.ReadTexture(temporal_pass, light_diffuse);
+			if (!use_compact_gbuffer)
+				render_graph.ReadTexture(temporal_pass, light_specular);
+			render_graph.ReadTexture(temporal_pass, lighting_depth);
+			render_graph.ReadTexture(temporal_pass, lighting_normal);
+			render_graph.SetSideEffects(temporal_pass);
+			lighting_passes.push_back(temporal_pass);
 		}
 
 
 		//
-		// Draw wireframe cones on top of the final image for debugging purposes
+		// Pass 3: Compute final image using both the g-buffer and  the light accumulation buffer
 		//
-		glBeginQuery(GL_TIME_ELAPSED, elapsed_time_queries[toU(ElapsedTimeQuery::ConeWireframe)]);
-		if (show_cone_wireframe) {
-			utils::opengl::debug::beginDebugGroup("Draw cone wireframe");
-
-			glDisable(GL_CULL_FACE);
-			glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-			for (size_t i = 0; i < lights_nb; ++i) {
-				cone.render(view_projection,
-				            lightTransforms[i].GetMatrix() * lightOffsetTransform.GetMatrix() * coneScaleTransform.GetMatrix(),
-				            render_light_cones_shader, set_uniforms);
-			}
-			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-			glEnable(GL_CULL_FACE);
-			utils::opengl::debug::endDebugGroup();
-		}
-		glEndQuery(GL_TIME_ELAPSED);
+		auto const resolve_pass = render_graph.AddPass("Resolve",
+		                                               [&, use_compact_gbuffer, use_temporal_lighting = configuration.use_temporal_lighting, lighting_scale = getLightingScale(configuration.lighting_resolution),
+		                                                gbuffer_diffuse, gbuffer_specular, gbuffer_normal, light_diffuse, light_specular, depth_buffer, lighting_depth, lighting_normal, lighting_min_max_depth](RenderGraph const& graph){
+			if (shader_reload_failed)
+				return;
+
+			state.UseProgram(resolve_deferred_shader);
+
+			auto const& history = temporal_lighting_history;
+			auto const light_diffuse_texture = use_temporal_lighting ? history.light_diffuse[history.current] : graph.GetTexture(light_diffuse);
+			auto const light_specular_texture = use_temporal_lighting ? history.light_specular[history.current] : graph.GetTexture(light_specular);
+			bind_texture_with_sampler(GL_TEXTURE_2D, 0, resolve_deferred_shader, "diffuse_texture", graph.GetTexture(gbuffer_diffuse), samplers[toU(Sampler::Nearest)]);
+			bind_texture_with_sampler(GL_TEXTURE_2D, 1, resolve_deferred_shader, "specular_texture", graph.GetTexture(gbuffer_specular), samplers[toU(Sampler::Nearest)]);
+			bind_texture_with_sampler(GL_TEXTURE_2D, 2, resolve_deferred_shader, "light_d_texture", light_diffuse_texture, samplers[toU(Sampler::Nearest)]);
+			bind_texture_with_sampler(GL_TEXTURE_2D, 3, resolve_deferred_shader, "light_s_texture", light_specular_texture, samplers[toU(Sampler::Nearest)]);
+			bind_texture_with_sampler(GL_TEXTURE_2D, 4, resolve_deferred_shader, "depth_texture", graph.GetTexture(depth_buffer), samplers[toU(Sampler::Nearest)]);
+			bind_texture_with_sampler(GL_TEXTURE_2D, 5, resolve_deferred_shader, "normal_texture", graph.GetTexture(gbuffer_normal), samplers[toU(Sampler::Nearest)]);
+			bind_texture_with_sampler(GL_TEXTURE_2D, 6, resolve_deferred_shader, "lighting_depth_texture", graph.GetTexture(lighting_depth), samplers[toU(Sampler::Nearest)]);
+			bind_texture_with_sampler(GL_TEXTURE_2D, 7, resolve_deferred_shader, "lighting_normal_texture", graph.GetTexture(lighting_normal), samplers[toU(Sampler::Nearest)]);
+			bind_texture_with_sampler(GL_TEXTURE_2D, 8, resolve_deferred_shader, "lighting_min_max_depth_texture", graph.GetTexture(lighting_min_max_depth), samplers[toU(Sampler::Nearest)]);
+			glUniform1i(glGetUniformLocation(resolve_deferred_shader, "use_compact_gbuffer"), use_compact_gbuffer ? 1 : 0);
+			glUniform2fv(glGetUniformLocation(resolve_deferred_shader, "render_scale"), 1, glm::value_ptr(render_scale));
+			glUniform2f(glGetUniformLocation(resolve_deferred_shader, "camera_near_far"), mCamera.mNear, mCamera.mFar);
+			glUniform1f(glGetUniformLocation(resolve_deferred_shader, "lighting_scale"), lighting_scale);
+			glUniform2i(glGetUniformLocation(resolve_deferred_shader, "lighting_size"), lighting_width, lighting_height);
+			glUniform1f(glGetUniformLocation(resolve_deferred_shader, "depth_sigma"), light_upsampling.depth_sigma);
+			glUniform1f(glGetUniformLocation(resolve_deferred_shader, "normal_power"), light_upsampling.normal_power);
+
+			bonobo::drawFullscreen();
 
+			state.BindSampler(8, 0u);
+			state.BindSampler(7, 0u);
+			state.BindSampler(6, 0u);
+			state.BindSampler(5, 0u);
+			state.BindSampler(4, 0u);
+			state.BindSampler(3, 0u);
+			state.BindSampler(2, 0u);
+			state.BindSampler(1, 0u);
+			state.BindSampler(0, 0u);
+		});
+		render_graph.WriteColour(resolve_pass, result, 0u, LoadOp::DontCare);
+		render_graph.ReadTexture(resolve_pass, gbuffer_diffuse);
+		if (!use_compact_gbuffer)
+			render_graph.ReadTexture(resolve_pass, gbuffer_specular);
+		if (!configuration.use_temporal_lighting) {
+			render_graph.ReadTexture(resolve_pass, light_diffuse);
+			if (!use_compact_gbuffer)
+				render_graph.ReadTexture(resolve_pass, light_specular);
+		}
+		render_graph.ReadTexture(resolve_pass, depth_buffer);
+		if (configuration.lighting_resolution != LightingResolution::Full) {
+			render_graph.ReadTexture(resolve_pass, gbuffer_normal);
+			render_graph.ReadTexture(resolve_pass, lighting_depth);
+			render_graph.ReadTexture(resolve_pass, lighting_normal);
+			render_graph.ReadTexture(resolve_pass, lighting_min_max_depth);
+		}
+		lighting_passes.push_back(resolve_pass);
 
-		utils::opengl::debug::beginDebugGroup("Draw GUI");
-		glBeginQuery(GL_TIME_ELAPSED, elapsed_time_queries[toU(ElapsedTimeQuery::GUI)]);
 
 		//
-		// Display 3D helpers
+		// Draw wireframe cones and the basis on top of the final image for
+		// debugging purposes
 		//
-		if (show_basis) {
-			bonobo::renderBasis(basis_thickness_scale, basis_length_scale, mCamera.GetWorldToClipMatrix());
-		}
+		if (configuration.show_debug_elements) {
+			auto const debug_elements_pass = render_graph.AddPass("Draw debug elements", [&](RenderGraph const& /*graph*/){
+				if (show_cone_wireframe) {
+					state.Disable(GL_CULL_FACE);
+					state.PolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+					for (size_t i = 0; i < static_cast<size_t>(lights_nb); ++i) {
+						cone.render(mCamera.GetWorldToClipMatrix(),
+						            lightTransforms[i].GetMatrix() * lightOffsetTransform.GetMatrix() * coneScaleTransform.GetMatrix(),
+						            render_light_cones_shader, set_uniforms);
+					}
+					state.PolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+					state.Enable(GL_CULL_FACE);
+				}
 
-		// If the basis and cone wireframe were not shown, FBO::Resolve
-		// is still bound so there is no need to rebind it.
-		if (show_debug_elements) {
-			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[toU(FBO::Resolve)]);
+				if (show_basis) {
+					bonobo::renderBasis(basis_thickness_scale, basis_length_scale, mCamera.GetWorldToClipMatrix());
+				}
+			});
+			render_graph.WriteColour(debug_elements_pass, result, 0u, LoadOp::Load);
+			render_graph.SetDepthAttachment(debug_elements_pass, depth_buffer, true);
 		}
 
+
 		//
-		// Output content of the g-buffer as well as of the shadowmap, for debugging purposes
+		// Output content of the g-buffer as well as of the shadowmap, for
+		// debugging purposes, and the GUI
 		//
-		if (show_textures) {
-			bonobo::displayTexture({-0.95f, -0.95f}, {-0.55f, -0.55f}, textures[toU(Texture::GBufferDiffuse)],            samplers[toU(Sampler::Linear)], {0, 1, 2, -1}, glm::uvec2(framebuffer_width, framebuffer_height));
-			bonobo::displayTexture({-0.45f, -0.95f}, {-0.05f, -0.55f}, textures[toU(Texture::GBufferSpecular)],           samplers[toU(Sampler::Linear)], {0, 1, 2, -1}, glm::uvec2(framebuffer_width, framebuffer_height));
-			bonobo::displayTexture({ 0.05f, -0.95f}, { 0.45f, -0.55f}, textures[toU(Texture::GBufferWorldSpaceNormal)],   samplers[toU(Sampler::Linear)], {0, 1, 2, -1}, glm::uvec2(framebuffer_width, framebuffer_height));
-			bonobo::displayTexture({ 0.55f, -0.95f}, { 0.95f, -0.55f}, textures[toU(Texture::DepthBuffer)],               samplers[toU(Sampler::Linear)], {0, 0, 0, -1}, glm::uvec2(framebuffer_width, framebuffer_height), true, mCamera.mNear, mCamera.mFar);
-			bonobo::displayTexture({-0.95f,  0.55f}, {-0.55f,  0.95f}, textures[toU(Texture::ShadowMap)],                 samplers[toU(Sampler::Linear)], {0, 0, 0, -1}, glm::uvec2(framebuffer_width, framebuffer_height), true, lightProjectionNearPlane, lightProjectionFarPlane);
-			bonobo::displayTexture({-0.45f,  0.55f}, {-0.05f,  0.95f}, textures[toU(Texture::LightDiffuseContribution)],  samplers[toU(Sampler::Linear)], {0, 1, 2, -1}, glm::uvec2(framebuffer_width, framebuffer_height));
-			bonobo::displayTexture({ 0.05f,  0.55f}, { 0.45f,  0.95f}, textures[toU(Texture::LightSpecularContribution)], samplers[toU(Sampler::Linear)], {0, 1, 2, -1}, glm::uvec2(framebuffer_width, framebuffer_height));
+		auto const last_shadow_map = shadow_map;
+		auto const last_shadow_moments = shadow_moments;
+		auto const gui_pass = render_graph.AddPass("Draw GUI",
+		                                           [&, use_compact_gbuffer, gbuffer_diffuse, gbuffer_specular, gbuffer_normal, depth_buffer, light_diffuse, light_specular, last_shadow_map, last_shadow_moments, result](RenderGraph const& graph){
+			if (show_textures) {
+				bonobo::displayTexture({-0.95f, -0.95f}, {-0.55f, -0.55f}, graph.GetTexture(gbuffer_diffuse),     samplers[toU(Sampler::Linear)], {0, 1, 2, -1}, glm::uvec2(framebuffer_width, framebuffer_height));
+				if (use_compact_gbuffer)
+					bonobo::displayTexture({-0.45f, -0.95f}, {-0.05f, -0.55f}, graph.GetTexture(gbuffer_diffuse), samplers[toU(Sampler::Linear)], {3, 3, 3, -1}, glm::uvec2(framebuffer_width, framebuffer_height));
+				else
+					bonobo::displayTexture({-0.45f, -0.95f}, {-0.05f, -0.55f}, graph.GetTexture(gbuffer_specular), samplers[toU(Sampler::Linear)], {0, 1, 2, -1}, glm::uvec2(framebuffer_width, framebuffer_height));
+				bonobo::displayTexture({ 0.05f, -0.95f}, { 0.45f, -0.55f}, graph.GetTexture(gbuffer_normal),      samplers[toU(Sampler::Linear)], use_compact_gbuffer ? glm::ivec4(0, 1, -1, -1) : glm::ivec4(0, 1, 2, -1), glm::uvec2(framebuffer_width, framebuffer_height));
+				bonobo::displayTexture({ 0.55f, -0.95f}, { 0.95f, -0.55f}, graph.GetTexture(depth_buffer),        samplers[toU(Sampler::Linear)], {0, 0, 0, -1}, glm::uvec2(framebuffer_width, framebuffer_height), true, mCamera.mNear, mCamera.mFar);
+				bonobo::displayTexture({-0.95f,  0.55f}, {-0.55f,  0.95f}, graph.GetTexture(last_shadow_map),     samplers[toU(Sampler::Linear)], {0, 0, 0, -1}, glm::uvec2(framebuffer_width, framebuffer_height), true, lightProjectionNearPlane, lightProjectionFarPlane);
+				bonobo::displayTexture({-0.45f,  0.55f}, {-0.05f,  0.95f}, graph.GetTexture(light_diffuse),       samplers[toU(Sampler::Linear)], {0, 1, 2, -1}, glm::uvec2(framebuffer_width, framebuffer_height));
+				if (!use_compact_gbuffer)
+					bonobo::displayTexture({ 0.05f,  0.55f}, { 0.45f,  0.95f}, graph.GetTexture(light_specular),  samplers[toU(Sampler::Linear)], {0, 1, 2, -1}, glm::uvec2(framebuffer_width, framebuffer_height));
+				if (shadow_settings.filtering == ShadowFiltering::VSM)
+					bonobo::displayTexture({ 0.55f,  0.55f}, { 0.95f,  0.95f}, graph.GetTexture(last_shadow_moments), samplers[toU(Sampler::Linear)], {0, 0, 0, -1}, glm::uvec2(framebuffer_width, framebuffer_height));
+			}
+			if (temporal_lighting.is_enabled && temporal_lighting.show_error)
+				bonobo::displayTexture({-1.0f, -1.0f}, { 1.0f,  1.0f}, temporal_lighting_history.error, samplers[toU(Sampler::Nearest)], {0, 1, 2, -1}, glm::uvec2(framebuffer_width, framebuffer_height));
+
+			//
+			// Reset viewport back to normal
+			//
+			glViewport(0, 0, graph.GetWidth(result), graph.GetHeight(result));
+
+			if (show_logs) {
+				Log::View::Render();
+				GLCallCounters::Get().RenderOverlay("EDAN35_assignment2_gl_calls.csv");
+				GPUMemoryRegistry::Get().RenderPanel();
+#if ENABLE_PROFILING
+				Profiler::Get().RenderFlameView("EDAN35_assignment2_cpu_trace.json");
+#endif
+			}
+			mWindowManager.RenderImGuiFrame(show_gui);
+		});
+		render_graph.WriteColour(gui_pass, result, 0u, LoadOp::Load);
+		if (configuration.show_textures) {
+			for (auto const texture : { gbuffer_diffuse, gbuffer_specular, gbuffer_normal, depth_buffer, last_shadow_map, light_diffuse, light_specular }) {
+				if (texture != RenderGraph::invalid_handle)
+					render_graph.ReadTexture(gui_pass, texture);
+			}
+			if (configuration.shadow_filtering == ShadowFiltering::VSM)
+				render_graph.ReadTexture(gui_pass, last_shadow_moments);
 		}
 
+
 		//
-		// Reset viewport back to normal
+		// Blit the result back to the default framebuffer.
 		//
-		glViewport(0, 0, framebuffer_width, framebuffer_height);
+		auto const copy_pass = render_graph.AddPass("Copy to default framebuffer", [&state, gui_pass, result](RenderGraph const& graph){
+			// The framebuffer of the GUI pass only has the result attached,
+			// and uses it as its read buffer.
+			state.BindFramebuffer(GL_READ_FRAMEBUFFER, graph.GetFramebuffer(gui_pass));
+			state.BindFramebuffer(GL_DRAW_FRAMEBUFFER, 0u);
+			auto const width = graph.GetWidth(result);
+			auto const height = graph.GetHeight(result);
+			glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+		});
+		render_graph.ReadTexture(copy_pass, result);
+		render_graph.SetSideEffects(copy_pass);
+
+		render_graph.Compile();
+	};
 
-		bool opened = ImGui::Begin("Render Time", nullptr, ImGuiWindowFlags_None);
-		if (opened) {
-			ImGui::Text("Frame CPU time: %.3f ms", std::chrono::duration<float, std::milli>(deltaTimeUs).count());
 
-			ImGui::Checkbox("Copy elapsed times back to CPU", &copy_elapsed_times);
+	while (!glfwWindowShouldClose(window)) {
+		PROFILE_BEGIN_FRAME();
+		PROFILE_ZONE("Frame");
+
+		auto const nowTime = std::chrono::high_resolution_clock::now();
+		auto const deltaTimeUs = std::chrono::duration_cast<std::chrono::microseconds>(nowTime - lastTime);
+		lastTime = nowTime;
+		// Lights move by a fixed amount per frame during flythroughs, for
+		// every run to render the same frames.
+		if (!are_lights_paused)
+			seconds_nb += flythrough.IsRunning() ? 1.0f / 60.0f : std::chrono::duration<decltype(seconds_nb)>(deltaTimeUs).count();
+
+		auto& io = ImGui::GetIO();
+		inputHandler.SetUICapture(io.WantCaptureMouse, io.WantCaptureKeyboard);
 
-			if (ImGui::BeginTable("Pass durations", 2, ImGuiTableFlags_SizingFixedFit))
+		glfwPollEvents();
+		inputHandler.Advance();
+		if (!flythrough.IsRunning())
+			mCamera.Update(deltaTimeUs, inputHandler);
+
+		camera_view_proj_transforms.view_projection = mCamera.GetWorldToClipMatrix();
+		camera_view_proj_transforms.view_projection_inverse = mCamera.GetClipToWorldMatrix();
+
+		// Programs whose sources get saved are rebuilt in the background.
+		bool were_programs_replaced = program_manager.Update();
+		if (inputHandler.GetKeycodeState(GLFW_KEY_R) & JUST_PRESSED) {
+			PROFILE_ZONE("Reload shaders");
+			if (!program_manager.ReloadModifiedPrograms())
 			{
-				ImGui::TableSetupColumn("Pass");
-				ImGui::TableSetupColumn("GPU time [ms]");
-				ImGui::TableHeadersRow();
-
-				ImGui::TableNextColumn();
-				ImGui::Text("Gbuffer gen.");
-				ImGui::TableNextColumn();
-				ImGui::Text("%.3f", pass_elapsed_times[toU(ElapsedTimeQuery::GbufferGeneration)] / 1000000.0f);
-
-				for (std::size_t i = 0; i < lights_nb; ++i) {
-					ImGui::TableNextColumn();
-					ImGui::Text("Light %zu", i);
-					ImGui::TableNextColumn();
-					ImGui::Text("");
-
-					ImGui::TableNextColumn();
-					ImGui::Text("  Shadow map");
-					ImGui::TableNextColumn();
-					ImGui::Text("%.3f", pass_elapsed_times[toU(ElapsedTimeQuery::ShadowMap0Generation) + i] / 1000000.0f);
-
-					ImGui::TableNextColumn();
-					ImGui::Text("  Light accumulation");
-					ImGui::TableNextColumn();
-					ImGui::Text("%.3f", pass_elapsed_times[toU(ElapsedTimeQuery::Light0Accumulation) + i] / 1000000.0f);
-				}
+				tinyfd_notifyPopup("Shader Program Reload Error",
+				                   "An error occurred while reloading shader programs; see the logs for details.\n"
+				                   "Failing programs keep their previous version until the issue is solved; they get rebuilt as soon as their sources are saved.",
+				                   "error");
+			}
+			were_programs_replaced = true;
+		}
+		if (were_programs_replaced) {
+			// Rendering is only suspended while some programs never built.
+			shader_reload_failed = !program_manager.AreAllProgramsValid();
+		}
+		if (inputHandler.GetKeycodeState(GLFW_KEY_F3) & JUST_RELEASED)
+			show_logs = !show_logs;
+		if (inputHandler.GetKeycodeState(GLFW_KEY_F2) & JUST_RELEASED)
+			show_gui = !show_gui;
 
-				ImGui::TableNextColumn();
-				ImGui::Text("Resolve");
-				ImGui::TableNextColumn();
-				ImGui::Text("%.3f", pass_elapsed_times[toU(ElapsedTimeQuery::Resolve)] / 1000000.0f);
+		mWindowManager.NewImGuiFrame();
 
-				ImGui::TableNextColumn();
-				ImGui::Text("Cone wireframe");
-				ImGui::TableNextColumn();
-				ImGui::Text("%.3f", pass_elapsed_times[toU(ElapsedTimeQuery::ConeWireframe)] / 1000000.0f);
+		glfwGetFramebufferSize(window, &framebuffer_width, &framebuffer_height);
+		render_graph.SetFramebufferSize(framebuffer_width, framebuffer_height);
+
+		// The benchmark drives the settings it sweeps over.
+		if (gbuffer_benchmark.is_running) {
+			advanceGBufferBenchmark(gbuffer_benchmark, render_graph.GetLastGPUTime(), render_width, render_height);
+			if (gbuffer_benchmark.is_running) {
+				auto const& benchmark_case = gbuffer_benchmark.cases[gbuffer_benchmark.current_case];
+				select_gbuffer_layout(benchmark_case.layout);
+				lights_nb = benchmark_case.lights_nb;
+				dynamic_resolution.is_enabled = false;
+				dynamic_resolution.scale = benchmark_case.scale;
+			} else {
+				exportGBufferBenchmark(gbuffer_benchmark, "EDAN35_assignment2_gbuffer_benchmark.csv");
+				gbuffer_layout = layout_before_benchmark;
+				lights_nb = lights_nb_before_benchmark;
+				dynamic_resolution = dynamic_resolution_before_benchmark;
+			}
+		}
 
-				ImGui::TableNextColumn();
-				ImGui::Text("GUI");
-				ImGui::TableNextColumn();
-				ImGui::Text("%.3f", pass_elapsed_times[toU(ElapsedTimeQuery::GUI)] / 1000000.0f);
+		// Passes that are culled or no longer part of the graph are not
+		// accounted for.
+		if (dynamic_resolution.is_enabled)
+			updateDynamicResolution(dynamic_resolution, static_cast<float>(render_graph.GetLastGPUTime()), 2 * static_cast<int>(gpu_timers.GetLatencyFramesCount()));
+		render_width = std::max(1, static_cast<int>(std::lround(framebuffer_width * dynamic_resolution.scale)));
+		render_height = std::max(1, static_cast<int>(std::lround(framebuffer_height * dynamic_resolution.scale)));
+		render_scale = glm::vec2(static_cast<float>(render_width) / static_cast<float>(framebuffer_width),
+		                         static_cast<float>(render_height) / static_cast<float>(framebuffer_height));
+
+		// Collect the timings from a few frames ago, without waiting for the
+		// GPU.
+		gpu_timers.BeginFrame();
+		advanceShadedFragmentsCounters(shaded_fragments_counters);
+		state.BeginFrame();
+		GLCallCounters::Get().BeginFrame();
+
+		if (flythrough.IsRunning()) {
+			if (flythrough.BeginFrame(mCamera) && is_flythrough_automated)
+				glfwSetWindowShouldClose(window, true);
+			camera_view_proj_transforms.view_projection = mCamera.GetWorldToClipMatrix();
+			camera_view_proj_transforms.view_projection_inverse = mCamera.GetClipToWorldMatrix();
+		}
 
-				ImGui::TableNextColumn();
-				ImGui::Text("Copy to framebuffer");
-				ImGui::TableNextColumn();
-				ImGui::Text("%.3f", pass_elapsed_times[toU(ElapsedTimeQuery::CopyToFramebuffer)] / 1000000.0f);
 
-				ImGui::EndTable();
+		for (size_t i = 0; i < static_cast<size_t>(lights_nb); ++i) {
+			auto& lightTransform = lightTransforms[i];
+			lightTransform.SetRotate(glm::two_pi<float>() * static_cast<float>(i) / static_cast<float>(constant::lights_nb) + 0.1f * seconds_nb, glm::vec3(0.0f, 1.0f, 0.0f));
+
+			auto const light_view_matrix = lightOffsetTransform.GetMatrixInverse() * lightTransform.GetMatrixInverse();
+			auto const light_world_to_clip_matrix = lightProjection * light_view_matrix;
+
+			light_view_proj_transforms[i].view_projection = light_world_to_clip_matrix;
+			light_view_proj_transforms[i].view_projection_inverse = glm::inverse(light_world_to_clip_matrix);
+		}
+
+
+		//
+		// Update per-frame changing UBOs.
+		//
+		glBindBuffer(GL_UNIFORM_BUFFER, ubos[toU(UBO::CameraViewProjTransforms)]);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(camera_view_proj_transforms), &camera_view_proj_transforms);
+		glBindBuffer(GL_UNIFORM_BUFFER, ubos[toU(UBO::LightViewProjTransforms)]);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(light_view_proj_transforms), light_view_proj_transforms.data());
+		glBindBuffer(GL_UNIFORM_BUFFER, 0u);
+
+
+		//
+		// Build the GUI first, as it is rendered by the last passes of the
+		// graph and may modify its structure.
+		//
+		bool opened = ImGui::Begin("Render Time", nullptr, ImGuiWindowFlags_None);
+		if (opened) {
+			ImGui::Text("Frame CPU time: %.3f ms", std::chrono::duration<float, std::milli>(deltaTimeUs).count());
+
+			ImGui::Text("GPU timings, %zu frames late (%llu dropped):", gpu_timers.GetLatencyFramesCount(), static_cast<unsigned long long>(gpu_timers.GetDroppedSamplesCount()));
+			gpu_timers.RenderStatisticsTable("Pass durations");
+
+			if (ImGui::Button("Reset"))
+				gpu_timers.ResetStatistics();
+			ImGui::SameLine();
+			if (ImGui::Button("Export CSV"))
+				gpu_timers.ExportCSV("EDAN35_assignment2_timings.csv");
+			ImGui::SameLine();
+			if (ImGui::Button("Export JSON"))
+				gpu_timers.ExportJSON("EDAN35_assignment2_timings.json");
+
+			if (ImGui::TreeNode("Render graph")) {
+				render_graph.RenderStatistics();
+				ImGui::TreePop();
+			}
+			if (ImGui::TreeNode("GL state changes")) {
+				state.RenderStatistics("GL state changes");
+				ImGui::TreePop();
 			}
 		}
 		ImGui::End();
 
+		flythrough.RenderControls(mCamera, flythrough_path_filename, flythrough_report_filename, &gpu_timers);
+
 		opened = ImGui::Begin("Scene Controls", nullptr, ImGuiWindowFlags_None);
 		if (opened) {
 			ImGui::Checkbox("Pause lights", &are_lights_paused);
@@ -801,52 +1896,300 @@ edan35::Assignment2::run()
 			ImGui::Checkbox("Show textures", &show_textures);
 			ImGui::Checkbox("Show light cones wireframe", &show_cone_wireframe);
 			ImGui::Separator();
+			ImGui::Checkbox("Depth pre-pass", &use_depth_prepass);
+			{
+				// Samples passing the depth test in the G-buffer pass, i.e.
+				// how many times each pixel got shaded on average.
+				auto const pixels_nb = static_cast<double>(render_width) * static_cast<double>(render_height);
+				auto const& counts = shaded_fragments_counters.gbuffer_last_counts;
+				ImGui::Text("G-buffer fragments without pre-pass: %llu (%.2f per pixel)", static_cast<unsigned long long>(counts[0]), counts[0] / pixels_nb);
+				ImGui::Text("G-buffer fragments with pre-pass:    %llu (%.2f per pixel)", static_cast<unsigned long long>(counts[1]), counts[1] / pixels_nb);
+			}
+			ImGui::Separator();
+			auto light_volume_culling_index = static_cast<int>(light_volume_culling);
+			if (ImGui::Combo("Light volume culling", &light_volume_culling_index, light_volume_culling_names, IM_ARRAYSIZE(light_volume_culling_names)))
+				light_volume_culling = static_cast<LightVolumeCulling>(light_volume_culling_index);
+			if (ImGui::TreeNode("Shaded fragments per light")) {
+				if (ImGui::BeginTable("Shaded fragments per light", 1 + toU(LightVolumeCulling::Count), ImGuiTableFlags_SizingFixedFit)) {
+					ImGui::TableSetupColumn("Light");
+					for (auto const name : light_volume_culling_names)
+						ImGui::TableSetupColumn(name);
+					ImGui::TableHeadersRow();
+
+					for (size_t i = 0; i < static_cast<size_t>(lights_nb); ++i) {
+						ImGui::TableNextColumn();
+						ImGui::Text("%zu", i);
+						for (auto const& counts : shaded_fragments_counters.last_counts) {
+							ImGui::TableNextColumn();
+							ImGui::Text("%llu", static_cast<unsigned long long>(counts[i]));
+						}
+					}
+
+					ImGui::EndTable();
+				}
+				ImGui::TextDisabled("Latest count measured with each mode.");
+				ImGui::TreePop();
+			}
+			ImGui::Separator();
+			ImGui::Checkbox("Temporal light accumulation", &temporal_lighting.is_enabled);
+			if (temporal_lighting.is_enabled) {
+				ImGui::SliderInt("Lights per pixel and frame", &temporal_lighting.lights_per_pixel, 1, lights_nb);
+				ImGui::SliderFloat("History weight", &temporal_lighting.history_weight, 0.0f, 0.99f);
+				ImGui::SliderFloat("Depth tolerance", &temporal_lighting.depth_tolerance, 0.001f, 0.2f, "%.3f");
+				ImGui::SliderFloat("Normal tolerance", &temporal_lighting.normal_tolerance, 0.0f, 1.0f);
+				ImGui::Checkbox("Show history rejection", &temporal_lighting.show_error);
+				ImGui::Text("Each pixel goes through all lights every %d frame(s).", lights_interleave);
+				ImGui::TextDisabled("Red: history rejected; green: change from the history.");
+			}
+			ImGui::Separator();
+			{
+				// Mean GPU time of the passes affected by the lighting
+				// resolution, kept per resolution; as for the vertex
+				// streams, timings restart from scratch when switching.
+				auto const current_resolution = gbuffer_layout == GBufferLayout::Compact ? LightingResolution::Full : light_upsampling.resolution;
+				auto& current_mean = lighting_mean_gpu_time[toU(current_resolution)];
+				current_mean = 0.0;
+				for (auto const pass : lighting_passes)
+					current_mean += render_graph.GetPassStatistics(pass).mean_ms;
+
+				if (ImGui::Combo("Lighting quality", &light_upsampling_preset, light_upsampling_preset_names, IM_ARRAYSIZE(light_upsampling_preset_names))) {
+					light_upsampling = light_upsampling_presets[light_upsampling_preset];
+					gpu_timers.ResetStatistics();
+				}
+				auto lighting_resolution_index = static_cast<int>(light_upsampling.resolution);
+				if (ImGui::Combo("Lighting resolution", &lighting_resolution_index, lighting_resolution_names, IM_ARRAYSIZE(lighting_resolution_names))) {
+					light_upsampling.resolution = static_cast<LightingResolution>(lighting_resolution_index);
+					gpu_timers.ResetStatistics();
+				}
+				if (light_upsampling.resolution != LightingResolution::Full) {
+					ImGui::SliderFloat("Upsampling depth sigma", &light_upsampling.depth_sigma, 0.001f, 0.2f, "%.3f");
+					ImGui::SliderFloat("Upsampling normal power", &light_upsampling.normal_power, 0.0f, 32.0f);
+				}
+				if (gbuffer_layout == GBufferLayout::Compact)
+					ImGui::TextDisabled("The compact layout always accumulates lights at full resolution.");
+				for (int resolution = 0; resolution < toU(LightingResolution::Count); ++resolution)
+					ImGui::Text("Lighting GPU time at %s resolution: %.3f ms", lighting_resolution_names[resolution], lighting_mean_gpu_time[resolution]);
+			}
+			ImGui::Separator();
+			ImGui::Checkbox("Dynamic resolution", &dynamic_resolution.is_enabled);
+			if (dynamic_resolution.is_enabled) {
+				ImGui::SliderFloat("Target GPU frame time (ms)", &dynamic_resolution.target_frame_time_ms, 1.0f, 50.0f);
+				ImGui::SliderFloat("Minimum scale", &dynamic_resolution.min_scale, 0.25f, dynamic_resolution.max_scale);
+				ImGui::SliderFloat("Maximum scale", &dynamic_resolution.max_scale, dynamic_resolution.min_scale, 1.0f);
+				ImGui::Text("Resolution scale: %.2f (%dx%d)", dynamic_resolution.scale, render_width, render_height);
+			} else {
+				ImGui::SliderFloat("Resolution scale", &dynamic_resolution.scale, 0.25f, 1.0f);
+			}
+			ImGui::Separator();
+			auto gbuffer_layout_index = static_cast<int>(gbuffer_layout);
+			if (ImGui::Combo("G-buffer layout", &gbuffer_layout_index, gbuffer_layout_names, IM_ARRAYSIZE(gbuffer_layout_names)))
+				select_gbuffer_layout(static_cast<GBufferLayout>(gbuffer_layout_index));
+			if (gbuffer_layout == GBufferLayout::Visibility)
+				ImGui::TextDisabled("Material textures are resampled to %dx%d.", constant::visibility_buffer_material_res, constant::visibility_buffer_material_res);
+			if (ImGui::TreeNode("G-buffer budget")) {
+				if (ImGui::BeginTable("G-buffer budget", 5, ImGuiTableFlags_SizingFixedFit)) {
+					ImGui::TableSetupColumn("Layout");
+					ImGui::TableSetupColumn("Storage [B/px]");
+					ImGui::TableSetupColumn("Traffic [B/px]");
+					ImGui::TableSetupColumn("1600x900 [MiB]");
+					ImGui::TableSetupColumn("3840x2160 [MiB]");
+					ImGui::TableHeadersRow();
+
+					for (int layout = 0; layout < toU(GBufferLayout::Count); ++layout) {
+						auto const budget = getGBufferBudget(static_cast<GBufferLayout>(layout));
+						auto const traffic = budget.fill + budget.per_light * static_cast<uint32_t>(lights_nb) + budget.resolve;
+						ImGui::TableNextColumn();
+						ImGui::Text("%s", gbuffer_layout_names[layout]);
+						ImGui::TableNextColumn();
+						ImGui::Text("%u", budget.storage);
+						ImGui::TableNextColumn();
+						ImGui::Text("%u", traffic);
+						ImGui::TableNextColumn();
+						ImGui::Text("%.1f / %.1f", budget.storage * 1600.0f * 900.0f / (1024.0f * 1024.0f), traffic * 1600.0f * 900.0f / (1024.0f * 1024.0f));
+						ImGui::TableNextColumn();
+						ImGui::Text("%.1f / %.1f", budget.storage * 3840.0f * 2160.0f / (1024.0f * 1024.0f), traffic * 3840.0f * 2160.0f / (1024.0f * 1024.0f));
+					}
+
+					ImGui::EndTable();
+				}
+				ImGui::TextDisabled("Traffic is per frame, for %d light(s);\nsizes are given as storage / traffic.", lights_nb);
+				ImGui::TreePop();
+			}
+			if (gbuffer_benchmark.is_running) {
+				ImGui::Text("Benchmarking G-buffer layouts: case %zu of %zu", gbuffer_benchmark.current_case + 1u, gbuffer_benchmark.cases.size());
+			} else if (ImGui::Button("Benchmark G-buffer layouts")) {
+				layout_before_benchmark = gbuffer_layout;
+				lights_nb_before_benchmark = lights_nb;
+				dynamic_resolution_before_benchmark = dynamic_resolution;
+				gbuffer_benchmark = createGBufferBenchmark(is_visibility_buffer_supported);
+			}
+			if (!gbuffer_benchmark.is_running && !gbuffer_benchmark.cases.empty() && ImGui::TreeNode("G-buffer benchmark results")) {
+				if (ImGui::BeginTable("G-buffer benchmark results", 4, ImGuiTableFlags_SizingFixedFit)) {
+					ImGui::TableSetupColumn("Layout");
+					ImGui::TableSetupColumn("Resolution");
+					ImGui::TableSetupColumn("Lights");
+					ImGui::TableSetupColumn("GPU frame time [ms]");
+					ImGui::TableHeadersRow();
+
+					for (auto const& benchmark_case : gbuffer_benchmark.cases) {
+						ImGui::TableNextColumn();
+						ImGui::Text("%s", gbuffer_layout_names[toU(benchmark_case.layout)]);
+						ImGui::TableNextColumn();
+						ImGui::Text("%dx%d", benchmark_case.render_width, benchmark_case.render_height);
+						ImGui::TableNextColumn();
+						ImGui::Text("%d", benchmark_case.lights_nb);
+						ImGui::TableNextColumn();
+						ImGui::Text("%.3f", benchmark_case.mean_gpu_frame_time_ms);
+					}
+
+					ImGui::EndTable();
+				}
+				ImGui::TreePop();
+			}
+			ImGui::Separator();
+			if (ImGui::Combo("Shadow quality", &shadow_quality_preset, shadow_quality_preset_names, IM_ARRAYSIZE(shadow_quality_preset_names)))
+				shadow_settings = shadow_quality_presets[shadow_quality_preset];
+			auto shadow_filtering = static_cast<int>(shadow_settings.filtering);
+			if (ImGui::Combo("Shadow filtering", &shadow_filtering, shadow_filtering_names, IM_ARRAYSIZE(shadow_filtering_names)))
+				shadow_settings.filtering = static_cast<ShadowFiltering>(shadow_filtering);
+			switch (shadow_settings.filtering) {
+				case ShadowFiltering::Reference5x5:
+					ImGui::SliderFloat("Depth bias", &shadow_settings.bias, 0.0f, 0.0005f, "%.5f");
+					break;
+				case ShadowFiltering::HardwarePoisson:
+					ImGui::SliderInt("Poisson taps", &shadow_settings.poisson_taps_nb, 1, 16);
+					ImGui::SliderFloat("Poisson radius (texels)", &shadow_settings.poisson_radius, 0.0f, 4.0f);
+					ImGui::SliderFloat("Depth bias", &shadow_settings.bias, 0.0f, 0.0005f, "%.5f");
+					break;
+				case ShadowFiltering::EVSM:
+					ImGui::SliderFloat2("EVSM exponents", glm::value_ptr(shadow_settings.evsm_exponents), 1.0f, 42.0f);
+					// Fallthrough
+				case ShadowFiltering::VSM:
+					ImGui::SliderInt("Blur passes", &shadow_settings.blur_passes_nb, 0, 4);
+					ImGui::SliderFloat("Light bleeding reduction", &shadow_settings.light_bleeding_reduction, 0.0f, 0.9f);
+					break;
+				default:
+					break;
+			}
+			{
+				// Mean GPU time of all shadow map passes, kept per vertex
+				// stream; the timings restart from scratch when switching,
+				// so each mode only gets measured on its own.
+				auto& current_mean = shadow_maps_mean_gpu_time[use_depth_only_vertex_streams ? 1 : 0];
+				current_mean = 0.0;
+				for (auto const pass : shadow_map_passes)
+					current_mean += render_graph.GetPassStatistics(pass).mean_ms;
+				if (ImGui::Checkbox("Depth-only vertex streams", &use_depth_only_vertex_streams))
+					gpu_timers.ResetStatistics();
+				ImGui::Text("Shadow maps GPU time with all attributes: %.3f ms", shadow_maps_mean_gpu_time[0]);
+				ImGui::Text("Shadow maps GPU time with depth-only VAOs: %.3f ms", shadow_maps_mean_gpu_time[1]);
+			}
+			ImGui::Separator();
 			ImGui::Checkbox("Show basis", &show_basis);
 			ImGui::SliderFloat("Basis thickness scale", &basis_thickness_scale, 0.0f, 100.0f);
 			ImGui::SliderFloat("Basis length scale", &basis_length_scale, 0.0f, 100.0f);
 		}
 		ImGui::End();
 
-		if (show_logs)
-			Log::View::Render();
-		mWindowManager.RenderImGuiFrame(show_gui);
 
-		glEndQuery(GL_TIME_ELAPSED);
-		utils::opengl::debug::endDebugGroup();
+		//
+		// The compact layout accumulates lights with the material already
+		// applied, which cannot be upsampled.
+		//
+		auto const lighting_resolution = gbuffer_layout == GBufferLayout::Compact ? LightingResolution::Full : light_upsampling.resolution;
+		auto const lighting_scale = getLightingScale(lighting_resolution);
+		lighting_width = getScaledSize(render_width, lighting_scale);
+		lighting_height = getScaledSize(render_height, lighting_scale);
+		lighting_render_scale = glm::vec2(static_cast<float>(lighting_width) / static_cast<float>(getScaledSize(framebuffer_width, lighting_scale)),
+		                                  static_cast<float>(lighting_height) / static_cast<float>(getScaledSize(framebuffer_height, lighting_scale)));
 
 		//
-		// Blit the result back to the default framebuffer.
+		// The history follows the size of the light targets, and starts over
+		// when reallocated.
 		//
-		utils::opengl::debug::beginDebugGroup("Copy to default framebuffer");
-		glBeginQuery(GL_TIME_ELAPSED, elapsed_time_queries[toU(ElapsedTimeQuery::CopyToFramebuffer)]);
+		auto const history_width = getScaledSize(framebuffer_width, lighting_scale);
+		auto const history_height = getScaledSize(framebuffer_height, lighting_scale);
+		if (temporal_lighting.is_enabled
+		    && (temporal_lighting_history.width != history_width || temporal_lighting_history.height != history_height)) {
+			deleteTemporalLightingHistory(temporal_lighting_history);
+			temporal_lighting_history = createTemporalLightingHistory(history_width, history_height);
+			state.Invalidate();
+		}
+		lights_interleave = temporal_lighting.is_enabled ? (lights_nb + temporal_lighting.lights_per_pixel - 1) / temporal_lighting.lights_per_pixel : 1;
+
+
+		//
+		// Rebuild the render graph if its structure changed, and run it.
+		//
+		RenderGraphConfiguration configuration;
+		configuration.gbuffer_layout = gbuffer_layout;
+		configuration.lights_nb = lights_nb;
+		configuration.shadow_filtering = shadow_settings.filtering;
+		configuration.blur_passes_nb = shadow_settings.blur_passes_nb;
+		configuration.use_depth_prepass = use_depth_prepass;
+		configuration.lighting_resolution = lighting_resolution;
+		configuration.use_temporal_lighting = temporal_lighting.is_enabled;
+		configuration.show_textures = show_textures;
+		configuration.show_debug_elements = show_cone_wireframe || show_basis;
+		if (!(configuration == render_graph_configuration)) {
+			PROFILE_ZONE("Build render graph");
+			build_render_graph(configuration);
+			render_graph_configuration = configuration;
+		}
 
-		// FBO::Resolve has already been bound to GL_READ_FRAMEBUFFER before rendering the first frame,
-		// as no other frame buffer gets bound to it.
-		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0u);
-		glBlitFramebuffer(0, 0, framebuffer_width, framebuffer_height, 0, 0, framebuffer_width, framebuffer_height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+		render_graph.Execute();
 
-		glEndQuery(GL_TIME_ELAPSED);
-		utils::opengl::debug::endDebugGroup();
+		if (temporal_lighting.is_enabled) {
+			auto& history = temporal_lighting_history;
+			history.previous_view_projection = camera_view_proj_transforms.view_projection;
+			history.previous_render_scale = lighting_render_scale;
+			history.is_valid = !shader_reload_failed;
+			history.current = 1u - history.current;
+			++history.frame_index;
+		}
 
-		glfwSwapBuffers(window);
+		mWindowManager.SwapBuffers(window);
 
-		first_frame = false;
+		if (is_first_frame) {
+			LogInfo("Time to first frame: %.3f s.",
+			        std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - startup_time).count());
+			is_first_frame = false;
+		}
 	}
 
+	GLCallCounters::Get().StopRecording();
+	deleteTemporalLightingHistory(temporal_lighting_history);
+	deleteVisibilityBufferScene(visibility_buffer_scene);
 	glDeleteBuffers(static_cast<GLsizei>(ubos.size()), ubos.data());
-	glDeleteQueries(static_cast<GLsizei>(elapsed_time_queries.size()), elapsed_time_queries.data());
 	glDeleteSamplers(static_cast<GLsizei>(samplers.size()), samplers.data());
-	glDeleteFramebuffers(static_cast<GLsizei>(fbos.size()), fbos.data());
-	glDeleteTextures(static_cast<GLsizei>(textures.size()), textures.data());
-
+	for (auto& queries : shaded_fragments_counters.queries)
+		glDeleteQueries(static_cast<GLsizei>(queries.size()), queries.data());
+	glDeleteQueries(static_cast<GLsizei>(shaded_fragments_counters.gbuffer_queries.size()), shaded_fragments_counters.gbuffer_queries.data());
+
+	glDeleteProgram(temporal_lights_shader);
+	temporal_lights_shader = 0u;
+	glDeleteProgram(downsample_gbuffer_shader);
+	downsample_gbuffer_shader = 0u;
 	glDeleteProgram(resolve_deferred_shader);
 	resolve_deferred_shader = 0u;
+	glDeleteProgram(resolve_visibility_buffer_shader);
+	resolve_visibility_buffer_shader = 0u;
+	glDeleteProgram(fill_visibility_buffer_shader);
+	fill_visibility_buffer_shader = 0u;
+	glDeleteProgram(shadow_blur_shader);
+	shadow_blur_shader = 0u;
+	glDeleteProgram(shadow_moments_shader);
+	shadow_moments_shader = 0u;
 	glDeleteProgram(accumulate_lights_shader);
 	accumulate_lights_shader = 0u;
+	glDeleteProgram(depth_prepass_opaque_shader);
+	depth_prepass_opaque_shader = 0u;
+	glDeleteProgram(depth_prepass_shader);
+	depth_prepass_shader = 0u;
+	glDeleteProgram(fill_shadowmap_opaque_shader);
+	fill_shadowmap_opaque_shader = 0u;
 	glDeleteProgram(fill_shadowmap_shader);
 	fill_shadowmap_shader = 0u;
-	glDeleteProgram(fill_gbuffer_shader);
-	fill_gbuffer_shader = 0u;
 	glDeleteProgram(fallback_shader);
 	fallback_shader = 0u;
 }
@@ -867,45 +2210,175 @@ int main()
 
 namespace
 {
-Textures createTextures(GLsizei framebuffer_width, GLsizei framebuffer_height)
+void updateDynamicResolution(DynamicResolution& dynamic_resolution, float gpu_frame_time_ms, int settle_frames_nb)
 {
-	Textures textures;
-	glGenTextures(static_cast<GLsizei>(textures.size()), textures.data());
+	if (gpu_frame_time_ms <= 0.0f)
+		return;
 
-	glBindTexture(GL_TEXTURE_2D, textures[toU(Texture::DepthBuffer)]);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, framebuffer_width, framebuffer_height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
-	utils::opengl::debug::nameObject(GL_TEXTURE, textures[toU(Texture::DepthBuffer)], "Depth buffer");
+	dynamic_resolution.smoothed_frame_time_ms = dynamic_resolution.smoothed_frame_time_ms > 0.0f
+	                                          ? glm::mix(dynamic_resolution.smoothed_frame_time_ms, gpu_frame_time_ms, 0.2f)
+	                                          : gpu_frame_time_ms;
+
+	if (++dynamic_resolution.frames_since_last_change < settle_frames_nb)
+		return;
 
-	glBindTexture(GL_TEXTURE_2D, textures[toU(Texture::ShadowMap)]);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, constant::shadowmap_res_x, constant::shadowmap_res_y, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
-	utils::opengl::debug::nameObject(GL_TEXTURE, textures[toU(Texture::ShadowMap)], "Shadow map");
+	// Leave some slack around the target to avoid oscillating.
+	auto const ratio = dynamic_resolution.target_frame_time_ms / dynamic_resolution.smoothed_frame_time_ms;
+	if (ratio > 0.95f && ratio < 1.05f)
+		return;
 
-	glBindTexture(GL_TEXTURE_2D, textures[toU(Texture::GBufferDiffuse)]);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, framebuffer_width, framebuffer_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
-	utils::opengl::debug::nameObject(GL_TEXTURE, textures[toU(Texture::GBufferDiffuse)], "GBuffer diffuse");
+	// Most of the cost scales with the amount of pixels, i.e. with the
+	// square of the scale; only go half-way there to stay on the safe side.
+	auto const new_scale = dynamic_resolution.scale * glm::mix(1.0f, std::sqrt(ratio), 0.5f);
+	dynamic_resolution.scale = glm::clamp(new_scale, dynamic_resolution.min_scale, dynamic_resolution.max_scale);
+	dynamic_resolution.frames_since_last_change = 0;
+}
 
-	glBindTexture(GL_TEXTURE_2D, textures[toU(Texture::GBufferSpecular)]);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, framebuffer_width, framebuffer_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
-	utils::opengl::debug::nameObject(GL_TEXTURE, textures[toU(Texture::GBufferSpecular)], "GBuffer specular");
+float getLightingScale(LightingResolution resolution)
+{
+	return 1.0f / static_cast<float>(1u << toU(resolution));
+}
 
-	glBindTexture(GL_TEXTURE_2D, textures[toU(Texture::GBufferWorldSpaceNormal)]);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, framebuffer_width, framebuffer_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
-	utils::opengl::debug::nameObject(GL_TEXTURE, textures[toU(Texture::GBufferWorldSpaceNormal)], "GBuffer normals");
+int getScaledSize(int size, float scale)
+{
+	return std::max(1, static_cast<int>(static_cast<float>(size) * scale));
+}
 
-	glBindTexture(GL_TEXTURE_2D, textures[toU(Texture::LightDiffuseContribution)]);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, framebuffer_width, framebuffer_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
-	utils::opengl::debug::nameObject(GL_TEXTURE, textures[toU(Texture::LightDiffuseContribution)], "Light diffuse contribution");
+TemporalLightingHistory createTemporalLightingHistory(GLsizei width, GLsizei height)
+{
+	TemporalLightingHistory history;
+	history.width = width;
+	history.height = height;
+
+	history.error = bonobo::createTexture(width, height, GL_TEXTURE_2D, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+	utils::opengl::debug::nameObject(GL_TEXTURE, history.error, "Temporal lighting error");
+
+	GLenum const draw_buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3 };
+	for (size_t i = 0; i < 2u; ++i) {
+		auto const suffix = " #" + std::to_string(i);
+		history.light_diffuse[i] = bonobo::createTexture(width, height, GL_TEXTURE_2D, GL_RGBA16F, GL_RGBA, GL_FLOAT);
+		history.light_specular[i] = bonobo::createTexture(width, height, GL_TEXTURE_2D, GL_RGBA16F, GL_RGBA, GL_FLOAT);
+		history.geometry[i] = bonobo::createTexture(width, height, GL_TEXTURE_2D, GL_RGBA32F, GL_RGBA, GL_FLOAT);
+		utils::opengl::debug::nameObject(GL_TEXTURE, history.light_diffuse[i], "Temporal light diffuse contribution" + suffix);
+		utils::opengl::debug::nameObject(GL_TEXTURE, history.light_specular[i], "Temporal light specular contribution" + suffix);
+		utils::opengl::debug::nameObject(GL_TEXTURE, history.geometry[i], "Temporal lighting geometry" + suffix);
+
+		history.framebuffers[i] = bonobo::createFBO({ history.light_diffuse[i], history.light_specular[i], history.geometry[i], history.error });
+		glBindFramebuffer(GL_FRAMEBUFFER, history.framebuffers[i]);
+		glDrawBuffers(4, draw_buffers);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0u);
+		utils::opengl::debug::nameObject(GL_FRAMEBUFFER, history.framebuffers[i], "Temporal lighting" + suffix);
+	}
 
-	glBindTexture(GL_TEXTURE_2D, textures[toU(Texture::LightSpecularContribution)]);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, framebuffer_width, framebuffer_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
-	utils::opengl::debug::nameObject(GL_TEXTURE, textures[toU(Texture::LightSpecularContribution)], "Light specular contribution");
+	return history;
+}
 
-	glBindTexture(GL_TEXTURE_2D, textures[toU(Texture::Result)]);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, framebuffer_width, framebuffer_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
-	utils::opengl::debug::nameObject(GL_TEXTURE, textures[toU(Texture::Result)], "Final result");
+void deleteTemporalLightingHistory(TemporalLightingHistory& history)
+{
+	glDeleteFramebuffers(static_cast<GLsizei>(history.framebuffers.size()), history.framebuffers.data());
+	glDeleteTextures(static_cast<GLsizei>(history.light_diffuse.size()), history.light_diffuse.data());
+	glDeleteTextures(static_cast<GLsizei>(history.light_specular.size()), history.light_specular.data());
+	glDeleteTextures(static_cast<GLsizei>(history.geometry.size()), history.geometry.data());
+	glDeleteTextures(1, &history.error);
+	history = TemporalLightingHistory();
+}
 
-	glBindTexture(GL_TEXTURE_2D, 0u);
-	return textures;
+glm::ivec4 computeLightScissor(glm::mat4 const& cone_model_to_clip, int viewport_width, int viewport_height)
+{
+	// The cone spans [-1, 1] along X and Y, and [-1, 0] along Z, in model
+	// space.
+	auto min_ndc = glm::vec2(std::numeric_limits<float>::max());
+	auto max_ndc = glm::vec2(std::numeric_limits<float>::lowest());
+	for (int i = 0; i < 8; ++i) {
+		auto const corner = glm::vec4((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? -1.0f : 0.0f, 1.0f);
+		auto const clip_corner = cone_model_to_clip * corner;
+		if (clip_corner.w <= 0.0f)
+			return glm::ivec4(0, 0, viewport_width, viewport_height);
+
+		auto const ndc_corner = glm::vec2(clip_corner) / clip_corner.w;
+		min_ndc = glm::min(min_ndc, ndc_corner);
+		max_ndc = glm::max(max_ndc, ndc_corner);
+	}
+
+	auto const viewport_size = glm::vec2(static_cast<float>(viewport_width), static_cast<float>(viewport_height));
+	auto const min_pixel = glm::ivec2(glm::floor((glm::clamp(min_ndc, -1.0f, 1.0f) * 0.5f + 0.5f) * viewport_size));
+	auto const max_pixel = glm::ivec2(glm::ceil((glm::clamp(max_ndc, -1.0f, 1.0f) * 0.5f + 0.5f) * viewport_size));
+	return glm::ivec4(min_pixel.x, min_pixel.y,
+	                  std::max(max_pixel.x - min_pixel.x, 0), std::max(max_pixel.y - min_pixel.y, 0));
+}
+
+ShadedFragmentsCounters createShadedFragmentsCounters()
+{
+	ShadedFragmentsCounters counters;
+	for (size_t frame = 0; frame < ShadedFragmentsCounters::latency_frames_nb; ++frame) {
+		glGenQueries(static_cast<GLsizei>(constant::lights_nb), counters.queries[frame].data());
+		counters.issued_with[frame].fill(LightVolumeCulling::Count);
+	}
+	for (auto& counts : counters.last_counts)
+		counts.fill(0u);
+	glGenQueries(static_cast<GLsizei>(counters.gbuffer_queries.size()), counters.gbuffer_queries.data());
+	counters.gbuffer_issued_with.fill(-1);
+	counters.gbuffer_last_counts.fill(0u);
+	return counters;
+}
+
+void advanceShadedFragmentsCounters(ShadedFragmentsCounters& counters)
+{
+	counters.current_frame = (counters.current_frame + 1u) % ShadedFragmentsCounters::latency_frames_nb;
+
+	auto& queries = counters.queries[counters.current_frame];
+	auto& issued_with = counters.issued_with[counters.current_frame];
+	for (size_t i = 0; i < constant::lights_nb; ++i) {
+		if (issued_with[i] == LightVolumeCulling::Count)
+			continue;
+
+		GLint is_available = GL_FALSE;
+		glGetQueryObjectiv(queries[i], GL_QUERY_RESULT_AVAILABLE, &is_available);
+		if (is_available != GL_FALSE)
+			glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &counters.last_counts[toU(issued_with[i])][i]);
+		issued_with[i] = LightVolumeCulling::Count;
+	}
+
+	auto& gbuffer_issued_with = counters.gbuffer_issued_with[counters.current_frame];
+	if (gbuffer_issued_with >= 0) {
+		auto const query = counters.gbuffer_queries[counters.current_frame];
+		GLint is_available = GL_FALSE;
+		glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &is_available);
+		if (is_available != GL_FALSE)
+			glGetQueryObjectui64v(query, GL_QUERY_RESULT, &counters.gbuffer_last_counts[gbuffer_issued_with]);
+		gbuffer_issued_with = -1;
+	}
+}
+
+GBufferBudget getGBufferBudget(GBufferLayout layout)
+{
+	// Depth (D24S8) and the final result (RGBA8) are shared by all layouts.
+	GBufferBudget budget;
+	switch (layout) {
+		case GBufferLayout::Reference:
+			budget.storage   = 4u /* depth */ + 3u * 4u /* diffuse, specular, normal */ + 2u * 4u /* light diffuse & specular */ + 4u /* result */;
+			budget.fill      = 4u /* depth */ + 3u * 4u;
+			budget.per_light = 4u /* depth */ + 4u /* normal */ + 2u * (4u + 4u) /* blended light targets */;
+			budget.resolve   = 4u * 4u + 4u;
+			break;
+		case GBufferLayout::Compact:
+			budget.storage   = 4u /* depth */ + 4u /* diffuse + specular */ + 4u /* normal */ + 4u /* light */ + 4u /* result */;
+			budget.fill      = 4u /* depth */ + 2u * 4u;
+			budget.per_light = 4u /* depth */ + 4u /* normal */ + 4u /* diffuse */ + (4u + 4u) /* blended light target */;
+			budget.resolve   = 2u * 4u + 4u;
+			break;
+		case GBufferLayout::Visibility:
+			// The compute pass reads the triangle IDs and writes the
+			// reference targets, once per pixel.
+			budget.storage   = 4u /* depth */ + 4u /* triangle IDs */ + 3u * 4u + 2u * 4u + 4u;
+			budget.fill      = 4u /* depth */ + 4u + (4u + 3u * 4u) /* compute pass */;
+			budget.per_light = 4u /* depth */ + 4u /* normal */ + 2u * (4u + 4u) /* blended light targets */;
+			budget.resolve   = 4u * 4u + 4u;
+			break;
+		default:
+			break;
+	}
+	return budget;
 }
 
 Samplers createSamplers()
@@ -928,185 +2401,306 @@ Samplers createSamplers()
 	glSamplerParameteri(samplers[toU(Sampler::Mipmaps)], GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	utils::opengl::debug::nameObject(GL_SAMPLER, samplers[toU(Sampler::Mipmaps)], "Mimaps");
 
+	// For hardware depth comparisons against a shadow map; the comparison
+	// results of the 2x2 footprint are bilinearly filtered.
+	glSamplerParameteri(samplers[toU(Sampler::ShadowCompare)], GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glSamplerParameteri(samplers[toU(Sampler::ShadowCompare)], GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glSamplerParameteri(samplers[toU(Sampler::ShadowCompare)], GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glSamplerParameteri(samplers[toU(Sampler::ShadowCompare)], GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	glSamplerParameteri(samplers[toU(Sampler::ShadowCompare)], GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glSamplerParameteri(samplers[toU(Sampler::ShadowCompare)], GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	utils::opengl::debug::nameObject(GL_SAMPLER, samplers[toU(Sampler::ShadowCompare)], "Shadow compare");
+
+	// For sampling prefiltered shadow moments.
+	glSamplerParameteri(samplers[toU(Sampler::ShadowMoments)], GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glSamplerParameteri(samplers[toU(Sampler::ShadowMoments)], GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glSamplerParameteri(samplers[toU(Sampler::ShadowMoments)], GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glSamplerParameteri(samplers[toU(Sampler::ShadowMoments)], GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	utils::opengl::debug::nameObject(GL_SAMPLER, samplers[toU(Sampler::ShadowMoments)], "Shadow moments");
+
 	return samplers;
 }
 
-FBOs createFramebufferObjects(Textures const& textures)
+UBOs createUniformBufferObjects()
 {
-	auto const validate_fbo = [](std::string const& fbo_name){
-		auto const status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-		if (status == GL_FRAMEBUFFER_COMPLETE)
-			return;
+	UBOs ubos;
+	glGenBuffers(static_cast<GLsizei>(ubos.size()), ubos.data());
 
-		LogError("Framebuffer \"%s\" is not complete: check the logs for additional information.", fbo_name.data());
-	};
+	glBindBuffer(GL_UNIFORM_BUFFER, ubos[toU(UBO::CameraViewProjTransforms)]);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(ViewProjTransforms), nullptr, GL_STREAM_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, ShaderReflection::GetBlockBinding(GL_UNIFORM_BLOCK, "CameraViewProjTransforms"), ubos[toU(UBO::CameraViewProjTransforms)]);
+	utils::opengl::debug::nameObject(GL_BUFFER, ubos[toU(UBO::CameraViewProjTransforms)], "Camera view-projection transforms");
 
-	FBOs fbos;
-	glGenFramebuffers(static_cast<GLsizei>(fbos.size()), fbos.data());
-
-	glBindFramebuffer(GL_FRAMEBUFFER, fbos[toU(FBO::GBuffer)]);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[toU(Texture::GBufferDiffuse)], 0);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, textures[toU(Texture::GBufferSpecular)], 0);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, textures[toU(Texture::GBufferWorldSpaceNormal)], 0);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, textures[toU(Texture::DepthBuffer)], 0);
-	glReadBuffer(GL_NONE); // Disable reading back from the colour attachments, as unnecessary in this assignment.
-	// Configure the mapping from fragment shader outputs to colour attachments.
-	std::array<GLenum, 3> const gbuffer_draws = {
-		GL_COLOR_ATTACHMENT0, // The fragment shader output at location 0 will be written to colour attachment 0 (i.e. the diffuse texture).
-		GL_COLOR_ATTACHMENT1, // The fragment shader output at location 1 will be written to colour attachment 1 (i.e. the specular texture).
-		GL_COLOR_ATTACHMENT2  // The fragment shader output at location 2 will be written to colour attachment 2 (i.e. the normal texture).
-	};
-	glDrawBuffers(static_cast<GLsizei>(gbuffer_draws.size()), gbuffer_draws.data());
-	validate_fbo("GBuffer");
-	utils::opengl::debug::nameObject(GL_FRAMEBUFFER, fbos[toU(FBO::GBuffer)], "GBuffer");
-
-	glBindFramebuffer(GL_FRAMEBUFFER, fbos[toU(FBO::ShadowMap)]);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, textures[toU(Texture::ShadowMap)], 0);
-	validate_fbo("Shadow map generation");
-	utils::opengl::debug::nameObject(GL_FRAMEBUFFER, fbos[toU(FBO::ShadowMap)], "Shadow map generation");
-
-	glBindFramebuffer(GL_FRAMEBUFFER, fbos[toU(FBO::LightAccumulation)]);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[toU(Texture::LightDiffuseContribution)], 0);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, textures[toU(Texture::LightSpecularContribution)], 0);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, textures[toU(Texture::DepthBuffer)], 0);
-	glReadBuffer(GL_NONE); // Disable reading back from the colour attachments, as unnecessary in this assignment.
-	// Configure the mapping from fragment shader outputs to colour attachments.
-	std::array<GLenum, 2> const light_accumulation_draws = {
-		GL_COLOR_ATTACHMENT0, // The fragment shader output at location 0 will be written to colour attachment 0 (i.e. the light diffuse contribution texture).
-		GL_COLOR_ATTACHMENT1  // The fragment shader output at location 1 will be written to colour attachment 1 (i.e. the light specular contribution texture).
-	};
-	glDrawBuffers(static_cast<GLsizei>(light_accumulation_draws.size()), light_accumulation_draws.data());
-	validate_fbo("Light accumulation");
-	utils::opengl::debug::nameObject(GL_FRAMEBUFFER, fbos[toU(FBO::LightAccumulation)], "Light acccumulation");
-
-	glBindFramebuffer(GL_FRAMEBUFFER, fbos[toU(FBO::Resolve)]);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[toU(Texture::Result)], 0);
-	glReadBuffer(GL_COLOR_ATTACHMENT0); // Colour attachment result 0 (i.e. the rendering result texture) will be blitted to the screen.
-	glDrawBuffer(GL_COLOR_ATTACHMENT0); // The fragment shader output at location 0 will be written to colour attachment 0 (i.e. the rendering result texture).
-	validate_fbo("Resolve");
-	utils::opengl::debug::nameObject(GL_FRAMEBUFFER, fbos[toU(FBO::Resolve)], "Resolve");
-
-	glBindFramebuffer(GL_FRAMEBUFFER, fbos[toU(FBO::FinalWithDepth)]);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[toU(Texture::Result)], 0);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, textures[toU(Texture::DepthBuffer)], 0);
-	glReadBuffer(GL_NONE); // Disable reading back from the colour attachments, as unnecessary in this assignment.
-	glDrawBuffer(GL_COLOR_ATTACHMENT0); // The fragment shader output at location 0 will be written to colour attachment 0 (i.e. the rendering result texture).
-	validate_fbo("Final with depth");
-	utils::opengl::debug::nameObject(GL_FRAMEBUFFER, fbos[toU(FBO::FinalWithDepth)], "Cone wireframe");
-
-	glBindFramebuffer(GL_FRAMEBUFFER, 0u);
-	return fbos;
+	glBindBuffer(GL_UNIFORM_BUFFER, ubos[toU(UBO::LightViewProjTransforms)]);
+	glBufferData(GL_UNIFORM_BUFFER, constant::lights_nb * sizeof(ViewProjTransforms), nullptr, GL_STREAM_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, ShaderReflection::GetBlockBinding(GL_UNIFORM_BLOCK, "LightViewProjTransforms"), ubos[toU(UBO::LightViewProjTransforms)]);
+	utils::opengl::debug::nameObject(GL_BUFFER, ubos[toU(UBO::LightViewProjTransforms)], "Light view-projection transforms");
+
+	glBindBuffer(GL_UNIFORM_BUFFER, 0u);
+	return ubos;
 }
 
-ElapsedTimeQueries createElapsedTimeQueries()
+std::uint32_t getMaterialFeatures(GeometryTextureData const& texture_data)
 {
-	ElapsedTimeQueries queries;
-	glGenQueries(static_cast<GLsizei>(queries.size()), queries.data());
+	std::uint32_t features = 0u;
+	if (texture_data.diffuse_texture_id != 0u)
+		features |= MaterialFeatureDiffuseTexture;
+	if (texture_data.specular_texture_id != 0u)
+		features |= MaterialFeatureSpecularTexture;
+	if (texture_data.normals_texture_id != 0u)
+		features |= MaterialFeatureNormalsTexture;
+	if (texture_data.opacity_texture_id != 0u)
+		features |= MaterialFeatureOpacityTexture;
+	return features;
+}
 
-	if (utils::opengl::debug::isSupported())
-	{
-		// Queries (like any other OpenGL object) need to have been used at least
-		// once to ensure their resources have been allocated so we can call
-		// `glObjectLabel()` on them.
-		auto const register_query = [](GLuint const query) {
-			glBeginQuery(GL_TIME_ELAPSED, query);
-			glEndQuery(GL_TIME_ELAPSED);
-		};
+VisibilityBufferScene createVisibilityBufferScene(std::vector<bonobo::mesh_data> const& geometry,
+                                                  std::vector<GeometryTextureData> const& texture_data)
+{
+	VisibilityBufferScene scene;
+	scene.first_triangles.resize(geometry.size(), 0u);
+	scene.is_packed.resize(geometry.size(), false);
+
+	// One layer per distinct material texture.
+	std::map<GLuint, int32_t> material_layers;
+	auto const get_layer = [&material_layers](GLuint texture){
+		if (texture == 0u)
+			return -1;
+		return material_layers.emplace(texture, static_cast<int32_t>(material_layers.size())).first->second;
+	};
 
-		register_query(queries[toU(ElapsedTimeQuery::GbufferGeneration)]);
-		utils::opengl::debug::nameObject(GL_QUERY, queries[toU(ElapsedTimeQuery::GbufferGeneration)], "GBuffer generation");
+	std::vector<VisibilityBufferMesh> meshes;
+	GLuint triangles_nb = 0u;
+	GLuint indices_nb = 0u;
+	for (std::size_t i = 0; i < geometry.size(); ++i) {
+		auto const& mesh = geometry[i];
+		if (mesh.ibo == 0u || mesh.drawing_mode != GL_TRIANGLES) {
+			LogWarning("Mesh \"%s\" is not an indexed triangle list, and is left out of the visibility buffer.", mesh.name.c_str());
+			continue;
+		}
 
-		for (size_t i = 0; i < constant::lights_nb; ++i)
-		{
-			register_query(queries[toU(ElapsedTimeQuery::ShadowMap0Generation) + i]);
-			utils::opengl::debug::nameObject(GL_QUERY, queries[toU(ElapsedTimeQuery::ShadowMap0Generation) + i], "Shadow map " + std::to_string(i) + " generation");
+		VisibilityBufferMesh record;
+		record.first_triangle = triangles_nb;
+		record.first_index = indices_nb;
+		record.first_vertex = scene.vertices_nb;
+		record.diffuse_layer = get_layer(texture_data[i].diffuse_texture_id);
+		record.specular_layer = get_layer(texture_data[i].specular_texture_id);
+		record.normals_layer = get_layer(texture_data[i].normals_texture_id);
+		meshes.push_back(record);
+
+		scene.first_triangles[i] = triangles_nb;
+		scene.is_packed[i] = true;
+		triangles_nb += static_cast<GLuint>(mesh.indices_nb) / 3u;
+		indices_nb += static_cast<GLuint>(mesh.indices_nb);
+		scene.vertices_nb += static_cast<GLuint>(mesh.vertices_nb);
+	}
+	if (meshes.empty()) {
+		LogError("No mesh could be packed for the visibility buffer.");
+		return scene;
+	}
 
-			register_query(queries[toU(ElapsedTimeQuery::Light0Accumulation) + i]);
-			utils::opengl::debug::nameObject(GL_QUERY, queries[toU(ElapsedTimeQuery::Light0Accumulation) + i], "Light" + std::to_string(i) + " accumulation");
+	glGenBuffers(1, &scene.meshes);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, scene.meshes);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(meshes.size() * sizeof(VisibilityBufferMesh)), meshes.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0u);
+	utils::opengl::debug::nameObject(GL_BUFFER, scene.meshes, "Visibility buffer meshes");
+
+	//
+	// Copy the indices and vertex attributes of all meshes, without going
+	// through the CPU. The location of each attribute within the buffer of
+	// a mesh is retrieved from its VAO; missing ones are left to 0.
+	//
+	glGenBuffers(1, &scene.indices);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, scene.indices);
+	glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(indices_nb * sizeof(GLuint)), nullptr, GL_STATIC_DRAW);
+	for (std::size_t i = 0, mesh_index = 0; i < geometry.size(); ++i) {
+		if (!scene.is_packed[i])
+			continue;
+		glBindBuffer(GL_COPY_READ_BUFFER, geometry[i].ibo);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0,
+		                    static_cast<GLintptr>(meshes[mesh_index++].first_index * sizeof(GLuint)),
+		                    static_cast<GLsizeiptr>(geometry[i].indices_nb * sizeof(GLuint)));
+	}
+	utils::opengl::debug::nameObject(GL_BUFFER, scene.indices, "Visibility buffer indices");
+
+	auto const packed_attributes = { bonobo::shader_bindings::vertices, bonobo::shader_bindings::normals,
+	                                 bonobo::shader_bindings::texcoords, bonobo::shader_bindings::tangents,
+	                                 bonobo::shader_bindings::binormals };
+	auto const attribute_size = static_cast<GLsizeiptr>(scene.vertices_nb * sizeof(glm::vec3));
+	glGenBuffers(1, &scene.attributes);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, scene.attributes);
+	glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(packed_attributes.size()) * attribute_size, nullptr, GL_STATIC_DRAW);
+	glClearBufferData(GL_COPY_WRITE_BUFFER, GL_R32F, GL_RED, GL_FLOAT, nullptr);
+	for (std::size_t i = 0, mesh_index = 0; i < geometry.size(); ++i) {
+		if (!scene.is_packed[i])
+			continue;
+		auto const& mesh = geometry[i];
+		auto const first_vertex = meshes[mesh_index++].first_vertex;
+
+		glBindVertexArray(mesh.vao);
+		GLintptr section_offset = 0;
+		for (auto const attribute : packed_attributes) {
+			auto const index = static_cast<GLuint>(attribute);
+			GLint is_enabled = GL_FALSE, components_nb = 0, type = 0, stride = 0, buffer = 0;
+			GLvoid* pointer = nullptr;
+			glGetVertexAttribiv(index, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &is_enabled);
+			glGetVertexAttribiv(index, GL_VERTEX_ATTRIB_ARRAY_SIZE, &components_nb);
+			glGetVertexAttribiv(index, GL_VERTEX_ATTRIB_ARRAY_TYPE, &type);
+			glGetVertexAttribiv(index, GL_VERTEX_ATTRIB_ARRAY_STRIDE, &stride);
+			glGetVertexAttribiv(index, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &buffer);
+			glGetVertexAttribPointerv(index, GL_VERTEX_ATTRIB_ARRAY_POINTER, &pointer);
+
+			auto const is_tightly_packed_vec3 = components_nb == 3 && type == GL_FLOAT
+			                                 && (stride == 0 || stride == static_cast<GLint>(sizeof(glm::vec3)));
+			if (is_enabled != GL_FALSE && buffer != 0 && is_tightly_packed_vec3) {
+				glBindBuffer(GL_COPY_READ_BUFFER, static_cast<GLuint>(buffer));
+				glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, reinterpret_cast<GLintptr>(pointer),
+				                    section_offset + static_cast<GLintptr>(first_vertex * sizeof(glm::vec3)),
+				                    static_cast<GLsizeiptr>(mesh.vertices_nb * sizeof(glm::vec3)));
+			} else if (is_enabled != GL_FALSE) {
+				LogWarning("Attribute %u of mesh \"%s\" is not made of tightly packed 3-D floats, and is left out of the visibility buffer.", index, mesh.name.c_str());
+			}
+			section_offset += attribute_size;
 		}
+	}
+	glBindVertexArray(0u);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0u);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0u);
+	utils::opengl::debug::nameObject(GL_BUFFER, scene.attributes, "Visibility buffer attributes");
 
-		register_query(queries[toU(ElapsedTimeQuery::Resolve)]);
-		utils::opengl::debug::nameObject(GL_QUERY, queries[toU(ElapsedTimeQuery::Resolve)], "Resolve");
+	//
+	// Resample the material textures into the layers of an array texture,
+	// by blitting each one of them.
+	//
+	auto const layers_nb = std::max<GLsizei>(static_cast<GLsizei>(material_layers.size()), 1);
+	auto const levels_nb = static_cast<GLsizei>(std::log2(constant::visibility_buffer_material_res)) + 1;
+	glGenTextures(1, &scene.material_textures);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, scene.material_textures);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels_nb, GL_RGBA8, constant::visibility_buffer_material_res, constant::visibility_buffer_material_res, layers_nb);
+
+	GLuint framebuffers[2] = { 0u, 0u };
+	glGenFramebuffers(2, framebuffers);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffers[0]);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffers[1]);
+	for (auto const& material_layer : material_layers) {
+		GLint width = 0, height = 0;
+		glBindTexture(GL_TEXTURE_2D, material_layer.first);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+
+		glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, material_layer.first, 0);
+		glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, scene.material_textures, 0, material_layer.second);
+		glBlitFramebuffer(0, 0, width, height,
+		                  0, 0, constant::visibility_buffer_material_res, constant::visibility_buffer_material_res,
+		                  GL_COLOR_BUFFER_BIT, GL_LINEAR);
+	}
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0u);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0u);
+	glDeleteFramebuffers(2, framebuffers);
+	glBindTexture(GL_TEXTURE_2D, 0u);
 
-		register_query(queries[toU(ElapsedTimeQuery::ConeWireframe)]);
-		utils::opengl::debug::nameObject(GL_QUERY, queries[toU(ElapsedTimeQuery::ConeWireframe)], "Cone wireframe");
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0u);
+	utils::opengl::debug::nameObject(GL_TEXTURE, scene.material_textures, "Visibility buffer materials");
 
-		register_query(queries[toU(ElapsedTimeQuery::GUI)]);
-		utils::opengl::debug::nameObject(GL_QUERY, queries[toU(ElapsedTimeQuery::GUI)], "GUI");
-	}
+	LogInfo("Visibility buffer: %zu meshes, %u triangles, %u vertices and %zu material textures packed.",
+	        meshes.size(), triangles_nb, scene.vertices_nb, material_layers.size());
 
-	return queries;
+	return scene;
 }
 
-UBOs createUniformBufferObjects()
+void deleteVisibilityBufferScene(VisibilityBufferScene& scene)
 {
-	UBOs ubos;
-	glGenBuffers(static_cast<GLsizei>(ubos.size()), ubos.data());
-
-	glBindBuffer(GL_UNIFORM_BUFFER, ubos[toU(UBO::CameraViewProjTransforms)]);
-	glBufferData(GL_UNIFORM_BUFFER, sizeof(ViewProjTransforms), nullptr, GL_STREAM_DRAW);
-	glBindBufferBase(GL_UNIFORM_BUFFER, toU(UBO::CameraViewProjTransforms), ubos[toU(UBO::CameraViewProjTransforms)]);
-	utils::opengl::debug::nameObject(GL_BUFFER, ubos[toU(UBO::CameraViewProjTransforms)], "Camera view-projection transforms");
-
-	glBindBuffer(GL_UNIFORM_BUFFER, ubos[toU(UBO::LightViewProjTransforms)]);
-	glBufferData(GL_UNIFORM_BUFFER, constant::lights_nb * sizeof(ViewProjTransforms), nullptr, GL_STREAM_DRAW);
-	glBindBufferBase(GL_UNIFORM_BUFFER, toU(UBO::LightViewProjTransforms), ubos[toU(UBO::LightViewProjTransforms)]);
-	utils::opengl::debug::nameObject(GL_BUFFER, ubos[toU(UBO::LightViewProjTransforms)], "Light view-projection transforms");
+	glDeleteBuffers(1, &scene.meshes);
+	glDeleteBuffers(1, &scene.indices);
+	glDeleteBuffers(1, &scene.attributes);
+	glDeleteTextures(1, &scene.material_textures);
+	scene = VisibilityBufferScene();
+}
 
-	glBindBuffer(GL_UNIFORM_BUFFER, 0u);
-	return ubos;
+GBufferBenchmark createGBufferBenchmark(bool include_visibility_buffer)
+{
+	GBufferBenchmark benchmark;
+	for (auto const layout : { GBufferLayout::Reference, GBufferLayout::Compact, GBufferLayout::Visibility }) {
+		if (layout == GBufferLayout::Visibility && !include_visibility_buffer)
+			continue;
+
+		for (auto const scale : { 0.5f, 0.75f, 1.0f }) {
+			for (auto const lights_nb : { 1, 2, static_cast<int>(constant::lights_nb) }) {
+				GBufferBenchmark::Case benchmark_case;
+				benchmark_case.layout = layout;
+				benchmark_case.scale = scale;
+				benchmark_case.lights_nb = lights_nb;
+				benchmark.cases.push_back(benchmark_case);
+			}
+		}
+	}
+	benchmark.is_running = !benchmark.cases.empty();
+	return benchmark;
 }
 
-void fillGBufferShaderLocations(GLuint gbuffer_shader, GBufferShaderLocations& locations)
+void advanceGBufferBenchmark(GBufferBenchmark& benchmark, double gpu_frame_time_ms, int render_width, int render_height)
 {
-	locations.ubo_CameraViewProjTransforms = glGetUniformBlockIndex(gbuffer_shader, "CameraViewProjTransforms");
-	locations.vertex_model_to_world = glGetUniformLocation(gbuffer_shader, "vertex_model_to_world");
-	locations.normal_model_to_world = glGetUniformLocation(gbuffer_shader, "normal_model_to_world");
-	locations.diffuse_texture = glGetUniformLocation(gbuffer_shader, "diffuse_texture");
-	locations.specular_texture = glGetUniformLocation(gbuffer_shader, "specular_texture");
-	locations.normals_texture = glGetUniformLocation(gbuffer_shader, "normals_texture");
-	locations.opacity_texture = glGetUniformLocation(gbuffer_shader, "opacity_texture");
-	locations.has_diffuse_texture = glGetUniformLocation(gbuffer_shader, "has_diffuse_texture");
-	locations.has_specular_texture = glGetUniformLocation(gbuffer_shader, "has_specular_texture");
-	locations.has_normals_texture = glGetUniformLocation(gbuffer_shader, "has_normals_texture");
-	locations.has_opacity_texture = glGetUniformLocation(gbuffer_shader, "has_opacity_texture");
-
-	glUniformBlockBinding(gbuffer_shader, locations.ubo_CameraViewProjTransforms, toU(UBO::CameraViewProjTransforms));
+	if (!benchmark.is_running)
+		return;
+
+	if (benchmark.current_frame >= GBufferBenchmark::warmup_frames_nb)
+		benchmark.accumulated_gpu_frame_time_ms += gpu_frame_time_ms;
+	if (++benchmark.current_frame < GBufferBenchmark::warmup_frames_nb + GBufferBenchmark::measured_frames_nb)
+		return;
+
+	auto& current_case = benchmark.cases[benchmark.current_case];
+	current_case.render_width = render_width;
+	current_case.render_height = render_height;
+	current_case.mean_gpu_frame_time_ms = benchmark.accumulated_gpu_frame_time_ms / GBufferBenchmark::measured_frames_nb;
 
+	benchmark.current_frame = 0;
+	benchmark.accumulated_gpu_frame_time_ms = 0.0;
+	if (++benchmark.current_case == benchmark.cases.size())
+		benchmark.is_running = false;
 }
 
-void fillShadowmapShaderLocations(GLuint shadowmap_shader, FillShadowmapShaderLocations& locations)
+bool exportGBufferBenchmark(GBufferBenchmark const& benchmark, std::string const& filename)
 {
-	locations.ubo_LightViewProjTransforms = glGetUniformBlockIndex(shadowmap_shader, "LightViewProjTransforms");
-	locations.light_index = glGetUniformLocation(shadowmap_shader, "light_index");
-	locations.vertex_model_to_world = glGetUniformLocation(shadowmap_shader, "vertex_model_to_world");
-	locations.opacity_texture = glGetUniformLocation(shadowmap_shader, "opacity_texture");
-	locations.has_opacity_texture = glGetUniformLocation(shadowmap_shader, "has_opacity_texture");
+	std::ofstream file(filename);
+	if (!file) {
+		LogError("Failed to open \"%s\" for writing the G-buffer benchmark.", filename.c_str());
+		return false;
+	}
+
+	file << "layout,scale,width,height,lights,mean_gpu_frame_time_ms\n";
+	for (auto const& benchmark_case : benchmark.cases) {
+		file << '"' << gbuffer_layout_names[toU(benchmark_case.layout)] << "\","
+		     << benchmark_case.scale << ','
+		     << benchmark_case.render_width << ','
+		     << benchmark_case.render_height << ','
+		     << benchmark_case.lights_nb << ','
+		     << benchmark_case.mean_gpu_frame_time_ms << '\n';
+	}
 
-	glUniformBlockBinding(shadowmap_shader, locations.ubo_LightViewProjTransforms, toU(UBO::LightViewProjTransforms));
+	LogInfo("G-buffer benchmark exported to \"%s\".", filename.c_str());
+	return true;
 }
 
-void fillAccumulateLightsShaderLocations(GLuint accumulate_lights_shader, AccumulateLightsShaderLocations& locations)
+FlythroughBenchmark createDefaultFlythrough()
 {
-	locations.ubo_CameraViewProjTransforms = glGetUniformBlockIndex(accumulate_lights_shader, "CameraViewProjTransforms");
-	locations.ubo_LightViewProjTransforms = glGetUniformBlockIndex(accumulate_lights_shader, "LightViewProjTransforms");
-	locations.light_index = glGetUniformLocation(accumulate_lights_shader, "light_index");
-	locations.vertex_model_to_world = glGetUniformLocation(accumulate_lights_shader, "vertex_model_to_world");
-	locations.vertex_world_to_clip = glGetUniformLocation(accumulate_lights_shader, "vertex_world_to_clip");
-	locations.vertex_clip_to_world = glGetUniformLocation(accumulate_lights_shader, "vertex_clip_to_world");
-	locations.depth_texture = glGetUniformLocation(accumulate_lights_shader, "depth_texture");
-	locations.normal_texture = glGetUniformLocation(accumulate_lights_shader, "normal_texture");
-	locations.shadow_texture = glGetUniformLocation(accumulate_lights_shader, "shadow_texture");
-	locations.camera_position = glGetUniformLocation(accumulate_lights_shader, "camera_position");
-	locations.inverse_screen_resolution = glGetUniformLocation(accumulate_lights_shader, "inverse_screen_resolution");
-	locations.light_color = glGetUniformLocation(accumulate_lights_shader, "light_color");
-	locations.light_position = glGetUniformLocation(accumulate_lights_shader, "light_position");
-	locations.light_direction = glGetUniformLocation(accumulate_lights_shader, "light_direction");
-	locations.light_intensity = glGetUniformLocation(accumulate_lights_shader, "light_intensity");
-	locations.light_angle_falloff = glGetUniformLocation(accumulate_lights_shader, "light_angle_falloff");
-
-	glUniformBlockBinding(accumulate_lights_shader, locations.ubo_CameraViewProjTransforms, toU(UBO::CameraViewProjTransforms));
-	glUniformBlockBinding(accumulate_lights_shader, locations.ubo_LightViewProjTransforms, toU(UBO::LightViewProjTransforms));
+	// Positions are given in metres.
+	std::array<FlythroughBenchmark::Keyframe, 6> const keyframes = {{
+		{ glm::vec3(-9.0f, 1.8f,  0.0f), glm::vec3( 1.0f,  0.0f,  0.0f) },
+		{ glm::vec3(-4.5f, 2.5f,  0.6f), glm::vec3( 1.0f, -0.1f, -0.2f) },
+		{ glm::vec3( 0.0f, 4.0f,  0.0f), glm::vec3( 1.0f, -0.3f,  0.0f) },
+		{ glm::vec3( 4.5f, 2.5f, -0.6f), glm::vec3( 1.0f, -0.1f,  0.2f) },
+		{ glm::vec3( 9.0f, 1.8f,  0.0f), glm::vec3( 0.2f,  0.0f,  1.0f) },
+		{ glm::vec3( 4.5f, 1.8f,  0.0f), glm::vec3(-1.0f,  0.0f,  0.0f) },
+	}};
+
+	FlythroughBenchmark flythrough;
+	for (auto keyframe : keyframes) {
+		keyframe.position *= constant::scale_lengths;
+		keyframe.front = glm::normalize(keyframe.front);
+		flythrough.AddKeyframe(keyframe);
+	}
+	return flythrough;
 }
 
 bonobo::mesh_data
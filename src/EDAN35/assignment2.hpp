@@ -2,8 +2,13 @@
 
 #include "core/InputHandler.h"
 #include "core/FPSCamera.h"
+#include "core/helpers.hpp"
 #include "core/WindowManager.hpp"
 
+#include <chrono>
+#include <future>
+#include <memory>
+
 
 class Window;
 
@@ -16,7 +21,8 @@ namespace edan35
 		//! \brief Default constructor.
 		//!
 		//! It will initialise various modules of bonobo and retrieve a
-		//! window to draw to.
+		//! window to draw to, while Sponza starts loading in the
+		//! background.
 		Assignment2(WindowManager& windowManager);
 
 		//! \brief Default destructor.
@@ -34,5 +40,8 @@ namespace edan35
 		InputHandler   inputHandler;
 		WindowManager& mWindowManager;
 		GLFWwindow*    window;
+
+		std::chrono::high_resolution_clock::time_point      startup_time;
+		std::future<std::shared_ptr<bonobo::scene_import>> sponza_import;
 	};
 }
@@ -0,0 +1,127 @@
+#include "FileWatcher.hpp"
+
+#include "Log.h"
+
+#include <sys/stat.h>
+#if defined(__linux__)
+#	include <sys/inotify.h>
+#	include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <set>
+
+namespace
+{
+	std::string getDirectory(std::string const& filename)
+	{
+		auto const separator = filename.find_last_of("/\\");
+		return separator != std::string::npos ? filename.substr(0, separator) : ".";
+	}
+}
+
+FileWatcher::FileWatcher()
+{
+#if defined(__linux__)
+	inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotify_fd < 0)
+		LogWarning("Failed to initialise inotify (%s); falling back to polling files.", std::strerror(errno));
+#endif
+}
+
+FileWatcher::~FileWatcher()
+{
+#if defined(__linux__)
+	if (inotify_fd >= 0)
+		close(inotify_fd);
+#endif
+}
+
+void FileWatcher::Watch(std::string const& filename)
+{
+	if (!files.emplace(filename, GetModificationTime(filename)).second)
+		return;
+
+#if defined(__linux__)
+	if (inotify_fd < 0)
+		return;
+
+	auto const directory = getDirectory(filename);
+	auto const is_watched = std::any_of(directories.begin(), directories.end(),
+	                                    [&directory](std::pair<int const, std::string> const& watch) {
+	                                        return watch.second == directory;
+	                                    });
+	if (is_watched)
+		return;
+
+	// Editors often save by renaming a temporary file over the original one.
+	int const watch = inotify_add_watch(inotify_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+	if (watch < 0) {
+		LogWarning("Failed to watch \"%s\" (%s).", directory.c_str(), std::strerror(errno));
+		return;
+	}
+	directories[watch] = directory;
+#endif
+}
+
+std::vector<std::string> FileWatcher::Poll()
+{
+#if defined(__linux__)
+	if (inotify_fd < 0)
+		return PollModificationTimes();
+
+	std::set<std::string> modified_files;
+	alignas(inotify_event) char buffer[4096];
+	for (;;) {
+		auto const length = read(inotify_fd, buffer, sizeof(buffer));
+		if (length <= 0)
+			break; // Nothing left to read, as the descriptor is non-blocking
+
+		for (auto offset = 0; offset < length;) {
+			auto const event = reinterpret_cast<inotify_event const*>(buffer + offset);
+			offset += static_cast<int>(sizeof(inotify_event) + event->len);
+			if (event->len == 0u)
+				continue;
+
+			auto const directory = directories.find(event->wd);
+			if (directory == directories.end())
+				continue;
+
+			auto const filename = directory->second + "/" + event->name;
+			if (files.find(filename) != files.end())
+				modified_files.insert(filename);
+		}
+	}
+	return std::vector<std::string>(modified_files.begin(), modified_files.end());
+#else
+	return PollModificationTimes();
+#endif
+}
+
+std::time_t FileWatcher::GetModificationTime(std::string const& filename)
+{
+	struct stat status;
+	return stat(filename.c_str(), &status) == 0 ? status.st_mtime : std::time_t(0);
+}
+
+std::vector<std::string> FileWatcher::PollModificationTimes()
+{
+	std::vector<std::string> modified_files;
+
+	auto const now = std::chrono::steady_clock::now();
+	if (now - last_poll_time < std::chrono::milliseconds(500))
+		return modified_files;
+	last_poll_time = now;
+
+	for (auto& file : files) {
+		auto const modification_time = GetModificationTime(file.first);
+		if (modification_time == file.second || modification_time == std::time_t(0))
+			continue;
+
+		file.second = modification_time;
+		modified_files.push_back(file.first);
+	}
+	return modified_files;
+}
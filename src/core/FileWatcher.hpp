@@ -0,0 +1,40 @@
+#pragma once
+
+#include <chrono>
+#include <ctime>
+#include <map>
+#include <string>
+#include <vector>
+
+//! \brief Reports modifications made to a set of files.
+//!
+//! On Linux, the directories containing the files are watched through
+//! inotify, which catches files being written to as well as files being
+//! replaced, as editors saving through a temporary file do. Elsewhere, or if
+//! inotify is unavailable, the modification times of the files get compared
+//! every half second instead.
+class FileWatcher
+{
+public:
+	FileWatcher();
+	~FileWatcher();
+	FileWatcher(FileWatcher const&) = delete;
+	FileWatcher& operator=(FileWatcher const&) = delete;
+
+	void Watch(std::string const& filename);
+
+	//! \brief Files modified since the previous call; does not wait.
+	std::vector<std::string> Poll();
+
+	//! \brief Last modification time of `filename`, or 0 if it could not
+	//! be retrieved.
+	static std::time_t GetModificationTime(std::string const& filename);
+
+private:
+	std::vector<std::string> PollModificationTimes();
+
+	std::map<std::string, std::time_t> files; // With their last modification time
+	std::map<int, std::string> directories;   // Per inotify watch
+	int inotify_fd = -1;
+	std::chrono::steady_clock::time_point last_poll_time;
+};
@@ -0,0 +1,426 @@
+#include "FlythroughBenchmark.hpp"
+
+#include "GLCallCounters.hpp"
+#include "GPUTimerQueryPool.hpp"
+#include "Log.h"
+#include "various.hpp"
+
+#include "EDAF80/interpolation.hpp"
+
+#include <imgui.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+	using Category = GLCallCounters::Category;
+
+	std::size_t const categories_nb = static_cast<std::size_t>(Category::Count);
+
+	void writeStatistics(std::ostream& stream, FlythroughBenchmark::Statistics const& statistics)
+	{
+		stream << "\"samples\": " << statistics.samples_nb
+		       << ", \"min\": " << statistics.min
+		       << ", \"mean\": " << statistics.mean
+		       << ", \"p50\": " << statistics.p50
+		       << ", \"p95\": " << statistics.p95
+		       << ", \"p99\": " << statistics.p99
+		       << ", \"max\": " << statistics.max;
+	}
+
+	void logStatistics(char const* const name, char const* const unit, FlythroughBenchmark::Statistics const& statistics)
+	{
+		LogInfo("  %s [%s]: min %.3f, mean %.3f, p50 %.3f, p95 %.3f, p99 %.3f, max %.3f", name, unit,
+		        statistics.min, statistics.mean, statistics.p50, statistics.p95, statistics.p99, statistics.max);
+	}
+}
+
+bool FlythroughBenchmark::LoadPath(std::string const& filename)
+{
+	std::ifstream file(filename);
+	if (!file) {
+		LogError("Failed to open the flythrough path \"%s\".", filename.c_str());
+		return false;
+	}
+
+	std::vector<Keyframe> keyframes;
+	std::string line;
+	for (std::size_t line_index = 1u; std::getline(file, line); ++line_index) {
+		auto const first_character = line.find_first_not_of(" \t\r");
+		if (first_character == std::string::npos || line[first_character] == '#')
+			continue;
+
+		Keyframe keyframe;
+		std::istringstream line_stream(line);
+		line_stream >> keyframe.position.x >> keyframe.position.y >> keyframe.position.z
+		            >> keyframe.front.x >> keyframe.front.y >> keyframe.front.z;
+		if (!line_stream || glm::length(keyframe.front) < 1e-6f) {
+			LogError("Malformed keyframe on line %zu of \"%s\".", line_index, filename.c_str());
+			return false;
+		}
+		keyframe.front = glm::normalize(keyframe.front);
+		keyframes.push_back(keyframe);
+	}
+
+	path = std::move(keyframes);
+	LogInfo("Loaded a flythrough path of %zu keyframes from \"%s\".", path.size(), filename.c_str());
+	return true;
+}
+
+bool FlythroughBenchmark::SavePath(std::string const& filename) const
+{
+	std::ofstream file(filename);
+	if (!file) {
+		LogError("Failed to open \"%s\" for writing the flythrough path.", filename.c_str());
+		return false;
+	}
+
+	file << "# x y z front_x front_y front_z\n";
+	for (auto const& keyframe : path) {
+		file << keyframe.position.x << ' ' << keyframe.position.y << ' ' << keyframe.position.z << ' '
+		     << keyframe.front.x << ' ' << keyframe.front.y << ' ' << keyframe.front.z << '\n';
+	}
+
+	LogInfo("Flythrough path saved to \"%s\".", filename.c_str());
+	return true;
+}
+
+void FlythroughBenchmark::AddKeyframe(FPSCameraf const& camera)
+{
+	Keyframe keyframe;
+	keyframe.position = camera.mWorld.GetTranslation();
+	keyframe.front = camera.mWorld.GetFront();
+	path.push_back(keyframe);
+}
+
+void FlythroughBenchmark::AddKeyframe(Keyframe const& keyframe)
+{
+	path.push_back(keyframe);
+}
+
+void FlythroughBenchmark::ClearPath()
+{
+	path.clear();
+}
+
+std::vector<FlythroughBenchmark::Keyframe> const& FlythroughBenchmark::GetPath() const
+{
+	return path;
+}
+
+bool FlythroughBenchmark::Start(Settings const& requested_settings, GPUTimerQueryPool const* const requested_timer_pool, std::string const& requested_report_filename)
+{
+	if (path.size() < 2u) {
+		LogError("A flythrough needs at least two keyframes, but the path only has %zu.", path.size());
+		return false;
+	}
+	if (requested_settings.measured_frames_nb == 0u) {
+		LogError("A flythrough needs to measure at least one frame.");
+		return false;
+	}
+
+	settings = requested_settings;
+	timer_pool = requested_timer_pool;
+	report_filename = requested_report_filename;
+
+	cpu_frame_times = Series();
+	cpu_frame_times.name = "cpu_frame_time_ms";
+	gpu_times.clear();
+	gpu_samples_nb.clear();
+	gl_call_counts.assign(categories_nb + 1u, Series());
+	for (std::size_t i = 0; i < categories_nb; ++i)
+		gl_call_counts[i].name = GLCallCounters::GetCategoryIdentifier(static_cast<Category>(i));
+	gl_call_counts[categories_nb].name = "total";
+	primitives_nb = Series();
+	primitives_nb.name = "primitives";
+
+	// GL calls are only counted while the counters are enabled.
+	were_gl_calls_counted = GLCallCounters::Get().IsEnabled();
+	GLCallCounters::Get().SetEnabled(true);
+
+	frame_index = 0u;
+	last_frame_time = std::chrono::high_resolution_clock::now();
+	is_running = true;
+	has_results = false;
+
+	LogInfo("Starting a flythrough benchmark of %zu + %zu frames.", settings.warmup_frames_nb, settings.measured_frames_nb);
+	return true;
+}
+
+void FlythroughBenchmark::Stop()
+{
+	if (!is_running)
+		return;
+
+	is_running = false;
+	GLCallCounters::Get().SetEnabled(were_gl_calls_counted);
+	LogInfo("Flythrough benchmark aborted.");
+}
+
+bool FlythroughBenchmark::IsRunning() const
+{
+	return is_running;
+}
+
+bool FlythroughBenchmark::BeginFrame(FPSCameraf& camera)
+{
+	if (!is_running)
+		return false;
+
+	// The measurements of the previous frame are now available.
+	if (frame_index > settings.warmup_frames_nb)
+		Record();
+	last_frame_time = std::chrono::high_resolution_clock::now();
+
+	if (frame_index == settings.warmup_frames_nb + settings.measured_frames_nb) {
+		Complete();
+		return true;
+	}
+
+	PlaceCamera(camera, GetProgress());
+	++frame_index;
+	return false;
+}
+
+float FlythroughBenchmark::GetProgress() const
+{
+	if (frame_index < settings.warmup_frames_nb || settings.measured_frames_nb < 2u)
+		return 0.0f;
+
+	auto const measured_frame_index = std::min(frame_index - settings.warmup_frames_nb, settings.measured_frames_nb - 1u);
+	return static_cast<float>(measured_frame_index) / static_cast<float>(settings.measured_frames_nb - 1u);
+}
+
+FlythroughBenchmark::Statistics const& FlythroughBenchmark::GetCPUFrameTimeStatistics() const
+{
+	return cpu_frame_times.statistics;
+}
+
+void FlythroughBenchmark::RenderControls(FPSCameraf& camera, std::string const& path_filename, std::string const& requested_report_filename, GPUTimerQueryPool const* const requested_timer_pool)
+{
+	bool const opened = ImGui::Begin("Flythrough benchmark", nullptr, ImGuiWindowFlags_None);
+	if (!opened) {
+		ImGui::End();
+		return;
+	}
+
+	ImGui::Text("Path: %zu keyframes", path.size());
+	if (is_running) {
+		ImGui::ProgressBar(static_cast<float>(frame_index) / static_cast<float>(settings.warmup_frames_nb + settings.measured_frames_nb), ImVec2(-1.0f, 0.0f));
+		if (ImGui::Button("Stop"))
+			Stop();
+		ImGui::End();
+		return;
+	}
+
+	if (ImGui::Button("Add keyframe"))
+		AddKeyframe(camera);
+	ImGui::SameLine();
+	if (ImGui::Button("Clear"))
+		ClearPath();
+	ImGui::SameLine();
+	if (ImGui::Button("Save"))
+		SavePath(path_filename);
+	ImGui::SameLine();
+	if (ImGui::Button("Load"))
+		LoadPath(path_filename);
+	ImGui::TextDisabled("From and to \"%s\"", path_filename.c_str());
+
+	auto warmup_frames_nb = static_cast<int>(settings.warmup_frames_nb);
+	if (ImGui::SliderInt("Warm-up frames", &warmup_frames_nb, 0, 600))
+		settings.warmup_frames_nb = static_cast<std::size_t>(warmup_frames_nb);
+	auto measured_frames_nb = static_cast<int>(settings.measured_frames_nb);
+	if (ImGui::SliderInt("Measured frames", &measured_frames_nb, 1, 10000))
+		settings.measured_frames_nb = static_cast<std::size_t>(measured_frames_nb);
+	ImGui::SliderFloat("Tension", &settings.tension, 0.0f, 1.0f);
+
+	if (ImGui::Button("Preview start"))
+		PlaceCamera(camera, 0.0f);
+	ImGui::SameLine();
+	if (ImGui::Button("Start"))
+		Start(settings, requested_timer_pool, requested_report_filename);
+
+	if (has_results && ImGui::BeginTable("Flythrough results", 7, ImGuiTableFlags_SizingFixedFit)) {
+		ImGui::TableSetupColumn("Measurement");
+		ImGui::TableSetupColumn("Min");
+		ImGui::TableSetupColumn("Mean");
+		ImGui::TableSetupColumn("p50");
+		ImGui::TableSetupColumn("p95");
+		ImGui::TableSetupColumn("p99");
+		ImGui::TableSetupColumn("Max");
+		ImGui::TableHeadersRow();
+
+		auto const display_series = [](Series const& series){
+			ImGui::TableNextColumn();
+			ImGui::Text("%s", series.name.c_str());
+			for (auto const value : { series.statistics.min, series.statistics.mean, series.statistics.p50,
+			                          series.statistics.p95, series.statistics.p99, series.statistics.max }) {
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", value);
+			}
+		};
+		display_series(cpu_frame_times);
+		for (auto const& series : gpu_times)
+			display_series(series);
+		display_series(gl_call_counts[categories_nb]);
+		display_series(gl_call_counts[static_cast<std::size_t>(Category::Draw)]);
+
+		ImGui::EndTable();
+	}
+
+	ImGui::End();
+}
+
+void FlythroughBenchmark::PlaceCamera(FPSCameraf& camera, float const path_progress) const
+{
+	if (path.empty())
+		return;
+	if (path.size() == 1u) {
+		camera.mWorld.SetTranslate(path.front().position);
+		camera.mWorld.LookTowards(path.front().front, glm::vec3(0.0f, 1.0f, 0.0f));
+		return;
+	}
+
+	// The end keyframes are duplicated for the first and last segments.
+	auto const segments_nb = path.size() - 1u;
+	auto const path_position = glm::clamp(path_progress, 0.0f, 1.0f) * static_cast<float>(segments_nb);
+	auto const segment = std::min(static_cast<std::size_t>(path_position), segments_nb - 1u);
+	auto const x = path_position - static_cast<float>(segment);
+
+	auto const& k0 = path[segment > 0u ? segment - 1u : 0u];
+	auto const& k1 = path[segment];
+	auto const& k2 = path[segment + 1u];
+	auto const& k3 = path[std::min(segment + 2u, path.size() - 1u)];
+
+	auto const position = interpolation::evalCatmullRom(k0.position, k1.position, k2.position, k3.position, settings.tension, x);
+	auto front = interpolation::evalCatmullRom(k0.front, k1.front, k2.front, k3.front, settings.tension, x);
+	front = glm::length(front) > 1e-6f ? glm::normalize(front) : k1.front;
+
+	camera.mWorld.SetTranslate(position);
+	camera.mWorld.LookTowards(front, glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+void FlythroughBenchmark::Record()
+{
+	auto const now = std::chrono::high_resolution_clock::now();
+	cpu_frame_times.samples.push_back(std::chrono::duration<double, std::milli>(now - last_frame_time).count());
+
+	auto const& counters = GLCallCounters::Get().GetLastFrameCounters();
+	std::uint64_t total_calls_nb = 0u;
+	for (std::size_t i = 0; i < categories_nb; ++i) {
+		gl_call_counts[i].samples.push_back(static_cast<double>(counters.calls_nb[i]));
+		total_calls_nb += counters.calls_nb[i];
+	}
+	gl_call_counts[categories_nb].samples.push_back(static_cast<double>(total_calls_nb));
+	primitives_nb.samples.push_back(static_cast<double>(counters.primitives_nb));
+
+	if (timer_pool == nullptr)
+		return;
+
+	// Timers can get registered at any point, for example when the render
+	// graph gets recompiled.
+	for (auto i = gpu_times.size(); i < timer_pool->GetTimersCount(); ++i) {
+		gpu_times.emplace_back();
+		gpu_times.back().name = timer_pool->GetTimerName(i);
+		gpu_samples_nb.push_back(timer_pool->GetStatistics(i).samples_nb);
+	}
+	for (std::size_t i = 0; i < gpu_times.size(); ++i) {
+		auto const statistics = timer_pool->GetStatistics(i);
+		if (statistics.samples_nb == gpu_samples_nb[i])
+			continue;
+
+		gpu_samples_nb[i] = statistics.samples_nb;
+		gpu_times[i].samples.push_back(statistics.last_ms);
+	}
+}
+
+void FlythroughBenchmark::Complete()
+{
+	is_running = false;
+	has_results = true;
+	GLCallCounters::Get().SetEnabled(were_gl_calls_counted);
+
+	cpu_frame_times.statistics = ComputeStatistics(cpu_frame_times.samples);
+	for (auto& series : gpu_times)
+		series.statistics = ComputeStatistics(series.samples);
+	for (auto& series : gl_call_counts)
+		series.statistics = ComputeStatistics(series.samples);
+	primitives_nb.statistics = ComputeStatistics(primitives_nb.samples);
+
+	LogInfo("Flythrough benchmark over %zu frames:", settings.measured_frames_nb);
+	logStatistics("CPU frame time", "ms", cpu_frame_times.statistics);
+	for (auto const& series : gpu_times) {
+		if (series.statistics.samples_nb > 0u)
+			logStatistics(series.name.c_str(), "GPU ms", series.statistics);
+	}
+	logStatistics("GL calls", "per frame", gl_call_counts[categories_nb].statistics);
+	logStatistics("Draw calls", "per frame", gl_call_counts[static_cast<std::size_t>(Category::Draw)].statistics);
+
+	if (!report_filename.empty())
+		WriteReport(report_filename);
+}
+
+bool FlythroughBenchmark::WriteReport(std::string const& filename) const
+{
+	std::ofstream file(filename);
+	if (!file) {
+		LogError("Failed to open \"%s\" for writing the flythrough report.", filename.c_str());
+		return false;
+	}
+
+	auto const write_series = [&file](std::vector<Series> const& series_list){
+		for (std::size_t i = 0; i < series_list.size(); ++i) {
+			file << (i == 0u ? "\n" : ",\n")
+			     << "\t\t{ \"name\": \"" << utils::escapeJSON(series_list[i].name) << "\", ";
+			writeStatistics(file, series_list[i].statistics);
+			file << " }";
+		}
+	};
+
+	file << "{\n\t\"keyframes\": " << path.size()
+	     << ",\n\t\"warmup_frames\": " << settings.warmup_frames_nb
+	     << ",\n\t\"measured_frames\": " << settings.measured_frames_nb
+	     << ",\n\t\"tension\": " << settings.tension
+	     << ",\n\t\"cpu_frame_time_ms\": { ";
+	writeStatistics(file, cpu_frame_times.statistics);
+	file << " },\n\t\"gpu_time_ms\": [";
+	write_series(gpu_times);
+	file << "\n\t],\n\t\"gl_calls_per_frame\": [";
+	write_series(gl_call_counts);
+	file << "\n\t],\n\t\"primitives_per_frame\": { ";
+	writeStatistics(file, primitives_nb.statistics);
+	file << " }\n}\n";
+
+	LogInfo("Flythrough report written to \"%s\".", filename.c_str());
+	return true;
+}
+
+FlythroughBenchmark::Statistics FlythroughBenchmark::ComputeStatistics(std::vector<double> samples)
+{
+	Statistics statistics;
+	if (samples.empty())
+		return statistics;
+	std::sort(samples.begin(), samples.end());
+
+	// Nearest-rank percentiles.
+	auto const percentile = [&samples](double const p){
+		auto const rank = static_cast<std::size_t>(std::ceil(p * static_cast<double>(samples.size())));
+		return samples[std::min(std::max<std::size_t>(rank, 1u), samples.size()) - 1u];
+	};
+
+	double sum = 0.0;
+	for (auto const sample : samples)
+		sum += sample;
+
+	statistics.samples_nb = samples.size();
+	statistics.min = samples.front();
+	statistics.mean = sum / static_cast<double>(samples.size());
+	statistics.p50 = percentile(0.50);
+	statistics.p95 = percentile(0.95);
+	statistics.p99 = percentile(0.99);
+	statistics.max = samples.back();
+	return statistics;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "FPSCamera.h"
+
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class GPUTimerQueryPool;
+
+//! \brief Reproducible performance measurements, obtained by flying the
+//! camera along a fixed path for a fixed number of frames.
+//!
+//! The path is a Catmull-Rom spline going through keyframed camera positions,
+//! with the viewing directions interpolated the same way; it can be authored
+//! in a text file, with one `x y z front_x front_y front_z` keyframe per line,
+//! or recorded by adding the current camera pose as a keyframe.
+//!
+//! The camera moves by the same amount every frame, regardless of how long
+//! frames take, so that two runs render the exact same frames. After some
+//! warm-up frames spent at the start of the path, the CPU frame times, the
+//! GPU times of every timer from the given pool and the GL call counts are
+//! recorded for each frame; their minimum, mean, median, 95th and 99th
+//! percentiles, and maximum are then logged and written out as JSON. As GPU
+//! timings are read back a few frames late, they lag behind the other
+//! measurements by that many frames.
+class FlythroughBenchmark
+{
+public:
+	struct Keyframe {
+		glm::vec3 position{ 0.0f };
+		glm::vec3 front{ 0.0f, 0.0f, -1.0f };
+	};
+
+	struct Settings {
+		std::size_t warmup_frames_nb = 60u;
+		std::size_t measured_frames_nb = 600u;
+		float tension = 0.5f; //!< Of the Catmull-Rom spline
+	};
+
+	struct Statistics {
+		std::size_t samples_nb = 0u;
+		double min = 0.0;
+		double mean = 0.0;
+		double p50 = 0.0;
+		double p95 = 0.0;
+		double p99 = 0.0;
+		double max = 0.0;
+	};
+
+	bool LoadPath(std::string const& filename);
+	bool SavePath(std::string const& filename) const;
+	void AddKeyframe(FPSCameraf const& camera);
+	void AddKeyframe(Keyframe const& keyframe);
+	void ClearPath();
+	std::vector<Keyframe> const& GetPath() const;
+
+	//! \brief Start flying along the path, which needs at least two
+	//! keyframes.
+	//!
+	//! \param [in] timer_pool whose timers get recorded; can be null
+	//! \param [in] report_filename where the JSON report gets written once
+	//!             the benchmark completes
+	bool Start(Settings const& settings, GPUTimerQueryPool const* timer_pool, std::string const& report_filename);
+
+	//! \brief Abort the benchmark, without writing any report.
+	void Stop();
+
+	bool IsRunning() const;
+
+	//! \brief Record the measurements of the previous frame, and move the
+	//! camera to its pose for the upcoming one; call it once per frame,
+	//! after `GPUTimerQueryPool::BeginFrame()` and
+	//! `GLCallCounters::BeginFrame()`.
+	//!
+	//! \return whether the benchmark completed with this frame
+	bool BeginFrame(FPSCameraf& camera);
+
+	//! \brief Where along the run the benchmark is, from 0 to 1.
+	float GetProgress() const;
+
+	Statistics const& GetCPUFrameTimeStatistics() const;
+
+	//! \brief Display the path and benchmark controls in an ImGui window.
+	void RenderControls(FPSCameraf& camera, std::string const& path_filename, std::string const& report_filename, GPUTimerQueryPool const* timer_pool);
+
+private:
+	struct Series {
+		std::string name;
+		std::vector<double> samples;
+		Statistics statistics;
+	};
+
+	void PlaceCamera(FPSCameraf& camera, float path_progress) const;
+	void Record();
+	void Complete();
+	bool WriteReport(std::string const& filename) const;
+
+	static Statistics ComputeStatistics(std::vector<double> samples);
+
+	std::vector<Keyframe> path;
+
+	Settings settings;
+	GPUTimerQueryPool const* timer_pool = nullptr;
+	std::string report_filename;
+	bool is_running = false;
+	bool has_results = false;
+	bool were_gl_calls_counted = false;
+	std::size_t frame_index = 0u;
+	std::chrono::high_resolution_clock::time_point last_frame_time;
+
+	Series cpu_frame_times;
+	std::vector<Series> gpu_times;             // One per timer
+	std::vector<std::size_t> gpu_samples_nb;   // Per timer, when last read
+	std::vector<Series> gl_call_counts;        // Per category, and in total
+	Series primitives_nb;
+};
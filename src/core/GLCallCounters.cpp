@@ -0,0 +1,516 @@
+#include "GLCallCounters.hpp"
+
+#include "Log.h"
+#include "various.hpp"
+
+#include <imgui.h>
+
+#include <algorithm>
+
+namespace
+{
+	using Category = GLCallCounters::Category;
+
+	char const* const category_names[] = {
+		"Draws",
+		"Compute dispatches",
+		"Clears and blits",
+		"State changes",
+		"Bindings",
+		"Uniform uploads",
+		"Buffer uploads",
+		"Texture uploads",
+		"Queries"
+	};
+
+	char const* const csv_category_names[] = {
+		"draws",
+		"dispatches",
+		"clears_blits",
+		"state_changes",
+		"bindings",
+		"uniforms",
+		"buffer_uploads",
+		"texture_uploads",
+		"queries"
+	};
+
+	GLCallCounters::Counters& counters()
+	{
+		return GLCallCounters::Get().GetCurrentFrameCounters();
+	}
+
+	//! \brief Wrappers around the GLAD function pointer `variable`.
+	template<typename Pfn>
+	struct Hook;
+
+	template<typename R, typename... Args>
+	struct Hook<R (APIENTRYP)(Args...)>
+	{
+		using Pfn = R (APIENTRYP)(Args...);
+
+		//! `account`, if any, is given the arguments of every call, to
+		//! update the counters other than the number of calls.
+		template<Pfn* variable, Category category, void (*account)(Args...) = nullptr>
+		struct For {
+			static Pfn& Original()
+			{
+				static Pfn original = nullptr;
+				return original;
+			}
+
+			static R APIENTRY Call(Args... args)
+			{
+				++counters().calls_nb[static_cast<std::size_t>(category)];
+				if (account != nullptr)
+					account(args...);
+				return Original()(args...);
+			}
+
+			static void Install(bool const is_enabled)
+			{
+				if (is_enabled) {
+					// Functions unsupported by the context are left alone.
+					if (*variable == nullptr || *variable == &Call)
+						return;
+					Original() = *variable;
+					*variable = &Call;
+				} else if (*variable == &Call) {
+					*variable = Original();
+				}
+			}
+		};
+	};
+
+	std::uint64_t getPrimitivesCount(GLenum const mode, GLsizei const count)
+	{
+		auto const n = static_cast<std::uint64_t>(std::max(count, 0));
+		switch (mode) {
+			case GL_POINTS:                   return n;
+			case GL_LINES:                    return n / 2u;
+			case GL_LINE_LOOP:                return n >= 2u ? n : 0u;
+			case GL_LINE_STRIP:               return n >= 1u ? n - 1u : 0u;
+			case GL_TRIANGLES:                return n / 3u;
+			case GL_TRIANGLE_STRIP:
+			case GL_TRIANGLE_FAN:             return n >= 2u ? n - 2u : 0u;
+			case GL_LINES_ADJACENCY:          return n / 4u;
+			case GL_LINE_STRIP_ADJACENCY:     return n >= 3u ? n - 3u : 0u;
+			case GL_TRIANGLES_ADJACENCY:      return n / 6u;
+			case GL_TRIANGLE_STRIP_ADJACENCY: return n >= 4u ? (n - 4u) / 2u : 0u;
+			default:                          return 0u; // Patches depend on the tessellation
+		}
+	}
+
+	std::uint64_t getPixelSize(GLenum const format, GLenum const type)
+	{
+		switch (type) {
+			case GL_UNSIGNED_BYTE_3_3_2:
+			case GL_UNSIGNED_BYTE_2_3_3_REV:
+				return 1u;
+			case GL_UNSIGNED_SHORT_5_6_5:
+			case GL_UNSIGNED_SHORT_5_6_5_REV:
+			case GL_UNSIGNED_SHORT_4_4_4_4:
+			case GL_UNSIGNED_SHORT_4_4_4_4_REV:
+			case GL_UNSIGNED_SHORT_5_5_5_1:
+			case GL_UNSIGNED_SHORT_1_5_5_5_REV:
+				return 2u;
+			case GL_UNSIGNED_INT_8_8_8_8:
+			case GL_UNSIGNED_INT_8_8_8_8_REV:
+			case GL_UNSIGNED_INT_10_10_10_2:
+			case GL_UNSIGNED_INT_2_10_10_10_REV:
+			case GL_UNSIGNED_INT_24_8:
+			case GL_UNSIGNED_INT_10F_11F_11F_REV:
+			case GL_UNSIGNED_INT_5_9_9_9_REV:
+				return 4u;
+			case GL_FLOAT_32_UNSIGNED_INT_24_8_REV:
+				return 8u;
+			default:
+				break;
+		}
+
+		std::uint64_t component_size = 1u;
+		switch (type) {
+			case GL_SHORT:
+			case GL_UNSIGNED_SHORT:
+			case GL_HALF_FLOAT:
+				component_size = 2u;
+				break;
+			case GL_INT:
+			case GL_UNSIGNED_INT:
+			case GL_FLOAT:
+				component_size = 4u;
+				break;
+			default:
+				break;
+		}
+
+		switch (format) {
+			case GL_RG:
+			case GL_RG_INTEGER:
+				return 2u * component_size;
+			case GL_RGB:
+			case GL_BGR:
+			case GL_RGB_INTEGER:
+			case GL_BGR_INTEGER:
+				return 3u * component_size;
+			case GL_RGBA:
+			case GL_BGRA:
+			case GL_RGBA_INTEGER:
+			case GL_BGRA_INTEGER:
+				return 4u * component_size;
+			default:
+				return component_size;
+		}
+	}
+
+	std::uint64_t getImageSize(GLsizei const width, GLsizei const height, GLsizei const depth, GLenum const format, GLenum const type)
+	{
+		return static_cast<std::uint64_t>(std::max(width, 0)) * static_cast<std::uint64_t>(std::max(height, 0))
+		     * static_cast<std::uint64_t>(std::max(depth, 0)) * getPixelSize(format, type);
+	}
+
+	void accountDrawArrays(GLenum mode, GLint /*first*/, GLsizei count)
+	{
+		counters().vertices_nb += static_cast<std::uint64_t>(std::max(count, 0));
+		counters().primitives_nb += getPrimitivesCount(mode, count);
+	}
+
+	void accountDrawArraysInstanced(GLenum mode, GLint /*first*/, GLsizei count, GLsizei instancecount)
+	{
+		auto const instances_nb = static_cast<std::uint64_t>(std::max(instancecount, 0));
+		counters().vertices_nb += static_cast<std::uint64_t>(std::max(count, 0)) * instances_nb;
+		counters().primitives_nb += getPrimitivesCount(mode, count) * instances_nb;
+	}
+
+	void accountMultiDrawArrays(GLenum mode, GLint const* /*first*/, GLsizei const* count, GLsizei drawcount)
+	{
+		for (GLsizei i = 0; i < drawcount; ++i)
+			accountDrawArrays(mode, 0, count[i]);
+	}
+
+	void accountDrawElements(GLenum mode, GLsizei count, GLenum /*type*/, void const* /*indices*/)
+	{
+		counters().indices_nb += static_cast<std::uint64_t>(std::max(count, 0));
+		counters().primitives_nb += getPrimitivesCount(mode, count);
+	}
+
+	void accountDrawElementsInstanced(GLenum mode, GLsizei count, GLenum /*type*/, void const* /*indices*/, GLsizei instancecount)
+	{
+		auto const instances_nb = static_cast<std::uint64_t>(std::max(instancecount, 0));
+		counters().indices_nb += static_cast<std::uint64_t>(std::max(count, 0)) * instances_nb;
+		counters().primitives_nb += getPrimitivesCount(mode, count) * instances_nb;
+	}
+
+	void accountDrawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, void const* indices, GLint /*basevertex*/)
+	{
+		accountDrawElements(mode, count, type, indices);
+	}
+
+	void accountDrawRangeElements(GLenum mode, GLuint /*start*/, GLuint /*end*/, GLsizei count, GLenum type, void const* indices)
+	{
+		accountDrawElements(mode, count, type, indices);
+	}
+
+	void accountMultiDrawElements(GLenum mode, GLsizei const* count, GLenum type, void const* const* indices, GLsizei drawcount)
+	{
+		for (GLsizei i = 0; i < drawcount; ++i)
+			accountDrawElements(mode, count[i], type, indices[i]);
+	}
+
+	// Allocations without any data do not transfer anything.
+	void accountBufferData(GLenum /*target*/, GLsizeiptr size, void const* data, GLenum /*usage*/)
+	{
+		if (data != nullptr)
+			counters().buffer_bytes += static_cast<std::uint64_t>(size);
+	}
+
+	void accountBufferSubData(GLenum /*target*/, GLintptr /*offset*/, GLsizeiptr size, void const* /*data*/)
+	{
+		counters().buffer_bytes += static_cast<std::uint64_t>(size);
+	}
+
+	void accountTexImage1D(GLenum /*target*/, GLint /*level*/, GLint /*internalformat*/, GLsizei width, GLint /*border*/, GLenum format, GLenum type, void const* pixels)
+	{
+		if (pixels != nullptr)
+			counters().texture_bytes += getImageSize(width, 1, 1, format, type);
+	}
+
+	void accountTexImage2D(GLenum /*target*/, GLint /*level*/, GLint /*internalformat*/, GLsizei width, GLsizei height, GLint /*border*/, GLenum format, GLenum type, void const* pixels)
+	{
+		if (pixels != nullptr)
+			counters().texture_bytes += getImageSize(width, height, 1, format, type);
+	}
+
+	void accountTexImage3D(GLenum /*target*/, GLint /*level*/, GLint /*internalformat*/, GLsizei width, GLsizei height, GLsizei depth, GLint /*border*/, GLenum format, GLenum type, void const* pixels)
+	{
+		if (pixels != nullptr)
+			counters().texture_bytes += getImageSize(width, height, depth, format, type);
+	}
+
+	void accountTexSubImage2D(GLenum /*target*/, GLint /*level*/, GLint /*xoffset*/, GLint /*yoffset*/, GLsizei width, GLsizei height, GLenum format, GLenum type, void const* /*pixels*/)
+	{
+		counters().texture_bytes += getImageSize(width, height, 1, format, type);
+	}
+
+	void accountTexSubImage3D(GLenum /*target*/, GLint /*level*/, GLint /*xoffset*/, GLint /*yoffset*/, GLint /*zoffset*/, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, void const* /*pixels*/)
+	{
+		counters().texture_bytes += getImageSize(width, height, depth, format, type);
+	}
+
+	void accountCompressedTexImage2D(GLenum /*target*/, GLint /*level*/, GLenum /*internalformat*/, GLsizei /*width*/, GLsizei /*height*/, GLint /*border*/, GLsizei imageSize, void const* data)
+	{
+		if (data != nullptr)
+			counters().texture_bytes += static_cast<std::uint64_t>(std::max(imageSize, 0));
+	}
+
+#define COUNTED(function, category) \
+	&Hook<decltype(function)>::For<&function, Category::category>::Install
+#define COUNTED_WITH(function, category, account) \
+	&Hook<decltype(function)>::For<&function, Category::category, &account>::Install
+
+	using Installer = void (*)(bool);
+	Installer const installers[] = {
+		COUNTED_WITH(glDrawArrays, Draw, accountDrawArrays),
+		COUNTED_WITH(glDrawArraysInstanced, Draw, accountDrawArraysInstanced),
+		COUNTED_WITH(glMultiDrawArrays, Draw, accountMultiDrawArrays),
+		COUNTED_WITH(glDrawElements, Draw, accountDrawElements),
+		COUNTED_WITH(glDrawElementsInstanced, Draw, accountDrawElementsInstanced),
+		COUNTED_WITH(glDrawElementsBaseVertex, Draw, accountDrawElementsBaseVertex),
+		COUNTED_WITH(glDrawRangeElements, Draw, accountDrawRangeElements),
+		COUNTED_WITH(glMultiDrawElements, Draw, accountMultiDrawElements),
+
+		COUNTED(glDispatchCompute, Dispatch),
+		COUNTED(glDispatchComputeIndirect, Dispatch),
+
+		COUNTED(glClear, ClearBlit),
+		COUNTED(glClearBufferfv, ClearBlit),
+		COUNTED(glClearBufferfi, ClearBlit),
+		COUNTED(glClearBufferiv, ClearBlit),
+		COUNTED(glClearBufferuiv, ClearBlit),
+		COUNTED(glBlitFramebuffer, ClearBlit),
+
+		COUNTED(glEnable, State),
+		COUNTED(glDisable, State),
+		COUNTED(glDepthFunc, State),
+		COUNTED(glDepthMask, State),
+		COUNTED(glColorMask, State),
+		COUNTED(glCullFace, State),
+		COUNTED(glFrontFace, State),
+		COUNTED(glPolygonMode, State),
+		COUNTED(glBlendEquation, State),
+		COUNTED(glBlendEquationSeparate, State),
+		COUNTED(glBlendFunc, State),
+		COUNTED(glBlendFuncSeparate, State),
+		COUNTED(glStencilFunc, State),
+		COUNTED(glStencilOp, State),
+		COUNTED(glStencilOpSeparate, State),
+		COUNTED(glStencilMask, State),
+		COUNTED(glScissor, State),
+		COUNTED(glViewport, State),
+		COUNTED(glDrawBuffer, State),
+		COUNTED(glDrawBuffers, State),
+		COUNTED(glReadBuffer, State),
+		COUNTED(glMemoryBarrier, State),
+
+		COUNTED(glUseProgram, Binding),
+		COUNTED(glBindVertexArray, Binding),
+		COUNTED(glBindFramebuffer, Binding),
+		COUNTED(glActiveTexture, Binding),
+		COUNTED(glBindTexture, Binding),
+		COUNTED(glBindSampler, Binding),
+		COUNTED(glBindBuffer, Binding),
+		COUNTED(glBindBufferBase, Binding),
+		COUNTED(glBindBufferRange, Binding),
+		COUNTED(glBindImageTexture, Binding),
+
+		COUNTED(glUniform1i, Uniform),
+		COUNTED(glUniform2i, Uniform),
+		COUNTED(glUniform3i, Uniform),
+		COUNTED(glUniform4i, Uniform),
+		COUNTED(glUniform1ui, Uniform),
+		COUNTED(glUniform2ui, Uniform),
+		COUNTED(glUniform1f, Uniform),
+		COUNTED(glUniform2f, Uniform),
+		COUNTED(glUniform3f, Uniform),
+		COUNTED(glUniform4f, Uniform),
+		COUNTED(glUniform1iv, Uniform),
+		COUNTED(glUniform1fv, Uniform),
+		COUNTED(glUniform2fv, Uniform),
+		COUNTED(glUniform3fv, Uniform),
+		COUNTED(glUniform4fv, Uniform),
+		COUNTED(glUniformMatrix3fv, Uniform),
+		COUNTED(glUniformMatrix4fv, Uniform),
+
+		COUNTED_WITH(glBufferData, BufferUpload, accountBufferData),
+		COUNTED_WITH(glBufferSubData, BufferUpload, accountBufferSubData),
+		COUNTED(glMapBufferRange, BufferUpload),
+		COUNTED(glUnmapBuffer, BufferUpload),
+
+		COUNTED_WITH(glTexImage1D, TextureUpload, accountTexImage1D),
+		COUNTED_WITH(glTexImage2D, TextureUpload, accountTexImage2D),
+		COUNTED_WITH(glTexImage3D, TextureUpload, accountTexImage3D),
+		COUNTED_WITH(glTexSubImage2D, TextureUpload, accountTexSubImage2D),
+		COUNTED_WITH(glTexSubImage3D, TextureUpload, accountTexSubImage3D),
+		COUNTED_WITH(glCompressedTexImage2D, TextureUpload, accountCompressedTexImage2D),
+
+		COUNTED(glBeginQuery, Query),
+		COUNTED(glEndQuery, Query),
+		COUNTED(glQueryCounter, Query),
+		COUNTED(glGetQueryObjectiv, Query),
+		COUNTED(glGetQueryObjectuiv, Query),
+		COUNTED(glGetQueryObjectui64v, Query)
+	};
+
+#undef COUNTED_WITH
+#undef COUNTED
+}
+
+GLCallCounters& GLCallCounters::Get()
+{
+	static GLCallCounters instance;
+	return instance;
+}
+
+void GLCallCounters::SetEnabled(bool const enable)
+{
+	if (enable == is_enabled)
+		return;
+
+	for (auto const install : installers)
+		install(enable);
+	is_enabled = enable;
+	current_counters = Counters();
+
+	if (!is_enabled)
+		StopRecording();
+}
+
+bool GLCallCounters::IsEnabled() const
+{
+	return is_enabled;
+}
+
+void GLCallCounters::BeginFrame()
+{
+	last_counters = current_counters;
+	current_counters = Counters();
+
+	if (recording.is_open()) {
+		recording << frame_index;
+		for (auto const calls_nb : last_counters.calls_nb)
+			recording << ',' << calls_nb;
+		recording << ',' << last_counters.vertices_nb
+		          << ',' << last_counters.indices_nb
+		          << ',' << last_counters.primitives_nb
+		          << ',' << last_counters.buffer_bytes
+		          << ',' << last_counters.texture_bytes << '\n';
+	}
+	++frame_index;
+}
+
+GLCallCounters::Counters const& GLCallCounters::GetLastFrameCounters() const
+{
+	return last_counters;
+}
+
+char const* GLCallCounters::GetCategoryIdentifier(Category category)
+{
+	return csv_category_names[static_cast<std::size_t>(category)];
+}
+
+GLCallCounters::Counters& GLCallCounters::GetCurrentFrameCounters()
+{
+	return current_counters;
+}
+
+bool GLCallCounters::StartRecording(std::string const& filename)
+{
+	StopRecording();
+
+	recording.open(filename);
+	if (!recording) {
+		LogError("Failed to open \"%s\" for recording the GL calls.", filename.c_str());
+		return false;
+	}
+
+	SetEnabled(true);
+
+	recording << "frame";
+	for (auto const name : csv_category_names)
+		recording << ',' << name;
+	recording << ",vertices,indices,primitives,buffer_bytes,texture_bytes\n";
+
+	LogInfo("Recording the GL calls of each frame to \"%s\".", filename.c_str());
+	return true;
+}
+
+void GLCallCounters::StopRecording()
+{
+	if (!recording.is_open())
+		return;
+
+	recording.close();
+	LogInfo("Stopped recording the GL calls.");
+}
+
+bool GLCallCounters::IsRecording() const
+{
+	return recording.is_open();
+}
+
+void GLCallCounters::RenderOverlay(std::string const& csv_filename)
+{
+	bool const opened = ImGui::Begin("GL calls", nullptr, ImGuiWindowFlags_None);
+	if (!opened) {
+		ImGui::End();
+		return;
+	}
+
+	bool enable = is_enabled;
+	if (ImGui::Checkbox("Count calls", &enable))
+		SetEnabled(enable);
+	ImGui::SameLine();
+	if (!IsRecording()) {
+		if (ImGui::Button("Record CSV"))
+			StartRecording(csv_filename);
+	} else {
+		if (ImGui::Button("Stop recording"))
+			StopRecording();
+	}
+
+	if (!is_enabled) {
+		ImGui::TextDisabled("Counting is disabled.");
+		ImGui::End();
+		return;
+	}
+
+	if (ImGui::BeginTable("GL calls", 2, ImGuiTableFlags_SizingFixedFit)) {
+		ImGui::TableSetupColumn("Calls");
+		ImGui::TableSetupColumn("Last frame");
+		ImGui::TableHeadersRow();
+
+		std::uint64_t calls_nb = 0u;
+		for (std::size_t i = 0; i < static_cast<std::size_t>(Category::Count); ++i) {
+			ImGui::TableNextColumn();
+			ImGui::Text("%s", category_names[i]);
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu", static_cast<unsigned long long>(last_counters.calls_nb[i]));
+			calls_nb += last_counters.calls_nb[i];
+		}
+		ImGui::TableNextColumn();
+		ImGui::Text("Total");
+		ImGui::TableNextColumn();
+		ImGui::Text("%llu", static_cast<unsigned long long>(calls_nb));
+
+		ImGui::EndTable();
+	}
+
+	ImGui::Separator();
+	ImGui::Text("Vertices:   %llu", static_cast<unsigned long long>(last_counters.vertices_nb));
+	ImGui::Text("Indices:    %llu", static_cast<unsigned long long>(last_counters.indices_nb));
+	ImGui::Text("Primitives: %llu", static_cast<unsigned long long>(last_counters.primitives_nb));
+	ImGui::Text("Buffer uploads:  %s", utils::formatBytes(last_counters.buffer_bytes).c_str());
+	ImGui::Text("Texture uploads: %s", utils::formatBytes(last_counters.texture_bytes).c_str());
+
+	ImGui::End();
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+//! \brief Opt-in counting of the OpenGL calls issued each frame.
+//!
+//! When enabled, the GLAD function pointers of the counted functions get
+//! replaced by wrappers which update the counters of the current frame
+//! before forwarding the call; when disabled, the original pointers are put
+//! back and nothing is counted, at no cost. Everything calling OpenGL
+//! through GLAD is accounted for, including the ImGui backend if it uses
+//! GLAD.
+//!
+//! Besides the calls per category, the vertices and indices submitted by
+//! draw calls are counted, along with the primitives they form, and the
+//! bytes sent through `glBufferData()`, `glBufferSubData()`,
+//! `glTexImage*()` and `glTexSubImage*()`; texture sizes assume tightly
+//! packed pixels, regardless of the unpack parameters.
+//!
+//! There is a single instance, as GLAD function pointers are global.
+class GLCallCounters
+{
+public:
+	enum class Category : std::uint32_t {
+		Draw = 0u,
+		Dispatch,
+		ClearBlit,
+		State,
+		Binding,
+		Uniform,
+		BufferUpload,
+		TextureUpload,
+		Query,
+		Count
+	};
+
+	struct Counters {
+		std::array<std::uint64_t, static_cast<std::size_t>(Category::Count)> calls_nb = {};
+		std::uint64_t vertices_nb = 0u;  //!< From non-indexed draws
+		std::uint64_t indices_nb = 0u;   //!< From indexed draws
+		std::uint64_t primitives_nb = 0u;
+		std::uint64_t buffer_bytes = 0u;
+		std::uint64_t texture_bytes = 0u;
+	};
+
+	static GLCallCounters& Get();
+
+	GLCallCounters(GLCallCounters const&) = delete;
+	GLCallCounters& operator=(GLCallCounters const&) = delete;
+
+	//! \brief Install or remove the wrappers; GLAD has to be loaded first.
+	void SetEnabled(bool is_enabled);
+	bool IsEnabled() const;
+
+	//! \brief Keep the counters of the frame that just ended, writing them
+	//! out if recording, and start counting from zero; call it once per
+	//! frame.
+	void BeginFrame();
+
+	Counters const& GetLastFrameCounters() const;
+
+	//! \brief Append the counters of every frame to `filename`, as CSV,
+	//! until `StopRecording()` is called; counting gets enabled if needed.
+	bool StartRecording(std::string const& filename);
+	void StopRecording();
+	bool IsRecording() const;
+
+	//! \brief Display the counters of the last frame in their own ImGui
+	//! window, alongside the controls for enabling them and for recording
+	//! them to `csv_filename`.
+	void RenderOverlay(std::string const& csv_filename);
+
+	//! \brief Short identifier of `category`, as used in the CSV exports.
+	static char const* GetCategoryIdentifier(Category category);
+
+	//! \brief Used by the wrappers; not meant to be called directly.
+	Counters& GetCurrentFrameCounters();
+
+private:
+	GLCallCounters() = default;
+
+	Counters current_counters;
+	Counters last_counters;
+	bool is_enabled = false;
+	std::ofstream recording;
+	std::uint64_t frame_index = 0u;
+};
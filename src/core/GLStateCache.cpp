@@ -0,0 +1,301 @@
+#include "GLStateCache.hpp"
+
+#include <imgui.h>
+
+namespace
+{
+	char const* const call_names[] = {
+		"glUseProgram",
+		"glBindVertexArray",
+		"glBindFramebuffer",
+		"glActiveTexture",
+		"glBindTexture",
+		"glBindSampler",
+		"glEnable/glDisable",
+		"glDepthFunc",
+		"glDepthMask",
+		"glColorMask",
+		"glCullFace",
+		"glPolygonMode",
+		"glBlendEquationSeparate",
+		"glBlendFuncSeparate"
+	};
+
+	std::size_t getTargetIndex(GLenum target)
+	{
+		switch (target) {
+			case GL_TEXTURE_1D:       return 0u;
+			case GL_TEXTURE_2D:       return 1u;
+			case GL_TEXTURE_3D:       return 2u;
+			case GL_TEXTURE_CUBE_MAP: return 3u;
+			case GL_TEXTURE_2D_ARRAY: return 4u;
+			default:                  return ~std::size_t(0);
+		}
+	}
+}
+
+constexpr GLuint GLStateCache::unknown;
+constexpr std::size_t GLStateCache::tracked_targets_nb;
+
+GLStateCache& GLStateCache::Get()
+{
+	static GLStateCache cache;
+	return cache;
+}
+
+GLStateCache::GLStateCache()
+{
+	Invalidate();
+}
+
+void GLStateCache::BeginFrame()
+{
+	last_counters = current_counters;
+	current_counters = Counters();
+	Invalidate();
+}
+
+void GLStateCache::Invalidate()
+{
+	program = unknown;
+	vao = unknown;
+	draw_framebuffer = unknown;
+	read_framebuffer = unknown;
+	active_texture = unknown;
+	textures.clear();
+	samplers.clear();
+	capabilities.fill(unknown);
+	depth_func = unknown;
+	depth_mask = unknown;
+	color_mask = unknown;
+	cull_face = unknown;
+	polygon_mode = unknown;
+	blend_equation.fill(unknown);
+	blend_func.fill(unknown);
+}
+
+bool GLStateCache::Elide(Call const call, bool const is_redundant)
+{
+	auto& counters = is_redundant ? current_counters.elided_nb : current_counters.issued_nb;
+	++counters[static_cast<std::size_t>(call)];
+	return is_redundant;
+}
+
+void GLStateCache::UseProgram(GLuint const new_program)
+{
+	if (Elide(Call::UseProgram, program == new_program))
+		return;
+
+	glUseProgram(new_program);
+	program = new_program;
+}
+
+void GLStateCache::BindVertexArray(GLuint const new_vao)
+{
+	if (Elide(Call::BindVertexArray, vao == new_vao))
+		return;
+
+	glBindVertexArray(new_vao);
+	vao = new_vao;
+}
+
+void GLStateCache::BindFramebuffer(GLenum const target, GLuint const framebuffer)
+{
+	auto const is_draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+	auto const is_read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+	if (Elide(Call::BindFramebuffer, (!is_draw || draw_framebuffer == framebuffer) && (!is_read || read_framebuffer == framebuffer)))
+		return;
+
+	glBindFramebuffer(target, framebuffer);
+	if (is_draw)
+		draw_framebuffer = framebuffer;
+	if (is_read)
+		read_framebuffer = framebuffer;
+}
+
+void GLStateCache::SetActiveTexture(GLuint const unit)
+{
+	if (Elide(Call::ActiveTexture, active_texture == unit))
+		return;
+
+	glActiveTexture(GL_TEXTURE0 + unit);
+	active_texture = unit;
+}
+
+void GLStateCache::BindTexture(GLuint const unit, GLenum const target, GLuint const texture)
+{
+	auto const target_index = getTargetIndex(target);
+	auto const is_tracked = target_index < tracked_targets_nb;
+	if (is_tracked && textures.size() <= unit) {
+		std::array<GLuint, tracked_targets_nb> unknown_bindings;
+		unknown_bindings.fill(unknown);
+		textures.resize(unit + 1u, unknown_bindings);
+	}
+
+	if (Elide(Call::BindTexture, is_tracked && textures[unit][target_index] == texture))
+		return;
+
+	SetActiveTexture(unit);
+	glBindTexture(target, texture);
+	if (is_tracked)
+		textures[unit][target_index] = texture;
+}
+
+void GLStateCache::BindSampler(GLuint const unit, GLuint const sampler)
+{
+	if (samplers.size() <= unit)
+		samplers.resize(unit + 1u, unknown);
+
+	if (Elide(Call::BindSampler, samplers[unit] == sampler))
+		return;
+
+	glBindSampler(unit, sampler);
+	samplers[unit] = sampler;
+}
+
+void GLStateCache::SetCapability(GLenum const capability, bool const is_enabled)
+{
+	auto index = Capability::Count;
+	switch (capability) {
+		case GL_BLEND:        index = Capability::Blend;       break;
+		case GL_CULL_FACE:    index = Capability::CullFace;    break;
+		case GL_DEPTH_TEST:   index = Capability::DepthTest;   break;
+		case GL_SCISSOR_TEST: index = Capability::ScissorTest; break;
+		case GL_STENCIL_TEST: index = Capability::StencilTest; break;
+		default:                                               break;
+	}
+
+	auto const value = is_enabled ? GLuint(GL_TRUE) : GLuint(GL_FALSE);
+	if (Elide(Call::EnableDisable, index != Capability::Count && capabilities[static_cast<std::size_t>(index)] == value))
+		return;
+
+	if (is_enabled)
+		glEnable(capability);
+	else
+		glDisable(capability);
+	if (index != Capability::Count)
+		capabilities[static_cast<std::size_t>(index)] = value;
+}
+
+void GLStateCache::Enable(GLenum const capability)
+{
+	SetCapability(capability, true);
+}
+
+void GLStateCache::Disable(GLenum const capability)
+{
+	SetCapability(capability, false);
+}
+
+void GLStateCache::DepthFunc(GLenum const func)
+{
+	if (Elide(Call::DepthFunc, depth_func == func))
+		return;
+
+	glDepthFunc(func);
+	depth_func = func;
+}
+
+void GLStateCache::DepthMask(GLboolean const flag)
+{
+	if (Elide(Call::DepthMask, depth_mask == flag))
+		return;
+
+	glDepthMask(flag);
+	depth_mask = flag;
+}
+
+void GLStateCache::ColorMask(GLboolean const red, GLboolean const green, GLboolean const blue, GLboolean const alpha)
+{
+	auto const mask = (red ? 1u : 0u) | (green ? 2u : 0u) | (blue ? 4u : 0u) | (alpha ? 8u : 0u);
+	if (Elide(Call::ColorMask, color_mask == mask))
+		return;
+
+	glColorMask(red, green, blue, alpha);
+	color_mask = mask;
+}
+
+void GLStateCache::CullFace(GLenum const mode)
+{
+	if (Elide(Call::CullFace, cull_face == mode))
+		return;
+
+	glCullFace(mode);
+	cull_face = mode;
+}
+
+void GLStateCache::PolygonMode(GLenum const face, GLenum const mode)
+{
+	auto const is_tracked = face == GL_FRONT_AND_BACK;
+	if (Elide(Call::PolygonMode, is_tracked && polygon_mode == mode))
+		return;
+
+	glPolygonMode(face, mode);
+	polygon_mode = is_tracked ? mode : unknown;
+}
+
+void GLStateCache::BlendEquationSeparate(GLenum const mode_rgb, GLenum const mode_alpha)
+{
+	if (Elide(Call::BlendEquation, blend_equation[0] == mode_rgb && blend_equation[1] == mode_alpha))
+		return;
+
+	glBlendEquationSeparate(mode_rgb, mode_alpha);
+	blend_equation = { mode_rgb, mode_alpha };
+}
+
+void GLStateCache::BlendFuncSeparate(GLenum const src_rgb, GLenum const dst_rgb, GLenum const src_alpha, GLenum const dst_alpha)
+{
+	if (Elide(Call::BlendFunc, blend_func[0] == src_rgb && blend_func[1] == dst_rgb
+	                        && blend_func[2] == src_alpha && blend_func[3] == dst_alpha))
+		return;
+
+	glBlendFuncSeparate(src_rgb, dst_rgb, src_alpha, dst_alpha);
+	blend_func = { src_rgb, dst_rgb, src_alpha, dst_alpha };
+}
+
+GLboolean GLStateCache::GetDepthMask()
+{
+	if (depth_mask == unknown) {
+		GLboolean flag = GL_TRUE;
+		glGetBooleanv(GL_DEPTH_WRITEMASK, &flag);
+		depth_mask = flag;
+	}
+	return static_cast<GLboolean>(depth_mask);
+}
+
+GLStateCache::Counters const& GLStateCache::GetLastFrameCounters() const
+{
+	return last_counters;
+}
+
+void GLStateCache::RenderStatistics(char const* const table_id) const
+{
+	if (!ImGui::BeginTable(table_id, 3, ImGuiTableFlags_SizingFixedFit))
+		return;
+
+	ImGui::TableSetupColumn("Call");
+	ImGui::TableSetupColumn("Issued");
+	ImGui::TableSetupColumn("Elided");
+	ImGui::TableHeadersRow();
+
+	std::uint64_t issued_nb = 0u;
+	std::uint64_t elided_nb = 0u;
+	for (std::size_t i = 0; i < static_cast<std::size_t>(Call::Count); ++i) {
+		ImGui::TableNextColumn();
+		ImGui::Text("%s", call_names[i]);
+		ImGui::TableNextColumn();
+		ImGui::Text("%llu", static_cast<unsigned long long>(last_counters.issued_nb[i]));
+		ImGui::TableNextColumn();
+		ImGui::Text("%llu", static_cast<unsigned long long>(last_counters.elided_nb[i]));
+		issued_nb += last_counters.issued_nb[i];
+		elided_nb += last_counters.elided_nb[i];
+	}
+	ImGui::TableNextColumn();
+	ImGui::Text("Total");
+	ImGui::TableNextColumn();
+	ImGui::Text("%llu", static_cast<unsigned long long>(issued_nb));
+	ImGui::TableNextColumn();
+	ImGui::Text("%llu", static_cast<unsigned long long>(elided_nb));
+
+	ImGui::EndTable();
+}
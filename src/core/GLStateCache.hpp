@@ -0,0 +1,139 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//! \brief Shadow copy of the OpenGL state most often changed while
+//! rendering, dropping the calls which would leave it unchanged.
+//!
+//! Tracked are the bound program, vertex array and framebuffers, the
+//! texture and sampler bindings of each texture unit, and the blending,
+//! depth, stencil, scissor, culling, colour mask and polygon mode states.
+//!
+//! Only changes made through the cache are known to it: code modifying the
+//! same state directly, like resource creation helpers, has to call
+//! `Invalidate()` afterwards, so that the next calls get issued again.
+//! `BeginFrame()` does so as well, which keeps anything done in-between
+//! frames safe. Code restoring the state it modified, like the ImGui
+//! backend, does not need to.
+//!
+//! There is a single cache, as there is a single OpenGL context.
+class GLStateCache
+{
+public:
+	enum class Call : std::uint32_t {
+		UseProgram = 0u,
+		BindVertexArray,
+		BindFramebuffer,
+		ActiveTexture,
+		BindTexture,
+		BindSampler,
+		EnableDisable,
+		DepthFunc,
+		DepthMask,
+		ColorMask,
+		CullFace,
+		PolygonMode,
+		BlendEquation,
+		BlendFunc,
+		Count
+	};
+
+	struct Counters {
+		std::array<std::uint64_t, static_cast<std::size_t>(Call::Count)> issued_nb = {};
+		std::array<std::uint64_t, static_cast<std::size_t>(Call::Count)> elided_nb = {};
+	};
+
+	static GLStateCache& Get();
+
+	GLStateCache(GLStateCache const&) = delete;
+	GLStateCache& operator=(GLStateCache const&) = delete;
+
+	//! \brief Keep the counters of the frame that just ended, and forget
+	//! the whole state; call it once per frame.
+	void BeginFrame();
+
+	//! \brief Forget the whole state, after it was modified without going
+	//! through the cache.
+	void Invalidate();
+
+	void UseProgram(GLuint program);
+	void BindVertexArray(GLuint vao);
+
+	//! \brief Bind `framebuffer` to `target`, which can be
+	//! GL_DRAW_FRAMEBUFFER, GL_READ_FRAMEBUFFER or GL_FRAMEBUFFER for both.
+	void BindFramebuffer(GLenum target, GLuint framebuffer);
+
+	//! \brief Bind `texture` to `target` of texture unit `unit`, which is
+	//! left active.
+	void BindTexture(GLuint unit, GLenum target, GLuint texture);
+	void BindSampler(GLuint unit, GLuint sampler);
+
+	//! \brief Enable or disable `capability`; capabilities other than
+	//! GL_BLEND, GL_CULL_FACE, GL_DEPTH_TEST, GL_SCISSOR_TEST and
+	//! GL_STENCIL_TEST are passed through.
+	void Enable(GLenum capability);
+	void Disable(GLenum capability);
+
+	void DepthFunc(GLenum func);
+	void DepthMask(GLboolean flag);
+	void ColorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha);
+	void CullFace(GLenum mode);
+
+	//! \brief Only GL_FRONT_AND_BACK is a valid `face` in core profiles.
+	void PolygonMode(GLenum face, GLenum mode);
+
+	void BlendEquationSeparate(GLenum mode_rgb, GLenum mode_alpha);
+	void BlendFuncSeparate(GLenum src_rgb, GLenum dst_rgb, GLenum src_alpha, GLenum dst_alpha);
+
+	//! \brief Current depth write mask, only queried from OpenGL if unknown.
+	GLboolean GetDepthMask();
+
+	Counters const& GetLastFrameCounters() const;
+
+	//! \brief Display the calls issued and elided during the last frame in
+	//! an ImGui table.
+	void RenderStatistics(char const* const table_id) const;
+
+private:
+	static constexpr GLuint unknown = ~GLuint(0);
+	static constexpr std::size_t tracked_targets_nb = 5u; // 1D, 2D, 3D, cube map and 2D array
+
+	enum class Capability : std::uint32_t {
+		Blend = 0u,
+		CullFace,
+		DepthTest,
+		ScissorTest,
+		StencilTest,
+		Count
+	};
+
+	GLStateCache();
+
+	void SetCapability(GLenum capability, bool is_enabled);
+	void SetActiveTexture(GLuint unit);
+	bool Elide(Call call, bool is_redundant);
+
+	GLuint program = unknown;
+	GLuint vao = unknown;
+	GLuint draw_framebuffer = unknown;
+	GLuint read_framebuffer = unknown;
+	GLuint active_texture = unknown;
+	std::vector<std::array<GLuint, tracked_targets_nb>> textures; // Per unit and target
+	std::vector<GLuint> samplers;                                 // Per unit
+	std::array<GLuint, static_cast<std::size_t>(Capability::Count)> capabilities;
+	GLuint depth_func = unknown;
+	GLuint depth_mask = unknown;
+	GLuint color_mask = unknown; // One bit per channel
+	GLuint cull_face = unknown;
+	GLuint polygon_mode = unknown;
+	std::array<GLuint, 2> blend_equation;
+	std::array<GLuint, 4> blend_func;
+
+	Counters current_counters;
+	Counters last_counters;
+};
@@ -0,0 +1,565 @@
+#include "GPUMemoryRegistry.hpp"
+
+#include "Log.h"
+#include "various.hpp"
+
+#include <imgui.h>
+
+#include <algorithm>
+#include <cstdio>
+
+namespace
+{
+	PFNGLBUFFERDATAPROC original_buffer_data = nullptr;
+	PFNGLTEXIMAGE1DPROC original_tex_image_1d = nullptr;
+	PFNGLTEXIMAGE2DPROC original_tex_image_2d = nullptr;
+	PFNGLTEXIMAGE3DPROC original_tex_image_3d = nullptr;
+	PFNGLTEXSTORAGE2DPROC original_tex_storage_2d = nullptr;
+	PFNGLTEXSTORAGE3DPROC original_tex_storage_3d = nullptr;
+	PFNGLGENERATEMIPMAPPROC original_generate_mipmap = nullptr;
+	PFNGLRENDERBUFFERSTORAGEPROC original_renderbuffer_storage = nullptr;
+	PFNGLRENDERBUFFERSTORAGEMULTISAMPLEPROC original_renderbuffer_storage_multisample = nullptr;
+	PFNGLDELETEBUFFERSPROC original_delete_buffers = nullptr;
+	PFNGLDELETETEXTURESPROC original_delete_textures = nullptr;
+	PFNGLDELETERENDERBUFFERSPROC original_delete_renderbuffers = nullptr;
+
+	void APIENTRY bufferData(GLenum target, GLsizeiptr size, void const* data, GLenum usage)
+	{
+		original_buffer_data(target, size, data, usage);
+		GPUMemoryRegistry::Get().OnBufferData(target, size, usage);
+	}
+
+	void APIENTRY texImage1D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLint border, GLenum format, GLenum type, void const* pixels)
+	{
+		original_tex_image_1d(target, level, internalformat, width, border, format, type, pixels);
+		GPUMemoryRegistry::Get().OnTexImage(target, level, internalformat, width, 1, 1);
+	}
+
+	void APIENTRY texImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, void const* pixels)
+	{
+		original_tex_image_2d(target, level, internalformat, width, height, border, format, type, pixels);
+		GPUMemoryRegistry::Get().OnTexImage(target, level, internalformat, width, height, 1);
+	}
+
+	void APIENTRY texImage3D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLenum format, GLenum type, void const* pixels)
+	{
+		original_tex_image_3d(target, level, internalformat, width, height, depth, border, format, type, pixels);
+		GPUMemoryRegistry::Get().OnTexImage(target, level, internalformat, width, height, depth);
+	}
+
+	void APIENTRY texStorage2D(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height)
+	{
+		original_tex_storage_2d(target, levels, internalformat, width, height);
+		GPUMemoryRegistry::Get().OnTexStorage(target, levels, internalformat, width, height, 1);
+	}
+
+	void APIENTRY texStorage3D(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height, GLsizei depth)
+	{
+		original_tex_storage_3d(target, levels, internalformat, width, height, depth);
+		GPUMemoryRegistry::Get().OnTexStorage(target, levels, internalformat, width, height, depth);
+	}
+
+	void APIENTRY generateMipmap(GLenum target)
+	{
+		original_generate_mipmap(target);
+		GPUMemoryRegistry::Get().OnGenerateMipmap(target);
+	}
+
+	void APIENTRY renderbufferStorage(GLenum target, GLenum internalformat, GLsizei width, GLsizei height)
+	{
+		original_renderbuffer_storage(target, internalformat, width, height);
+		GPUMemoryRegistry::Get().OnRenderbufferStorage(target, 1, internalformat, width, height);
+	}
+
+	void APIENTRY renderbufferStorageMultisample(GLenum target, GLsizei samples, GLenum internalformat, GLsizei width, GLsizei height)
+	{
+		original_renderbuffer_storage_multisample(target, samples, internalformat, width, height);
+		GPUMemoryRegistry::Get().OnRenderbufferStorage(target, samples, internalformat, width, height);
+	}
+
+	void APIENTRY deleteBuffers(GLsizei n, GLuint const* buffers)
+	{
+		GPUMemoryRegistry::Get().OnDelete(GL_BUFFER, n, buffers);
+		original_delete_buffers(n, buffers);
+	}
+
+	void APIENTRY deleteTextures(GLsizei n, GLuint const* textures)
+	{
+		GPUMemoryRegistry::Get().OnDelete(GL_TEXTURE, n, textures);
+		original_delete_textures(n, textures);
+	}
+
+	void APIENTRY deleteRenderbuffers(GLsizei n, GLuint const* renderbuffers)
+	{
+		GPUMemoryRegistry::Get().OnDelete(GL_RENDERBUFFER, n, renderbuffers);
+		original_delete_renderbuffers(n, renderbuffers);
+	}
+
+	template<typename Pfn>
+	void swapHook(Pfn& variable, Pfn& original, Pfn const hook, bool const install)
+	{
+		if (install) {
+			// Functions unsupported by the context are left alone.
+			if (variable == nullptr || variable == hook)
+				return;
+			original = variable;
+			variable = hook;
+		} else if (variable == hook) {
+			variable = original;
+		}
+	}
+
+	void swapHooks(bool const install)
+	{
+		swapHook(glBufferData, original_buffer_data, &bufferData, install);
+		swapHook(glTexImage1D, original_tex_image_1d, &texImage1D, install);
+		swapHook(glTexImage2D, original_tex_image_2d, &texImage2D, install);
+		swapHook(glTexImage3D, original_tex_image_3d, &texImage3D, install);
+		swapHook(glTexStorage2D, original_tex_storage_2d, &texStorage2D, install);
+		swapHook(glTexStorage3D, original_tex_storage_3d, &texStorage3D, install);
+		swapHook(glGenerateMipmap, original_generate_mipmap, &generateMipmap, install);
+		swapHook(glRenderbufferStorage, original_renderbuffer_storage, &renderbufferStorage, install);
+		swapHook(glRenderbufferStorageMultisample, original_renderbuffer_storage_multisample, &renderbufferStorageMultisample, install);
+		swapHook(glDeleteBuffers, original_delete_buffers, &deleteBuffers, install);
+		swapHook(glDeleteTextures, original_delete_textures, &deleteTextures, install);
+		swapHook(glDeleteRenderbuffers, original_delete_renderbuffers, &deleteRenderbuffers, install);
+	}
+
+	GLuint getBinding(GLenum const binding)
+	{
+		GLint id = 0;
+		glGetIntegerv(binding, &id);
+		return static_cast<GLuint>(id);
+	}
+
+	GLuint getBoundBuffer(GLenum const target)
+	{
+		switch (target) {
+			case GL_ARRAY_BUFFER:              return getBinding(GL_ARRAY_BUFFER_BINDING);
+			case GL_ELEMENT_ARRAY_BUFFER:      return getBinding(GL_ELEMENT_ARRAY_BUFFER_BINDING);
+			case GL_UNIFORM_BUFFER:            return getBinding(GL_UNIFORM_BUFFER_BINDING);
+			case GL_SHADER_STORAGE_BUFFER:     return getBinding(GL_SHADER_STORAGE_BUFFER_BINDING);
+			case GL_PIXEL_PACK_BUFFER:         return getBinding(GL_PIXEL_PACK_BUFFER_BINDING);
+			case GL_PIXEL_UNPACK_BUFFER:       return getBinding(GL_PIXEL_UNPACK_BUFFER_BINDING);
+			case GL_COPY_READ_BUFFER:          return getBinding(GL_COPY_READ_BUFFER_BINDING);
+			case GL_COPY_WRITE_BUFFER:         return getBinding(GL_COPY_WRITE_BUFFER_BINDING);
+			case GL_DRAW_INDIRECT_BUFFER:      return getBinding(GL_DRAW_INDIRECT_BUFFER_BINDING);
+			case GL_DISPATCH_INDIRECT_BUFFER:  return getBinding(GL_DISPATCH_INDIRECT_BUFFER_BINDING);
+			case GL_ATOMIC_COUNTER_BUFFER:     return getBinding(GL_ATOMIC_COUNTER_BUFFER_BINDING);
+			case GL_TRANSFORM_FEEDBACK_BUFFER: return getBinding(GL_TRANSFORM_FEEDBACK_BUFFER_BINDING);
+			default:                           return 0u;
+		}
+	}
+
+	bool isCubeMapFace(GLenum const target)
+	{
+		return target >= GL_TEXTURE_CUBE_MAP_POSITIVE_X && target <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z;
+	}
+
+	GLuint getBoundTexture(GLenum const target)
+	{
+		if (isCubeMapFace(target))
+			return getBinding(GL_TEXTURE_BINDING_CUBE_MAP);
+
+		switch (target) {
+			case GL_TEXTURE_1D:             return getBinding(GL_TEXTURE_BINDING_1D);
+			case GL_TEXTURE_2D:             return getBinding(GL_TEXTURE_BINDING_2D);
+			case GL_TEXTURE_3D:             return getBinding(GL_TEXTURE_BINDING_3D);
+			case GL_TEXTURE_1D_ARRAY:       return getBinding(GL_TEXTURE_BINDING_1D_ARRAY);
+			case GL_TEXTURE_2D_ARRAY:       return getBinding(GL_TEXTURE_BINDING_2D_ARRAY);
+			case GL_TEXTURE_RECTANGLE:      return getBinding(GL_TEXTURE_BINDING_RECTANGLE);
+			case GL_TEXTURE_CUBE_MAP:       return getBinding(GL_TEXTURE_BINDING_CUBE_MAP);
+			case GL_TEXTURE_CUBE_MAP_ARRAY: return getBinding(GL_TEXTURE_BINDING_CUBE_MAP_ARRAY);
+			default:                        return 0u; // Including proxy targets
+		}
+	}
+
+	std::string getEnumName(GLenum const value)
+	{
+		switch (value) {
+			case GL_RED:                return "GL_RED";
+			case GL_RG:                 return "GL_RG";
+			case GL_RGB:                return "GL_RGB";
+			case GL_RGBA:               return "GL_RGBA";
+			case GL_R8:                 return "GL_R8";
+			case GL_RG8:                return "GL_RG8";
+			case GL_RGB8:               return "GL_RGB8";
+			case GL_RGBA8:              return "GL_RGBA8";
+			case GL_SRGB8_ALPHA8:       return "GL_SRGB8_ALPHA8";
+			case GL_RG16:               return "GL_RG16";
+			case GL_RGBA16:             return "GL_RGBA16";
+			case GL_R16F:               return "GL_R16F";
+			case GL_RG16F:              return "GL_RG16F";
+			case GL_RGBA16F:            return "GL_RGBA16F";
+			case GL_R32F:               return "GL_R32F";
+			case GL_RG32F:              return "GL_RG32F";
+			case GL_RGB32F:             return "GL_RGB32F";
+			case GL_RGBA32F:            return "GL_RGBA32F";
+			case GL_R32UI:              return "GL_R32UI";
+			case GL_RGBA32UI:           return "GL_RGBA32UI";
+			case GL_R11F_G11F_B10F:     return "GL_R11F_G11F_B10F";
+			case GL_RGB10_A2:           return "GL_RGB10_A2";
+			case GL_DEPTH_COMPONENT:    return "GL_DEPTH_COMPONENT";
+			case GL_DEPTH_COMPONENT16:  return "GL_DEPTH_COMPONENT16";
+			case GL_DEPTH_COMPONENT24:  return "GL_DEPTH_COMPONENT24";
+			case GL_DEPTH_COMPONENT32F: return "GL_DEPTH_COMPONENT32F";
+			case GL_DEPTH_STENCIL:      return "GL_DEPTH_STENCIL";
+			case GL_DEPTH24_STENCIL8:   return "GL_DEPTH24_STENCIL8";
+			case GL_DEPTH32F_STENCIL8:  return "GL_DEPTH32F_STENCIL8";
+			case GL_STATIC_DRAW:        return "GL_STATIC_DRAW";
+			case GL_DYNAMIC_DRAW:       return "GL_DYNAMIC_DRAW";
+			case GL_STREAM_DRAW:        return "GL_STREAM_DRAW";
+			case GL_STATIC_READ:        return "GL_STATIC_READ";
+			case GL_DYNAMIC_READ:       return "GL_DYNAMIC_READ";
+			case GL_STREAM_READ:        return "GL_STREAM_READ";
+			case GL_STATIC_COPY:        return "GL_STATIC_COPY";
+			case GL_DYNAMIC_COPY:       return "GL_DYNAMIC_COPY";
+			case GL_STREAM_COPY:        return "GL_STREAM_COPY";
+			default:
+				break;
+		}
+
+		char buffer[16];
+		std::snprintf(buffer, sizeof(buffer), "0x%04X", value);
+		return buffer;
+	}
+
+	char const* getTypeName(GLenum const type)
+	{
+		switch (type) {
+			case GL_BUFFER:       return "Buffer";
+			case GL_TEXTURE:      return "Texture";
+			case GL_RENDERBUFFER: return "Renderbuffer";
+			default:              return "Unknown";
+		}
+	}
+
+	std::size_t getMipSize(GLsizei const size, GLsizei const level)
+	{
+		return static_cast<std::size_t>(std::max(size >> level, 1));
+	}
+}
+
+GPUMemoryRegistry::Scope::Scope(std::string const& site)
+{
+	GPUMemoryRegistry::Get().sites.push_back(site);
+}
+
+GPUMemoryRegistry::Scope::~Scope()
+{
+	GPUMemoryRegistry::Get().sites.pop_back();
+}
+
+GPUMemoryRegistry& GPUMemoryRegistry::Get()
+{
+	static GPUMemoryRegistry registry;
+	return registry;
+}
+
+void GPUMemoryRegistry::Install()
+{
+	if (is_installed)
+		return;
+
+	swapHooks(true);
+	is_installed = true;
+}
+
+void GPUMemoryRegistry::Uninstall()
+{
+	if (!is_installed)
+		return;
+
+	swapHooks(false);
+	is_installed = false;
+	entries.clear();
+	UpdateTotal();
+}
+
+void GPUMemoryRegistry::SetLabel(GLenum const type, GLuint const id, std::string const& label)
+{
+	if (!is_installed || id == 0u)
+		return;
+	if (type != GL_BUFFER && type != GL_TEXTURE && type != GL_RENDERBUFFER)
+		return;
+
+	GetEntry(type, id).allocation.label = label;
+}
+
+void GPUMemoryRegistry::SetBudget(std::size_t const bytes)
+{
+	budget = bytes;
+	is_over_budget = false;
+	UpdateTotal();
+}
+
+std::size_t GPUMemoryRegistry::GetBudget() const
+{
+	return budget;
+}
+
+std::size_t GPUMemoryRegistry::GetTotalSize() const
+{
+	return total_size;
+}
+
+std::size_t GPUMemoryRegistry::GetTotalSize(GLenum const type) const
+{
+	std::size_t size = 0u;
+	for (auto const& entry : entries)
+		if (entry.first.first == type)
+			size += entry.second.allocation.size;
+	return size;
+}
+
+std::vector<GPUMemoryRegistry::Allocation> GPUMemoryRegistry::GetAllocations() const
+{
+	std::vector<Allocation> allocations;
+	allocations.reserve(entries.size());
+	for (auto const& entry : entries)
+		allocations.push_back(entry.second.allocation);
+	std::sort(allocations.begin(), allocations.end(),
+	          [](Allocation const& lhs, Allocation const& rhs){ return lhs.size > rhs.size; });
+	return allocations;
+}
+
+void GPUMemoryRegistry::ReportLeaks() const
+{
+	if (entries.empty()) {
+		LogInfo("No GPU memory leaked.");
+		return;
+	}
+
+	LogWarning("%zu objects totalling %s are still allocated:", entries.size(), utils::formatBytes(total_size).c_str());
+	for (auto const& allocation : GetAllocations()) {
+		LogWarning("* %s %u \"%s\", %s (%s), allocated by %s", getTypeName(allocation.type), allocation.id,
+		           allocation.label.c_str(), utils::formatBytes(allocation.size).c_str(), allocation.format.c_str(),
+		           allocation.site.empty() ? "an unknown site" : allocation.site.c_str());
+	}
+}
+
+void GPUMemoryRegistry::RenderPanel()
+{
+	bool const opened = ImGui::Begin("GPU memory", nullptr, ImGuiWindowFlags_None);
+	if (!opened) {
+		ImGui::End();
+		return;
+	}
+
+	ImGui::Text("Total: %s (buffers: %s, textures: %s, renderbuffers: %s)", utils::formatBytes(total_size).c_str(),
+	            utils::formatBytes(GetTotalSize(GL_BUFFER)).c_str(), utils::formatBytes(GetTotalSize(GL_TEXTURE)).c_str(),
+	            utils::formatBytes(GetTotalSize(GL_RENDERBUFFER)).c_str());
+
+	auto budget_mib = static_cast<int>(budget / (1024u * 1024u));
+	if (ImGui::SliderInt("Budget (MiB)", &budget_mib, 0, 8192))
+		SetBudget(static_cast<std::size_t>(budget_mib) * 1024u * 1024u);
+	if (budget > 0u) {
+		auto const usage = static_cast<float>(static_cast<double>(total_size) / static_cast<double>(budget));
+		if (is_over_budget)
+			ImGui::PushStyleColor(ImGuiCol_PlotHistogram, ImVec4(0.8f, 0.2f, 0.2f, 1.0f));
+		ImGui::ProgressBar(std::min(usage, 1.0f), ImVec2(-1.0f, 0.0f));
+		if (is_over_budget)
+			ImGui::PopStyleColor();
+	}
+
+	if (ImGui::BeginTable("GPU allocations", 5, ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY,
+	                      ImVec2(0.0f, 300.0f))) {
+		ImGui::TableSetupScrollFreeze(0, 1);
+		ImGui::TableSetupColumn("Type");
+		ImGui::TableSetupColumn("Label");
+		ImGui::TableSetupColumn("Size");
+		ImGui::TableSetupColumn("Format");
+		ImGui::TableSetupColumn("Site");
+		ImGui::TableHeadersRow();
+
+		for (auto const& allocation : GetAllocations()) {
+			ImGui::TableNextColumn();
+			ImGui::Text("%s %u", getTypeName(allocation.type), allocation.id);
+			ImGui::TableNextColumn();
+			ImGui::Text("%s", allocation.label.c_str());
+			ImGui::TableNextColumn();
+			ImGui::Text("%s", utils::formatBytes(allocation.size).c_str());
+			ImGui::TableNextColumn();
+			ImGui::Text("%s", allocation.format.c_str());
+			ImGui::TableNextColumn();
+			ImGui::Text("%s", allocation.site.c_str());
+		}
+
+		ImGui::EndTable();
+	}
+
+	ImGui::End();
+}
+
+std::size_t GPUMemoryRegistry::GetBytesPerTexel(GLint const internal_format)
+{
+	switch (internal_format) {
+		case GL_RED:
+		case GL_R8:
+			return 1u;
+		case GL_RG:
+		case GL_RG8:
+		case GL_R16F:
+		case GL_DEPTH_COMPONENT16:
+			return 2u;
+		case GL_RGB16F:
+			return 6u;
+		case GL_RGBA16F:
+		case GL_RG32F:
+		case GL_RGBA16:
+			return 8u;
+		case GL_RGB32F:
+			return 12u;
+		case GL_RGBA32F:
+		case GL_RGBA32UI:
+			return 16u;
+		case GL_DEPTH32F_STENCIL8:
+			return 5u;
+		default:
+			// Most other formats used, like GL_RGBA8, GL_RG16,
+			// GL_R11F_G11F_B10F, GL_R32F or GL_DEPTH24_STENCIL8, but also
+			// the unsized GL_RGB and GL_RGBA.
+			return 4u;
+	}
+}
+
+void GPUMemoryRegistry::OnBufferData(GLenum const target, GLsizeiptr const size, GLenum const usage)
+{
+	if (!is_installed)
+		return;
+	auto const id = getBoundBuffer(target);
+	if (id == 0u)
+		return;
+
+	auto& allocation = GetEntry(GL_BUFFER, id).allocation;
+	allocation.size = static_cast<std::size_t>(size);
+	allocation.format = getEnumName(usage);
+	UpdateTotal();
+}
+
+void GPUMemoryRegistry::OnTexImage(GLenum const target, GLint const level, GLint const internal_format, GLsizei const width, GLsizei const height, GLsizei const depth)
+{
+	if (!is_installed)
+		return;
+	auto const id = getBoundTexture(target);
+	if (id == 0u)
+		return;
+
+	auto& entry = GetEntry(GL_TEXTURE, id);
+	entry.images[{ target, level }] = GetBytesPerTexel(internal_format) * static_cast<std::size_t>(std::max(width, 0))
+	                                * static_cast<std::size_t>(std::max(height, 0)) * static_cast<std::size_t>(std::max(depth, 0));
+	if (level == 0) {
+		entry.allocation.format = getEnumName(static_cast<GLenum>(internal_format));
+		entry.has_generated_mipmaps = false;
+	}
+	UpdateTextureSize(entry);
+}
+
+void GPUMemoryRegistry::OnTexStorage(GLenum const target, GLsizei const levels, GLenum const internal_format, GLsizei const width, GLsizei const height, GLsizei const depth)
+{
+	if (!is_installed)
+		return;
+	auto const id = getBoundTexture(target);
+	if (id == 0u)
+		return;
+
+	// Layers are not affected by the mipmapping.
+	auto const are_rows_layers = target == GL_TEXTURE_1D_ARRAY;
+	auto const are_slices_layers = target == GL_TEXTURE_2D_ARRAY || target == GL_TEXTURE_CUBE_MAP_ARRAY;
+	auto const faces_nb = target == GL_TEXTURE_CUBE_MAP ? 6u : 1u;
+
+	auto& entry = GetEntry(GL_TEXTURE, id);
+	entry.images.clear();
+	for (GLsizei level = 0; level < levels; ++level) {
+		entry.images[{ target, level }] = GetBytesPerTexel(static_cast<GLint>(internal_format)) * faces_nb
+		                                * getMipSize(width, level)
+		                                * (are_rows_layers ? static_cast<std::size_t>(height) : getMipSize(height, level))
+		                                * (are_slices_layers ? static_cast<std::size_t>(depth) : getMipSize(depth, level));
+	}
+	entry.allocation.format = getEnumName(internal_format);
+	entry.has_generated_mipmaps = false;
+	UpdateTextureSize(entry);
+}
+
+void GPUMemoryRegistry::OnGenerateMipmap(GLenum const target)
+{
+	if (!is_installed)
+		return;
+	auto const id = getBoundTexture(target);
+	if (id == 0u)
+		return;
+
+	auto& entry = GetEntry(GL_TEXTURE, id);
+	entry.has_generated_mipmaps = true;
+	UpdateTextureSize(entry);
+}
+
+void GPUMemoryRegistry::OnRenderbufferStorage(GLenum const /*target*/, GLsizei const samples, GLenum const internal_format, GLsizei const width, GLsizei const height)
+{
+	if (!is_installed)
+		return;
+	auto const id = getBinding(GL_RENDERBUFFER_BINDING);
+	if (id == 0u)
+		return;
+
+	auto& allocation = GetEntry(GL_RENDERBUFFER, id).allocation;
+	allocation.size = GetBytesPerTexel(static_cast<GLint>(internal_format)) * static_cast<std::size_t>(std::max(samples, 1))
+	                * static_cast<std::size_t>(std::max(width, 0)) * static_cast<std::size_t>(std::max(height, 0));
+	allocation.format = getEnumName(internal_format);
+	UpdateTotal();
+}
+
+void GPUMemoryRegistry::OnDelete(GLenum const type, GLsizei const n, GLuint const* const ids)
+{
+	if (!is_installed)
+		return;
+	for (GLsizei i = 0; i < n; ++i)
+		entries.erase({ type, ids[i] });
+	UpdateTotal();
+}
+
+GPUMemoryRegistry::Entry& GPUMemoryRegistry::GetEntry(GLenum const type, GLuint const id)
+{
+	auto& entry = entries[{ type, id }];
+	entry.allocation.type = type;
+	entry.allocation.id = id;
+
+	// Keep the site of the first allocation, as reallocations are usually
+	// done elsewhere, like when resizing.
+	if (entry.allocation.site.empty() && !sites.empty()) {
+		for (auto const& site : sites) {
+			if (!entry.allocation.site.empty())
+				entry.allocation.site += " > ";
+			entry.allocation.site += site;
+		}
+	}
+	return entry;
+}
+
+void GPUMemoryRegistry::UpdateTextureSize(Entry& entry)
+{
+	std::size_t size = 0u;
+	std::size_t base_size = 0u;
+	for (auto const& image : entry.images) {
+		size += image.second;
+		if (image.first.second == 0)
+			base_size += image.second;
+	}
+	// The generated levels add up to a third of the base level.
+	if (entry.has_generated_mipmaps)
+		size = base_size + base_size / 3u;
+	entry.allocation.size = size;
+	UpdateTotal();
+}
+
+void GPUMemoryRegistry::UpdateTotal()
+{
+	total_size = 0u;
+	for (auto const& entry : entries)
+		total_size += entry.second.allocation.size;
+
+	auto const was_over_budget = is_over_budget;
+	is_over_budget = budget > 0u && total_size > budget;
+	if (is_over_budget && !was_over_budget)
+		LogWarning("GPU memory usage (%s) went over its budget of %s.", utils::formatBytes(total_size).c_str(), utils::formatBytes(budget).c_str());
+}
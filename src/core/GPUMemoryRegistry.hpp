@@ -0,0 +1,114 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+//! \brief Registry of the buffers, textures and renderbuffers currently
+//! allocated, along with their size.
+//!
+//! Once installed, the registry wraps the GLAD function pointers allocating
+//! storage (`glBufferData()`, `glTexImage*()`, `glTexStorage*()`,
+//! `glGenerateMipmap()` and `glRenderbufferStorage*()`), attributing the
+//! storage to the object bound to the given target, and the ones deleting
+//! objects. Every allocation is thus accounted for, whoever makes it.
+//!
+//! Objects are labelled with the names given to
+//! `utils::opengl::debug::nameObject()`, and remember the creation sites that
+//! were active when their storage was allocated; see `Scope`.
+//!
+//! Sizes are estimates: texel sizes are derived from the internal formats,
+//! and do not account for padding or compression done by the driver.
+class GPUMemoryRegistry
+{
+public:
+	//! \brief Creation site attributed to all allocations done during its
+	//! lifetime; nested sites are joined together.
+	class Scope
+	{
+	public:
+		explicit Scope(std::string const& site);
+		~Scope();
+		Scope(Scope const&) = delete;
+		Scope& operator=(Scope const&) = delete;
+	};
+
+	struct Allocation {
+		GLenum type = GL_NONE; //!< GL_BUFFER, GL_TEXTURE or GL_RENDERBUFFER
+		GLuint id = 0u;
+		std::size_t size = 0u; //!< In bytes
+		std::string format;
+		std::string label;
+		std::string site;
+	};
+
+	static GPUMemoryRegistry& Get();
+
+	GPUMemoryRegistry(GPUMemoryRegistry const&) = delete;
+	GPUMemoryRegistry& operator=(GPUMemoryRegistry const&) = delete;
+
+	//! \brief Start tracking allocations; GLAD has to be loaded first.
+	void Install();
+
+	//! \brief Stop tracking allocations, and forget the current ones.
+	void Uninstall();
+
+	//! \brief Associate `label` to the object, if it is of a tracked type.
+	void SetLabel(GLenum type, GLuint id, std::string const& label);
+
+	//! \brief Warn whenever the total size goes over `bytes`; 0 disables
+	//! the warnings.
+	void SetBudget(std::size_t bytes);
+	std::size_t GetBudget() const;
+
+	std::size_t GetTotalSize() const;
+	std::size_t GetTotalSize(GLenum type) const;
+	std::vector<Allocation> GetAllocations() const;
+
+	//! \brief Log every object which is still allocated; meant to be called
+	//! once everything should have been released.
+	void ReportLeaks() const;
+
+	//! \brief Display the allocations and the budget in their own ImGui
+	//! window.
+	void RenderPanel();
+
+	//! \brief Size of a texel of the given internal format, in bytes.
+	static std::size_t GetBytesPerTexel(GLint internal_format);
+
+	// Used by the wrappers; not meant to be called directly.
+	void OnBufferData(GLenum target, GLsizeiptr size, GLenum usage);
+	void OnTexImage(GLenum target, GLint level, GLint internal_format, GLsizei width, GLsizei height, GLsizei depth);
+	void OnTexStorage(GLenum target, GLsizei levels, GLenum internal_format, GLsizei width, GLsizei height, GLsizei depth);
+	void OnGenerateMipmap(GLenum target);
+	void OnRenderbufferStorage(GLenum target, GLsizei samples, GLenum internal_format, GLsizei width, GLsizei height);
+	void OnDelete(GLenum type, GLsizei n, GLuint const* ids);
+
+private:
+	using Key = std::pair<GLenum, GLuint>;
+
+	struct Entry {
+		Allocation allocation;
+		// Texture images per (target, level); cube map faces are separate
+		// targets.
+		std::map<std::pair<GLenum, GLint>, std::size_t> images;
+		bool has_generated_mipmaps = false;
+	};
+
+	GPUMemoryRegistry() = default;
+
+	Entry& GetEntry(GLenum type, GLuint id);
+	void UpdateTextureSize(Entry& entry);
+	void UpdateTotal();
+
+	std::map<Key, Entry> entries;
+	std::vector<std::string> sites;
+	std::size_t total_size = 0u;
+	std::size_t budget = std::size_t(1024u) * 1024u * 1024u;
+	bool is_over_budget = false;
+	bool is_installed = false;
+};
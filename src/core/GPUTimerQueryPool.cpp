@@ -0,0 +1,244 @@
+#include "GPUTimerQueryPool.hpp"
+
+#include "Log.h"
+#include "opengl.hpp"
+#include "Profiler.h"
+#include "various.hpp"
+
+#include <imgui.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+GPUTimerQueryPool::GPUTimerQueryPool(std::size_t requested_latency_frames_nb, std::size_t requested_history_size) :
+	latency_frames_nb(std::max<std::size_t>(requested_latency_frames_nb, 2u)),
+	history_size(std::max<std::size_t>(requested_history_size, 1u))
+{
+	if (requested_latency_frames_nb < 2u)
+		LogWarning("A latency of %zu frame(s) would stall the CPU; using 2 instead.", requested_latency_frames_nb);
+}
+
+GPUTimerQueryPool::~GPUTimerQueryPool()
+{
+	for (auto& timer : timers)
+		glDeleteQueries(static_cast<GLsizei>(timer.queries.size()), timer.queries.data());
+}
+
+std::size_t GPUTimerQueryPool::RegisterTimer(std::string const& name)
+{
+	Timer timer;
+	timer.name = name;
+	timer.queries.resize(latency_frames_nb, 0u);
+	timer.was_issued.resize(latency_frames_nb, false);
+	timer.history.reserve(history_size);
+	glGenQueries(static_cast<GLsizei>(timer.queries.size()), timer.queries.data());
+
+	if (utils::opengl::debug::isSupported()) {
+		for (std::size_t i = 0; i < timer.queries.size(); ++i) {
+			// Queries (like any other OpenGL object) need to have been used
+			// at least once to ensure their resources have been allocated so
+			// we can call `glObjectLabel()` on them.
+			glBeginQuery(GL_TIME_ELAPSED, timer.queries[i]);
+			glEndQuery(GL_TIME_ELAPSED);
+			utils::opengl::debug::nameObject(GL_QUERY, timer.queries[i], name + " #" + std::to_string(i));
+		}
+	}
+
+	timers.emplace_back(std::move(timer));
+	return timers.size() - 1u;
+}
+
+void GPUTimerQueryPool::BeginFrame()
+{
+	PROFILE_FUNCTION();
+
+	current_frame = (current_frame + 1u) % latency_frames_nb;
+
+	// The queries about to be reused were issued `latency_frames_nb - 1`
+	// frames ago: only read them back if the GPU is done with them.
+	for (auto& timer : timers) {
+		if (!timer.was_issued[current_frame])
+			continue;
+		timer.was_issued[current_frame] = false;
+
+		auto const query = timer.queries[current_frame];
+		GLint is_available = GL_FALSE;
+		glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &is_available);
+		if (is_available == GL_FALSE) {
+			++dropped_samples_nb;
+			continue;
+		}
+
+		GLuint64 elapsed_time = 0u;
+		glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed_time);
+		timer.last_ms = static_cast<double>(elapsed_time) / 1000000.0;
+		if (timer.history.size() < history_size)
+			timer.history.push_back(timer.last_ms);
+		else
+			timer.history[timer.history_next] = timer.last_ms;
+		timer.history_next = (timer.history_next + 1u) % history_size;
+		++timer.samples_nb;
+	}
+}
+
+void GPUTimerQueryPool::BeginTimer(std::size_t timer)
+{
+	if (timer >= timers.size()) {
+		LogError("Invalid timer index '%zu': only %zu timers are registered.", timer, timers.size());
+		return;
+	}
+
+	glBeginQuery(GL_TIME_ELAPSED, timers[timer].queries[current_frame]);
+}
+
+void GPUTimerQueryPool::EndTimer(std::size_t timer)
+{
+	if (timer >= timers.size()) {
+		LogError("Invalid timer index '%zu': only %zu timers are registered.", timer, timers.size());
+		return;
+	}
+
+	glEndQuery(GL_TIME_ELAPSED);
+	timers[timer].was_issued[current_frame] = true;
+}
+
+std::size_t GPUTimerQueryPool::GetLatencyFramesCount() const
+{
+	return latency_frames_nb;
+}
+
+std::size_t GPUTimerQueryPool::GetTimersCount() const
+{
+	return timers.size();
+}
+
+std::string const& GPUTimerQueryPool::GetTimerName(std::size_t timer) const
+{
+	return timers.at(timer).name;
+}
+
+GPUTimerQueryPool::Statistics GPUTimerQueryPool::GetStatistics(std::size_t timer) const
+{
+	Statistics statistics;
+	if (timer >= timers.size())
+		return statistics;
+
+	auto sorted_history = timers[timer].history;
+	if (sorted_history.empty())
+		return statistics;
+	std::sort(sorted_history.begin(), sorted_history.end());
+
+	// Nearest-rank percentiles.
+	auto const percentile = [&sorted_history](double const p){
+		auto const rank = static_cast<std::size_t>(std::ceil(p * static_cast<double>(sorted_history.size())));
+		return sorted_history[std::min(std::max<std::size_t>(rank, 1u), sorted_history.size()) - 1u];
+	};
+
+	double sum = 0.0;
+	for (auto const duration : sorted_history)
+		sum += duration;
+
+	statistics.samples_nb = timers[timer].samples_nb;
+	statistics.last_ms = timers[timer].last_ms;
+	statistics.mean_ms = sum / static_cast<double>(sorted_history.size());
+	statistics.p95_ms = percentile(0.95);
+	statistics.p99_ms = percentile(0.99);
+	statistics.max_ms = sorted_history.back();
+	return statistics;
+}
+
+std::uint64_t GPUTimerQueryPool::GetDroppedSamplesCount() const
+{
+	return dropped_samples_nb;
+}
+
+void GPUTimerQueryPool::ResetStatistics()
+{
+	for (auto& timer : timers) {
+		timer.history.clear();
+		timer.history_next = 0u;
+		timer.samples_nb = 0u;
+		timer.last_ms = 0.0;
+	}
+	dropped_samples_nb = 0u;
+}
+
+void GPUTimerQueryPool::RenderStatisticsTable(char const* const table_id)
+{
+	if (!ImGui::BeginTable(table_id, 5, ImGuiTableFlags_SizingFixedFit))
+		return;
+
+	ImGui::TableSetupColumn("Pass");
+	ImGui::TableSetupColumn("Mean [ms]");
+	ImGui::TableSetupColumn("P95 [ms]");
+	ImGui::TableSetupColumn("P99 [ms]");
+	ImGui::TableSetupColumn("Max [ms]");
+	ImGui::TableHeadersRow();
+
+	for (std::size_t i = 0; i < timers.size(); ++i) {
+		auto const statistics = GetStatistics(i);
+		ImGui::TableNextColumn();
+		ImGui::Text("%s", timers[i].name.c_str());
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", statistics.mean_ms);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", statistics.p95_ms);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", statistics.p99_ms);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", statistics.max_ms);
+	}
+
+	ImGui::EndTable();
+}
+
+bool GPUTimerQueryPool::ExportCSV(std::string const& filename) const
+{
+	std::ofstream file(filename);
+	if (!file) {
+		LogError("Failed to open \"%s\" for writing the GPU timings.", filename.c_str());
+		return false;
+	}
+
+	file << "pass,samples,last_ms,mean_ms,p95_ms,p99_ms,max_ms\n";
+	for (std::size_t i = 0; i < timers.size(); ++i) {
+		auto const statistics = GetStatistics(i);
+		file << utils::quoteCSV(timers[i].name) << ','
+		     << statistics.samples_nb << ','
+		     << statistics.last_ms << ','
+		     << statistics.mean_ms << ','
+		     << statistics.p95_ms << ','
+		     << statistics.p99_ms << ','
+		     << statistics.max_ms << '\n';
+	}
+
+	LogInfo("GPU timings exported to \"%s\".", filename.c_str());
+	return true;
+}
+
+bool GPUTimerQueryPool::ExportJSON(std::string const& filename) const
+{
+	std::ofstream file(filename);
+	if (!file) {
+		LogError("Failed to open \"%s\" for writing the GPU timings.", filename.c_str());
+		return false;
+	}
+
+	file << "{\n\t\"dropped_samples\": " << dropped_samples_nb << ",\n\t\"passes\": [";
+	for (std::size_t i = 0; i < timers.size(); ++i) {
+		auto const statistics = GetStatistics(i);
+		file << (i == 0u ? "\n" : ",\n")
+		     << "\t\t{ \"name\": \"" << utils::escapeJSON(timers[i].name) << "\""
+		     << ", \"samples\": " << statistics.samples_nb
+		     << ", \"last_ms\": " << statistics.last_ms
+		     << ", \"mean_ms\": " << statistics.mean_ms
+		     << ", \"p95_ms\": " << statistics.p95_ms
+		     << ", \"p99_ms\": " << statistics.p99_ms
+		     << ", \"max_ms\": " << statistics.max_ms << " }";
+	}
+	file << "\n\t]\n}\n";
+
+	LogInfo("GPU timings exported to \"%s\".", filename.c_str());
+	return true;
+}
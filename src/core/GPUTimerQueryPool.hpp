@@ -0,0 +1,93 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//! \brief Pool of GL_TIME_ELAPSED queries, read back a few frames late so that
+//! fetching GPU timings never stalls the CPU.
+//!
+//! Each registered timer owns one query per in-flight frame. At the start of a
+//! frame, the queries issued `latency_frames_nb` frames ago are polled with
+//! GL_QUERY_RESULT_AVAILABLE; results that are ready are added to a rolling
+//! history, and the others are dropped rather than waited upon.
+//!
+//! As with plain GL_TIME_ELAPSED queries, timers can not be nested: only one
+//! of them can be running at any given time.
+class GPUTimerQueryPool
+{
+public:
+	struct Statistics {
+		std::size_t samples_nb = 0u;
+		double last_ms = 0.0;
+		double mean_ms = 0.0;
+		double p95_ms = 0.0;
+		double p99_ms = 0.0;
+		double max_ms = 0.0;
+	};
+
+	//! \param [in] latency_frames_nb how many frames to wait for before
+	//!             reading back a timer; must be at least 2 to avoid stalls
+	//! \param [in] history_size how many samples per timer are kept for
+	//!             computing the statistics
+	explicit GPUTimerQueryPool(std::size_t latency_frames_nb = 4u, std::size_t history_size = 256u);
+	~GPUTimerQueryPool();
+	GPUTimerQueryPool(GPUTimerQueryPool const&) = delete;
+	GPUTimerQueryPool& operator=(GPUTimerQueryPool const&) = delete;
+
+	//! \brief Add a new timer to the pool.
+	//!
+	//! This should not be called while a timer is running.
+	//!
+	//! \param [in] name used for labelling the queries and in the exports
+	//! \return the identifier of the timer, which are handed out
+	//!         sequentially starting from 0
+	std::size_t RegisterTimer(std::string const& name);
+
+	//! \brief Collect the available results from older frames, and move on
+	//! to the next set of queries.
+	//!
+	//! Call it once per frame, before any timer is started.
+	void BeginFrame();
+
+	void BeginTimer(std::size_t timer);
+	void EndTimer(std::size_t timer);
+
+	std::size_t GetLatencyFramesCount() const;
+	std::size_t GetTimersCount() const;
+	std::string const& GetTimerName(std::size_t timer) const;
+	Statistics GetStatistics(std::size_t timer) const;
+
+	//! \brief How many results were discarded as they were still not
+	//! available after `latency_frames_nb` frames.
+	std::uint64_t GetDroppedSamplesCount() const;
+
+	//! \brief Clear the history of all timers.
+	void ResetStatistics();
+
+	//! \brief Display the statistics of all timers in an ImGui table.
+	void RenderStatisticsTable(char const* const table_id);
+
+	bool ExportCSV(std::string const& filename) const;
+	bool ExportJSON(std::string const& filename) const;
+
+private:
+	struct Timer {
+		std::string name;
+		std::vector<GLuint> queries;  // One per in-flight frame
+		std::vector<bool> was_issued; // One per in-flight frame
+		std::vector<double> history;  // Ring buffer of durations, in ms
+		std::size_t history_next = 0u;
+		std::size_t samples_nb = 0u;
+		double last_ms = 0.0;
+	};
+
+	std::size_t latency_frames_nb;
+	std::size_t history_size;
+	std::size_t current_frame = 0u;
+	std::uint64_t dropped_samples_nb = 0u;
+	std::vector<Timer> timers;
+};
@@ -21,6 +21,7 @@ void (* textout_func)(Type, const char *) = nullptr;
 std::unordered_map<size_t, size_t> once_map;
 size_t output_targets = LOG_OUT_STD | LOG_OUT_CUSTOM | LOG_OUT_FILE;
 std::mutex fileMutex;
+std::mutex reportMutex; // Report() is called from worker threads as well
 char log_result_string[RESULT_MAX_STRING_LENGTH];
 bool logIncludeThreadID = false;
 
@@ -125,6 +126,7 @@ void Report(
 {
 	if (output_targets == 0)
 		return;
+	std::unique_lock<std::mutex> lock(reportMutex);
 	size_t t = size_t(type);
 #ifndef LOG_WHISPERS
 	if (logSettings[t].verbosity == Verbosity::WHISPER)
@@ -190,6 +192,7 @@ void Report(
   		__debugbreak();
 #endif
 	if (logSettings[t].severity == Severity::TERMINAL) {
+		lock.unlock();
 		Destroy();
 		exit(1); // TODO: Proper deconstruction
 	}
@@ -0,0 +1,380 @@
+#include "Profiler.h"
+
+#if defined ENABLE_PROFILING && ENABLE_PROFILING != 0
+
+#include "Log.h"
+#include "various.hpp"
+
+#include <imgui.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <set>
+#include <utility>
+
+namespace
+{
+	constexpr std::size_t thread_buffer_capacity = 8192u;
+
+	double toMicroseconds(std::uint64_t ns)
+	{
+		return static_cast<double>(ns) / 1000.0;
+	}
+
+	double toMilliseconds(std::uint64_t ns)
+	{
+		return static_cast<double>(ns) / 1000000.0;
+	}
+}
+
+// Single producer (the owning thread), single consumer (`BeginFrame()`):
+// the producer only advances `write_index` and the consumer `read_index`.
+struct Profiler::ThreadBuffer {
+	std::vector<Event> events = std::vector<Event>(thread_buffer_capacity);
+	std::atomic<std::uint64_t> write_index{ 0u };
+	std::atomic<std::uint64_t> read_index{ 0u };
+	std::atomic<std::uint64_t> dropped_events_nb{ 0u };
+	std::uint32_t id = 0u;
+	std::uint32_t depth = 0u; // Only accessed by the owning thread
+};
+
+char const* Profiler::Event::GetName() const
+{
+	return name != nullptr ? name : dynamic_name;
+}
+
+Profiler::Zone::Zone(char const* name, bool open_debug_group)
+{
+	event.name = name;
+	if (open_debug_group) {
+		utils::opengl::debug::beginDebugGroup(name);
+		has_debug_group = true;
+	}
+	Begin();
+}
+
+Profiler::Zone::Zone(std::string const& name, bool open_debug_group)
+{
+	auto const length = std::min(name.size(), sizeof(event.dynamic_name) - 1u);
+	std::memcpy(event.dynamic_name, name.data(), length);
+	if (open_debug_group) {
+		utils::opengl::debug::beginDebugGroup(name);
+		has_debug_group = true;
+	}
+	Begin();
+}
+
+void Profiler::Zone::Begin()
+{
+	auto& profiler = Profiler::Get();
+	if (!profiler.IsEnabled())
+		return;
+
+	buffer = &profiler.GetThreadBuffer();
+	event.depth = buffer->depth++;
+	event.start_ns = GetTimestamp();
+}
+
+Profiler::Zone::~Zone()
+{
+	if (buffer != nullptr) {
+		event.end_ns = GetTimestamp();
+		--buffer->depth;
+
+		auto const write_index = buffer->write_index.load(std::memory_order_relaxed);
+		if (write_index - buffer->read_index.load(std::memory_order_acquire) < thread_buffer_capacity) {
+			buffer->events[write_index % thread_buffer_capacity] = event;
+			buffer->write_index.store(write_index + 1u, std::memory_order_release);
+		} else {
+			buffer->dropped_events_nb.fetch_add(1u, std::memory_order_relaxed);
+		}
+	}
+
+	if (has_debug_group)
+		utils::opengl::debug::endDebugGroup();
+}
+
+Profiler& Profiler::Get()
+{
+	static Profiler instance;
+	return instance;
+}
+
+void Profiler::BeginFrame()
+{
+	if (frame_index == 0u)
+		SetThreadName("Main thread");
+
+	Frame frame;
+	frame.index = frame_index++;
+	frame.start_ns = frame_start_ns;
+	frame.end_ns = GetTimestamp();
+	frame_start_ns = frame.end_ns;
+
+	{
+		std::lock_guard<std::mutex> lock(buffers_mutex);
+		for (auto const& buffer : buffers) {
+			auto const write_index = buffer->write_index.load(std::memory_order_acquire);
+			auto read_index = buffer->read_index.load(std::memory_order_relaxed);
+			if (read_index == write_index)
+				continue;
+
+			ThreadEvents thread;
+			thread.thread_id = buffer->id;
+			thread.events.reserve(static_cast<std::size_t>(write_index - read_index));
+			for (; read_index != write_index; ++read_index) {
+				thread.events.push_back(buffer->events[read_index % thread_buffer_capacity]);
+				thread.max_depth = std::max(thread.max_depth, thread.events.back().depth);
+			}
+			buffer->read_index.store(read_index, std::memory_order_release);
+
+			frame.threads.push_back(std::move(thread));
+		}
+	}
+
+	if (is_paused)
+		return;
+
+	frames.push_back(std::move(frame));
+	while (frames.size() > frames_history_size)
+		frames.pop_front();
+}
+
+void Profiler::SetThreadName(std::string const& name)
+{
+	auto const& buffer = GetThreadBuffer();
+
+	std::lock_guard<std::mutex> lock(buffers_mutex);
+	thread_names[buffer.id] = name;
+}
+
+void Profiler::SetEnabled(bool enable)
+{
+	is_enabled.store(enable, std::memory_order_relaxed);
+}
+
+bool Profiler::IsEnabled() const
+{
+	return is_enabled.load(std::memory_order_relaxed);
+}
+
+void Profiler::SetPaused(bool pause)
+{
+	is_paused = pause;
+}
+
+bool Profiler::IsPaused() const
+{
+	return is_paused;
+}
+
+std::deque<Profiler::Frame> const& Profiler::GetFrames() const
+{
+	return frames;
+}
+
+std::uint64_t Profiler::GetDroppedEventsCount() const
+{
+	std::lock_guard<std::mutex> lock(buffers_mutex);
+
+	std::uint64_t dropped_events_nb = 0u;
+	for (auto const& buffer : buffers)
+		dropped_events_nb += buffer->dropped_events_nb.load(std::memory_order_relaxed);
+	return dropped_events_nb;
+}
+
+bool Profiler::ExportChromeTrace(std::string const& filename) const
+{
+	std::ofstream file(filename);
+	if (!file) {
+		LogError("Failed to open \"%s\" for writing the CPU trace.", filename.c_str());
+		return false;
+	}
+
+	std::set<std::uint32_t> thread_ids;
+	for (auto const& frame : frames)
+		for (auto const& thread : frame.threads)
+			thread_ids.insert(thread.thread_id);
+
+	// Timestamps are in microseconds; nanoseconds are kept as decimals.
+	file << std::fixed << std::setprecision(3);
+	file << "{\n\t\"displayTimeUnit\": \"ms\",\n\t\"traceEvents\": [";
+	bool is_first = true;
+	auto const separator = [&is_first]() {
+		char const* const value = is_first ? "\n" : ",\n";
+		is_first = false;
+		return value;
+	};
+
+	for (auto const thread_id : thread_ids) {
+		file << separator()
+		     << "\t\t{ \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": " << thread_id
+		     << ", \"args\": { \"name\": \"" << utils::escapeJSON(GetThreadName(thread_id)) << "\" } }";
+	}
+	for (auto const& frame : frames) {
+		file << separator()
+		     << "\t\t{ \"name\": \"Frame " << frame.index << "\", \"ph\": \"i\", \"s\": \"g\""
+		     << ", \"ts\": " << toMicroseconds(frame.start_ns) << ", \"pid\": 0, \"tid\": 0 }";
+		for (auto const& thread : frame.threads) {
+			for (auto const& event : thread.events) {
+				file << separator()
+				     << "\t\t{ \"name\": \"" << utils::escapeJSON(event.GetName()) << "\", \"cat\": \"cpu\", \"ph\": \"X\""
+				     << ", \"ts\": " << toMicroseconds(event.start_ns)
+				     << ", \"dur\": " << toMicroseconds(event.end_ns - event.start_ns)
+				     << ", \"pid\": 0, \"tid\": " << thread.thread_id << " }";
+			}
+		}
+	}
+	file << "\n\t]\n}\n";
+
+	LogInfo("CPU trace exported to \"%s\".", filename.c_str());
+	return true;
+}
+
+void Profiler::RenderFlameView(std::string const& trace_filename)
+{
+	bool const opened = ImGui::Begin("CPU profiler", nullptr, ImGuiWindowFlags_None);
+	if (!opened) {
+		ImGui::End();
+		return;
+	}
+
+	bool enable = IsEnabled();
+	if (ImGui::Checkbox("Record zones", &enable))
+		SetEnabled(enable);
+	ImGui::SameLine();
+	ImGui::Checkbox("Pause", &is_paused);
+	ImGui::SameLine();
+	if (ImGui::Button("Export Chrome trace"))
+		ExportChromeTrace(trace_filename);
+
+	if (frames.empty()) {
+		ImGui::TextDisabled("No frames recorded yet.");
+		ImGui::End();
+		return;
+	}
+
+	auto frame_offset = static_cast<int>(std::min(selected_frame_offset, frames.size() - 1u));
+	if (ImGui::SliderInt("Frames ago", &frame_offset, 0, static_cast<int>(frames.size()) - 1))
+		selected_frame_offset = static_cast<std::size_t>(frame_offset);
+	auto const& frame = frames[frames.size() - 1u - static_cast<std::size_t>(frame_offset)];
+	ImGui::Text("Frame %llu: %.3f ms (%llu zones dropped)", static_cast<unsigned long long>(frame.index),
+	            toMilliseconds(frame.end_ns - frame.start_ns), static_cast<unsigned long long>(GetDroppedEventsCount()));
+
+	// Zones started before the frame, like those from loading, still get
+	// shown in full.
+	auto span_start_ns = frame.start_ns;
+	auto span_end_ns = frame.end_ns;
+	for (auto const& thread : frame.threads) {
+		for (auto const& event : thread.events) {
+			span_start_ns = std::min(span_start_ns, event.start_ns);
+			span_end_ns = std::max(span_end_ns, event.end_ns);
+		}
+	}
+	auto const span_ns = static_cast<double>(std::max<std::uint64_t>(span_end_ns - span_start_ns, 1u));
+
+	auto const row_height = ImGui::GetTextLineHeightWithSpacing();
+	auto* const draw_list = ImGui::GetWindowDrawList();
+	for (auto const& thread : frame.threads) {
+		ImGui::TextUnformatted(GetThreadName(thread.thread_id).c_str());
+
+		auto const origin = ImGui::GetCursorScreenPos();
+		auto const width = std::max(ImGui::GetContentRegionAvail().x, 1.0f);
+		auto const height = row_height * static_cast<float>(thread.max_depth + 1u);
+		ImGui::PushID(static_cast<int>(thread.thread_id));
+		ImGui::InvisibleButton("Flame graph", ImVec2(width, height));
+		bool const is_hovered = ImGui::IsItemHovered();
+		ImGui::PopID();
+
+		auto const mouse_position = ImGui::GetMousePos();
+		auto const clip_rect = ImVec4(origin.x, origin.y, origin.x + width, origin.y + height);
+		draw_list->PushClipRect(ImVec2(clip_rect.x, clip_rect.y), ImVec2(clip_rect.z, clip_rect.w), true);
+		for (auto const& event : thread.events) {
+			auto const x_min = origin.x + static_cast<float>((event.start_ns - span_start_ns) / span_ns) * width;
+			auto const x_max = std::max(origin.x + static_cast<float>((event.end_ns - span_start_ns) / span_ns) * width, x_min + 1.0f);
+			auto const y_min = origin.y + static_cast<float>(event.depth) * row_height;
+			auto const y_max = y_min + row_height - 1.0f;
+
+			auto const name = event.GetName();
+			auto const hue = static_cast<float>(std::hash<std::string>{}(name) % 360u) / 360.0f;
+			draw_list->AddRectFilled(ImVec2(x_min, y_min), ImVec2(x_max, y_max), ImColor::HSV(hue, 0.5f, 0.65f));
+			auto const text_clip_rect = ImVec4(x_min, y_min, std::min(x_max, clip_rect.z), y_max);
+			draw_list->AddText(ImGui::GetFont(), ImGui::GetFontSize(), ImVec2(x_min + 2.0f, y_min), IM_COL32_WHITE, name, nullptr, 0.0f, &text_clip_rect);
+
+			if (is_hovered && mouse_position.x >= x_min && mouse_position.x < x_max
+			               && mouse_position.y >= y_min && mouse_position.y < y_max)
+				ImGui::SetTooltip("%s\n%.3f ms", name, toMilliseconds(event.end_ns - event.start_ns));
+		}
+		draw_list->PopClipRect();
+	}
+
+	if (ImGui::TreeNode("Zones")) {
+		// Total time and count per zone name, across all threads.
+		std::map<std::string, std::pair<std::uint64_t, std::size_t>> zones;
+		for (auto const& thread : frame.threads) {
+			for (auto const& event : thread.events) {
+				auto& zone = zones[event.GetName()];
+				zone.first += event.end_ns - event.start_ns;
+				++zone.second;
+			}
+		}
+		std::vector<std::pair<std::string, std::pair<std::uint64_t, std::size_t>>> sorted_zones(zones.begin(), zones.end());
+		std::sort(sorted_zones.begin(), sorted_zones.end(), [](auto const& lhs, auto const& rhs) {
+			return lhs.second.first > rhs.second.first;
+		});
+
+		if (ImGui::BeginTable("Zones", 3, ImGuiTableFlags_SizingFixedFit)) {
+			ImGui::TableSetupColumn("Zone");
+			ImGui::TableSetupColumn("Calls");
+			ImGui::TableSetupColumn("Total (ms)");
+			ImGui::TableHeadersRow();
+
+			for (auto const& zone : sorted_zones) {
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(zone.first.c_str());
+				ImGui::TableNextColumn();
+				ImGui::Text("%zu", zone.second.second);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", toMilliseconds(zone.second.first));
+			}
+
+			ImGui::EndTable();
+		}
+		ImGui::TreePop();
+	}
+
+	ImGui::End();
+}
+
+std::uint64_t Profiler::GetTimestamp()
+{
+	static auto const epoch = std::chrono::steady_clock::now();
+	return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count());
+}
+
+Profiler::ThreadBuffer& Profiler::GetThreadBuffer()
+{
+	static thread_local ThreadBuffer* buffer = nullptr;
+	if (buffer != nullptr)
+		return *buffer;
+
+	std::lock_guard<std::mutex> lock(buffers_mutex);
+	buffers.push_back(std::make_unique<ThreadBuffer>());
+	buffer = buffers.back().get();
+	buffer->id = static_cast<std::uint32_t>(buffers.size() - 1u);
+	thread_names.push_back("Thread " + std::to_string(buffer->id));
+	return *buffer;
+}
+
+std::string Profiler::GetThreadName(std::uint32_t thread_id) const
+{
+	std::lock_guard<std::mutex> lock(buffers_mutex);
+	return thread_id < thread_names.size() ? thread_names[thread_id] : std::string();
+}
+
+#endif
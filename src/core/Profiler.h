@@ -0,0 +1,162 @@
+/*
+ * Hierarchical CPU profiler
+ */
+
+#include "BuildSettings.h"
+#include "opengl.hpp"
+
+#pragma once
+
+#define PROFILER_CONCATENATE_IMPL(a, b)	a##b
+#define PROFILER_CONCATENATE(a, b)		PROFILER_CONCATENATE_IMPL(a, b)
+
+#if defined ENABLE_PROFILING && ENABLE_PROFILING != 0
+#	define PROFILE_ZONE(name)			Profiler::Zone const PROFILER_CONCATENATE(profiler_zone_, __LINE__)(name)
+#	define PROFILE_GL_ZONE(name)		Profiler::Zone const PROFILER_CONCATENATE(profiler_zone_, __LINE__)(name, true)
+#	define PROFILE_FUNCTION()			PROFILE_ZONE(__FUNCTION__)
+#	define PROFILE_BEGIN_FRAME()		Profiler::Get().BeginFrame()
+#	define PROFILE_THREAD_NAME(name)	Profiler::Get().SetThreadName(name)
+#else
+#	define PROFILE_ZONE(name)
+#	define PROFILE_GL_ZONE(name)		utils::opengl::debug::ScopedDebugGroup const PROFILER_CONCATENATE(profiler_zone_, __LINE__)(name)
+#	define PROFILE_FUNCTION()
+#	define PROFILE_BEGIN_FRAME()
+#	define PROFILE_THREAD_NAME(name)
+#endif
+
+#if defined ENABLE_PROFILING && ENABLE_PROFILING != 0
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//! \brief Scoped CPU timings, grouped per frame and per thread.
+//!
+//! Zones are RAII objects, usually created through the `PROFILE_*` macros
+//! above, which record when they start and end, and how deep they are
+//! nested. Each thread writes its completed zones to its own ring buffer
+//! without taking any lock; `BeginFrame()` then collects them all, and keeps
+//! the last frames around for displaying them as flame graphs, or exporting
+//! them in the Chrome trace format, which can be opened in Perfetto or in
+//! `chrome://tracing`.
+//!
+//! Zones created with `PROFILE_GL_ZONE()` also open an OpenGL debug group of
+//! the same name, so that they line up with the captures of tools like
+//! RenderDoc or Nsight Graphics, and with the passes of the render graph.
+//!
+//! Setting `ENABLE_PROFILING` to 0 in BuildSettings.h compiles all of it
+//! out; `PROFILE_GL_ZONE()` then only opens the debug group.
+class Profiler
+{
+	struct ThreadBuffer;
+
+public:
+	struct Event {
+		std::uint64_t start_ns = 0u;
+		std::uint64_t end_ns = 0u;
+		char const* name = nullptr; //!< Static string, or null when using `dynamic_name`
+		std::uint32_t depth = 0u;
+		char dynamic_name[44] = {};
+
+		char const* GetName() const;
+	};
+
+	class Zone
+	{
+	public:
+		//! \param [in] name has to outlive the profiler, as string literals
+		//!             do; it is not copied
+		explicit Zone(char const* name, bool open_debug_group = false);
+
+		//! \param [in] name gets copied, and truncated if needed; the debug
+		//!             group gets the full name
+		explicit Zone(std::string const& name, bool open_debug_group = false);
+
+		~Zone();
+		Zone(Zone const&) = delete;
+		Zone& operator=(Zone const&) = delete;
+
+	private:
+		void Begin();
+
+		ThreadBuffer* buffer = nullptr;
+		Event event;
+		bool has_debug_group = false;
+	};
+
+	struct ThreadEvents {
+		std::uint32_t thread_id = 0u;
+		std::uint32_t max_depth = 0u;
+		std::vector<Event> events;
+	};
+
+	struct Frame {
+		std::uint64_t index = 0u;
+		std::uint64_t start_ns = 0u;
+		std::uint64_t end_ns = 0u;
+		std::vector<ThreadEvents> threads;
+	};
+
+	static Profiler& Get();
+
+	Profiler(Profiler const&) = delete;
+	Profiler& operator=(Profiler const&) = delete;
+
+	//! \brief Collect the zones that completed since the previous call, as
+	//! the frame that just ended; call it once per frame, from the main
+	//! thread.
+	void BeginFrame();
+
+	//! \brief Name the calling thread, in the flame view and the traces.
+	void SetThreadName(std::string const& name);
+
+	//! \brief Start or stop recording zones; they are recorded by default.
+	void SetEnabled(bool is_enabled);
+	bool IsEnabled() const;
+
+	//! \brief Stop or resume keeping new frames, to inspect the current ones.
+	void SetPaused(bool is_paused);
+	bool IsPaused() const;
+
+	std::deque<Frame> const& GetFrames() const;
+
+	//! \brief Zones that could not be recorded as their thread buffer was
+	//! full, because `BeginFrame()` was not called often enough.
+	std::uint64_t GetDroppedEventsCount() const;
+
+	//! \brief Write all kept frames to `filename`, in the Chrome trace event
+	//! format.
+	bool ExportChromeTrace(std::string const& filename) const;
+
+	//! \brief Display the kept frames as flame graphs, one per thread, in
+	//! their own ImGui window, with a button exporting them to
+	//! `trace_filename`.
+	void RenderFlameView(std::string const& trace_filename);
+
+	static std::uint64_t GetTimestamp();
+
+private:
+	Profiler() = default;
+
+	ThreadBuffer& GetThreadBuffer();
+	std::string GetThreadName(std::uint32_t thread_id) const;
+
+	mutable std::mutex buffers_mutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> buffers; // Never released, as threads may still be writing to them
+	std::vector<std::string> thread_names;
+
+	std::atomic<bool> is_enabled{ true };
+	bool is_paused = false;
+	std::uint64_t frame_index = 0u;
+	std::uint64_t frame_start_ns = 0u;
+	std::deque<Frame> frames;
+	std::size_t frames_history_size = 240u;
+	std::size_t selected_frame_offset = 0u; // From the most recent frame
+};
+
+#endif
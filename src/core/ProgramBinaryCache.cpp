@@ -0,0 +1,187 @@
+#include "ProgramBinaryCache.hpp"
+
+#include "config.hpp"
+
+#include "Log.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+	char const cache_magic[4] = { 'C', 'G', 'P', 'B' };
+	constexpr std::uint32_t cache_version = 1u;
+
+	struct CacheHeader {
+		char magic[4];
+		std::uint32_t version;
+		std::uint64_t key;
+		std::uint32_t format;
+		std::uint32_t length;
+	};
+
+	// 64-bit FNV-1a
+	std::uint64_t hashBytes(std::uint64_t hash, void const* data, std::size_t size)
+	{
+		auto const bytes = static_cast<unsigned char const*>(data);
+		for (std::size_t i = 0; i < size; ++i) {
+			hash ^= bytes[i];
+			hash *= 0x100000001b3ull;
+		}
+		return hash;
+	}
+
+	std::uint64_t hashString(std::uint64_t hash, std::string const& value)
+	{
+		// Include the terminator, for "ab" + "c" to differ from "a" + "bc".
+		return hashBytes(hash, value.c_str(), value.size() + 1u);
+	}
+
+	std::string getGLString(GLenum name)
+	{
+		auto const value = reinterpret_cast<char const*>(glGetString(name));
+		return value != nullptr ? value : "";
+	}
+}
+
+bool ProgramBinaryCache::IsEnabled() const
+{
+	Initialise();
+	return is_enabled;
+}
+
+std::uint64_t ProgramBinaryCache::ComputeKey(Stages const& stages) const
+{
+	Initialise();
+
+	auto key = hashString(0xcbf29ce484222325ull, driver_identifier);
+	for (auto const& stage : stages) {
+		key = hashBytes(key, &stage.first, sizeof(stage.first));
+		key = hashString(key, stage.second);
+	}
+	return key;
+}
+
+GLuint ProgramBinaryCache::Load(std::uint64_t key) const
+{
+	if (!IsEnabled())
+		return 0u;
+
+	auto const filename = GetFilename(key);
+	std::ifstream file(filename, std::ios::binary);
+	if (!file)
+		return 0u;
+
+	CacheHeader header;
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!file || std::memcmp(header.magic, cache_magic, sizeof(cache_magic)) != 0
+	    || header.version != cache_version || header.key != key || header.length == 0u) {
+		LogWarning("Ignoring invalid shader cache entry \"%s\".", filename.c_str());
+		return 0u;
+	}
+	std::vector<char> binary(header.length);
+	file.read(binary.data(), static_cast<std::streamsize>(binary.size()));
+	if (!file) {
+		LogWarning("Ignoring truncated shader cache entry \"%s\".", filename.c_str());
+		return 0u;
+	}
+	file.close();
+
+	GLuint const program = glCreateProgram();
+	glProgramBinary(program, static_cast<GLenum>(header.format), binary.data(), static_cast<GLsizei>(binary.size()));
+	GLint status = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	if (status == GL_FALSE) {
+		LogWarning("The driver rejected the cached program \"%s\"; it will be rebuilt from its sources.", filename.c_str());
+		glDeleteProgram(program);
+		std::remove(filename.c_str());
+		return 0u;
+	}
+
+	return program;
+}
+
+void ProgramBinaryCache::Store(std::uint64_t key, GLuint program) const
+{
+	if (!IsEnabled() || program == 0u)
+		return;
+
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	std::vector<char> binary(static_cast<std::size_t>(length));
+	GLenum format = GL_NONE;
+	glGetProgramBinary(program, length, &length, &format, binary.data());
+	if (length <= 0)
+		return;
+
+	CacheHeader header;
+	std::memcpy(header.magic, cache_magic, sizeof(cache_magic));
+	header.version = cache_version;
+	header.key = key;
+	header.format = static_cast<std::uint32_t>(format);
+	header.length = static_cast<std::uint32_t>(length);
+
+	auto const filename = GetFilename(key);
+	std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+	if (!file) {
+		LogWarning("Failed to open \"%s\" for caching a shader program.", filename.c_str());
+		return;
+	}
+	file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+	file.write(binary.data(), length);
+	if (!file) {
+		LogWarning("Failed to write the shader program cached in \"%s\".", filename.c_str());
+		file.close();
+		std::remove(filename.c_str());
+	}
+}
+
+void ProgramBinaryCache::Initialise() const
+{
+	if (is_initialised)
+		return;
+	is_initialised = true;
+
+	char const* const setting = std::getenv("LUGGCGL_SHADER_CACHE");
+	if (setting != nullptr && std::strcmp(setting, "0") == 0) {
+		LogInfo("Shader program cache disabled through LUGGCGL_SHADER_CACHE.");
+		return;
+	}
+	if (!GLAD_GL_VERSION_4_1) {
+		LogInfo("Shader program cache unavailable, as it requires OpenGL 4.1.");
+		return;
+	}
+
+	GLint formats_nb = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats_nb);
+	if (formats_nb <= 0) {
+		LogInfo("Shader program cache unavailable, as the driver exposes no program binary formats.");
+		return;
+	}
+	std::vector<GLint> formats(static_cast<std::size_t>(formats_nb));
+	glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats.data());
+
+	std::ostringstream identifier;
+	identifier << getGLString(GL_VENDOR) << '\n'
+	           << getGLString(GL_RENDERER) << '\n'
+	           << getGLString(GL_VERSION) << '\n'
+	           << getGLString(GL_SHADING_LANGUAGE_VERSION);
+	for (auto const format : formats)
+		identifier << '\n' << format;
+	driver_identifier = identifier.str();
+
+	is_enabled = true;
+}
+
+std::string ProgramBinaryCache::GetFilename(std::uint64_t key)
+{
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+	return config::shader_cache_path(name);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+//! \brief On-disk cache of linked shader programs, in the binary format of
+//! the driver.
+//!
+//! Programs are identified by a hash of the type and source of each of their
+//! stages, along with the GL vendor, renderer and version strings and the
+//! binary formats the driver supports, so that a driver update invalidates
+//! the cache. Drivers can still reject a binary they produced, in which case
+//! `Load()` fails and the caller should compile the program from its sources.
+//!
+//! The cache needs OpenGL 4.1, and lives in `config::shader_cache_path()`;
+//! it can be turned off by setting the `LUGGCGL_SHADER_CACHE` environment
+//! variable to 0.
+class ProgramBinaryCache
+{
+public:
+	using Stages = std::vector<std::pair<GLenum, std::string>>;
+
+	bool IsEnabled() const;
+
+	std::uint64_t ComputeKey(Stages const& stages) const;
+
+	//! \brief Create a program from the binary cached under `key`.
+	//!
+	//! \return the program, or 0 if none was cached or if the driver
+	//!         rejected it
+	GLuint Load(std::uint64_t key) const;
+
+	//! \brief Cache the binary of `program` under `key`; the program should
+	//! have been linked with `GL_PROGRAM_BINARY_RETRIEVABLE_HINT` set.
+	void Store(std::uint64_t key, GLuint program) const;
+
+private:
+	void Initialise() const;
+
+	static std::string GetFilename(std::uint64_t key);
+
+	mutable bool is_initialised = false;
+	mutable bool is_enabled = false;
+	mutable std::string driver_identifier;
+};
@@ -0,0 +1,652 @@
+#include "RenderGraph.hpp"
+
+#include "GLStateCache.hpp"
+#include "GPUMemoryRegistry.hpp"
+#include "Log.h"
+#include "opengl.hpp"
+#include "Profiler.h"
+
+#include <imgui.h>
+
+#include <algorithm>
+#include <numeric>
+
+constexpr std::size_t RenderGraph::invalid_handle;
+
+namespace
+{
+	bool isDepthStencilFormat(GLenum format)
+	{
+		return format == GL_DEPTH_STENCIL;
+	}
+
+	bool isIntegerFormat(GLenum format)
+	{
+		return format == GL_RED_INTEGER || format == GL_RG_INTEGER
+		    || format == GL_RGB_INTEGER || format == GL_RGBA_INTEGER;
+	}
+
+	bool isUnsignedType(GLenum type)
+	{
+		return type == GL_UNSIGNED_BYTE || type == GL_UNSIGNED_SHORT || type == GL_UNSIGNED_INT;
+	}
+
+	bool areCompatible(RenderGraph::TextureDescription const& a, GLsizei a_width, GLsizei a_height,
+	                   RenderGraph::TextureDescription const& b, GLsizei b_width, GLsizei b_height)
+	{
+		return a.internal_format == b.internal_format
+		    && a.format == b.format
+		    && a.type == b.type
+		    && a.has_mipmaps == b.has_mipmaps
+		    && a_width == b_width
+		    && a_height == b_height;
+	}
+}
+
+RenderGraph::~RenderGraph()
+{
+	for (auto const& physical_texture : physical_textures)
+		glDeleteTextures(1, &physical_texture.texture);
+	for (auto const& framebuffer : framebuffers)
+		glDeleteFramebuffers(1, &framebuffer.second);
+}
+
+void RenderGraph::SetFramebufferSize(GLsizei width, GLsizei height)
+{
+	if (width == framebuffer_width && height == framebuffer_height)
+		return;
+
+	framebuffer_width = width;
+	framebuffer_height = height;
+	is_dirty = true;
+}
+
+void RenderGraph::SetTimerPool(GPUTimerQueryPool* pool)
+{
+	timer_pool = pool;
+	timers.clear();
+	is_dirty = true;
+}
+
+void RenderGraph::Reset()
+{
+	passes.clear();
+	resources.clear();
+	is_dirty = true;
+}
+
+RenderGraph::ResourceHandle RenderGraph::CreateTexture(std::string const& name, TextureDescription const& description)
+{
+	Resource resource;
+	resource.name = name;
+	resource.description = description;
+	resources.emplace_back(std::move(resource));
+	is_dirty = true;
+	return resources.size() - 1u;
+}
+
+RenderGraph::PassHandle RenderGraph::AddPass(std::string const& name, ExecuteCallback execute)
+{
+	Pass pass;
+	pass.name = name;
+	pass.execute = std::move(execute);
+	passes.emplace_back(std::move(pass));
+	is_dirty = true;
+	return passes.size() - 1u;
+}
+
+void RenderGraph::ReadTexture(PassHandle pass, ResourceHandle texture)
+{
+	if (!ValidatePass(pass, __func__) || !ValidateResource(texture, __func__))
+		return;
+
+	passes[pass].reads.push_back(texture);
+	is_dirty = true;
+}
+
+void RenderGraph::WriteColour(PassHandle pass, ResourceHandle texture, GLuint location, LoadOp load_op, glm::vec4 const& clear_colour)
+{
+	if (!ValidatePass(pass, __func__) || !ValidateResource(texture, __func__))
+		return;
+
+	Attachment attachment;
+	attachment.texture = texture;
+	attachment.location = location;
+	attachment.load_op = load_op;
+	attachment.clear_colour = clear_colour;
+	passes[pass].colour_attachments.push_back(attachment);
+	is_dirty = true;
+}
+
+void RenderGraph::WriteImage(PassHandle pass, ResourceHandle texture)
+{
+	if (!ValidatePass(pass, __func__) || !ValidateResource(texture, __func__))
+		return;
+
+	passes[pass].image_writes.push_back(texture);
+	is_dirty = true;
+}
+
+void RenderGraph::SetDepthAttachment(PassHandle pass, ResourceHandle texture, bool is_written, LoadOp load_op, float clear_depth)
+{
+	if (!ValidatePass(pass, __func__) || !ValidateResource(texture, __func__))
+		return;
+
+	auto& attachment = passes[pass].depth_attachment;
+	attachment.texture = texture;
+	attachment.is_written = is_written;
+	// Depth that is only tested against has to be kept.
+	attachment.load_op = is_written ? load_op : LoadOp::Load;
+	attachment.clear_depth = clear_depth;
+	is_dirty = true;
+}
+
+void RenderGraph::SetSideEffects(PassHandle pass)
+{
+	if (!ValidatePass(pass, __func__))
+		return;
+
+	passes[pass].has_side_effects = true;
+	is_dirty = true;
+}
+
+void RenderGraph::MarkOutput(ResourceHandle texture)
+{
+	if (!ValidateResource(texture, __func__))
+		return;
+
+	resources[texture].is_output = true;
+	is_dirty = true;
+}
+
+void RenderGraph::Compile()
+{
+	PROFILE_FUNCTION();
+
+	for (auto& resource : resources) {
+		auto const& description = resource.description;
+		resource.width = description.is_framebuffer_relative ? std::max(1, static_cast<GLsizei>(framebuffer_width * description.scale)) : description.width;
+		resource.height = description.is_framebuffer_relative ? std::max(1, static_cast<GLsizei>(framebuffer_height * description.scale)) : description.height;
+		resource.first_use = invalid_handle;
+		resource.last_use = invalid_handle;
+		resource.physical_texture = invalid_handle;
+	}
+
+	//
+	// Cull passes, going backwards from the outputs and the passes with side
+	// effects; a texture is live if its current content will be read later
+	// on.
+	//
+	std::vector<bool> is_live(resources.size(), false);
+	for (std::size_t i = 0; i < resources.size(); ++i)
+		is_live[i] = resources[i].is_output;
+
+	for (auto pass_it = passes.rbegin(); pass_it != passes.rend(); ++pass_it) {
+		auto& pass = *pass_it;
+
+		auto const for_each_attachment = [&pass](std::function<void(Attachment&)> const& callback){
+			for (auto& attachment : pass.colour_attachments)
+				callback(attachment);
+			if (pass.depth_attachment.texture != invalid_handle)
+				callback(pass.depth_attachment);
+		};
+
+		bool is_needed = pass.has_side_effects;
+		for_each_attachment([&is_needed, &is_live](Attachment const& attachment){
+			is_needed |= attachment.is_written && is_live[attachment.texture];
+		});
+		// Image writes may be partial: unlike attachments, they never make
+		// the previous content dead.
+		for (auto const texture : pass.image_writes)
+			is_needed |= is_live[texture];
+		pass.is_culled = !is_needed;
+		if (pass.is_culled)
+			continue;
+
+		// Content written and never read afterwards does not need to be
+		// stored; content fully overwritten by this pass was dead before it.
+		for_each_attachment([&is_live](Attachment& attachment){
+			attachment.is_stored = attachment.is_written && is_live[attachment.texture];
+			if (attachment.is_written && attachment.load_op != LoadOp::Load)
+				is_live[attachment.texture] = false;
+		});
+		for_each_attachment([&is_live](Attachment const& attachment){
+			if (attachment.load_op == LoadOp::Load)
+				is_live[attachment.texture] = true;
+		});
+		for (auto const texture : pass.reads)
+			is_live[texture] = true;
+	}
+
+	//
+	// Work out the actual load operations and the lifetime of all textures.
+	//
+	std::vector<bool> has_content(resources.size(), false);
+	for (std::size_t pass_index = 0; pass_index < passes.size(); ++pass_index) {
+		auto& pass = passes[pass_index];
+		if (pass.is_culled)
+			continue;
+
+		auto const use = [this, pass_index](ResourceHandle texture){
+			auto& resource = resources[texture];
+			if (resource.first_use == invalid_handle)
+				resource.first_use = pass_index;
+			resource.last_use = pass_index;
+		};
+
+		for (auto const texture : pass.reads) {
+			if (!has_content[texture])
+				LogWarning("Pass \"%s\" reads from texture \"%s\" which has not been written to yet.", pass.name.c_str(), resources[texture].name.c_str());
+			use(texture);
+		}
+
+		std::vector<Attachment*> attachments;
+		for (auto& attachment : pass.colour_attachments)
+			attachments.push_back(&attachment);
+		if (pass.depth_attachment.texture != invalid_handle)
+			attachments.push_back(&pass.depth_attachment);
+
+		for (auto const texture : pass.image_writes) {
+			has_content[texture] = true;
+			use(texture);
+		}
+
+		pass.width = 0;
+		pass.height = 0;
+		for (auto attachment : attachments) {
+			// There is nothing to load on first use, so clear instead to
+			// avoid rendering on top of undefined content.
+			attachment->effective_load_op = attachment->load_op;
+			if (attachment->load_op == LoadOp::Load && !has_content[attachment->texture])
+				attachment->effective_load_op = LoadOp::Clear;
+			if (attachment->is_written)
+				has_content[attachment->texture] = true;
+			use(attachment->texture);
+
+			auto const& resource = resources[attachment->texture];
+			if (pass.width != 0 && (pass.width != resource.width || pass.height != resource.height))
+				LogError("Attachments of pass \"%s\" have different sizes.", pass.name.c_str());
+			pass.width = resource.width;
+			pass.height = resource.height;
+		}
+	}
+	for (auto& resource : resources) {
+		if (resource.is_output && resource.first_use != invalid_handle)
+			resource.last_use = passes.size();
+	}
+
+	AllocateTextures();
+	CreateFramebuffers();
+	// Names of deleted textures and framebuffers get reused, and must not be
+	// taken as still bound.
+	GLStateCache::Get().Invalidate();
+
+	if (timer_pool != nullptr) {
+		for (auto& pass : passes) {
+			pass.timer = invalid_handle;
+			if (pass.is_culled)
+				continue;
+
+			auto const timer_it = timers.find(pass.name);
+			pass.timer = timer_it != timers.end() ? timer_it->second
+			                                      : (timers[pass.name] = timer_pool->RegisterTimer(pass.name));
+		}
+	}
+
+	is_dirty = false;
+}
+
+void RenderGraph::AllocateTextures()
+{
+	GPUMemoryRegistry::Scope const memory_scope("RenderGraph::AllocateTextures");
+
+	// Textures are assigned in order of first use, each one reusing a
+	// compatible texture no longer in use at that point, then any
+	// compatible texture left over from the previous compilation.
+	std::vector<ResourceHandle> order;
+	for (std::size_t i = 0; i < resources.size(); ++i) {
+		if (resources[i].first_use != invalid_handle)
+			order.push_back(i);
+	}
+	std::stable_sort(order.begin(), order.end(), [this](ResourceHandle a, ResourceHandle b){
+		return resources[a].first_use < resources[b].first_use;
+	});
+
+	std::vector<bool> is_assigned(physical_textures.size(), false);
+	for (auto& physical_texture : physical_textures)
+		physical_texture.busy_until = invalid_handle;
+
+	for (auto const handle : order) {
+		auto& resource = resources[handle];
+
+		auto const find = [&](bool assigned){
+			for (std::size_t i = 0; i < physical_textures.size(); ++i) {
+				auto const& physical_texture = physical_textures[i];
+				if (is_assigned[i] != assigned
+				 || (assigned && physical_texture.busy_until >= resource.first_use)
+				 || !areCompatible(physical_texture.description, physical_texture.width, physical_texture.height,
+				                   resource.description, resource.width, resource.height))
+					continue;
+				return i;
+			}
+			return invalid_handle;
+		};
+
+		auto physical_index = find(true);
+		if (physical_index == invalid_handle)
+			physical_index = find(false);
+		if (physical_index == invalid_handle) {
+			PhysicalTexture physical_texture;
+			physical_texture.description = resource.description;
+			physical_texture.width = resource.width;
+			physical_texture.height = resource.height;
+			physical_texture.size = GPUMemoryRegistry::GetBytesPerTexel(resource.description.internal_format)
+			                      * static_cast<std::size_t>(resource.width) * static_cast<std::size_t>(resource.height);
+			if (resource.description.has_mipmaps)
+				physical_texture.size = physical_texture.size * 4u / 3u;
+
+			glGenTextures(1, &physical_texture.texture);
+			GLStateCache::Get().BindTexture(0u, GL_TEXTURE_2D, physical_texture.texture);
+			glTexImage2D(GL_TEXTURE_2D, 0, resource.description.internal_format, resource.width, resource.height, 0,
+			             resource.description.format, resource.description.type, nullptr);
+			if (resource.description.has_mipmaps)
+				glGenerateMipmap(GL_TEXTURE_2D);
+			else
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0); // Keep it complete with mipmapping samplers.
+			GLStateCache::Get().BindTexture(0u, GL_TEXTURE_2D, 0u);
+
+			physical_textures.push_back(physical_texture);
+			is_assigned.push_back(false);
+			physical_index = physical_textures.size() - 1u;
+		}
+
+		is_assigned[physical_index] = true;
+		physical_textures[physical_index].busy_until = resource.last_use;
+		resource.physical_texture = physical_index;
+	}
+
+	// Release the textures that are no longer needed, and remap the others.
+	std::vector<std::size_t> remapping(physical_textures.size(), invalid_handle);
+	std::vector<PhysicalTexture> kept_textures;
+	for (std::size_t i = 0; i < physical_textures.size(); ++i) {
+		if (!is_assigned[i]) {
+			glDeleteTextures(1, &physical_textures[i].texture);
+			continue;
+		}
+		remapping[i] = kept_textures.size();
+		kept_textures.push_back(physical_textures[i]);
+	}
+	physical_textures = std::move(kept_textures);
+
+	std::vector<std::string> labels(physical_textures.size());
+	for (auto& resource : resources) {
+		if (resource.physical_texture == invalid_handle)
+			continue;
+		resource.physical_texture = remapping[resource.physical_texture];
+		auto& label = labels[resource.physical_texture];
+		label += (label.empty() ? "" : " / ") + resource.name;
+	}
+	for (std::size_t i = 0; i < physical_textures.size(); ++i)
+		utils::opengl::debug::nameObject(GL_TEXTURE, physical_textures[i].texture, labels[i]);
+}
+
+void RenderGraph::CreateFramebuffers()
+{
+	std::map<std::vector<GLuint>, GLuint> previous_framebuffers;
+	std::swap(previous_framebuffers, framebuffers);
+
+	for (auto& pass : passes) {
+		pass.fbo = 0u;
+		if (pass.is_culled || (pass.colour_attachments.empty() && pass.depth_attachment.texture == invalid_handle))
+			continue;
+
+		// The key lists the depth texture, followed by the colour texture
+		// bound at each location (or 0).
+		GLuint max_location = 0u;
+		for (auto const& attachment : pass.colour_attachments)
+			max_location = std::max(max_location, attachment.location + 1u);
+		std::vector<GLuint> key(max_location + 1u, 0u);
+		if (pass.depth_attachment.texture != invalid_handle)
+			key[0] = GetTexture(pass.depth_attachment.texture);
+		for (auto const& attachment : pass.colour_attachments)
+			key[attachment.location + 1u] = GetTexture(attachment.texture);
+
+		auto const existing = framebuffers.find(key);
+		if (existing != framebuffers.end()) {
+			pass.fbo = existing->second;
+			continue;
+		}
+		auto const previous = previous_framebuffers.find(key);
+		if (previous != previous_framebuffers.end()) {
+			pass.fbo = previous->second;
+			framebuffers.insert(*previous);
+			previous_framebuffers.erase(previous);
+			continue;
+		}
+
+		glGenFramebuffers(1, &pass.fbo);
+		GLStateCache::Get().BindFramebuffer(GL_FRAMEBUFFER, pass.fbo);
+		std::vector<GLenum> draw_buffers(max_location, GL_NONE);
+		for (auto const& attachment : pass.colour_attachments) {
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + attachment.location, GL_TEXTURE_2D, GetTexture(attachment.texture), 0);
+			draw_buffers[attachment.location] = GL_COLOR_ATTACHMENT0 + attachment.location;
+		}
+		if (pass.depth_attachment.texture != invalid_handle) {
+			auto const is_depth_stencil = isDepthStencilFormat(resources[pass.depth_attachment.texture].description.format);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, is_depth_stencil ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT,
+			                       GL_TEXTURE_2D, GetTexture(pass.depth_attachment.texture), 0);
+		}
+		if (draw_buffers.empty())
+			glDrawBuffer(GL_NONE);
+		else
+			glDrawBuffers(static_cast<GLsizei>(draw_buffers.size()), draw_buffers.data());
+		glReadBuffer(draw_buffers.empty() ? GL_NONE : draw_buffers.front());
+
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			LogError("Framebuffer for pass \"%s\" is not complete: check the logs for additional information.", pass.name.c_str());
+		utils::opengl::debug::nameObject(GL_FRAMEBUFFER, pass.fbo, pass.name);
+
+		framebuffers.emplace(key, pass.fbo);
+	}
+	GLStateCache::Get().BindFramebuffer(GL_FRAMEBUFFER, 0u);
+
+	for (auto const& framebuffer : previous_framebuffers)
+		glDeleteFramebuffers(1, &framebuffer.second);
+}
+
+void RenderGraph::Execute()
+{
+	PROFILE_FUNCTION();
+
+	if (is_dirty)
+		Compile();
+
+	auto& state = GLStateCache::Get();
+	for (auto const& pass : passes) {
+		if (pass.is_culled)
+			continue;
+
+		PROFILE_GL_ZONE(pass.name);
+		if (timer_pool != nullptr && pass.timer != invalid_handle)
+			timer_pool->BeginTimer(pass.timer);
+
+		if (pass.fbo != 0u) {
+			state.BindFramebuffer(GL_DRAW_FRAMEBUFFER, pass.fbo);
+			glViewport(0, 0, pass.width, pass.height);
+
+			for (auto const& attachment : pass.colour_attachments) {
+				if (attachment.effective_load_op != LoadOp::Clear)
+					continue;
+
+				// Integer targets have to be cleared with integer values.
+				auto const& description = resources[attachment.texture].description;
+				auto const location = static_cast<GLint>(attachment.location);
+				if (!isIntegerFormat(description.format)) {
+					glClearBufferfv(GL_COLOR, location, &attachment.clear_colour.x);
+				} else if (isUnsignedType(description.type)) {
+					auto const clear_colour = glm::uvec4(attachment.clear_colour);
+					glClearBufferuiv(GL_COLOR, location, &clear_colour.x);
+				} else {
+					auto const clear_colour = glm::ivec4(attachment.clear_colour);
+					glClearBufferiv(GL_COLOR, location, &clear_colour.x);
+				}
+			}
+			auto const& depth_attachment = pass.depth_attachment;
+			if (depth_attachment.texture != invalid_handle && depth_attachment.effective_load_op == LoadOp::Clear) {
+				// Clears are subject to the depth mask.
+				auto const depth_mask = state.GetDepthMask();
+				state.DepthMask(GL_TRUE);
+				if (isDepthStencilFormat(resources[depth_attachment.texture].description.format))
+					glClearBufferfi(GL_DEPTH_STENCIL, 0, depth_attachment.clear_depth, 0);
+				else
+					glClearBufferfv(GL_DEPTH, 0, &depth_attachment.clear_depth);
+				state.DepthMask(depth_mask);
+			}
+		}
+
+		pass.execute(*this);
+
+		// Let the driver discard what will not be read again; this needs
+		// OpenGL 4.3.
+		if (pass.fbo != 0u && GLAD_GL_VERSION_4_3) {
+			std::vector<GLenum> discarded_attachments;
+			for (auto const& attachment : pass.colour_attachments) {
+				if (!attachment.is_stored)
+					discarded_attachments.push_back(GL_COLOR_ATTACHMENT0 + attachment.location);
+			}
+			auto const& depth_attachment = pass.depth_attachment;
+			if (depth_attachment.texture != invalid_handle && depth_attachment.is_written && !depth_attachment.is_stored)
+				discarded_attachments.push_back(isDepthStencilFormat(resources[depth_attachment.texture].description.format) ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT);
+			if (!discarded_attachments.empty()) {
+				state.BindFramebuffer(GL_DRAW_FRAMEBUFFER, pass.fbo);
+				glInvalidateFramebuffer(GL_DRAW_FRAMEBUFFER, static_cast<GLsizei>(discarded_attachments.size()), discarded_attachments.data());
+			}
+		}
+
+		if (timer_pool != nullptr && pass.timer != invalid_handle)
+			timer_pool->EndTimer(pass.timer);
+	}
+}
+
+bool RenderGraph::IsDirty() const
+{
+	return is_dirty;
+}
+
+GLuint RenderGraph::GetTexture(ResourceHandle texture) const
+{
+	if (texture >= resources.size() || resources[texture].physical_texture == invalid_handle)
+		return 0u;
+
+	return physical_textures[resources[texture].physical_texture].texture;
+}
+
+GLsizei RenderGraph::GetWidth(ResourceHandle texture) const
+{
+	return texture < resources.size() ? resources[texture].width : 0;
+}
+
+GLsizei RenderGraph::GetHeight(ResourceHandle texture) const
+{
+	return texture < resources.size() ? resources[texture].height : 0;
+}
+
+GLuint RenderGraph::GetFramebuffer(PassHandle pass) const
+{
+	return pass < passes.size() ? passes[pass].fbo : 0u;
+}
+
+bool RenderGraph::IsCulled(PassHandle pass) const
+{
+	return pass >= passes.size() || passes[pass].is_culled;
+}
+
+double RenderGraph::GetLastGPUTime() const
+{
+	if (timer_pool == nullptr)
+		return 0.0;
+
+	double total = 0.0;
+	for (auto const& pass : passes) {
+		if (!pass.is_culled && pass.timer != invalid_handle)
+			total += timer_pool->GetStatistics(pass.timer).last_ms;
+	}
+	return total;
+}
+
+GPUTimerQueryPool::Statistics RenderGraph::GetPassStatistics(PassHandle pass) const
+{
+	if (timer_pool == nullptr || IsCulled(pass) || passes[pass].timer == invalid_handle)
+		return GPUTimerQueryPool::Statistics();
+
+	return timer_pool->GetStatistics(passes[pass].timer);
+}
+
+void RenderGraph::RenderStatistics()
+{
+	if (ImGui::BeginTable("Render graph passes", 2, ImGuiTableFlags_SizingFixedFit)) {
+		ImGui::TableSetupColumn("Pass");
+		ImGui::TableSetupColumn("Status");
+		ImGui::TableHeadersRow();
+		for (auto const& pass : passes) {
+			ImGui::TableNextColumn();
+			ImGui::Text("%s", pass.name.c_str());
+			ImGui::TableNextColumn();
+			ImGui::Text("%s", pass.is_culled ? "culled" : "executed");
+		}
+		ImGui::EndTable();
+	}
+
+	std::size_t requested_size = 0u;
+	if (ImGui::BeginTable("Render graph textures", 4, ImGuiTableFlags_SizingFixedFit)) {
+		ImGui::TableSetupColumn("Texture");
+		ImGui::TableSetupColumn("Size");
+		ImGui::TableSetupColumn("Passes");
+		ImGui::TableSetupColumn("Storage");
+		ImGui::TableHeadersRow();
+		for (auto const& resource : resources) {
+			if (resource.physical_texture == invalid_handle)
+				continue;
+			requested_size += physical_textures[resource.physical_texture].size;
+
+			ImGui::TableNextColumn();
+			ImGui::Text("%s", resource.name.c_str());
+			ImGui::TableNextColumn();
+			ImGui::Text("%dx%d", resource.width, resource.height);
+			ImGui::TableNextColumn();
+			if (resource.last_use == passes.size())
+				ImGui::Text("%zu-end", resource.first_use);
+			else
+				ImGui::Text("%zu-%zu", resource.first_use, resource.last_use);
+			ImGui::TableNextColumn();
+			ImGui::Text("#%zu", resource.physical_texture);
+		}
+		ImGui::EndTable();
+	}
+
+	auto const allocated_size = std::accumulate(physical_textures.begin(), physical_textures.end(), std::size_t{ 0u },
+	                                            [](std::size_t sum, PhysicalTexture const& texture){ return sum + texture.size; });
+	ImGui::Text("%zu textures backed by %zu allocations: %.1f MiB, %.1f MiB saved by aliasing",
+	            std::count_if(resources.begin(), resources.end(), [](Resource const& resource){ return resource.physical_texture != invalid_handle; }),
+	            physical_textures.size(),
+	            allocated_size / (1024.0f * 1024.0f),
+	            (requested_size - allocated_size) / (1024.0f * 1024.0f));
+}
+
+bool RenderGraph::ValidatePass(PassHandle pass, char const* caller) const
+{
+	if (pass < passes.size())
+		return true;
+
+	LogError("%s: invalid pass handle '%zu'.", caller, pass);
+	return false;
+}
+
+bool RenderGraph::ValidateResource(ResourceHandle texture, char const* caller) const
+{
+	if (texture < resources.size())
+		return true;
+
+	LogError("%s: invalid texture handle '%zu'.", caller, texture);
+	return false;
+}
@@ -0,0 +1,200 @@
+#pragma once
+
+#include "GPUTimerQueryPool.hpp"
+
+#include <glad/glad.h>
+#include <glm/vec4.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+//! \brief Small frame graph taking care of the render targets and
+//! framebuffers of a rendering pipeline.
+//!
+//! Passes are declared in execution order, alongside the textures they
+//! sample from and render to; `Compile()` then
+//! * culls passes whose results are never used;
+//! * works out which attachments need to be cleared, which can be left
+//!   undefined, and which can be invalidated once the pass is done;
+//! * allocates the textures, reusing the same OpenGL texture for several
+//!   graph textures of identical format and size whose lifetimes do not
+//!   overlap;
+//! * creates one framebuffer per distinct set of attachments.
+//!
+//! `Execute()` runs the passes, each one within its own debug group and, if a
+//! timer pool was provided, timed.
+//!
+//! Declaring the graph is cheap and meant to be redone whenever its structure
+//! changes, by calling `Reset()` first: OpenGL textures and framebuffers are
+//! kept around and reused by the next compilation when possible.
+class RenderGraph
+{
+public:
+	using ResourceHandle = std::size_t;
+	using PassHandle = std::size_t;
+	static constexpr std::size_t invalid_handle = ~std::size_t(0);
+
+	enum class LoadOp : std::uint32_t {
+		Load = 0u, //!< Keep the previous content; cleared if there is none
+		Clear,     //!< Clear to the given value before running the pass
+		DontCare   //!< The pass overwrites the whole attachment
+	};
+
+	struct TextureDescription {
+		GLint internal_format = GL_RGBA8;
+		GLenum format = GL_RGBA;
+		GLenum type = GL_UNSIGNED_BYTE;
+		//! When set, the texture is sized after the framebuffer multiplied
+		//! by `scale`, and `width` and `height` are ignored.
+		bool is_framebuffer_relative = true;
+		float scale = 1.0f;
+		GLsizei width = 0;
+		GLsizei height = 0;
+		bool has_mipmaps = false;
+	};
+
+	//! \brief Record the commands of a pass.
+	//!
+	//! The framebuffer derived from the attachments of the pass is bound,
+	//! the viewport covers the attachments, and clears have been done by the
+	//! time it is called.
+	using ExecuteCallback = std::function<void(RenderGraph const& graph)>;
+
+	RenderGraph() = default;
+	~RenderGraph();
+	RenderGraph(RenderGraph const&) = delete;
+	RenderGraph& operator=(RenderGraph const&) = delete;
+
+	//! \brief Set the size framebuffer-relative textures are derived from;
+	//! takes effect on the next compilation.
+	void SetFramebufferSize(GLsizei width, GLsizei height);
+
+	//! \brief Time all passes using the given pool; it has to outlive the
+	//! graph. Timers are registered by pass name, and kept across resets.
+	void SetTimerPool(GPUTimerQueryPool* pool);
+
+	//! \brief Remove all passes and textures, to declare a new graph.
+	void Reset();
+
+	ResourceHandle CreateTexture(std::string const& name, TextureDescription const& description);
+
+	PassHandle AddPass(std::string const& name, ExecuteCallback execute);
+
+	//! \brief Declare that `pass` samples from `texture`.
+	void ReadTexture(PassHandle pass, ResourceHandle texture);
+
+	//! \brief Declare that `pass` renders to `texture`, with its fragment
+	//! shader output at `location`.
+	void WriteColour(PassHandle pass, ResourceHandle texture, GLuint location,
+	                 LoadOp load_op = LoadOp::Load, glm::vec4 const& clear_colour = glm::vec4(0.0f));
+
+	//! \brief Declare that `pass` writes to `texture` as an image, for
+	//! example from a compute shader; the pass has to bind it and issue the
+	//! memory barriers needed by the passes reading it.
+	void WriteImage(PassHandle pass, ResourceHandle texture);
+
+	//! \brief Use `texture` as the depth (or depth-stencil) attachment of
+	//! `pass`; if `is_written` is false, it is only used for depth testing.
+	void SetDepthAttachment(PassHandle pass, ResourceHandle texture, bool is_written,
+	                        LoadOp load_op = LoadOp::Load, float clear_depth = 1.0f);
+
+	//! \brief Prevent `pass` from being culled, for example because it
+	//! renders to the default framebuffer.
+	void SetSideEffects(PassHandle pass);
+
+	//! \brief Keep the content of `texture` around after the last pass.
+	void MarkOutput(ResourceHandle texture);
+
+	void Compile();
+	void Execute();
+
+	//! \brief Whether the graph was modified since it was last compiled.
+	bool IsDirty() const;
+
+	GLuint GetTexture(ResourceHandle texture) const;
+	GLsizei GetWidth(ResourceHandle texture) const;
+	GLsizei GetHeight(ResourceHandle texture) const;
+	GLuint GetFramebuffer(PassHandle pass) const;
+	bool IsCulled(PassHandle pass) const;
+
+	//! \brief Sum of the latest GPU timings of all passes that are not
+	//! culled, or 0 if no timer pool was set.
+	double GetLastGPUTime() const;
+
+	//! \brief GPU timings of `pass`, or empty statistics if no timer pool
+	//! was set or if it is culled.
+	GPUTimerQueryPool::Statistics GetPassStatistics(PassHandle pass) const;
+
+	//! \brief Display the passes, textures and memory usage in ImGui.
+	void RenderStatistics();
+
+private:
+	struct Attachment {
+		ResourceHandle texture = invalid_handle;
+		GLuint location = 0u;
+		LoadOp load_op = LoadOp::Load;
+		glm::vec4 clear_colour = glm::vec4(0.0f);
+		float clear_depth = 1.0f;
+		bool is_written = true;
+		// Filled in by Compile()
+		LoadOp effective_load_op = LoadOp::Load;
+		bool is_stored = true;
+	};
+
+	struct Pass {
+		std::string name;
+		ExecuteCallback execute;
+		std::vector<ResourceHandle> reads;
+		std::vector<ResourceHandle> image_writes;
+		std::vector<Attachment> colour_attachments;
+		Attachment depth_attachment;
+		bool has_side_effects = false;
+		// Filled in by Compile()
+		bool is_culled = false;
+		GLuint fbo = 0u;
+		GLsizei width = 0;
+		GLsizei height = 0;
+		std::size_t timer = invalid_handle;
+	};
+
+	struct Resource {
+		std::string name;
+		TextureDescription description;
+		bool is_output = false;
+		// Filled in by Compile()
+		GLsizei width = 0;
+		GLsizei height = 0;
+		std::size_t first_use = invalid_handle;
+		std::size_t last_use = invalid_handle;
+		std::size_t physical_texture = invalid_handle;
+	};
+
+	struct PhysicalTexture {
+		GLuint texture = 0u;
+		TextureDescription description;
+		GLsizei width = 0;
+		GLsizei height = 0;
+		std::size_t size = 0u; // In bytes
+		std::size_t busy_until = invalid_handle;
+	};
+
+	//! \return whether the handle is valid; it gets reported otherwise.
+	bool ValidatePass(PassHandle pass, char const* caller) const;
+	bool ValidateResource(ResourceHandle texture, char const* caller) const;
+	void AllocateTextures();
+	void CreateFramebuffers();
+
+	std::vector<Pass> passes;
+	std::vector<Resource> resources;
+	std::vector<PhysicalTexture> physical_textures;
+	std::map<std::vector<GLuint>, GLuint> framebuffers; // Keyed by their attachments
+	std::map<std::string, std::size_t> timers;          // Keyed by pass name
+	GPUTimerQueryPool* timer_pool = nullptr;
+	GLsizei framebuffer_width = 0;
+	GLsizei framebuffer_height = 0;
+	bool is_dirty = true;
+};
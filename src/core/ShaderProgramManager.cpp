@@ -2,16 +2,155 @@
 
 #include "config.hpp"
 
+#include "GLStateCache.hpp"
 #include "Log.h"
 #include "opengl.hpp"
+#include "Profiler.h"
 #include "various.hpp"
 
 #include <imgui.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <sstream>
 #include <type_traits>
 
+namespace
+{
+	// From GL_KHR_parallel_shader_compile, which GLAD was not generated with;
+	// GL_ARB_parallel_shader_compile uses the same value.
+	constexpr GLenum completion_status = 0x91B1;
+
+	bool isParallelCompileSupported()
+	{
+		static bool const is_supported = []() {
+			GLint extensions_nb = 0;
+			glGetIntegerv(GL_NUM_EXTENSIONS, &extensions_nb);
+			for (GLint i = 0; i < extensions_nb; ++i) {
+				auto const extension = reinterpret_cast<char const*>(glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+				if (extension != nullptr && (std::strcmp(extension, "GL_KHR_parallel_shader_compile") == 0
+				                             || std::strcmp(extension, "GL_ARB_parallel_shader_compile") == 0))
+					return true;
+			}
+			return false;
+		}();
+		return is_supported;
+	}
+
+	// The #version directive has to come first; #line keeps the line
+	// numbers of compilation errors matching the file.
+	std::string injectDefines(std::string const& source, std::vector<std::string> const& defines)
+	{
+		std::string defines_block;
+		for (auto const& define : defines)
+			defines_block += "#define " + define + "\n";
+
+		auto const version = source.find("#version");
+		if (version == std::string::npos)
+			return defines_block + "#line 1\n" + source;
+		auto const version_end = source.find('\n', version);
+		if (version_end == std::string::npos)
+			return source + "\n" + defines_block;
+
+		auto const next_line = std::count(source.begin(), source.begin() + version_end, '\n') + 2;
+		return source.substr(0, version_end + 1u) + defines_block
+		     + "#line " + std::to_string(next_line) + " 0\n" + source.substr(version_end + 1u);
+	}
+
+	// Guards against files including each other through different paths.
+	constexpr std::size_t max_include_depth = 32u;
+
+	enum class Directive {
+		none,
+		include,
+		pragma_once
+	};
+
+	// Recognises `#include "filename"` (or with angle brackets) and
+	// `#pragma once`, as all other directives are left to the GLSL compiler.
+	Directive parseDirective(std::string const& line, std::string& include_filename)
+	{
+		auto position = line.find_first_not_of(" \t");
+		if (position == std::string::npos || line[position] != '#')
+			return Directive::none;
+		position = line.find_first_not_of(" \t", position + 1u);
+		if (position == std::string::npos)
+			return Directive::none;
+
+		if (line.compare(position, 6u, "pragma") == 0) {
+			position = line.find_first_not_of(" \t", position + 6u);
+			return position != std::string::npos && line.compare(position, 4u, "once") == 0
+			     ? Directive::pragma_once : Directive::none;
+		}
+		if (line.compare(position, 7u, "include") != 0)
+			return Directive::none;
+
+		position = line.find_first_not_of(" \t", position + 7u);
+		if (position == std::string::npos || (line[position] != '"' && line[position] != '<'))
+			return Directive::none;
+		auto const end = line.find(line[position] == '"' ? '"' : '>', position + 1u);
+		if (end == std::string::npos)
+			return Directive::none;
+
+		include_filename = line.substr(position + 1u, end - position - 1u);
+		return Directive::include;
+	}
+
+	// Collapses the "." and ".." components, for a file included through
+	// different paths to still be known under a single name.
+	std::string normalisePath(std::string const& path)
+	{
+		std::vector<std::string> components;
+		std::size_t start = 0u;
+		for (;;) {
+			auto const end = path.find_first_of("/\\", start);
+			auto const component = path.substr(start, end != std::string::npos ? end - start : std::string::npos);
+			if (component == ".." && !components.empty() && !components.back().empty() && components.back() != "..")
+				components.pop_back();
+			else if (component != ".")
+				components.push_back(component);
+			if (end == std::string::npos)
+				break;
+			start = end + 1u;
+		}
+
+		if (components.empty())
+			return ".";
+
+		std::string normalised_path;
+		for (auto const& component : components) {
+			if (&component != &components.front())
+				normalised_path += '/';
+			normalised_path += component;
+		}
+		return normalised_path;
+	}
+
+	bool doesFileExist(std::string const& filename)
+	{
+		return std::ifstream(utils::widen(filename)).is_open();
+	}
+
+	std::string resolveInclude(std::string const& including_filename, std::string const& include_filename)
+	{
+		auto const separator = including_filename.find_last_of("/\\");
+		auto const directory = separator != std::string::npos ? including_filename.substr(0, separator + 1u) : std::string();
+		auto const relative_filename = normalisePath(directory + include_filename);
+		if (doesFileExist(relative_filename))
+			return relative_filename;
+
+		auto const shaders_filename = normalisePath(config::shaders_path(include_filename));
+		return doesFileExist(shaders_filename) ? shaders_filename : std::string();
+	}
+}
+
 ShaderProgramManager::~ShaderProgramManager()
 {
+	for (auto& build : pending_builds)
+		CancelBuild(build);
+
 	for (auto const& i : program_entries) {
 		if (i.first != 0u) {
 			glDeleteProgram(i.first);
@@ -33,6 +172,8 @@ void ShaderProgramManager::CreateAndRegisterProgram(char const* const program_na
 
 	program_entries.emplace_back(program, program_data);
 	program_names.emplace_back(program_name);
+	program_defines.emplace_back();
+	program_reflections.emplace_back();
 
 	ProcessProgram(program_entries.size() - 1);
 }
@@ -46,23 +187,227 @@ void ShaderProgramManager::CreateAndRegisterComputeProgram(char const* const pro
 
 	program_entries.emplace_back(program, ProgramData{ { ShaderType::compute, filename } });
 	program_names.emplace_back(program_name);
+	program_defines.emplace_back();
+	program_reflections.emplace_back();
 
 	ProcessProgram(program_entries.size() - 1);
 }
 
-bool ShaderProgramManager::ReloadAllPrograms()
+std::size_t ShaderProgramManager::CreateAndRegisterProgramVariants(char const* const program_name, ProgramData const& program_data, std::vector<std::string> const& feature_defines)
+{
+	if (feature_defines.size() > 32u)
+		LogWarning("Program '%s' has %zu features, but only the first 32 can be selected.", program_name, feature_defines.size());
+
+	ProgramVariants variants;
+	variants.name = program_name;
+	variants.data = program_data;
+	variants.feature_defines = feature_defines;
+	program_variants.push_back(std::move(variants));
+
+	return program_variants.size() - 1u;
+}
+
+GLuint ShaderProgramManager::GetProgramVariant(std::size_t const variants_handle, std::uint32_t features)
+{
+	if (variants_handle >= program_variants.size()) {
+		LogError("Invalid program variants handle '%zu': only %zu are registered.", variants_handle, program_variants.size());
+		return 0u;
+	}
+
+	auto& variants = program_variants[variants_handle];
+	if (variants.feature_defines.size() < 32u)
+		features &= (1u << variants.feature_defines.size()) - 1u;
+
+	auto const program_index = variants.program_indices.find(features);
+	if (program_index != variants.program_indices.end())
+		return program_entries[program_index->second].first;
+
+	std::vector<std::string> defines;
+	std::string name = variants.name;
+	for (std::size_t i = 0; i < variants.feature_defines.size() && i < 32u; ++i) {
+		if ((features & (1u << i)) == 0u)
+			continue;
+		name += defines.empty() ? " [" : ", ";
+		defines.push_back(variants.feature_defines[i]);
+		name += variants.feature_defines[i];
+	}
+	if (!defines.empty())
+		name += "]";
+
+	variant_programs.push_back(0u);
+	variant_names.push_back(std::move(name));
+	program_entries.emplace_back(variant_programs.back(), variants.data);
+	program_names.emplace_back(variant_names.back().c_str());
+	program_defines.push_back(std::move(defines));
+	program_reflections.emplace_back();
+	variants.program_indices.emplace(features, program_entries.size() - 1u);
+
+	ProcessProgram(program_entries.size() - 1u);
+
+	return variant_programs.back();
+}
+
+ShaderReflection const& ShaderProgramManager::GetReflection(GLuint const& program) const
 {
-	bool encountered_failures = false;
 	for (std::size_t i = 0; i < program_entries.size(); ++i) {
-		auto& program = program_entries[i].first;
-		if (program != 0u)
-			glDeleteProgram(program);
-		program = 0u;
-		ProcessProgram(i);
-		encountered_failures |= program == 0u;
+		if (&program_entries[i].first == &program)
+			return program_reflections[i];
 	}
 
-	return !encountered_failures;
+	static ShaderReflection empty_reflection;
+	return empty_reflection;
+}
+
+ShaderReflection const& ShaderProgramManager::GetProgramVariantReflection(std::size_t const variants_handle, std::uint32_t const features)
+{
+	static ShaderReflection empty_reflection;
+	if (variants_handle >= program_variants.size()) {
+		LogError("Invalid program variants handle '%zu': only %zu are registered.", variants_handle, program_variants.size());
+		return empty_reflection;
+	}
+
+	GetProgramVariant(variants_handle, features);
+	auto const& variants = program_variants[variants_handle];
+	auto const mask = variants.feature_defines.size() < 32u ? (1u << variants.feature_defines.size()) - 1u : ~0u;
+	return program_reflections[variants.program_indices.at(features & mask)];
+}
+
+bool ShaderProgramManager::ReloadAllPrograms()
+{
+	PROFILE_FUNCTION();
+
+	for (auto& build : pending_builds)
+		CancelBuild(build);
+	pending_builds.clear();
+
+	source_files.clear();
+	preprocessed_sources.clear();
+
+	std::vector<std::size_t> program_indices(program_entries.size());
+	for (std::size_t i = 0; i < program_indices.size(); ++i)
+		program_indices[i] = i;
+	return RebuildPrograms(program_indices);
+}
+
+bool ShaderProgramManager::ReloadModifiedPrograms()
+{
+	PROFILE_FUNCTION();
+
+	// Rely on the modification times rather than on the file watcher, as
+	// its events are consumed by `Update()`.
+	std::vector<std::string> modified_files;
+	for (auto const& file : source_files) {
+		if (FileWatcher::GetModificationTime(file.first) != file.second.modification_time)
+			modified_files.push_back(file.first);
+	}
+
+	std::set<std::size_t> program_indices(failed_programs);
+	for (auto const& filename : modified_files) {
+		InvalidateSourceFile(filename);
+		auto const programs = programs_per_source.find(filename);
+		if (programs != programs_per_source.end())
+			program_indices.insert(programs->second.begin(), programs->second.end());
+	}
+
+	if (program_indices.empty()) {
+		LogInfo("No shader sources were modified since they were last read: no programs to reload.");
+		return true;
+	}
+	return RebuildPrograms(std::vector<std::size_t>(program_indices.begin(), program_indices.end()));
+}
+
+bool ShaderProgramManager::Update()
+{
+	PROFILE_FUNCTION();
+
+	// Starting a build blocks until it is compiled unless the driver works
+	// in the background.
+	auto const started_builds_nb = isParallelCompileSupported() ? queued_programs.size()
+	                                                            : std::min<std::size_t>(queued_programs.size(), 1u);
+	for (std::size_t i = 0; i < started_builds_nb; ++i) {
+		Build build;
+		if (StartBuild(queued_programs[i], build))
+			pending_builds.push_back(std::move(build));
+		else
+			failed_programs.insert(queued_programs[i]);
+	}
+	queued_programs.erase(queued_programs.begin(), queued_programs.begin() + started_builds_nb);
+
+	// A program gets rebuilt once, even if several of its files changed.
+	std::set<std::size_t> modified_programs;
+	for (auto const& filename : file_watcher.Poll()) {
+		InvalidateSourceFile(filename);
+		auto const programs = programs_per_source.find(filename);
+		if (programs == programs_per_source.end())
+			continue;
+
+		for (auto const program_index : programs->second) {
+			if (modified_programs.insert(program_index).second)
+				LogInfo("\"%s\" was modified: rebuilding program \"%s\".", filename.c_str(), program_names[program_index]);
+		}
+	}
+
+	for (auto const program_index : modified_programs) {
+		queued_programs.erase(std::remove(queued_programs.begin(), queued_programs.end(), program_index), queued_programs.end());
+
+		// A build still in progress is already outdated.
+		auto const pending_build = std::find_if(pending_builds.begin(), pending_builds.end(),
+		                                        [program_index](Build const& build) {
+		                                            return build.program_index == program_index;
+		                                        });
+		if (pending_build != pending_builds.end()) {
+			CancelBuild(*pending_build);
+			pending_builds.erase(pending_build);
+		}
+
+		Build build;
+		if (StartBuild(program_index, build))
+			pending_builds.push_back(std::move(build));
+		else
+			failed_programs.insert(program_index);
+	}
+
+	bool were_programs_replaced = false;
+	for (auto build = pending_builds.begin(); build != pending_builds.end();) {
+		if (!IsBuildComplete(*build)) {
+			++build;
+			continue;
+		}
+
+		GLuint const program = FinishBuild(*build);
+		if (program != 0u) {
+			ReplaceProgram(build->program_index, program);
+			failed_programs.erase(build->program_index);
+			were_programs_replaced = true;
+		} else {
+			failed_programs.insert(build->program_index);
+			if (program_entries[build->program_index].first != 0u)
+				LogError("Program \"%s\" failed to build; its previous version is kept.", program_names[build->program_index]);
+			else
+				LogError("Program \"%s\" failed to build.", program_names[build->program_index]);
+		}
+		build = pending_builds.erase(build);
+	}
+
+	return were_programs_replaced;
+}
+
+bool ShaderProgramManager::AreAllProgramsValid() const
+{
+	return std::all_of(program_entries.begin(), program_entries.end(),
+	                   [](ProgramEntry const& entry) {
+	                       return entry.first != 0u;
+	                   });
+}
+
+void ShaderProgramManager::SetBuildsDeferred(bool const are_deferred)
+{
+	are_builds_deferred = are_deferred;
+}
+
+std::size_t ShaderProgramManager::GetPendingBuildsCount() const
+{
+	return queued_programs.size() + pending_builds.size();
 }
 
 ShaderProgramManager::SelectedProgram ShaderProgramManager::SelectProgram(std::string const& label, std::int32_t& program_index)
@@ -81,34 +426,290 @@ ShaderProgramManager::SelectedProgram ShaderProgramManager::SelectProgram(std::s
 
 void ShaderProgramManager::ProcessProgram(std::size_t const program_index)
 {
-	auto& program_entry = program_entries[program_index];
-	auto& program = program_entry.first;
-	auto const& program_data = program_entry.second;
+	// Watched even if they fail to build, for them to be rebuilt once fixed.
+	auto const& program_data = program_entries[program_index].second;
+	for (auto const& i : program_data)
+		AddDependency(normalisePath(config::shaders_path(i.second)), program_index);
+
+	if (are_builds_deferred) {
+		queued_programs.push_back(program_index);
+		return;
+	}
 
-	std::vector<GLuint> shaders;
-	shaders.reserve(program_data.size());
+	Build build;
+	if (StartBuild(program_index, build))
+		program_entries[program_index].first = FinishBuild(build);
+	if (program_entries[program_index].first == 0u)
+		failed_programs.insert(program_index);
+	program_reflections[program_index].Reflect(program_entries[program_index].first);
+}
+
+bool ShaderProgramManager::RebuildPrograms(std::vector<std::size_t> const& program_indices)
+{
+	auto const start_time = std::chrono::high_resolution_clock::now();
+
+	// Start all builds before waiting on any, for drivers to work on them in
+	// parallel.
+	std::vector<Build> builds(program_indices.size());
+	std::vector<bool> were_builds_started(program_indices.size(), false);
+	for (std::size_t i = 0; i < program_indices.size(); ++i) {
+		auto const program_index = program_indices[i];
+		queued_programs.erase(std::remove(queued_programs.begin(), queued_programs.end(), program_index), queued_programs.end());
+		auto const pending_build = std::find_if(pending_builds.begin(), pending_builds.end(),
+		                                        [program_index](Build const& build) {
+		                                            return build.program_index == program_index;
+		                                        });
+		if (pending_build != pending_builds.end()) {
+			CancelBuild(*pending_build);
+			pending_builds.erase(pending_build);
+		}
+
+		were_builds_started[i] = StartBuild(program_index, builds[i]);
+	}
+
+	bool encountered_failures = false;
+	for (std::size_t i = 0; i < program_indices.size(); ++i) {
+		GLuint const program = were_builds_started[i] ? FinishBuild(builds[i]) : 0u;
+		if (program == 0u) {
+			failed_programs.insert(program_indices[i]);
+			encountered_failures = true;
+			continue;
+		}
+		ReplaceProgram(program_indices[i], program);
+		failed_programs.erase(program_indices[i]);
+	}
 
+	auto const end_time = std::chrono::high_resolution_clock::now();
+	LogInfo("%zu programs reloaded in %.3f ms.", program_indices.size(),
+	        std::chrono::duration<float, std::milli>(end_time - start_time).count());
+
+	return !encountered_failures;
+}
+
+void ShaderProgramManager::AddDependency(std::string const& filename, std::size_t const program_index)
+{
+	file_watcher.Watch(filename);
+	programs_per_source[filename].insert(program_index);
+}
+
+void ShaderProgramManager::InvalidateSourceFile(std::string const& filename)
+{
+	source_files.erase(filename);
+	for (auto source = preprocessed_sources.begin(); source != preprocessed_sources.end();) {
+		auto const& files = source->second.files;
+		if (std::find(files.begin(), files.end(), filename) != files.end())
+			source = preprocessed_sources.erase(source);
+		else
+			++source;
+	}
+}
+
+ShaderProgramManager::SourceFile const* ShaderProgramManager::GetSourceFile(std::string const& filename)
+{
+	auto const cached_file = source_files.find(filename);
+	if (cached_file != source_files.end())
+		return &cached_file->second;
+
+	// Retrieved first, for a modification made while reading the file to
+	// be caught by `ReloadModifiedPrograms()`.
+	SourceFile file;
+	file.modification_time = FileWatcher::GetModificationTime(filename);
+	file.contents = utils::slurp_file(filename);
+	if (file.contents.empty()) {
+		LogError("Retrieval of shader '%s' failed; see previous message for details.", filename.c_str());
+		return nullptr;
+	}
+
+	return &source_files.emplace(filename, std::move(file)).first->second;
+}
+
+bool ShaderProgramManager::Preprocess(std::string const& filename, PreprocessedSource& preprocessed)
+{
+	auto const cached_source = preprocessed_sources.find(filename);
+	if (cached_source != preprocessed_sources.end()) {
+		preprocessed = cached_source->second;
+		return true;
+	}
+
+	preprocessed = PreprocessedSource();
+	if (!PreprocessFile(filename, 0u, preprocessed))
+		return false;
+
+	preprocessed_sources.emplace(filename, preprocessed);
+	return true;
+}
+
+bool ShaderProgramManager::PreprocessFile(std::string const& filename, std::size_t const depth, PreprocessedSource& preprocessed)
+{
+	auto const source_string = std::to_string(preprocessed.files.size());
+	preprocessed.files.push_back(filename);
+
+	auto const file = GetSourceFile(filename);
+	if (file == nullptr)
+		return false;
+
+	std::istringstream lines(file->contents);
+	std::string line;
+	std::size_t line_number = 0u;
+	while (std::getline(lines, line)) {
+		++line_number;
+
+		std::string include_filename;
+		auto const directive = parseDirective(line, include_filename);
+		if (directive == Directive::none) {
+			preprocessed.source += line + "\n";
+			continue;
+		}
+		// Lines are kept, empty, for the following ones to keep their number.
+		if (directive == Directive::pragma_once) {
+			preprocessed.source += "\n";
+			continue;
+		}
+
+		auto const included_filename = resolveInclude(filename, include_filename);
+		if (included_filename.empty()) {
+			LogError("Failed to find \"%s\", included by '%s' at line %zu.", include_filename.c_str(), filename.c_str(), line_number);
+			return false;
+		}
+		if (std::find(preprocessed.files.begin(), preprocessed.files.end(), included_filename) != preprocessed.files.end()) {
+			preprocessed.source += "\n";
+			continue;
+		}
+		if (depth + 1u >= max_include_depth) {
+			LogError("Too many nested includes when including \"%s\" from '%s' at line %zu.", include_filename.c_str(), filename.c_str(), line_number);
+			return false;
+		}
+
+		preprocessed.source += "#line 1 " + std::to_string(preprocessed.files.size()) + "\n";
+		if (!PreprocessFile(included_filename, depth + 1u, preprocessed))
+			return false;
+		preprocessed.source += "#line " + std::to_string(line_number + 1u) + " " + source_string + "\n";
+	}
+
+	return true;
+}
+
+bool ShaderProgramManager::StartBuild(std::size_t const program_index, Build& build)
+{
+	build.program_index = program_index;
+	build.start_time = std::chrono::high_resolution_clock::now();
+
+	auto const& program_data = program_entries[program_index].second;
+	ProgramBinaryCache::Stages stages;
+	stages.reserve(program_data.size());
 	for (auto const& i : program_data) {
-		std::string const full_filename = config::shaders_path(i.second);
-		auto const shader_source = utils::slurp_file(full_filename);
-		if (shader_source.empty()) {
-			LogError("Retrieval of shader '%s' failed; see previous message for details.", full_filename.c_str());
-			return;
+		auto const full_filename = normalisePath(config::shaders_path(i.second));
+		PreprocessedSource preprocessed;
+		bool const is_preprocessed = Preprocess(full_filename, preprocessed);
+		for (auto const& filename : preprocessed.files)
+			AddDependency(filename, program_index);
+		if (!is_preprocessed) {
+			LogError("Preprocessing of shader '%s' failed; see previous message for details.", full_filename.c_str());
+			return false;
 		}
 
-		GLuint shader = utils::opengl::shader::generate_shader(static_cast<std::underlying_type<ShaderType>::type>(i.first), shader_source);
-		if (shader == 0u) {
-			for (auto& shader : shaders)
-				glDeleteShader(shader);
-			LogError("Compilation of shader '%s' failed; see previous message for details.", full_filename.c_str());
-			return;
+		auto shader_source = std::move(preprocessed.source);
+		if (!program_defines[program_index].empty())
+			shader_source = injectDefines(shader_source, program_defines[program_index]);
+		build.filenames.push_back(full_filename);
+		build.source_strings.push_back(std::move(preprocessed.files));
+		stages.emplace_back(static_cast<std::underlying_type<ShaderType>::type>(i.first), std::move(shader_source));
+	}
+
+	build.cache_key = binary_cache.ComputeKey(stages);
+	build.program = binary_cache.Load(build.cache_key);
+	build.was_cached = build.program != 0u;
+	if (build.was_cached)
+		return true;
+
+	// Nothing gets checked before the linking completed, to not block on
+	// drivers compiling in the background.
+	build.program = glCreateProgram();
+	if (binary_cache.IsEnabled())
+		glProgramParameteri(build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	for (auto const& stage : stages) {
+		GLuint const shader = glCreateShader(stage.first);
+		GLchar const* const source = stage.second.c_str();
+		glShaderSource(shader, 1, &source, nullptr);
+		glCompileShader(shader);
+		glAttachShader(build.program, shader);
+		build.shaders.push_back(shader);
+	}
+	glLinkProgram(build.program);
+
+	return true;
+}
+
+bool ShaderProgramManager::IsBuildComplete(Build const& build) const
+{
+	if (build.was_cached || !isParallelCompileSupported())
+		return true;
+
+	GLint is_complete = GL_FALSE;
+	glGetProgramiv(build.program, completion_status, &is_complete);
+	return is_complete != GL_FALSE;
+}
+
+GLuint ShaderProgramManager::FinishBuild(Build& build)
+{
+	bool are_shaders_compiled = true;
+	for (std::size_t i = 0; i < build.shaders.size(); ++i) {
+		if (!utils::opengl::shader::check_shader_compilation(build.shaders[i])) {
+			LogError("Compilation of shader '%s' failed; see previous message for details.", build.filenames[i].c_str());
+			are_shaders_compiled = false;
+
+			auto const& source_strings = build.source_strings[i];
+			for (std::size_t j = 1; j < source_strings.size(); ++j)
+				LogError("\tSource string %zu of '%s' is '%s'.", j, build.filenames[i].c_str(), source_strings[j].c_str());
 		}
-		shaders.push_back(shader);
+	}
+	bool const is_linked = build.was_cached
+	                    || (are_shaders_compiled && utils::opengl::shader::check_program_linking(build.program));
+
+	for (auto const shader : build.shaders) {
+		glDetachShader(build.program, shader);
+		glDeleteShader(shader);
+	}
+	build.shaders.clear();
+
+	if (!is_linked) {
+		glDeleteProgram(build.program);
+		build.program = 0u;
+		return 0u;
 	}
 
-	program = utils::opengl::shader::generate_program(shaders);
-	utils::opengl::debug::nameObject(GL_PROGRAM, program, program_names[program_index]);
+	if (!build.was_cached)
+		binary_cache.Store(build.cache_key, build.program);
+	utils::opengl::debug::nameObject(GL_PROGRAM, build.program, program_names[build.program_index]);
+
+	auto const end_time = std::chrono::high_resolution_clock::now();
+	LogInfo("Program \"%s\" %s in %.3f ms.", program_names[build.program_index],
+	        build.was_cached ? "loaded from the binary cache" : "compiled and linked",
+	        std::chrono::duration<float, std::milli>(end_time - build.start_time).count());
+
+	auto const program = build.program;
+	build.program = 0u;
+	return program;
+}
 
-	for (auto& shader : shaders)
+void ShaderProgramManager::CancelBuild(Build& build)
+{
+	for (auto const shader : build.shaders)
 		glDeleteShader(shader);
+	build.shaders.clear();
+	if (build.program != 0u)
+		glDeleteProgram(build.program);
+	build.program = 0u;
+}
+
+void ShaderProgramManager::ReplaceProgram(std::size_t const program_index, GLuint const program)
+{
+	auto& current_program = program_entries[program_index].first;
+	if (current_program != 0u)
+		glDeleteProgram(current_program);
+	current_program = program;
+	program_reflections[program_index].Reflect(program);
+
+	// The cache could still refer to the deleted program.
+	GLStateCache::Get().Invalidate();
 }
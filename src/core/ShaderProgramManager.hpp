@@ -1,9 +1,17 @@
 #pragma once
 
+#include "FileWatcher.hpp"
+#include "ProgramBinaryCache.hpp"
+#include "ShaderReflection.hpp"
+
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include <chrono>
+#include <ctime>
+#include <deque>
 #include <map>
+#include <set>
 #include <string>
 #include <utility>
 #include <vector>
@@ -19,6 +27,17 @@ enum class ShaderType : std::uint32_t {
 	compute = GL_COMPUTE_SHADER
 };
 
+//! \brief Builds and keeps track of shader programs, rebuilding them when
+//! their sources get modified.
+//!
+//! Shader sources can use `#include "filename"`, where the filename is
+//! relative to the including file or, failing that, to the shaders folder.
+//! Every file is only included once per shader, as if it had include guards,
+//! and `#line` directives keep the line numbers of compilation errors
+//! matching the files: each included file gets its own source string number,
+//! with the main file being 0, and the mapping gets logged along with the
+//! errors. Preprocessed sources are kept in memory until one of the files
+//! they are made of gets modified.
 class ShaderProgramManager
 {
 public:
@@ -31,12 +50,139 @@ public:
 	~ShaderProgramManager();
 	void CreateAndRegisterProgram(char const* const program_name, ProgramData const& program_data, GLuint& program);
 	void CreateAndRegisterComputeProgram(char const* const program_name, std::string const& filename, GLuint& program);
+
+	//! \brief Register a program built in several variants, each enabling a
+	//! different subset of features through preprocessor defines.
+	//!
+	//! The defines get injected right after the `#version` directive of each
+	//! stage, and variants are only built the first time they are requested.
+	//!
+	//! \param [in] feature_defines one define per feature, like
+	//!             "HAS_DIFFUSE_TEXTURE"; at most 32 of them
+	//! \return the handle to pass to `GetProgramVariant()`
+	std::size_t CreateAndRegisterProgramVariants(char const* const program_name, ProgramData const& program_data, std::vector<std::string> const& feature_defines);
+
+	//! \brief Get the variant enabling the features whose bits are set in
+	//! `features`, bit i enabling `feature_defines[i]`; it gets built if
+	//! this is the first time it is requested.
+	//!
+	//! The program changes whenever the variant gets rebuilt, so it should
+	//! be retrieved again every frame.
+	//!
+	//! \return the variant, or 0 if it failed to build
+	GLuint GetProgramVariant(std::size_t variants_handle, std::uint32_t features);
+
+	//! \brief Reflection of `program`, which has to be the very variable
+	//! given when registering it.
+	//!
+	//! The reference stays valid for the lifetime of the manager, and gets
+	//! updated whenever the program is rebuilt: uniforms can be set through
+	//! it without querying anything again after a reload. Programs that
+	//! were never registered, for example as they need a more recent
+	//! OpenGL version, get an empty reflection on which setters are no-ops.
+	ShaderReflection const& GetReflection(GLuint const& program) const;
+
+	//! \brief Reflection of a variant, built if this is the first time it
+	//! is requested; see `GetReflection()`.
+	ShaderReflection const& GetProgramVariantReflection(std::size_t variants_handle, std::uint32_t features);
+
+	//! \brief Rebuild all programs, reading all their sources again; those
+	//! failing to build keep their previous version.
+	//!
+	//! \return whether all programs were rebuilt successfully
 	bool ReloadAllPrograms();
+
+	//! \brief Rebuild the programs depending on a source file, included ones
+	//! among them, modified since it was last read, as well as those whose
+	//! last build failed; those failing to build keep their previous version.
+	//!
+	//! \return whether all those programs were rebuilt successfully
+	bool ReloadModifiedPrograms();
+
+	//! \brief Rebuild the programs whose sources were modified on disk,
+	//! start the builds deferred by `SetBuildsDeferred()`, and swap in the
+	//! ones done building; call it once per frame.
+	//!
+	//! Programs are compiled and linked in the background if the driver
+	//! supports GL_KHR_parallel_shader_compile, and only replace their
+	//! previous version once they linked successfully.
+	//!
+	//! \return whether any program got replaced, in which case the uniform
+	//!         locations of the replaced programs have to be queried again
+	bool Update();
+
+	//! \brief Whether every program was successfully built at least once.
+	bool AreAllProgramsValid() const;
+
+	//! \brief While enabled, registering a program, or requesting a variant
+	//! for the first time, only queues its build, leaving the program at 0;
+	//! `Update()` then carries the queued builds out, all at once if the
+	//! driver compiles in the background, one per call otherwise. This lets
+	//! the application keep rendering a loading screen meanwhile.
+	void SetBuildsDeferred(bool are_deferred);
+
+	//! \brief Number of builds queued or in progress.
+	std::size_t GetPendingBuildsCount() const;
+
 	SelectedProgram SelectProgram(std::string const& label, std::int32_t& program_index);
 
 private:
+	struct Build {
+		std::size_t program_index = 0u;
+		GLuint program = 0u;
+		std::vector<GLuint> shaders;
+		std::vector<std::string> filenames; // Per shader
+		std::vector<std::vector<std::string>> source_strings; // Per shader, the file of each #line source string
+		std::uint64_t cache_key = 0u;
+		bool was_cached = false;
+		std::chrono::high_resolution_clock::time_point start_time;
+	};
+
+	struct ProgramVariants {
+		char const* name = nullptr;
+		ProgramData data;
+		std::vector<std::string> feature_defines;
+		std::map<std::uint32_t, std::size_t> program_indices; // Per feature set
+	};
+
+	struct SourceFile {
+		std::string contents;
+		std::time_t modification_time = 0; // When it was read
+	};
+
+	struct PreprocessedSource {
+		std::string source;
+		std::vector<std::string> files; // Per #line source string
+	};
+
 	void ProcessProgram(std::size_t program_index);
+	bool RebuildPrograms(std::vector<std::size_t> const& program_indices);
+	void AddDependency(std::string const& filename, std::size_t program_index);
+	void InvalidateSourceFile(std::string const& filename);
+	SourceFile const* GetSourceFile(std::string const& filename);
+	bool Preprocess(std::string const& filename, PreprocessedSource& preprocessed);
+	bool PreprocessFile(std::string const& filename, std::size_t depth, PreprocessedSource& preprocessed);
+	bool StartBuild(std::size_t program_index, Build& build);
+	bool IsBuildComplete(Build const& build) const;
+	GLuint FinishBuild(Build& build);
+	void CancelBuild(Build& build);
+	void ReplaceProgram(std::size_t program_index, GLuint program);
+
 	using ProgramEntry = std::pair<GLuint&, ProgramData>;
 	std::vector<ProgramEntry> program_entries;
 	std::vector<char const*> program_names;
+	std::vector<std::vector<std::string>> program_defines;
+	std::deque<ShaderReflection> program_reflections; // Referenced by users
+	std::vector<ProgramVariants> program_variants;
+	std::deque<GLuint> variant_programs;   // Referenced by their entry
+	std::deque<std::string> variant_names; // Referenced by `program_names`
+	ProgramBinaryCache binary_cache;
+	FileWatcher file_watcher;
+	std::map<std::string, std::set<std::size_t>> programs_per_source; // Included files too
+	std::map<std::string, SourceFile> source_files;
+	std::map<std::string, PreprocessedSource> preprocessed_sources; // Per main file
+	std::set<std::size_t> failed_programs; // Whose last build failed
+	std::vector<Build> pending_builds;
+	std::vector<std::size_t> queued_programs; // Deferred, not started yet
+	bool are_builds_deferred = false;
 };
@@ -0,0 +1,420 @@
+#include "ShaderReflection.hpp"
+
+#include "GLStateCache.hpp"
+#include "Log.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <map>
+#include <numeric>
+
+namespace
+{
+	struct UniformRegistry {
+		std::map<std::string, ShaderReflection::UniformId> ids;
+		std::vector<std::string> names; // Per identifier
+	};
+
+	UniformRegistry& getUniformRegistry()
+	{
+		static UniformRegistry registry;
+		return registry;
+	}
+
+	bool isSampler(GLenum type)
+	{
+		switch (type) {
+		case GL_SAMPLER_1D:
+		case GL_SAMPLER_2D:
+		case GL_SAMPLER_3D:
+		case GL_SAMPLER_CUBE:
+		case GL_SAMPLER_1D_SHADOW:
+		case GL_SAMPLER_2D_SHADOW:
+		case GL_SAMPLER_1D_ARRAY:
+		case GL_SAMPLER_2D_ARRAY:
+		case GL_SAMPLER_1D_ARRAY_SHADOW:
+		case GL_SAMPLER_2D_ARRAY_SHADOW:
+		case GL_SAMPLER_2D_MULTISAMPLE:
+		case GL_SAMPLER_2D_MULTISAMPLE_ARRAY:
+		case GL_SAMPLER_CUBE_SHADOW:
+		case GL_SAMPLER_BUFFER:
+		case GL_SAMPLER_2D_RECT:
+		case GL_SAMPLER_2D_RECT_SHADOW:
+		case GL_SAMPLER_CUBE_MAP_ARRAY:
+		case GL_SAMPLER_CUBE_MAP_ARRAY_SHADOW:
+		case GL_INT_SAMPLER_1D:
+		case GL_INT_SAMPLER_2D:
+		case GL_INT_SAMPLER_3D:
+		case GL_INT_SAMPLER_CUBE:
+		case GL_INT_SAMPLER_1D_ARRAY:
+		case GL_INT_SAMPLER_2D_ARRAY:
+		case GL_INT_SAMPLER_2D_MULTISAMPLE:
+		case GL_INT_SAMPLER_2D_MULTISAMPLE_ARRAY:
+		case GL_INT_SAMPLER_BUFFER:
+		case GL_INT_SAMPLER_2D_RECT:
+		case GL_INT_SAMPLER_CUBE_MAP_ARRAY:
+		case GL_UNSIGNED_INT_SAMPLER_1D:
+		case GL_UNSIGNED_INT_SAMPLER_2D:
+		case GL_UNSIGNED_INT_SAMPLER_3D:
+		case GL_UNSIGNED_INT_SAMPLER_CUBE:
+		case GL_UNSIGNED_INT_SAMPLER_1D_ARRAY:
+		case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY:
+		case GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE:
+		case GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE_ARRAY:
+		case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+		case GL_UNSIGNED_INT_SAMPLER_2D_RECT:
+		case GL_UNSIGNED_INT_SAMPLER_CUBE_MAP_ARRAY:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	// Booleans can be set as integers, and samplers are set as integers.
+	bool isCompatible(GLenum uniform_type, GLenum value_type)
+	{
+		if (uniform_type == value_type)
+			return true;
+		if (value_type == GL_INT)
+			return uniform_type == GL_BOOL || isSampler(uniform_type);
+		if (value_type == GL_UNSIGNED_INT)
+			return uniform_type == GL_BOOL;
+		return false;
+	}
+
+	// Arrays are reported as "name[0]", but are set through "name".
+	std::string stripArraySuffix(std::string name)
+	{
+		auto const suffix_length = sizeof("[0]") - 1u;
+		if (name.size() > suffix_length && name.compare(name.size() - suffix_length, suffix_length, "[0]") == 0)
+			name.resize(name.size() - suffix_length);
+		return name;
+	}
+
+	std::string getResourceName(GLuint program, GLenum interface, GLuint index, GLint max_length)
+	{
+		std::vector<GLchar> name(static_cast<std::size_t>(std::max(max_length, 1)), '\0');
+		GLsizei length = 0;
+		glGetProgramResourceName(program, interface, index, static_cast<GLsizei>(name.size()), &length, name.data());
+		return std::string(name.data(), static_cast<std::size_t>(length));
+	}
+}
+
+ShaderReflection::UniformId ShaderReflection::GetUniformId(std::string const& name)
+{
+	auto& registry = getUniformRegistry();
+	auto const id = registry.ids.emplace(name, registry.names.size());
+	if (id.second)
+		registry.names.push_back(name);
+	return id.first->second;
+}
+
+GLuint ShaderReflection::GetBlockBinding(GLenum const interface, std::string const& name)
+{
+	static std::map<GLenum, std::map<std::string, GLuint>> bindings_per_interface;
+	auto& bindings = bindings_per_interface[interface];
+	return bindings.emplace(name, static_cast<GLuint>(bindings.size())).first->second;
+}
+
+void ShaderReflection::Reflect(GLuint const program_)
+{
+	program = program_;
+	uniforms.clear();
+	buffer_variables.clear();
+	blocks.clear();
+	slots.clear();
+	texture_units_nb = 0u;
+	if (program == 0u)
+		return;
+
+	if (GLAD_GL_VERSION_4_3)
+		QueryInterfaces();
+	else
+		QueryLegacy();
+	Configure();
+}
+
+GLuint ShaderReflection::GetProgram() const
+{
+	return program;
+}
+
+std::vector<ShaderReflection::Variable> const& ShaderReflection::GetUniforms() const
+{
+	return uniforms;
+}
+
+std::vector<ShaderReflection::Variable> const& ShaderReflection::GetBufferVariables() const
+{
+	return buffer_variables;
+}
+
+std::vector<ShaderReflection::Block> const& ShaderReflection::GetBlocks() const
+{
+	return blocks;
+}
+
+bool ShaderReflection::HasUniform(UniformId const id) const
+{
+	return id < slots.size() && slots[id].location >= 0;
+}
+
+GLint ShaderReflection::GetTextureUnit(UniformId const id) const
+{
+	return id < slots.size() ? slots[id].texture_unit : -1;
+}
+
+GLuint ShaderReflection::GetTextureUnitsCount() const
+{
+	return texture_units_nb;
+}
+
+void ShaderReflection::BindTexture(UniformId const id, GLenum const target, GLuint const texture, GLuint const sampler) const
+{
+	auto const unit = GetTextureUnit(id);
+	if (unit < 0)
+		return;
+
+	auto& state = GLStateCache::Get();
+	state.BindTexture(static_cast<GLuint>(unit), target, texture);
+	state.BindSampler(static_cast<GLuint>(unit), sampler);
+}
+
+void ShaderReflection::UnbindSamplers() const
+{
+	auto& state = GLStateCache::Get();
+	for (GLuint unit = 0u; unit < texture_units_nb; ++unit)
+		state.BindSampler(unit, 0u);
+}
+
+void ShaderReflection::Set(UniformId const id, bool const value) const
+{
+	auto const location = GetLocation(id, GL_BOOL);
+	if (location >= 0)
+		glProgramUniform1i(program, location, value ? 1 : 0);
+}
+
+void ShaderReflection::Set(UniformId const id, GLint const value) const
+{
+	auto const location = GetLocation(id, GL_INT);
+	if (location >= 0)
+		glProgramUniform1i(program, location, value);
+}
+
+void ShaderReflection::Set(UniformId const id, GLuint const value) const
+{
+	auto const location = GetLocation(id, GL_UNSIGNED_INT);
+	if (location >= 0)
+		glProgramUniform1ui(program, location, value);
+}
+
+void ShaderReflection::Set(UniformId const id, float const value) const
+{
+	auto const location = GetLocation(id, GL_FLOAT);
+	if (location >= 0)
+		glProgramUniform1f(program, location, value);
+}
+
+void ShaderReflection::Set(UniformId const id, glm::vec2 const& value) const
+{
+	auto const location = GetLocation(id, GL_FLOAT_VEC2);
+	if (location >= 0)
+		glProgramUniform2fv(program, location, 1, glm::value_ptr(value));
+}
+
+void ShaderReflection::Set(UniformId const id, glm::vec3 const& value) const
+{
+	auto const location = GetLocation(id, GL_FLOAT_VEC3);
+	if (location >= 0)
+		glProgramUniform3fv(program, location, 1, glm::value_ptr(value));
+}
+
+void ShaderReflection::Set(UniformId const id, glm::vec4 const& value) const
+{
+	auto const location = GetLocation(id, GL_FLOAT_VEC4);
+	if (location >= 0)
+		glProgramUniform4fv(program, location, 1, glm::value_ptr(value));
+}
+
+void ShaderReflection::Set(UniformId const id, glm::ivec2 const& value) const
+{
+	auto const location = GetLocation(id, GL_INT_VEC2);
+	if (location >= 0)
+		glProgramUniform2iv(program, location, 1, glm::value_ptr(value));
+}
+
+void ShaderReflection::Set(UniformId const id, glm::mat3 const& value) const
+{
+	auto const location = GetLocation(id, GL_FLOAT_MAT3);
+	if (location >= 0)
+		glProgramUniformMatrix3fv(program, location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void ShaderReflection::Set(UniformId const id, glm::mat4 const& value) const
+{
+	auto const location = GetLocation(id, GL_FLOAT_MAT4);
+	if (location >= 0)
+		glProgramUniformMatrix4fv(program, location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void ShaderReflection::QueryInterfaces()
+{
+	auto const get_resources_nb = [this](GLenum interface, GLint& max_name_length){
+		GLint resources_nb = 0;
+		glGetProgramInterfaceiv(program, interface, GL_ACTIVE_RESOURCES, &resources_nb);
+		glGetProgramInterfaceiv(program, interface, GL_MAX_NAME_LENGTH, &max_name_length);
+		return static_cast<GLuint>(std::max(resources_nb, 0));
+	};
+
+	// Uniform blocks come first, for their indices to match the ones the
+	// driver reports for uniforms.
+	GLuint uniform_blocks_nb = 0u;
+	for (auto const interface : { GL_UNIFORM_BLOCK, GL_SHADER_STORAGE_BLOCK }) {
+		GLint max_name_length = 0;
+		auto const resources_nb = get_resources_nb(interface, max_name_length);
+		for (GLuint i = 0u; i < resources_nb; ++i) {
+			GLenum const property = GL_BUFFER_DATA_SIZE;
+			Block block;
+			block.name = getResourceName(program, interface, i, max_name_length);
+			block.interface = interface;
+			block.index = i;
+			glGetProgramResourceiv(program, interface, i, 1, &property, 1, nullptr, &block.data_size);
+			blocks.push_back(std::move(block));
+		}
+		if (interface == GL_UNIFORM_BLOCK)
+			uniform_blocks_nb = resources_nb;
+	}
+
+	GLint max_name_length = 0;
+	auto resources_nb = get_resources_nb(GL_UNIFORM, max_name_length);
+	for (GLuint i = 0u; i < resources_nb; ++i) {
+		GLenum const properties[] = { GL_TYPE, GL_ARRAY_SIZE, GL_LOCATION, GL_BLOCK_INDEX, GL_OFFSET };
+		GLint values[5] = { 0 };
+		glGetProgramResourceiv(program, GL_UNIFORM, i, 5, properties, 5, nullptr, values);
+
+		Variable uniform;
+		uniform.name = stripArraySuffix(getResourceName(program, GL_UNIFORM, i, max_name_length));
+		uniform.type = static_cast<GLenum>(values[0]);
+		uniform.array_size = values[1];
+		uniform.location = values[2];
+		uniform.block_index = values[3];
+		uniform.offset = values[4];
+		uniforms.push_back(std::move(uniform));
+	}
+
+	resources_nb = get_resources_nb(GL_BUFFER_VARIABLE, max_name_length);
+	for (GLuint i = 0u; i < resources_nb; ++i) {
+		GLenum const properties[] = { GL_TYPE, GL_ARRAY_SIZE, GL_BLOCK_INDEX, GL_OFFSET };
+		GLint values[4] = { 0 };
+		glGetProgramResourceiv(program, GL_BUFFER_VARIABLE, i, 4, properties, 4, nullptr, values);
+
+		Variable variable;
+		variable.name = stripArraySuffix(getResourceName(program, GL_BUFFER_VARIABLE, i, max_name_length));
+		variable.type = static_cast<GLenum>(values[0]);
+		variable.array_size = values[1];
+		variable.block_index = values[2] >= 0 ? values[2] + static_cast<GLint>(uniform_blocks_nb) : -1;
+		variable.offset = values[3];
+		buffer_variables.push_back(std::move(variable));
+	}
+}
+
+void ShaderReflection::QueryLegacy()
+{
+	GLint blocks_nb = 0;
+	GLint max_name_length = 0;
+	glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &blocks_nb);
+	glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &max_name_length);
+	std::vector<GLchar> name(static_cast<std::size_t>(std::max(max_name_length, 1)), '\0');
+	for (GLuint i = 0u; i < static_cast<GLuint>(std::max(blocks_nb, 0)); ++i) {
+		GLsizei length = 0;
+		glGetActiveUniformBlockName(program, i, static_cast<GLsizei>(name.size()), &length, name.data());
+
+		Block block;
+		block.name.assign(name.data(), static_cast<std::size_t>(length));
+		block.interface = GL_UNIFORM_BLOCK;
+		block.index = i;
+		glGetActiveUniformBlockiv(program, i, GL_UNIFORM_BLOCK_DATA_SIZE, &block.data_size);
+		blocks.push_back(std::move(block));
+	}
+
+	GLint uniforms_nb = 0;
+	glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniforms_nb);
+	glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_name_length);
+	if (uniforms_nb <= 0)
+		return;
+
+	std::vector<GLuint> indices(static_cast<std::size_t>(uniforms_nb));
+	std::iota(indices.begin(), indices.end(), 0u);
+	std::vector<GLint> types(indices.size()), sizes(indices.size()), block_indices(indices.size()), offsets(indices.size());
+	glGetActiveUniformsiv(program, uniforms_nb, indices.data(), GL_UNIFORM_TYPE, types.data());
+	glGetActiveUniformsiv(program, uniforms_nb, indices.data(), GL_UNIFORM_SIZE, sizes.data());
+	glGetActiveUniformsiv(program, uniforms_nb, indices.data(), GL_UNIFORM_BLOCK_INDEX, block_indices.data());
+	glGetActiveUniformsiv(program, uniforms_nb, indices.data(), GL_UNIFORM_OFFSET, offsets.data());
+
+	name.assign(static_cast<std::size_t>(std::max(max_name_length, 1)), '\0');
+	for (std::size_t i = 0; i < indices.size(); ++i) {
+		GLsizei length = 0;
+		glGetActiveUniformName(program, indices[i], static_cast<GLsizei>(name.size()), &length, name.data());
+		std::string const full_name(name.data(), static_cast<std::size_t>(length));
+
+		Variable uniform;
+		uniform.name = stripArraySuffix(full_name);
+		uniform.type = static_cast<GLenum>(types[i]);
+		uniform.array_size = sizes[i];
+		uniform.location = block_indices[i] < 0 ? glGetUniformLocation(program, full_name.c_str()) : -1;
+		uniform.block_index = block_indices[i];
+		uniform.offset = offsets[i];
+		uniforms.push_back(std::move(uniform));
+	}
+}
+
+void ShaderReflection::Configure()
+{
+	for (auto& block : blocks) {
+		block.binding = GetBlockBinding(block.interface, block.name);
+		if (block.interface == GL_UNIFORM_BLOCK)
+			glUniformBlockBinding(program, block.index, block.binding);
+		else
+			glShaderStorageBlockBinding(program, block.index, block.binding);
+	}
+
+	for (auto& uniform : uniforms) {
+		if (uniform.location < 0)
+			continue;
+
+		if (isSampler(uniform.type)) {
+			std::vector<GLint> units(static_cast<std::size_t>(uniform.array_size));
+			std::iota(units.begin(), units.end(), static_cast<GLint>(texture_units_nb));
+			glProgramUniform1iv(program, uniform.location, uniform.array_size, units.data());
+			uniform.texture_unit = static_cast<GLint>(texture_units_nb);
+			texture_units_nb += static_cast<GLuint>(uniform.array_size);
+		}
+
+		// Every name of the program gets registered here, so identifiers
+		// past the end of `slots` are for uniforms it does not have.
+		auto const id = GetUniformId(uniform.name);
+		if (id >= slots.size())
+			slots.resize(id + 1u);
+		slots[id].location = uniform.location;
+		slots[id].type = uniform.type;
+		slots[id].texture_unit = uniform.texture_unit;
+	}
+}
+
+GLint ShaderReflection::GetLocation(UniformId const id, GLenum const type) const
+{
+	if (id >= slots.size() || slots[id].location < 0)
+		return -1;
+
+	auto const& slot = slots[id];
+	if (!isCompatible(slot.type, type)) {
+		if (!slot.was_mismatch_reported) {
+			LogWarning("Uniform \"%s\" of program %u is of type 0x%04x, but was set as 0x%04x.",
+			           getUniformRegistry().names[id].c_str(), program, slot.type, type);
+			slot.was_mismatch_reported = true;
+		}
+		return -1;
+	}
+	return slot.location;
+}
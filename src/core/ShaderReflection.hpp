@@ -0,0 +1,116 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+//! \brief Active uniforms, samplers, uniform blocks and shader storage
+//! blocks of a linked program, as reported by the driver.
+//!
+//! Reflecting a program also configures it: samplers get consecutive
+//! texture units starting from 0, in the order the driver lists them, and
+//! each block gets the binding point associated to its name, which is the
+//! same across all programs. Binding qualifiers written in the shaders are
+//! overridden as a result.
+//!
+//! Uniforms are set through identifiers shared by all programs, obtained
+//! once per name from `GetUniformId()`; each reflection keeps a table
+//! indexed by those identifiers, making setting a uniform a constant-time
+//! operation. Setting a uniform the program does not use is a no-op, and
+//! setting it with a mismatching type gets reported once per uniform.
+//!
+//! The program interface query API of OpenGL 4.3 is used when available;
+//! older contexts fall back to the OpenGL 3.1 queries, which do not expose
+//! shader storage blocks.
+class ShaderReflection
+{
+public:
+	using UniformId = std::size_t;
+
+	//! \brief A uniform, or a variable of a shader storage block.
+	struct Variable {
+		std::string name; // Without the "[0]" suffix of arrays
+		GLenum type = GL_NONE;
+		GLint array_size = 1;
+		GLint location = -1;     // -1 for members of blocks
+		GLint block_index = -1;  // Into `GetBlocks()`, -1 if not in a block
+		GLint offset = -1;       // In bytes from the start of its block
+		GLint texture_unit = -1; // First unit, for samplers
+	};
+
+	struct Block {
+		std::string name;
+		GLenum interface = GL_NONE; // GL_UNIFORM_BLOCK or GL_SHADER_STORAGE_BLOCK
+		GLuint index = 0u;          // Within its interface
+		GLuint binding = 0u;
+		GLint data_size = 0;        // In bytes
+	};
+
+	//! \brief Identifier of the uniform called `name` in any program; the
+	//! same name always gives the same identifier.
+	static UniformId GetUniformId(std::string const& name);
+
+	//! \brief Binding point of all blocks of `interface` called `name`,
+	//! assigned the first time the name is encountered.
+	static GLuint GetBlockBinding(GLenum interface, std::string const& name);
+
+	//! \brief Query and configure `program`, replacing what was previously
+	//! reflected; reflecting program 0 clears everything.
+	void Reflect(GLuint program);
+
+	GLuint GetProgram() const;
+	std::vector<Variable> const& GetUniforms() const;
+	std::vector<Variable> const& GetBufferVariables() const;
+	std::vector<Block> const& GetBlocks() const;
+
+	bool HasUniform(UniformId id) const;
+
+	//! \return the texture unit of sampler `id`, or -1 if the program has
+	//!         no such sampler
+	GLint GetTextureUnit(UniformId id) const;
+
+	//! \brief Units 0 to the returned value excluded are used by samplers.
+	GLuint GetTextureUnitsCount() const;
+
+	//! \brief Bind `texture`, and `sampler`, to the unit of sampler `id`,
+	//! through the GLStateCache; nothing is bound if there is no such
+	//! sampler.
+	void BindTexture(UniformId id, GLenum target, GLuint texture, GLuint sampler = 0u) const;
+
+	//! \brief Unbind the sampler objects of all units used by the program.
+	void UnbindSamplers() const;
+
+	void Set(UniformId id, bool value) const;
+	void Set(UniformId id, GLint value) const;
+	void Set(UniformId id, GLuint value) const;
+	void Set(UniformId id, float value) const;
+	void Set(UniformId id, glm::vec2 const& value) const;
+	void Set(UniformId id, glm::vec3 const& value) const;
+	void Set(UniformId id, glm::vec4 const& value) const;
+	void Set(UniformId id, glm::ivec2 const& value) const;
+	void Set(UniformId id, glm::mat3 const& value) const;
+	void Set(UniformId id, glm::mat4 const& value) const;
+
+private:
+	struct Slot {
+		GLint location = -1;
+		GLenum type = GL_NONE;
+		GLint texture_unit = -1;
+		mutable bool was_mismatch_reported = false;
+	};
+
+	void QueryInterfaces();
+	void QueryLegacy();
+	void Configure();
+	GLint GetLocation(UniformId id, GLenum type) const;
+
+	GLuint program = 0u;
+	std::vector<Variable> uniforms;
+	std::vector<Variable> buffer_variables;
+	std::vector<Block> blocks;
+	std::vector<Slot> slots; // Per uniform identifier
+	GLuint texture_units_nb = 0u;
+};
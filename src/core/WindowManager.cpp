@@ -1,12 +1,23 @@
 #include "WindowManager.hpp"
 
+#include "config.hpp"
 #include "Log.h"
 #include "opengl.hpp"
+#include "Profiler.h"
 
 #include <glad/glad.h>
 #include <imgui.h>
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
+#if LUGGCGL_ENABLE_HEADLESS
+#	define EGL_NO_X11
+#	include <EGL/egl.h>
+#	include <EGL/eglext.h>
+#endif
+
+#include <cerrno>
+#include <cstdlib>
+#include <limits>
 
 namespace
 {
@@ -63,8 +74,148 @@ namespace
 		WindowManager::WindowDatum* const instance = static_cast<WindowManager::WindowDatum*>(glfwGetWindowUserPointer(window));
 		instance->camera.SetAspect(static_cast<float>(width) / static_cast<float>(height));
 	}
+
+	unsigned int GetEnvironmentValue(char const* name)
+	{
+		char const* const value = std::getenv(name);
+		if (value == nullptr || *value == '\0')
+			return 0u;
+
+		// Parsed as signed, as strtoul() silently wraps negative values
+		// around; the result ends up in ints, hence the upper bound.
+		errno = 0;
+		char* end = nullptr;
+		auto const parsed_value = std::strtol(value, &end, 10);
+		if (end == value || *end != '\0' || errno == ERANGE
+		    || parsed_value <= 0l || parsed_value > std::numeric_limits<int>::max()) {
+			LogWarning("Ignoring %s, as \"%s\" is not a positive integer.", name, value);
+			return 0u;
+		}
+		return static_cast<unsigned int>(parsed_value);
+	}
 } // anonymous namespace
 
+//! \brief OpenGL context created through EGL, rendering to an offscreen
+//!        pbuffer surface rather than to a window.
+struct WindowManager::HeadlessContext
+{
+#if LUGGCGL_ENABLE_HEADLESS
+	EGLDisplay display = EGL_NO_DISPLAY;
+	EGLSurface surface = EGL_NO_SURFACE;
+	EGLContext context = EGL_NO_CONTEXT;
+#endif
+
+	bool Create(int width, int height, unsigned int msaa);
+	void Destroy();
+	void Swap();
+};
+
+bool WindowManager::HeadlessContext::Create(int width, int height, unsigned int msaa)
+{
+#if LUGGCGL_ENABLE_HEADLESS
+	// Prefer Mesa’s surfaceless platform, which needs neither a display
+	// server nor a GPU, falling back to whatever the default one is.
+	auto const get_platform_display = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+	if (get_platform_display != nullptr)
+		display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+	if (display == EGL_NO_DISPLAY)
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	EGLint egl_major_version = 0, egl_minor_version = 0;
+	if (display == EGL_NO_DISPLAY || eglInitialize(display, &egl_major_version, &egl_minor_version) != EGL_TRUE) {
+		LogError("[EGL]: Failed to initialise a display (error 0x%04X).", eglGetError());
+		display = EGL_NO_DISPLAY;
+		return false;
+	}
+
+	EGLint const config_attributes[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_ALPHA_SIZE, 8,
+		EGL_DEPTH_SIZE, 24,
+		EGL_STENCIL_SIZE, 8,
+		EGL_SAMPLE_BUFFERS, msaa > 1u ? 1 : 0,
+		EGL_SAMPLES, msaa > 1u ? static_cast<EGLint>(msaa) : 0,
+		EGL_NONE
+	};
+	EGLConfig config = nullptr;
+	EGLint configs_nb = 0;
+	if (eglChooseConfig(display, config_attributes, &config, 1, &configs_nb) != EGL_TRUE || configs_nb == 0) {
+		LogError("[EGL]: No framebuffer configuration supports offscreen OpenGL rendering.");
+		Destroy();
+		return false;
+	}
+
+	EGLint const surface_attributes[] = {
+		EGL_WIDTH, width,
+		EGL_HEIGHT, height,
+		EGL_NONE
+	};
+	surface = eglCreatePbufferSurface(display, config, surface_attributes);
+	if (surface == EGL_NO_SURFACE) {
+		LogError("[EGL]: Failed to create a %dx%d offscreen surface (error 0x%04X).", width, height, eglGetError());
+		Destroy();
+		return false;
+	}
+
+	EGLint const context_attributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, default_opengl_major_version,
+		EGL_CONTEXT_MINOR_VERSION, default_opengl_minor_version,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+#if DEBUG_LEVEL >= 2
+		EGL_CONTEXT_OPENGL_DEBUG, EGL_TRUE,
+#endif
+		EGL_NONE
+	};
+	if (eglBindAPI(EGL_OPENGL_API) == EGL_TRUE)
+		context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attributes);
+	if (context == EGL_NO_CONTEXT || eglMakeCurrent(display, surface, surface, context) != EGL_TRUE) {
+		LogError("Couldn't create an OpenGL %d.%d context through EGL (error 0x%04X).", default_opengl_major_version, default_opengl_minor_version, eglGetError());
+		Destroy();
+		return false;
+	}
+
+	LogInfo("Rendering headlessly to a %dx%d surface, through EGL %d.%d.", width, height, egl_major_version, egl_minor_version);
+	return true;
+#else
+	static_cast<void>(width);
+	static_cast<void>(height);
+	static_cast<void>(msaa);
+	return false;
+#endif
+}
+
+void WindowManager::HeadlessContext::Destroy()
+{
+#if LUGGCGL_ENABLE_HEADLESS
+	if (display == EGL_NO_DISPLAY)
+		return;
+
+	eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (context != EGL_NO_CONTEXT)
+		eglDestroyContext(display, context);
+	if (surface != EGL_NO_SURFACE)
+		eglDestroySurface(display, surface);
+	eglTerminate(display);
+
+	display = EGL_NO_DISPLAY;
+	surface = EGL_NO_SURFACE;
+	context = EGL_NO_CONTEXT;
+#endif
+}
+
+void WindowManager::HeadlessContext::Swap()
+{
+#if LUGGCGL_ENABLE_HEADLESS
+	// Nothing gets presented from a pbuffer, but it ends the frame all the
+	// same.
+	eglSwapBuffers(display, surface);
+#endif
+}
+
 std::mutex WindowManager::mMutex;
 
 WindowManager::WindowManager()
@@ -75,6 +226,21 @@ WindowManager::WindowManager()
 
 	glfwSetErrorCallback(ErrorCallback);
 
+	mHeadlessFramesNb = GetEnvironmentValue("LUGGCGL_HEADLESS_FRAMES");
+	if (mHeadlessFramesNb > 0u) {
+#if LUGGCGL_ENABLE_HEADLESS
+		mHeadlessWidth = static_cast<int>(GetEnvironmentValue("LUGGCGL_HEADLESS_WIDTH"));
+		mHeadlessHeight = static_cast<int>(GetEnvironmentValue("LUGGCGL_HEADLESS_HEIGHT"));
+
+		// Windows of the null platform are never displayed, and it does
+		// not need a display server to be running.
+		glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#else
+		WindowManager::mMutex.unlock();
+		throw std::runtime_error("[WindowManager] Headless mode was requested, but the framework was configured without LUGGCGL_ENABLE_HEADLESS.");
+#endif
+	}
+
 	int const init_res = glfwInit();
 	if (init_res == GLFW_FALSE) {
 		WindowManager::mMutex.unlock();
@@ -84,51 +250,21 @@ WindowManager::WindowManager()
 
 WindowManager::~WindowManager()
 {
+	if (mHeadlessContext != nullptr)
+		mHeadlessContext->Destroy();
+
 	glfwTerminate();
 	WindowManager::mMutex.unlock();
 }
 
 GLFWwindow* WindowManager::CreateGLFWWindow(std::string const& title, WindowDatum const& data, unsigned int msaa, bool fullscreen, bool resizable, SwapStrategy swap)
 {
-#ifdef __APPLE__
-	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-#endif
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-#if DEBUG_LEVEL >= 2
-	glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
-#endif
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, default_opengl_major_version);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, default_opengl_minor_version);
-
-	glfwWindowHint(GLFW_RESIZABLE, resizable ? GLFW_TRUE : GLFW_FALSE);
-	glfwWindowHint(GLFW_SAMPLES, static_cast<int>(msaa));
-
-	GLFWmonitor* const monitor = glfwGetPrimaryMonitor();
-	GLFWvidmode const* const video_mode = glfwGetVideoMode(monitor);
-	int width  = fullscreen ? data.fullscreen_width  : data.windowed_width;
-	int height = fullscreen ? data.fullscreen_height : data.windowed_height;
-	if (width == 0)
-		width = video_mode->width;
-	if (height == 0)
-		height = video_mode->height;
-
-	glfwWindowHint(GLFW_RED_BITS, video_mode->redBits);
-	glfwWindowHint(GLFW_GREEN_BITS, video_mode->greenBits);
-	glfwWindowHint(GLFW_BLUE_BITS, video_mode->blueBits);
-	glfwWindowHint(GLFW_REFRESH_RATE, video_mode->refreshRate);
-
-	GLFWwindow* window = glfwCreateWindow(width, height, title.c_str(), fullscreen ? monitor : nullptr, nullptr);
-
+	int width = 0, height = 0;
+	GLFWwindow* const window = IsHeadless() ? CreateHeadlessWindow(title, data, msaa, width, height)
+	                                        : CreateVisibleWindow(title, data, msaa, fullscreen, resizable, width, height);
 	if (window == nullptr)
 		return nullptr;
 
-	glfwMakeContextCurrent(window);
-
-	if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(glfwGetProcAddress))) {
-		LogError("[GLAD]: Failed to initialise OpenGL context.");
-		return nullptr;
-	}
-
 	// Setup Dear ImGui context
 	IMGUI_CHECKVERSION();
 	ImGui::CreateContext();
@@ -195,7 +331,8 @@ GLFWwindow* WindowManager::CreateGLFWWindow(std::string const& title, WindowDatu
 		LogInfo("DebugCallback is not core in OpenGL %d.%d, and sadly the GL_KHR_DEBUG extension is not available either.", GLVersion.major, GLVersion.minor);
 	}
 
-	glfwSwapInterval(static_cast<std::underlying_type<SwapStrategy>::type>(swap));
+	if (!IsHeadless())
+		glfwSwapInterval(static_cast<std::underlying_type<SwapStrategy>::type>(swap));
 
 	auto& datum_copy = mWindowData[window] = std::make_unique<WindowDatum>(data);
 	datum_copy->fullscreen_width = width;
@@ -205,12 +342,101 @@ GLFWwindow* WindowManager::CreateGLFWWindow(std::string const& title, WindowDatu
 	return window;
 }
 
+GLFWwindow* WindowManager::CreateHeadlessWindow(std::string const& title, WindowDatum const& data, unsigned int msaa, int& width, int& height)
+{
+	if (mHeadlessContext != nullptr) {
+		LogError("Only one window can be created in headless mode.");
+		return nullptr;
+	}
+
+	width = mHeadlessWidth > 0 ? mHeadlessWidth : data.windowed_width > 0 ? data.windowed_width : static_cast<int>(config::resolution_x);
+	height = mHeadlessHeight > 0 ? mHeadlessHeight : data.windowed_height > 0 ? data.windowed_height : static_cast<int>(config::resolution_y);
+
+	// The window is only kept around for its inputs and its closing status;
+	// the OpenGL context is created separately.
+	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+	GLFWwindow* const window = glfwCreateWindow(width, height, title.c_str(), nullptr, nullptr);
+	if (window == nullptr)
+		return nullptr;
+
+	mHeadlessContext = std::make_unique<HeadlessContext>();
+	if (!mHeadlessContext->Create(width, height, msaa)) {
+		mHeadlessContext.reset();
+		glfwDestroyWindow(window);
+		return nullptr;
+	}
+
+#if LUGGCGL_ENABLE_HEADLESS
+	if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(eglGetProcAddress))) {
+		LogError("[GLAD]: Failed to initialise OpenGL context.");
+		return nullptr;
+	}
+#endif
+
+	// The framebuffer size will never change, so the callback would not be
+	// called.
+	data.camera.SetAspect(static_cast<float>(width) / static_cast<float>(height));
+
+	return window;
+}
+
+GLFWwindow* WindowManager::CreateVisibleWindow(std::string const& title, WindowDatum const& data, unsigned int msaa, bool fullscreen, bool resizable, int& width, int& height)
+{
+#ifdef __APPLE__
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#if DEBUG_LEVEL >= 2
+	glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+#endif
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, default_opengl_major_version);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, default_opengl_minor_version);
+
+	glfwWindowHint(GLFW_RESIZABLE, resizable ? GLFW_TRUE : GLFW_FALSE);
+	glfwWindowHint(GLFW_SAMPLES, static_cast<int>(msaa));
+
+	GLFWmonitor* const monitor = glfwGetPrimaryMonitor();
+	GLFWvidmode const* const video_mode = glfwGetVideoMode(monitor);
+	width  = fullscreen ? data.fullscreen_width  : data.windowed_width;
+	height = fullscreen ? data.fullscreen_height : data.windowed_height;
+	if (width == 0)
+		width = video_mode->width;
+	if (height == 0)
+		height = video_mode->height;
+
+	glfwWindowHint(GLFW_RED_BITS, video_mode->redBits);
+	glfwWindowHint(GLFW_GREEN_BITS, video_mode->greenBits);
+	glfwWindowHint(GLFW_BLUE_BITS, video_mode->blueBits);
+	glfwWindowHint(GLFW_REFRESH_RATE, video_mode->refreshRate);
+
+	GLFWwindow* const window = glfwCreateWindow(width, height, title.c_str(), fullscreen ? monitor : nullptr, nullptr);
+
+	if (window == nullptr)
+		return nullptr;
+
+	glfwMakeContextCurrent(window);
+
+	if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(glfwGetProcAddress))) {
+		LogError("[GLAD]: Failed to initialise OpenGL context.");
+		return nullptr;
+	}
+
+	return window;
+}
+
 void WindowManager::DestroyWindow(GLFWwindow* const window)
 {
 	ImGui_ImplOpenGL3_Shutdown();
 	ImGui_ImplGlfw_Shutdown();
 	ImGui::DestroyContext();
 
+	if (mHeadlessContext != nullptr) {
+		mHeadlessContext->Destroy();
+		mHeadlessContext.reset();
+	}
+
 	glfwDestroyWindow(window);
 
 	auto const window_datum_iter = mWindowData.find(window);
@@ -220,6 +446,8 @@ void WindowManager::DestroyWindow(GLFWwindow* const window)
 
 void WindowManager::NewImGuiFrame()
 {
+	PROFILE_FUNCTION();
+
 	ImGui_ImplOpenGL3_NewFrame();
 	ImGui_ImplGlfw_NewFrame();
 	ImGui::NewFrame();
@@ -227,6 +455,8 @@ void WindowManager::NewImGuiFrame()
 
 void WindowManager::RenderImGuiFrame(bool show_gui)
 {
+	PROFILE_FUNCTION();
+
 	ImGui::Render();
 	if (show_gui)
 		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
@@ -234,7 +464,7 @@ void WindowManager::RenderImGuiFrame(bool show_gui)
 
 void WindowManager::ToggleFullscreenStatusForWindow(GLFWwindow* const window) noexcept
 {
-	if (window == nullptr)
+	if (window == nullptr || IsHeadless())
 		return;
 
 	WindowDatum* const datum = reinterpret_cast<WindowDatum*>(glfwGetWindowUserPointer(window));
@@ -253,3 +483,25 @@ void WindowManager::ToggleFullscreenStatusForWindow(GLFWwindow* const window) no
 		glfwSetWindowMonitor(window, nullptr, datum->xpos, datum->ypos, datum->windowed_width, datum->windowed_height, 0);
 	}
 }
+
+void WindowManager::SwapBuffers(GLFWwindow* const window)
+{
+	PROFILE_FUNCTION();
+
+	if (!IsHeadless()) {
+		glfwSwapBuffers(window);
+		return;
+	}
+
+	if (mHeadlessContext != nullptr)
+		mHeadlessContext->Swap();
+	if (++mPresentedFramesNb == mHeadlessFramesNb) {
+		LogInfo("All %u headless frames were presented; closing the window.", mHeadlessFramesNb);
+		glfwSetWindowShouldClose(window, GLFW_TRUE);
+	}
+}
+
+bool WindowManager::IsHeadless() const noexcept
+{
+	return mHeadlessFramesNb > 0u;
+}
@@ -18,6 +18,15 @@
 //! All windows, which were not manually destroyed using the
 //! WindowManager::DestroyWindow method, will be automatically destroyed along
 //! with the WindowManager object when it gets deleted.
+//!
+//! When the `LUGGCGL_HEADLESS_FRAMES` environment variable is set to a
+//! positive number of frames, and the framework was configured with
+//! `LUGGCGL_ENABLE_HEADLESS`, no window gets displayed: the OpenGL context is
+//! created through EGL on an offscreen surface, whose resolution defaults to
+//! the windowed one of the window and can be overridden with
+//! `LUGGCGL_HEADLESS_WIDTH` and `LUGGCGL_HEADLESS_HEIGHT`, and the window is
+//! flagged for closing once that many frames were presented with
+//! `SwapBuffers()`.
 class WindowManager
 {
 public:
@@ -43,8 +52,25 @@ public:
 	void RenderImGuiFrame(bool show_gui);
 	void ToggleFullscreenStatusForWindow(GLFWwindow* const window) noexcept;
 
+	//! \brief Present the frame rendered to `window`; to be called instead
+	//!        of `glfwSwapBuffers()`, as it also counts the frames run in
+	//!        headless mode.
+	void SwapBuffers(GLFWwindow* const window);
+
+	bool IsHeadless() const noexcept;
+
 private:
+	struct HeadlessContext;
+
+	GLFWwindow* CreateHeadlessWindow(std::string const& title, WindowDatum const& data, unsigned int msaa, int& width, int& height);
+	GLFWwindow* CreateVisibleWindow(std::string const& title, WindowDatum const& data, unsigned int msaa, bool fullscreen, bool resizable, int& width, int& height);
+
 	std::unordered_map<GLFWwindow*, std::unique_ptr<WindowDatum>> mWindowData;
 
+	unsigned int mHeadlessFramesNb = 0u;
+	int mHeadlessWidth = 0, mHeadlessHeight = 0;
+	unsigned int mPresentedFramesNb = 0u;
+	std::unique_ptr<HeadlessContext> mHeadlessContext;
+
 	static std::mutex mMutex;
 };
@@ -1,8 +1,11 @@
 #include "helpers.hpp"
 #include "config.hpp"
 
+#include "core/GLStateCache.hpp"
+#include "core/GPUMemoryRegistry.hpp"
 #include "core/Log.h"
 #include "core/opengl.hpp"
+#include "core/Profiler.h"
 #include "core/various.hpp"
 
 #include <assimp/Importer.hpp>
@@ -12,10 +15,14 @@
 #include <imgui.h>
 #include <stb_image.h>
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <cassert>
 #include <cstdint>
+#include <map>
 #include <memory>
+#include <thread>
 
 namespace {
     struct {
@@ -52,6 +59,9 @@ namespace local {
 }
 
 void bonobo::init() {
+    GPUMemoryRegistry::Get().Install();
+    GPUMemoryRegistry::Scope const memory_scope("bonobo::init");
+
     setupBasisData();
     createDebugTexture();
 
@@ -73,6 +83,9 @@ void bonobo::deinit() {
 
     glDeleteProgram(local::fullscreen_shader);
     glDeleteVertexArrays(1, &local::display_vao);
+
+    GPUMemoryRegistry::Get().ReportLeaks();
+    GPUMemoryRegistry::Get().Uninstall();
 }
 
 static std::vector<std::uint8_t>
@@ -96,38 +109,132 @@ getTextureData(std::string const &filename, std::uint32_t &width, std::uint32_t
     return image;
 }
 
-std::vector<bonobo::mesh_data>
-bonobo::loadObjects(std::string const &filename) {
-    auto const scene_start_time = std::chrono::high_resolution_clock::now();
+static GLuint
+createTexture2D(std::vector<std::uint8_t> const &data, std::uint32_t width, std::uint32_t height, bool generate_mipmap) {
+    GLuint texture = bonobo::createTexture(width, height, GL_TEXTURE_2D, GL_RGBA, GL_RGBA, GL_UNSIGNED_BYTE, reinterpret_cast<GLvoid const *>(data.data()));
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, generate_mipmap ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    if (generate_mipmap)
+        glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0u);
+    GLStateCache::Get().Invalidate();
 
-    std::vector<bonobo::mesh_data> objects;
+    return texture;
+}
+
+namespace {
+    std::array<aiTextureType, 4> const material_texture_types{
+        aiTextureType_DIFFUSE,
+        aiTextureType_SPECULAR,
+        aiTextureType_NORMALS,
+        aiTextureType_OPACITY};
+
+    struct decoded_image {
+        std::vector<std::uint8_t> data;
+        std::uint32_t width{0u};
+        std::uint32_t height{0u};
+    };
+}
+
+struct bonobo::scene_import {
+    std::string filename;
+    std::string parent_folder;
+    Assimp::Importer importer; // Owns `assimp_scene`
+    aiScene const *assimp_scene{nullptr};
+    std::vector<bool> are_materials_used;
+    std::map<std::string, decoded_image> images; // Per path, relative to `parent_folder`
+    std::chrono::high_resolution_clock::time_point start_time;
+    float decoding_duration{0.0f}; // In seconds
+};
+
+std::shared_ptr<bonobo::scene_import>
+bonobo::importObjects(std::string const &filename) {
+    PROFILE_FUNCTION();
+
+    auto scene = std::make_shared<scene_import>();
+    scene->filename = filename;
+    scene->start_time = std::chrono::high_resolution_clock::now();
 
     auto const end_of_basedir = filename.rfind("/");
-    auto const parent_folder = (end_of_basedir != std::string::npos ? filename.substr(0, end_of_basedir) : ".") + "/";
-    Assimp::Importer importer;
-    auto const assimp_scene = importer.ReadFile(filename, aiProcess_Triangulate | aiProcess_SortByPType | aiProcess_CalcTangentSpace);
+    scene->parent_folder = (end_of_basedir != std::string::npos ? filename.substr(0, end_of_basedir) : ".") + "/";
+    auto const assimp_scene = scene->importer.ReadFile(filename, aiProcess_Triangulate | aiProcess_SortByPType | aiProcess_CalcTangentSpace);
     if (assimp_scene == nullptr || assimp_scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || assimp_scene->mRootNode == nullptr) {
-        LogError("Assimp failed to load \"%s\": %s", filename.c_str(), importer.GetErrorString());
-        return objects;
+        LogError("Assimp failed to load \"%s\": %s", filename.c_str(), scene->importer.GetErrorString());
+        return nullptr;
     }
 
     if (assimp_scene->mNumMeshes == 0u) {
         LogError("No mesh available; loading \"%s\" must have had issues", filename.c_str());
-        return objects;
+        return nullptr;
     }
+    scene->assimp_scene = assimp_scene;
 
-    LogInfo("┭ Loading \"%s\"…", filename.c_str());
-
-    std::vector<bool> are_materials_used(assimp_scene->mNumMaterials, false);
+    scene->are_materials_used.resize(assimp_scene->mNumMaterials, false);
     for (size_t j = 0; j < assimp_scene->mNumMeshes; ++j) {
         auto const assimp_object_mesh = assimp_scene->mMeshes[j];
         auto const material_id = assimp_object_mesh->mMaterialIndex;
         if (material_id >= assimp_scene->mNumMaterials)
             LogError("Mesh \"%s\" has a material index of %u, but only %u materials are present.", assimp_object_mesh->mName.C_Str(), material_id, assimp_scene->mNumMaterials);
         else
-            are_materials_used[material_id] = true;
+            scene->are_materials_used[material_id] = true;
+    }
+
+    // Images shared by several materials only get decoded once.
+    std::vector<std::pair<std::string const, decoded_image> *> images;
+    for (size_t i = 0; i < assimp_scene->mNumMaterials; ++i) {
+        if (!scene->are_materials_used[i])
+            continue;
+        for (auto const type : material_texture_types) {
+            aiString path;
+            if (assimp_scene->mMaterials[i]->GetTexture(type, 0, &path) != aiReturn_SUCCESS)
+                continue;
+            auto const image = scene->images.emplace(std::string(path.C_Str()), decoded_image());
+            if (image.second)
+                images.push_back(&*image.first);
+        }
     }
 
+    // Decoding dominates the loading time, and stb_image can be used from
+    // several threads at once; workers only write to the image they picked.
+    auto const decoding_start_time = std::chrono::high_resolution_clock::now();
+    std::atomic<std::size_t> next_image{0u};
+    auto const decode_images = [&images, &next_image, &scene]() {
+        for (auto i = next_image++; i < images.size(); i = next_image++) {
+            PROFILE_ZONE("Decode image");
+            auto &image = images[i]->second;
+            image.data = getTextureData(scene->parent_folder + images[i]->first, image.width, image.height, true);
+        }
+    };
+    auto const workers_nb = std::min<std::size_t>(std::max(std::thread::hardware_concurrency(), 1u), images.size());
+    std::vector<std::thread> workers;
+    for (std::size_t i = 1; i < workers_nb; ++i)
+        workers.emplace_back([&decode_images]() {
+            PROFILE_THREAD_NAME("Image decoding");
+            decode_images();
+        });
+    decode_images();
+    for (auto &worker : workers)
+        worker.join();
+    scene->decoding_duration = std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - decoding_start_time).count();
+
+    return scene;
+}
+
+std::vector<bonobo::mesh_data>
+bonobo::uploadObjects(scene_import const &scene) {
+    PROFILE_FUNCTION();
+
+    std::vector<bonobo::mesh_data> objects;
+
+    auto const &filename = scene.filename;
+    auto const &parent_folder = scene.parent_folder;
+    auto const assimp_scene = scene.assimp_scene;
+    auto const &are_materials_used = scene.are_materials_used;
+
+    LogInfo("┭ Loading \"%s\"…", filename.c_str());
+    GPUMemoryRegistry::Scope const memory_scope("bonobo::loadObjects(\"" + filename + "\")");
+
     auto const materials_start_time = std::chrono::high_resolution_clock::now();
     std::vector<texture_bindings> materials_bindings(assimp_scene->mNumMaterials);
     std::vector<material_data> material_constants(assimp_scene->mNumMaterials);
@@ -136,20 +243,28 @@ bonobo::loadObjects(std::string const &filename) {
         if (!are_materials_used[i])
             continue;
 
+        PROFILE_ZONE("Load material");
         auto const material_start_time = std::chrono::high_resolution_clock::now();
         texture_bindings &bindings = materials_bindings[i];
         material_data &constants = material_constants[i];
         auto const material = assimp_scene->mMaterials[i];
 
-        auto const process_texture = [&bindings, &material, i, &parent_folder, &texture_count](aiTextureType type, std::string const &type_as_str, std::string const &name) {
+        auto const process_texture = [&bindings, &material, &scene, &parent_folder, &texture_count](aiTextureType type, std::string const &type_as_str, std::string const &name) {
             if (material->GetTextureCount(type)) {
+                PROFILE_ZONE("Load texture");
                 auto const texture_start_time = std::chrono::high_resolution_clock::now();
 
                 if (material->GetTextureCount(type) > 1)
                     LogWarning("Material \"%s\" has more than one %s texture: discarding all but the first one.", material->GetName().C_Str(), type_as_str.c_str());
                 aiString path;
                 material->GetTexture(type, 0, &path);
-                auto const id = bonobo::loadTexture2D(parent_folder + std::string(path.C_Str()));
+                auto const image = scene.images.find(std::string(path.C_Str()));
+                if (image == scene.images.end() || image->second.data.empty()) {
+                    LogWarning("Failed to load the %s texture for material \"%s\".", type_as_str.c_str(), material->GetName().C_Str());
+                    return;
+                }
+                GPUMemoryRegistry::Scope const texture_memory_scope("bonobo::loadTexture2D(\"" + parent_folder + image->first + "\")");
+                auto const id = createTexture2D(image->second.data, image->second.width, image->second.height, true);
                 if (id == 0u) {
                     LogWarning("Failed to load the %s texture for material \"%s\".", type_as_str.c_str(), material->GetName().C_Str());
                     return;
@@ -195,6 +310,7 @@ bonobo::loadObjects(std::string const &filename) {
     auto const meshes_start_time = std::chrono::high_resolution_clock::now();
     objects.reserve(assimp_scene->mNumMeshes);
     for (size_t j = 0; j < assimp_scene->mNumMeshes; ++j) {
+        PROFILE_ZONE("Load mesh");
         auto const mesh_start_time = std::chrono::high_resolution_clock::now();
 
         auto const assimp_object_mesh = assimp_scene->mMeshes[j];
@@ -221,6 +337,8 @@ bonobo::loadObjects(std::string const &filename) {
             object.name = std::string(assimp_object_mesh->mName.C_Str());
         }
 
+        object.vertices_nb = static_cast<GLsizei>(assimp_object_mesh->mNumVertices);
+
         glGenVertexArrays(1, &object.vao);
         assert(object.vao != 0u);
         glBindVertexArray(object.vao);
@@ -247,6 +365,12 @@ bonobo::loadObjects(std::string const &filename) {
         glBufferData(GL_ARRAY_BUFFER, bo_size, nullptr, GL_STATIC_DRAW);
 
         glBufferSubData(GL_ARRAY_BUFFER, vertices_offset, vertices_size, static_cast<GLvoid const *>(assimp_object_mesh->mVertices));
+        object.bounds_min = object.bounds_max = glm::vec3(assimp_object_mesh->mVertices[0u].x, assimp_object_mesh->mVertices[0u].y, assimp_object_mesh->mVertices[0u].z);
+        for (size_t i = 1u; i < assimp_object_mesh->mNumVertices; ++i) {
+            auto const vertex = glm::vec3(assimp_object_mesh->mVertices[i].x, assimp_object_mesh->mVertices[i].y, assimp_object_mesh->mVertices[i].z);
+            object.bounds_min = glm::min(object.bounds_min, vertex);
+            object.bounds_max = glm::max(object.bounds_max, vertex);
+        }
         glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::vertices));
         glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::vertices), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const *>(0x0));
 
@@ -306,6 +430,45 @@ bonobo::loadObjects(std::string const &filename) {
             object.material = material_constants[material_id];
         }
 
+        // Depth-only passes get a VAO of their own, sourcing tightly packed
+        // positions, and texture coordinates only if they are needed for
+        // alpha testing; it shares the index buffer of the main VAO.
+        auto const needs_depth_texcoords = assimp_object_mesh->HasTextureCoords(0u)
+                                        && object.bindings.find("opacity_texture") != object.bindings.end();
+        auto const depth_texcoords_offset = vertices_size;
+        auto const depth_texcoords_size = needs_depth_texcoords ? static_cast<GLsizeiptr>(assimp_object_mesh->mNumVertices * sizeof(glm::vec2)) : 0;
+
+        glGenVertexArrays(1, &object.depth_vao);
+        assert(object.depth_vao != 0u);
+        glBindVertexArray(object.depth_vao);
+
+        glGenBuffers(1, &object.depth_bo);
+        assert(object.depth_bo != 0u);
+        glBindBuffer(GL_ARRAY_BUFFER, object.depth_bo);
+        glBufferData(GL_ARRAY_BUFFER, vertices_size + depth_texcoords_size, nullptr, GL_STATIC_DRAW);
+
+        glBufferSubData(GL_ARRAY_BUFFER, vertices_offset, vertices_size, static_cast<GLvoid const *>(assimp_object_mesh->mVertices));
+        glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::vertices));
+        glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::vertices), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const *>(0x0));
+
+        if (needs_depth_texcoords) {
+            std::vector<glm::vec2> texcoords(assimp_object_mesh->mNumVertices);
+            for (size_t i = 0u; i < assimp_object_mesh->mNumVertices; ++i)
+                texcoords[i] = glm::vec2(assimp_object_mesh->mTextureCoords[0u][i].x, assimp_object_mesh->mTextureCoords[0u][i].y);
+            glBufferSubData(GL_ARRAY_BUFFER, depth_texcoords_offset, depth_texcoords_size, static_cast<GLvoid const *>(texcoords.data()));
+            glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::texcoords));
+            glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::texcoords), 2, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const *>(depth_texcoords_offset));
+        }
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, object.ibo);
+
+        utils::opengl::debug::nameObject(GL_VERTEX_ARRAY, object.depth_vao, object.name + " depth VAO");
+        utils::opengl::debug::nameObject(GL_BUFFER, object.depth_bo, object.name + " depth VBO");
+
+        glBindVertexArray(0u);
+        glBindBuffer(GL_ARRAY_BUFFER, 0u);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0u);
+
         objects.push_back(object);
 
         auto const mesh_end_time = std::chrono::high_resolution_clock::now();
@@ -327,22 +490,39 @@ bonobo::loadObjects(std::string const &filename) {
     auto const meshes_end_time = std::chrono::high_resolution_clock::now();
 
     auto const scene_end_time = std::chrono::high_resolution_clock::now();
-    LogInfo("┕ Scene loaded in %.3f s: %u textures loaded in %.3f s and %zu meshes in %.3f s",
-            std::chrono::duration<float>(scene_end_time - scene_start_time).count(),
+    LogInfo("┕ Scene loaded in %.3f s: %u textures decoded in %.3f s and uploaded in %.3f s, and %zu meshes in %.3f s",
+            std::chrono::duration<float>(scene_end_time - scene.start_time).count(),
             texture_count,
+            scene.decoding_duration,
             std::chrono::duration<float>(materials_end_time - materials_start_time).count(),
             objects.size(),
             std::chrono::duration<float>(meshes_end_time - meshes_start_time).count());
 
+    // Vertex arrays and textures were bound directly.
+    GLStateCache::Get().Invalidate();
+
     return objects;
 }
 
+std::vector<bonobo::mesh_data>
+bonobo::loadObjects(std::string const &filename) {
+    auto const scene = bonobo::importObjects(filename);
+    if (scene == nullptr)
+        return std::vector<bonobo::mesh_data>();
+
+    return bonobo::uploadObjects(*scene);
+}
+
 GLuint
 bonobo::createTexture(uint32_t width, uint32_t height, GLenum target, GLint internal_format, GLenum format, GLenum type, GLvoid const *data) {
+    GPUMemoryRegistry::Scope const memory_scope("bonobo::createTexture");
+
     GLuint texture = 0u;
     glGenTextures(1, &texture);
     assert(texture != 0u);
     glBindTexture(target, texture);
+    // Bound directly, as most callers run outside of any frame.
+    GLStateCache::Get().Invalidate();
     glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     switch (target) {
@@ -364,20 +544,14 @@ bonobo::createTexture(uint32_t width, uint32_t height, GLenum target, GLint inte
 
 GLuint
 bonobo::loadTexture2D(std::string const &filename, bool generate_mipmap) {
+    PROFILE_FUNCTION();
     std::uint32_t width, height;
     auto const data = getTextureData(filename, width, height, true);
     if (data.empty())
         return 0u;
 
-    GLuint texture = bonobo::createTexture(width, height, GL_TEXTURE_2D, GL_RGBA, GL_RGBA, GL_UNSIGNED_BYTE, reinterpret_cast<GLvoid const *>(data.data()));
-    glBindTexture(GL_TEXTURE_2D, texture);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, generate_mipmap ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    if (generate_mipmap)
-        glGenerateMipmap(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, 0u);
-
-    return texture;
+    GPUMemoryRegistry::Scope const memory_scope("bonobo::loadTexture2D(\"" + filename + "\")");
+    return createTexture2D(data, width, height, generate_mipmap);
 }
 
 GLuint
@@ -385,6 +559,8 @@ bonobo::loadTextureCubeMap(std::string const &posx, std::string const &negx,
                            std::string const &posy, std::string const &negy,
                            std::string const &posz, std::string const &negz,
                            bool generate_mipmap) {
+    GPUMemoryRegistry::Scope const memory_scope("bonobo::loadTextureCubeMap(\"" + posx + "\")");
+
     GLuint texture = 0u;
     // Create an OpenGL texture object. Similarly to `glGenVertexArrays()`
     // and `glGenBuffers()` that were used in assignment 2,
@@ -482,6 +658,7 @@ bonobo::loadTextureCubeMap(std::string const &posx, std::string const &negx,
         glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
 
     glBindTexture(GL_TEXTURE_CUBE_MAP, 0u);
+    GLStateCache::Get().Invalidate();
 
     return texture;
 }
@@ -514,21 +691,20 @@ void bonobo::displayTexture(glm::vec2 const &lower_left, glm::vec2 const &upper_
                                           relative_to_absolute(upper_right.y, window_size.y)) -
                                viewport_origin;
 
+    auto &state = GLStateCache::Get();
     glViewport(viewport_origin.x, viewport_origin.y, viewport_size.x, viewport_size.y);
-    glUseProgram(local::fullscreen_shader);
-    glBindVertexArray(local::display_vao);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture);
-    glBindSampler(0, sampler);
+    state.UseProgram(local::fullscreen_shader);
+    state.BindVertexArray(local::display_vao);
+    state.BindTexture(0u, GL_TEXTURE_2D, texture);
+    state.BindSampler(0u, sampler);
     glUniform1i(glGetUniformLocation(local::fullscreen_shader, "tex"), 0);
     glUniform4iv(glGetUniformLocation(local::fullscreen_shader, "swizzle"), 1, glm::value_ptr(swizzle));
     glUniform1i(glGetUniformLocation(local::fullscreen_shader, "linearise"), linearise);
     glUniform1f(glGetUniformLocation(local::fullscreen_shader, "near"), nearPlane);
     glUniform1f(glGetUniformLocation(local::fullscreen_shader, "far"), farPlane);
     glDrawArrays(GL_TRIANGLES, 0, 3);
-    glBindSampler(0, 0u);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glUseProgram(0);
+    // Other users of the unit may rely on the sampler state of the texture.
+    state.BindSampler(0u, 0u);
 }
 
 GLuint
@@ -549,6 +725,7 @@ bonobo::createFBO(std::vector<GLuint> const &color_attachments, GLuint depth_att
     if (depth_attachment != 0u)
         attach(GL_DEPTH_ATTACHMENT, depth_attachment);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GLStateCache::Get().Invalidate();
 
     return fbo;
 }
@@ -563,9 +740,8 @@ bonobo::createSampler(std::function<void(GLuint)> const &setup) {
 }
 
 void bonobo::drawFullscreen() {
-    glBindVertexArray(local::display_vao);
+    GLStateCache::Get().BindVertexArray(local::display_vao);
     glDrawArrays(GL_TRIANGLES, 0, 3);
-    glBindVertexArray(0u);
 }
 
 GLuint
@@ -577,15 +753,14 @@ void bonobo::renderBasis(float thickness_scale, float length_scale, glm::mat4 co
     if (basis.shader == 0u)
         return;
 
-    glUseProgram(basis.shader);
-    glBindVertexArray(basis.vao);
+    auto &state = GLStateCache::Get();
+    state.UseProgram(basis.shader);
+    state.BindVertexArray(basis.vao);
     glUniformMatrix4fv(basis.shader_locations.world, 1, GL_FALSE, glm::value_ptr(world));
     glUniformMatrix4fv(basis.shader_locations.view_proj, 1, GL_FALSE, glm::value_ptr(view_projection));
     glUniform1f(basis.shader_locations.thickness_scale, thickness_scale);
     glUniform1f(basis.shader_locations.length_scale, length_scale);
     glDrawElementsInstanced(GL_TRIANGLES, basis.index_count, GL_UNSIGNED_INT, nullptr, 3);
-    glBindVertexArray(0u);
-    glUseProgram(0u);
 }
 
 bool bonobo::uiSelectCullMode(std::string const &label, enum cull_mode_t &cull_mode) noexcept {
@@ -598,17 +773,18 @@ bool bonobo::uiSelectCullMode(std::string const &label, enum cull_mode_t &cull_m
 }
 
 void bonobo::changeCullMode(enum cull_mode_t const cull_mode) noexcept {
+    auto &state = GLStateCache::Get();
     switch (cull_mode) {
     case bonobo::cull_mode_t::disabled:
-        glDisable(GL_CULL_FACE);
+        state.Disable(GL_CULL_FACE);
         break;
     case bonobo::cull_mode_t::back_faces:
-        glEnable(GL_CULL_FACE);
-        glCullFace(GL_BACK);
+        state.Enable(GL_CULL_FACE);
+        state.CullFace(GL_BACK);
         break;
     case bonobo::cull_mode_t::front_faces:
-        glEnable(GL_CULL_FACE);
-        glCullFace(GL_FRONT);
+        state.Enable(GL_CULL_FACE);
+        state.CullFace(GL_FRONT);
         break;
     }
 }
@@ -623,15 +799,16 @@ bool bonobo::uiSelectPolygonMode(std::string const &label, enum polygon_mode_t &
 }
 
 void bonobo::changePolygonMode(enum polygon_mode_t const polygon_mode) noexcept {
+    auto &state = GLStateCache::Get();
     switch (polygon_mode) {
     case bonobo::polygon_mode_t::fill:
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        state.PolygonMode(GL_FRONT_AND_BACK, GL_FILL);
         break;
     case bonobo::polygon_mode_t::line:
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+        state.PolygonMode(GL_FRONT_AND_BACK, GL_LINE);
         break;
     case bonobo::polygon_mode_t::point:
-        glPolygonMode(GL_FRONT_AND_BACK, GL_POINT);
+        state.PolygonMode(GL_FRONT_AND_BACK, GL_POINT);
         break;
     }
 }
@@ -705,6 +882,7 @@ namespace {
         glBindVertexArray(0u);
         glBindBuffer(GL_ARRAY_BUFFER, 0U);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0U);
+        GLStateCache::Get().Invalidate();
 
         basis.shader = bonobo::createProgram("common/basis.vert", "common/basis.frag");
         if (basis.shader == 0u) {
@@ -744,6 +922,7 @@ namespace {
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, debug_texture_width, debug_texture_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, debug_texture_content.data());
         glBindTexture(GL_TEXTURE_2D, 0u);
+        GLStateCache::Get().Invalidate();
 
         utils::opengl::debug::nameObject(GL_TEXTURE, debug_texture_id, "Debug texture");
     }
@@ -7,6 +7,7 @@
 #include "core/FPSCamera.h" // As it includes OpenGL headers, import it after glad
 
 #include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -43,11 +44,15 @@ namespace bonobo
 		GLuint vao{0u};                          //!< OpenGL name of the Vertex Array Object
 		GLuint bo{0u};                           //!< OpenGL name of the Buffer Object
 		GLuint ibo{0u};                          //!< OpenGL name of the Buffer Object for indices
+		GLuint depth_vao{0u};                    //!< OpenGL name of a Vertex Array Object for depth-only passes, sourcing only positions (and texture coordinates if the mesh has an opacity texture); 0 if not available
+		GLuint depth_bo{0u};                     //!< OpenGL name of the Buffer Object backing `depth_vao`
 		GLsizei vertices_nb{0};                  //!< number of vertices stored in bo
 		GLsizei indices_nb{0};                   //!< number of indices stored in ibo
 		texture_bindings bindings{};             //!< texture bindings for this mesh
 		material_data material{};                //!< constant values for the material of this mesh
 		GLenum drawing_mode{GL_TRIANGLES};       //!< OpenGL drawing mode, i.e. GL_TRIANGLES, GL_LINES, etc.
+		glm::vec3 bounds_min{0.0f};              //!< minimum corner of the axis-aligned bounding box, in model space
+		glm::vec3 bounds_max{0.0f};              //!< maximum corner of the axis-aligned bounding box, in model space
 		std::string name{"un-named mesh"};       //!< Name of the mesh; used for debugging purposes.
 	};
 
@@ -76,6 +81,31 @@ namespace bonobo
 	//!         object found in the input file
 	std::vector<mesh_data> loadObjects(std::string const& filename);
 
+	//! \brief Content of an object/scene file read by `importObjects()`,
+	//!        waiting to be uploaded by `uploadObjects()`.
+	struct scene_import;
+
+	//! \brief First half of `loadObjects()`: read an object/scene file
+	//!        using assimp, and decode the textures of its materials on
+	//!        as many threads as there are cores.
+	//!
+	//! No OpenGL calls are made, so it can run on any thread, for example
+	//! while the main thread is busy creating the context or compiling
+	//! shaders.
+	//!
+	//! @param [in] filename of the object/scene file to load.
+	//! @return the content of the file, or nullptr if it could not be read
+	std::shared_ptr<scene_import> importObjects(std::string const& filename);
+
+	//! \brief Second half of `loadObjects()`: upload the meshes and
+	//!        textures read by `importObjects()`; it has to be called from
+	//!        the thread owning the OpenGL context.
+	//!
+	//! @param [in] scene as returned by `importObjects()`
+	//! @return a vector of filled in `mesh_data` structures, one per
+	//!         object found in the scene
+	std::vector<mesh_data> uploadObjects(scene_import const& scene);
+
 	//! \brief Creates an OpenGL texture without any content nor parameters.
 	//!
 	//! @param [in] width width of the texture to create
@@ -1,6 +1,7 @@
 #include "node.hpp"
 #include "helpers.hpp"
 
+#include "core/GLStateCache.hpp"
 #include "core/Log.h"
 #include "core/opengl.hpp"
 
@@ -22,7 +23,10 @@ Node::render(glm::mat4 const& view_projection, glm::mat4 const& world, GLuint pr
 
 	utils::opengl::debug::beginDebugGroup(_name);
 
-	glUseProgram(program);
+	// Bindings are left as they are after drawing: the state cache drops
+	// them when the next node uses the same program or textures.
+	auto& state = GLStateCache::Get();
+	state.UseProgram(program);
 
 	auto const normal_model_to_world = glm::transpose(glm::inverse(world));
 
@@ -34,8 +38,7 @@ Node::render(glm::mat4 const& view_projection, glm::mat4 const& world, GLuint pr
 
 	for (size_t i = 0u; i < _textures.size(); ++i) {
 		auto const& texture = _textures[i];
-		glActiveTexture(GL_TEXTURE0 + static_cast<GLenum>(i));
-		glBindTexture(std::get<2>(texture), std::get<1>(texture));
+		state.BindTexture(static_cast<GLuint>(i), std::get<2>(texture), std::get<1>(texture));
 		glUniform1i(glGetUniformLocation(program, std::get<0>(texture).c_str()), static_cast<GLint>(i));
 
 		std::string texture_presence_var_name = "has_" + std::get<0>(texture);
@@ -50,23 +53,21 @@ Node::render(glm::mat4 const& view_projection, glm::mat4 const& world, GLuint pr
 	glUniform1f(glGetUniformLocation(program, "index_of_refraction_value"), _constants.indexOfRefraction);
 	glUniform1f(glGetUniformLocation(program, "opacity_value"), _constants.opacity);
 
-	glBindVertexArray(_vao);
+	state.BindVertexArray(_vao);
 	if (_has_indices)
 		glDrawElements(_drawing_mode, _indices_nb, GL_UNSIGNED_INT, reinterpret_cast<GLvoid const*>(0x0));
 	else
 		glDrawArrays(_drawing_mode, 0, _vertices_nb);
-	glBindVertexArray(0u);
 
+	// The program keeps its uniforms: reset the texture ones for the next
+	// node using it.
 	for (auto const& texture : _textures) {
-		glBindTexture(std::get<2>(texture), 0);
 		glUniform1i(glGetUniformLocation(program, std::get<0>(texture).c_str()), 0);
 
 		std::string texture_presence_var_name = "has_" + std::get<0>(texture);
 		glUniform1i(glGetUniformLocation(program, texture_presence_var_name.c_str()), 0);
 	}
 
-	glUseProgram(0u);
-
 	utils::opengl::debug::endDebugGroup();
 }
 
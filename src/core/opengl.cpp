@@ -1,3 +1,5 @@
+#include "GLStateCache.hpp"
+#include "GPUMemoryRegistry.hpp"
 #include "Log.h"
 #include "opengl.hpp"
 #include "various.hpp"
@@ -114,6 +116,8 @@ endDebugGroup()
 void
 nameObject(GLenum type, GLuint id, std::string const& label)
 {
+	GPUMemoryRegistry::Get().SetLabel(type, id, label);
+
 	if (!isSupported())
 		return;
 
@@ -173,6 +177,12 @@ source_and_build_shader(GLuint id, std::string const& source)
 	glShaderSource(id, 1, &char_source, NULL);
 
 	glCompileShader(id);
+	return check_shader_compilation(id);
+}
+
+bool
+check_shader_compilation(GLuint id)
+{
 	GLint state = GLint(0);
 	glGetShaderiv(id, GL_COMPILE_STATUS, &state);
 	auto const wasCompilationSuccessful = state != GL_FALSE;
@@ -219,6 +229,12 @@ bool
 link_program(GLuint id)
 {
 	glLinkProgram(id);
+	return check_program_linking(id);
+}
+
+bool
+check_program_linking(GLuint id)
+{
 	GLint state = GLint(0);
 	glGetProgramiv(id, GL_LINK_STATUS, &state);
 	auto const wasLinkingSuccessful = state != GL_FALSE;
@@ -325,6 +341,8 @@ init(std::string const& vs_path, std::string const& fs_path, size_t width, size_
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, static_cast<GLsizei>(width), static_cast<GLsizei>(height), 0, GL_RGBA, GL_FLOAT, nullptr);
+
+	GLStateCache::Get().Invalidate();
 }
 
 void
@@ -360,6 +378,8 @@ deinit()
 		glBindVertexArray(0u);
 	glDeleteVertexArrays(1, &vao_id);
 	vao_id = 0u;
+
+	GLStateCache::Get().Invalidate();
 }
 
 GLuint
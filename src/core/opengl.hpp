@@ -39,6 +39,16 @@ void beginDebugGroup(std::string const& message, GLuint id = 0u);
 //! The call will be ignored if OpenGL debug facilities are not available.
 void endDebugGroup();
 
+//! \brief Debug group spanning the lifetime of the object.
+class ScopedDebugGroup
+{
+public:
+	explicit ScopedDebugGroup(std::string const& message) { beginDebugGroup(message); }
+	~ScopedDebugGroup() { endDebugGroup(); }
+	ScopedDebugGroup(ScopedDebugGroup const&) = delete;
+	ScopedDebugGroup& operator=(ScopedDebugGroup const&) = delete;
+};
+
 //! \brief Label an OpenGL object with a custon string.
 //!
 //! This will allow tools like RenderDoc or Nsight Graphics, or the debug
@@ -72,6 +82,16 @@ bool link_program(GLuint id);
 void reload_program(GLuint id, std::vector<GLuint> const& ids, std::vector<std::string> const& sources);
 GLuint generate_program(std::vector<GLuint> const& shaders_id);
 
+//! \brief Log the result of compiling shader `id`, once it completed.
+//!
+//! \return whether the compilation succeeded
+bool check_shader_compilation(GLuint id);
+
+//! \brief Log the result of linking program `id`, once it completed.
+//!
+//! \return whether the linking succeeded
+bool check_program_linking(GLuint id);
+
 } // end of namespace shader
 
 namespace fullscreen
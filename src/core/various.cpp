@@ -2,6 +2,7 @@
 
 #include "core/Log.h"
 
+#include <cstdio>
 #include <fstream>
 #include <iostream>
 #include <limits>
@@ -88,3 +89,57 @@ utils::slurp_file(std::string const& path)
 
   return std::string(content.get());
 }
+
+std::string
+utils::quoteCSV(std::string const& field)
+{
+	std::string quoted;
+	quoted.reserve(field.size() + 2u);
+	quoted.push_back('"');
+	for (auto const c : field) {
+		if (c == '"')
+			quoted.push_back('"');
+		quoted.push_back(c);
+	}
+	quoted.push_back('"');
+	return quoted;
+}
+
+std::string
+utils::escapeJSON(std::string const& value)
+{
+	std::string escaped;
+	escaped.reserve(value.size());
+	for (auto const c : value) {
+		switch (c) {
+			case '"':  escaped += "\\\""; break;
+			case '\\': escaped += "\\\\"; break;
+			case '\n': escaped += "\\n"; break;
+			case '\r': escaped += "\\r"; break;
+			case '\t': escaped += "\\t"; break;
+			default:
+				if (static_cast<unsigned char>(c) < 0x20u) {
+					char code[7];
+					std::snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned int>(static_cast<unsigned char>(c)));
+					escaped += code;
+				} else {
+					escaped.push_back(c);
+				}
+				break;
+		}
+	}
+	return escaped;
+}
+
+std::string
+utils::formatBytes(std::uint64_t const bytes)
+{
+	char buffer[32];
+	if (bytes >= 1024u * 1024u)
+		std::snprintf(buffer, sizeof(buffer), "%.2f MiB", static_cast<double>(bytes) / (1024.0 * 1024.0));
+	else if (bytes >= 1024u)
+		std::snprintf(buffer, sizeof(buffer), "%.2f KiB", static_cast<double>(bytes) / 1024.0);
+	else
+		std::snprintf(buffer, sizeof(buffer), "%llu B", static_cast<unsigned long long>(bytes));
+	return buffer;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 
+#include <cstdint>
 #include <string>
 
 
@@ -17,4 +18,16 @@ inline std::string const& widen(std::string const& utf8) { return utf8; }
 
 std::string slurp_file(std::string const& path);
 
+//! \brief Quote `field` for a CSV file, doubling the quotes inside it as
+//! per RFC 4180.
+std::string quoteCSV(std::string const& field);
+
+//! \brief Escape `value` for use inside a JSON string: quotes, backslashes
+//! and control characters get escaped.
+std::string escapeJSON(std::string const& value);
+
+//! \brief Format a size in bytes with the largest binary unit it reaches,
+//! up to MiB, e.g. "1.50 KiB".
+std::string formatBytes(std::uint64_t bytes);
+
 } // end of namespace